@@ -24,6 +24,7 @@
 
 #include "apply_pixel.h"
 
+#include "batch_expr.h"
 #include "external/tinyexpr/tinyexpr.h"
 
 namespace gdalcubes {
@@ -36,50 +37,34 @@ std::shared_ptr<chunk_data> apply_pixel_cube::read_chunk(chunkid_t id) {
 
     std::shared_ptr<chunk_data> out = std::make_shared<chunk_data>();
 
-    // Parse expressions and create symbol table
-    std::vector<double> values;
-    values.resize(_in_cube->bands().count() + 9, NAN);
-    // CAUTION: never change size of values from now
+    // propagate empty input chunks without parsing any expression
+    std::shared_ptr<chunk_data> in = _in_cube->read_chunk(id);
+    if (in->empty()) {
+        return out;
+    }
 
-    // Add further variables like x, y, t to symbol table
-    std::vector<te_variable> vars;
-    for (uint16_t i = 0; i < _in_cube->bands().count(); ++i) {
-        char* varname = new char[_in_cube->bands().get(i).name.length() + 1];
+    // Compile expressions, variables are the bands of the input cube followed by additional variables like x, y, t
+    uint16_t nb = _in_cube->bands().count();
+    std::vector<std::string> varnames;
+    for (uint16_t i = 0; i < nb; ++i) {
         std::string temp_name = _in_cube->bands().get(i).name;
         std::transform(temp_name.begin(), temp_name.end(), temp_name.begin(), ::tolower);
-        std::strncpy(varname, temp_name.c_str(), temp_name.length() + 1);
-        vars.push_back({varname, &values[i]});
+        varnames.push_back(temp_name);
     }
-    vars.push_back({"t0", &values[_in_cube->bands().count() + 0]});
-    vars.push_back({"t1", &values[_in_cube->bands().count() + 1]});
-    vars.push_back({"left", &values[_in_cube->bands().count() + 2]});
-    vars.push_back({"right", &values[_in_cube->bands().count() + 3]});
-    vars.push_back({"top", &values[_in_cube->bands().count() + 4]});
-    vars.push_back({"bottom", &values[_in_cube->bands().count() + 5]});
-    vars.push_back({"ix", &values[_in_cube->bands().count() + 6]});
-    vars.push_back({"iy", &values[_in_cube->bands().count() + 7]});
-    vars.push_back({"it", &values[_in_cube->bands().count() + 8]});
-
-    std::vector<te_expr*> expr;
+    varnames.insert(varnames.end(), {"t0", "t1", "left", "right", "top", "bottom", "ix", "iy", "it"});
+
+    std::vector<std::shared_ptr<batch_expr>> expr;
     for (uint16_t i = 0; i < _expr.size(); ++i) {
         int err;
-
-        te_expr* x = te_compile(_expr[i].c_str(), vars.data(), vars.size(), &err);
+        std::shared_ptr<batch_expr> x = batch_expr::compile(_expr[i], varnames, &err);
         if (!x) {
             std::string msg = "Cannot parse expression for " + _bands.get(i).name + " '" + _expr[i] + "': error at token " + std::to_string(err);
             GCBS_ERROR(msg);
-
-            // free other expressions
-            for (uint16_t j = 0; j < expr.size(); ++j) {
-                te_free(expr[j]);
-            }
             return out;
-        } else {
-            expr.push_back(x);
         }
+        expr.push_back(x);
     }
 
-    std::shared_ptr<chunk_data> in = _in_cube->read_chunk(id);
     out->size({_bands.count(), in->size()[1], in->size()[2], in->size()[3]});
     out->buf(std::calloc(_bands.count() * in->size()[1] * in->size()[2] * in->size()[3], sizeof(double)));
 
@@ -93,69 +78,81 @@ std::shared_ptr<chunk_data> apply_pixel_cube::read_chunk(chunkid_t id) {
                     sizeof(double) * in->size()[0] * in->size()[1] * in->size()[2] * in->size()[3]);
     }
 
+    const uint32_t B = batch_expr::block_size;
+    uint32_t nxy = in->size()[2] * in->size()[3];
+    uint32_t ntxy = in->size()[1] * nxy;
+    bounds_nd<uint32_t, 3> climits = _in_cube->chunk_limits(id);
+    bool regular_space = _in_cube->st_reference()->has_regular_space();
+
+    // Band variables point to the input chunk, additional variables to buffers of one block
+    std::vector<double> extra(9 * B, NAN);
+    double *t0 = &extra[0 * B], *t1 = &extra[1 * B], *left = &extra[2 * B], *right = &extra[3 * B], *top = &extra[4 * B],
+           *bottom = &extra[5 * B], *ix = &extra[6 * B], *iy = &extra[7 * B], *it = &extra[8 * B];
+    std::vector<const double*> vars(nb + 9);
+    for (uint16_t j = 0; j < 9; ++j) {
+        vars[nb + j] = &extra[j * B];
+    }
+
     uint16_t outb = (_keep_bands) ? _in_cube->size_bands() : 0;
     uint16_t expr_idx = 0;
     while (outb < _bands.count()) {
-        std::vector<uint16_t> bidx;
-        for (auto it = _band_usage[expr_idx].begin(); it != _band_usage[expr_idx].end(); ++it) {
-            bidx.push_back(_in_cube->bands().get_index(*it));
-        }
-        for (uint32_t i = 0; i < in->size()[1] * in->size()[2] * in->size()[3]; ++i) {
-            for (uint16_t inb = 0; inb < bidx.size(); ++inb) {
-                values[bidx[inb]] = ((double*)in->buf())[bidx[inb] * in->size()[1] * in->size()[2] * in->size()[3] + i];
+        batch_expr& x = *expr[expr_idx];
+
+        // check once per expression which additional variables must be computed
+        bool use_t0 = x.uses(nb + 0), use_t1 = x.uses(nb + 1);
+        bool use_left = x.uses(nb + 2) && regular_space, use_right = x.uses(nb + 3) && regular_space;
+        bool use_top = x.uses(nb + 4) && regular_space, use_bottom = x.uses(nb + 5) && regular_space;
+        bool use_it = x.uses(nb + 8) || use_t0 || use_t1;
+        bool use_ix = x.uses(nb + 6) || use_left || use_right;
+        bool use_iy = x.uses(nb + 7) || use_top || use_bottom;
+
+        double cached_it = NAN, cached_t0 = NAN, cached_t1 = NAN;
+        for (uint32_t i0 = 0; i0 < ntxy; i0 += B) {
+            uint32_t n = std::min(B, ntxy - i0);
+            for (uint16_t ib = 0; ib < nb; ++ib) {
+                vars[ib] = ((double*)in->buf()) + ib * ntxy + i0;
             }
 
-            // additional variables
-            if (_var_usage[expr_idx].count("it") || _var_usage[expr_idx].count("t0") || _var_usage[expr_idx].count("t1")) {
-                values[_in_cube->bands().count() + 8] = (double)(_in_cube->chunk_limits(id).low[0] + (i / (in->size()[2] * in->size()[3])));  // _t
+            if (use_it) {
+                for (uint32_t k = 0; k < n; ++k) it[k] = (double)(climits.low[0] + ((i0 + k) / nxy));
             }
-            if (_var_usage[expr_idx].count("t0")) {
-                values[_in_cube->bands().count() + 0] = (_in_cube->st_reference()->datetime_at_index((int)(values[_in_cube->bands().count() + 8]))).epoch_time();
+            if (use_t0 || use_t1) {
+                // time changes only every nxy pixels
+                for (uint32_t k = 0; k < n; ++k) {
+                    if (it[k] != cached_it) {
+                        cached_it = it[k];
+                        if (use_t0) cached_t0 = (_in_cube->st_reference()->datetime_at_index((int)(cached_it))).epoch_time();
+                        if (use_t1) cached_t1 = (_in_cube->st_reference()->datetime_at_index((int)(cached_it + 1))).epoch_time();
+                    }
+                    t0[k] = cached_t0;
+                    t1[k] = cached_t1;
+                }
             }
-            if (_var_usage[expr_idx].count("t1")) {
-                values[_in_cube->bands().count() + 1] = (_in_cube->st_reference()->datetime_at_index((int)(values[_in_cube->bands().count() + 8] + 1))).epoch_time();
+            if (use_ix) {
+                for (uint32_t k = 0; k < n; ++k) ix[k] = (double)(climits.low[2] + ((i0 + k) % in->size()[3]));
             }
-
-            if (_var_usage[expr_idx].count("ix") || _var_usage[expr_idx].count("left") || _var_usage[expr_idx].count("right")) {
-                values[_in_cube->bands().count() + 6] = (double)(_in_cube->chunk_limits(id).low[2] + (i % in->size()[3]));
+            if (use_iy) {
+                for (uint32_t k = 0; k < n; ++k) iy[k] = (double)(_in_cube->size_y() - 1 - (climits.high[1] - (((i0 + k) / in->size()[3]) % in->size()[2])));
             }
-            if (_var_usage[expr_idx].count("iy") || _var_usage[expr_idx].count("top") || _var_usage[expr_idx].count("bottom")) {
-                values[_in_cube->bands().count() + 7] = (double)(_in_cube->size_y() - 1 - (_in_cube->chunk_limits(id).high[1] - ((i / in->size()[3]) % in->size()[2])));
+            if (use_left) {
+                for (uint32_t k = 0; k < n; ++k) left[k] = _in_cube->st_reference()->left() + _in_cube->st_reference()->dx() * ix[k];
             }
-
-            if (_in_cube->st_reference()->has_regular_space()) {
-                if (_var_usage[expr_idx].count("left")) {
-                    values[_in_cube->bands().count() + 2] = _in_cube->st_reference()->left() +
-                                                            _in_cube->st_reference()->dx() * values[_in_cube->bands().count() + 6];
-                }
-                if (_var_usage[expr_idx].count("right")) {
-                    values[_in_cube->bands().count() + 3] = _in_cube->st_reference()->left() +
-                                                            _in_cube->st_reference()->dx() * (values[_in_cube->bands().count() + 6] + 1);
-                }
-                if (_var_usage[expr_idx].count("top")) {
-                    values[_in_cube->bands().count() + 4] = _in_cube->st_reference()->top() -
-                                                            _in_cube->st_reference()->dy() * values[_in_cube->bands().count() + 7];
-                }
-                if (_var_usage[expr_idx].count("bottom")) {
-                    values[_in_cube->bands().count() + 5] = _in_cube->st_reference()->top() -
-                                                            _in_cube->st_reference()->dy() * (values[_in_cube->bands().count() + 7] + 1);
-                }
+            if (use_right) {
+                for (uint32_t k = 0; k < n; ++k) right[k] = _in_cube->st_reference()->left() + _in_cube->st_reference()->dx() * (ix[k] + 1);
+            }
+            if (use_top) {
+                for (uint32_t k = 0; k < n; ++k) top[k] = _in_cube->st_reference()->top() - _in_cube->st_reference()->dy() * iy[k];
             }
-            ((double*)out->buf())[outb * in->size()[1] * in->size()[2] * in->size()[3] + i] = te_eval(expr[expr_idx]);
+            if (use_bottom) {
+                for (uint32_t k = 0; k < n; ++k) bottom[k] = _in_cube->st_reference()->top() - _in_cube->st_reference()->dy() * (iy[k] + 1);
+            }
+
+            x.eval(vars.data(), n, ((double*)out->buf()) + outb * ntxy + i0);
         }
         ++outb;
         ++expr_idx;
     }
 
-    // free expressions
-    for (uint16_t j = 0; j < expr.size(); ++j) {
-        te_free(expr[j]);
-    }
-    // free varnames
-    for (uint16_t i = 0; i < _in_cube->bands().count(); ++i) {
-        delete[] vars[i].name;  // delete only names of band variables
-    }
-
     return out;
 }
 
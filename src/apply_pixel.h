@@ -126,16 +126,6 @@ class apply_pixel_cube : public cube {
                     _band_usage_all.insert(name);
                 }
             }
-            _var_usage.push_back(std::unordered_set<std::string>());
-            if (_expr[i].find("ix") != std::string::npos) _var_usage[i].insert("ix");
-            if (_expr[i].find("iy") != std::string::npos) _var_usage[i].insert("iy");
-            if (_expr[i].find("it") != std::string::npos) _var_usage[i].insert("it");
-            if (_expr[i].find("left") != std::string::npos) _var_usage[i].insert("left");
-            if (_expr[i].find("right") != std::string::npos) _var_usage[i].insert("right");
-            if (_expr[i].find("top") != std::string::npos) _var_usage[i].insert("top");
-            if (_expr[i].find("bottom") != std::string::npos) _var_usage[i].insert("bottom");
-            if (_expr[i].find("t0") != std::string::npos) _var_usage[i].insert("t0");
-            if (_expr[i].find("t1") != std::string::npos) _var_usage[i].insert("t1");
         }
     }
 
@@ -144,6 +134,10 @@ class apply_pixel_cube : public cube {
 
     std::shared_ptr<chunk_data> read_chunk(chunkid_t id) override;
 
+    bool chunk_is_empty(chunkid_t id) override {
+        return _in_cube->chunk_is_empty(id);  // empty input chunks are propagated
+    }
+
     json11::Json make_constructible_json() override {
         json11::Json::object out;
         out["cube_type"] = "apply_pixel";
@@ -162,8 +156,6 @@ class apply_pixel_cube : public cube {
     std::vector<std::unordered_set<std::string>> _band_usage;  // store which bands are really used per expression
     std::unordered_set<std::string> _band_usage_all;
 
-    std::vector<std::unordered_set<std::string>> _var_usage;
-
     bool _keep_bands;
 
     bool parse_expressions();
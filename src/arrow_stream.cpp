@@ -0,0 +1,330 @@
+/*
+    MIT License
+
+    Copyright (c) 2019 Marius Appel <marius.appel@uni-muenster.de>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#include "arrow_stream.h"
+
+#include <cerrno>
+#include <cstring>
+#include <memory>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace gdalcubes {
+
+namespace {
+
+/*
+ * A tiny flatbuffer encoder, sufficient for Arrow IPC message metadata.
+ *
+ * Objects are serialized front to back: a table is written as its vtable, followed by the table itself,
+ * followed by all referenced objects. This guarantees that unsigned offsets always point forward, as required
+ * by the flatbuffers format.
+ */
+struct fb_node;
+typedef std::shared_ptr<fb_node> fb_ref;
+
+struct fb_field {
+    uint16_t slot;
+    std::string scalar;  // inline scalar bytes, empty if ref is used
+    fb_ref ref;
+};
+
+struct fb_node {
+    enum class kind { TABLE,
+                      STRING,
+                      OFFSET_VECTOR,
+                      STRUCT_VECTOR };
+    kind k;
+    std::vector<fb_field> fields;  // TABLE
+    std::string bytes;             // STRING content or STRUCT_VECTOR elements
+    uint32_t count;                // STRUCT_VECTOR
+    std::vector<fb_ref> elements;  // OFFSET_VECTOR
+};
+
+fb_ref fb_table() {
+    fb_ref n = std::make_shared<fb_node>();
+    n->k = fb_node::kind::TABLE;
+    return n;
+}
+
+template <typename T>
+void fb_add_scalar(fb_ref table, uint16_t slot, T v) {
+    fb_field f;
+    f.slot = slot;
+    f.scalar = std::string((const char *)&v, sizeof(T));
+    f.ref = nullptr;
+    table->fields.push_back(f);
+}
+
+void fb_add_ref(fb_ref table, uint16_t slot, fb_ref child) {
+    fb_field f;
+    f.slot = slot;
+    f.ref = child;
+    table->fields.push_back(f);
+}
+
+fb_ref fb_string(std::string s) {
+    fb_ref n = std::make_shared<fb_node>();
+    n->k = fb_node::kind::STRING;
+    n->bytes = s;
+    return n;
+}
+
+fb_ref fb_offset_vector(std::vector<fb_ref> elements) {
+    fb_ref n = std::make_shared<fb_node>();
+    n->k = fb_node::kind::OFFSET_VECTOR;
+    n->elements = elements;
+    return n;
+}
+
+// elements must consist of structs with 8 byte alignment
+fb_ref fb_struct_vector(std::string bytes, uint32_t count) {
+    fb_ref n = std::make_shared<fb_node>();
+    n->k = fb_node::kind::STRUCT_VECTOR;
+    n->bytes = bytes;
+    n->count = count;
+    return n;
+}
+
+void fb_pad(std::string &buf, std::size_t align, std::size_t rem = 0) {
+    while (buf.size() % align != rem) buf.push_back('\0');
+}
+
+template <typename T>
+void fb_put(std::string &buf, std::size_t pos, T v) {
+    std::memcpy(&buf[pos], &v, sizeof(T));
+}
+
+template <typename T>
+void fb_append(std::string &buf, T v) {
+    buf.append((const char *)&v, sizeof(T));
+}
+
+// serialize an object and return its position in buf
+uint32_t fb_write(std::string &buf, fb_ref n) {
+    if (n->k == fb_node::kind::STRING) {
+        fb_pad(buf, 4);
+        uint32_t pos = buf.size();
+        fb_append<uint32_t>(buf, n->bytes.size());
+        buf.append(n->bytes);
+        buf.push_back('\0');
+        return pos;
+    }
+    if (n->k == fb_node::kind::STRUCT_VECTOR) {
+        fb_pad(buf, 8, 4);  // elements must be 8 byte aligned
+        uint32_t pos = buf.size();
+        fb_append<uint32_t>(buf, n->count);
+        buf.append(n->bytes);
+        return pos;
+    }
+    if (n->k == fb_node::kind::OFFSET_VECTOR) {
+        fb_pad(buf, 4);
+        uint32_t pos = buf.size();
+        fb_append<uint32_t>(buf, n->elements.size());
+        buf.append(4 * n->elements.size(), '\0');
+        for (uint32_t i = 0; i < n->elements.size(); ++i) {
+            uint32_t epos = pos + 4 + 4 * i;
+            uint32_t cpos = fb_write(buf, n->elements[i]);
+            fb_put<uint32_t>(buf, epos, cpos - epos);
+        }
+        return pos;
+    }
+
+    // TABLE
+    uint16_t nslots = 0;
+    for (uint16_t i = 0; i < n->fields.size(); ++i) {
+        if (n->fields[i].slot + 1 > nslots) nslots = n->fields[i].slot + 1;
+    }
+    fb_pad(buf, 2);
+    uint32_t vtpos = buf.size();
+    buf.append(4 + 2 * nslots, '\0');
+    fb_pad(buf, 8);
+    uint32_t tpos = buf.size();
+    fb_append<int32_t>(buf, tpos - vtpos);
+
+    // inline fields, largest first to reduce padding
+    std::vector<uint32_t> fpos(n->fields.size(), 0);
+    for (uint16_t size = 8; size >= 1; size /= 2) {
+        for (uint16_t i = 0; i < n->fields.size(); ++i) {
+            uint16_t fsize = n->fields[i].ref ? 4 : n->fields[i].scalar.size();
+            if (fsize != size) continue;
+            fb_pad(buf, size);
+            fpos[i] = buf.size();
+            if (n->fields[i].ref) {
+                buf.append(4, '\0');
+            } else {
+                buf.append(n->fields[i].scalar);
+            }
+        }
+    }
+    fb_put<uint16_t>(buf, vtpos, 4 + 2 * nslots);
+    fb_put<uint16_t>(buf, vtpos + 2, buf.size() - tpos);
+    for (uint16_t i = 0; i < n->fields.size(); ++i) {
+        fb_put<uint16_t>(buf, vtpos + 4 + 2 * n->fields[i].slot, fpos[i] - tpos);
+    }
+
+    // referenced objects
+    for (uint16_t i = 0; i < n->fields.size(); ++i) {
+        if (!n->fields[i].ref) continue;
+        uint32_t cpos = fb_write(buf, n->fields[i].ref);
+        fb_put<uint32_t>(buf, fpos[i], cpos - fpos[i]);
+    }
+    return tpos;
+}
+
+std::string fb_finish(fb_ref root) {
+    std::string buf;
+    fb_append<uint32_t>(buf, 0);
+    uint32_t pos = fb_write(buf, root);
+    fb_put<uint32_t>(buf, 0, pos);
+    return buf;
+}
+
+fb_ref fb_key_values(const arrow_stream_writer::key_value_list &kv) {
+    std::vector<fb_ref> out;
+    for (uint32_t i = 0; i < kv.size(); ++i) {
+        fb_ref t = fb_table();
+        fb_add_ref(t, 0, fb_string(kv[i].first));
+        fb_add_ref(t, 1, fb_string(kv[i].second));
+        out.push_back(t);
+    }
+    return fb_offset_vector(out);
+}
+
+// constants from Arrow's Schema.fbs and Message.fbs
+const int16_t ARROW_METADATA_V5 = 4;
+const uint8_t ARROW_HEADER_SCHEMA = 1;
+const uint8_t ARROW_HEADER_RECORD_BATCH = 3;
+const uint8_t ARROW_TYPE_FLOATING_POINT = 3;
+const int16_t ARROW_PRECISION_DOUBLE = 2;
+
+fb_ref arrow_message(uint8_t header_type, fb_ref header, int64_t body_length, const arrow_stream_writer::key_value_list &metadata) {
+    fb_ref msg = fb_table();
+    fb_add_scalar<int16_t>(msg, 0, ARROW_METADATA_V5);
+    fb_add_scalar<uint8_t>(msg, 1, header_type);
+    fb_add_ref(msg, 2, header);
+    fb_add_scalar<int64_t>(msg, 3, body_length);
+    if (!metadata.empty()) {
+        fb_add_ref(msg, 4, fb_key_values(metadata));
+    }
+    return msg;
+}
+
+}  // namespace
+
+void arrow_stream_writer::write_bytes(const void *buf, std::size_t n) {
+    const char *p = (const char *)buf;
+    while (n > 0) {
+#ifdef _WIN32
+        int res = _write(_fd, p, (unsigned int)n);
+#else
+        ssize_t res = ::write(_fd, p, n);
+#endif
+        if (res < 0) {
+            if (errno == EINTR) continue;
+            throw std::string("ERROR in arrow_stream_writer::write_bytes(): write failed (" + std::string(std::strerror(errno)) + ")");
+        }
+        p += res;
+        n -= res;
+    }
+}
+
+void arrow_stream_writer::write_message(const std::string &metadata) {
+    // encapsulated message: continuation marker, metadata length, metadata padded to 8 bytes
+    uint32_t padded = (metadata.size() + 7) / 8 * 8;
+    uint32_t prefix[2] = {0xFFFFFFFF, padded};
+    write_bytes(prefix, 8);
+    write_bytes(metadata.data(), metadata.size());
+    std::string padding(padded - metadata.size(), '\0');
+    write_bytes(padding.data(), padding.size());
+}
+
+void arrow_stream_writer::write_schema(std::vector<std::string> columns, key_value_list metadata) {
+    int16_t one = 1;
+    int16_t endianness = (*(char *)&one == 1) ? 0 : 1;
+
+    std::vector<fb_ref> fields;
+    for (uint16_t i = 0; i < columns.size(); ++i) {
+        fb_ref type = fb_table();
+        fb_add_scalar<int16_t>(type, 0, ARROW_PRECISION_DOUBLE);
+
+        fb_ref field = fb_table();
+        fb_add_ref(field, 0, fb_string(columns[i]));
+        fb_add_scalar<uint8_t>(field, 1, 0);  // not nullable
+        fb_add_scalar<uint8_t>(field, 2, ARROW_TYPE_FLOATING_POINT);
+        fb_add_ref(field, 3, type);
+        fb_add_ref(field, 5, fb_offset_vector(std::vector<fb_ref>()));  // children
+        fields.push_back(field);
+    }
+    fb_ref schema = fb_table();
+    fb_add_scalar<int16_t>(schema, 0, endianness);
+    fb_add_ref(schema, 1, fb_offset_vector(fields));
+    if (!metadata.empty()) {
+        fb_add_ref(schema, 2, fb_key_values(metadata));
+    }
+    write_message(fb_finish(arrow_message(ARROW_HEADER_SCHEMA, schema, 0, key_value_list())));
+    _ncol = columns.size();
+}
+
+void arrow_stream_writer::write_record_batch(uint64_t nrows, std::vector<const double *> columns, key_value_list metadata) {
+    if (columns.size() != _ncol) {
+        throw std::string("ERROR in arrow_stream_writer::write_record_batch(): number of columns does not match the schema");
+    }
+
+    // per column: one field node, an empty validity buffer, and the data buffer (8 byte multiple, needs no padding)
+    std::string nodes;
+    std::string buffers;
+    int64_t offset = 0;
+    for (uint16_t i = 0; i < columns.size(); ++i) {
+        fb_append<int64_t>(nodes, nrows);
+        fb_append<int64_t>(nodes, 0);
+
+        fb_append<int64_t>(buffers, offset);
+        fb_append<int64_t>(buffers, 0);
+        fb_append<int64_t>(buffers, offset);
+        fb_append<int64_t>(buffers, nrows * sizeof(double));
+        offset += nrows * sizeof(double);
+    }
+
+    fb_ref batch = fb_table();
+    fb_add_scalar<int64_t>(batch, 0, nrows);
+    fb_add_ref(batch, 1, fb_struct_vector(nodes, columns.size()));
+    fb_add_ref(batch, 2, fb_struct_vector(buffers, 2 * columns.size()));
+    write_message(fb_finish(arrow_message(ARROW_HEADER_RECORD_BATCH, batch, offset, metadata)));
+
+    for (uint16_t i = 0; i < columns.size(); ++i) {
+        write_bytes(columns[i], nrows * sizeof(double));
+    }
+}
+
+void arrow_stream_writer::write_eos() {
+    uint32_t eos[2] = {0xFFFFFFFF, 0};
+    write_bytes(eos, 8);
+}
+
+}  // namespace gdalcubes
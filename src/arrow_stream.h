@@ -0,0 +1,85 @@
+/*
+    MIT License
+
+    Copyright (c) 2019 Marius Appel <marius.appel@uni-muenster.de>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#ifndef ARROW_STREAM_H
+#define ARROW_STREAM_H
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace gdalcubes {
+
+/**
+ * @brief Minimal writer for the Apache Arrow IPC streaming format
+ *
+ * This class writes a schema message with float64 columns, any number of record batches, and an end-of-stream marker
+ * to a file descriptor (https://arrow.apache.org/docs/format/Columnar.html#ipc-streaming-format).
+ * Message metadata is serialized as flatbuffers by a small built-in encoder, such that no dependency on the Arrow library is needed.
+ * Column data of record batches is written directly from the provided buffers without copying.
+ *
+ * Only non-nullable float64 columns are supported, missing values are represented as NaN.
+ */
+class arrow_stream_writer {
+   public:
+    typedef std::vector<std::pair<std::string, std::string>> key_value_list;
+
+    /**
+     * @brief Create a writer for a given file descriptor
+     * @param fd file descriptor of an open file or pipe, the writer does not close it
+     */
+    arrow_stream_writer(int fd) : _fd(fd), _ncol(0) {}
+
+    /**
+     * @brief Write the schema message, must be called exactly once before writing record batches
+     * @param columns names of float64 columns
+     * @param metadata custom key value metadata of the schema
+     */
+    void write_schema(std::vector<std::string> columns, key_value_list metadata = key_value_list());
+
+    /**
+     * @brief Write a record batch message
+     * @param nrows number of rows
+     * @param columns pointers to the data of all columns, each pointing to nrows contiguous double values
+     * @param metadata custom key value metadata of the batch
+     */
+    void write_record_batch(uint64_t nrows, std::vector<const double *> columns, key_value_list metadata = key_value_list());
+
+    /**
+     * @brief Write the end-of-stream marker
+     */
+    void write_eos();
+
+   private:
+    void write_message(const std::string &metadata);
+    void write_bytes(const void *buf, std::size_t n);
+
+    int _fd;
+    uint16_t _ncol;
+};
+
+}  // namespace gdalcubes
+
+#endif  //ARROW_STREAM_H
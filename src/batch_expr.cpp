@@ -0,0 +1,272 @@
+/*
+    MIT License
+
+    Copyright (c) 2019 Marius Appel <marius.appel@uni-muenster.de>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#include "batch_expr.h"
+
+#include <cmath>
+#include <cstring>
+#include <map>
+
+#include "external/tinyexpr/tinyexpr.h"
+
+namespace gdalcubes {
+
+namespace {
+
+// node types of tinyexpr that are not part of its public interface
+const int TE_CONSTANT = 1;
+inline int te_type_mask(int type) { return type & 0x0000001F; }
+inline int te_arity(int type) { return (type & (TE_FUNCTION0 | TE_CLOSURE0)) ? (type & 0x00000007) : 0; }
+
+enum op_code : uint8_t {
+    OP_ADD,
+    OP_SUB,
+    OP_MUL,
+    OP_DIV,
+    OP_NEG,
+    OP_LT,
+    OP_LTE,
+    OP_GT,
+    OP_GTE,
+    OP_EQ,
+    OP_NEQ,
+    OP_AND,
+    OP_OR,
+    OP_IFELSE,
+    OP_COMMA,
+    OP_ABS,
+    OP_SQRT,
+    OP_FLOOR,
+    OP_CEIL,
+    OP_ISNAN,
+    OP_CALL  // any other function, called per pixel
+};
+
+/**
+ * Operators of tinyexpr are implemented as static functions, their addresses are taken from compiled reference
+ * expressions.
+ */
+const std::map<void (*)(void), op_code> &known_functions() {
+    static const std::map<void (*)(void), op_code> ops = []() {
+        std::map<void (*)(void), op_code> out;
+        double a = 1, b = 1, c = 1;
+        te_variable vars[] = {{"a", &a, TE_VARIABLE, nullptr}, {"b", &b, TE_VARIABLE, nullptr}, {"c", &c, TE_VARIABLE, nullptr}};
+        std::vector<std::pair<std::string, op_code>> ref = {
+            {"a+b", OP_ADD}, {"a-b", OP_SUB}, {"a*b", OP_MUL}, {"a/b", OP_DIV}, {"-a", OP_NEG}, {"a<b", OP_LT}, {"a<=b", OP_LTE}, {"a>b", OP_GT}, {"a>=b", OP_GTE}, {"a==b", OP_EQ}, {"a!=b", OP_NEQ}, {"a&&b", OP_AND}, {"a||b", OP_OR}, {"ifelse(a,b,c)", OP_IFELSE}, {"(a,b)", OP_COMMA}, {"abs(a)", OP_ABS}, {"sqrt(a)", OP_SQRT}, {"floor(a)", OP_FLOOR}, {"ceil(a)", OP_CEIL}, {"isnan(a)", OP_ISNAN}};
+        for (auto it = ref.begin(); it != ref.end(); ++it) {
+            int err;
+            te_expr *x = te_compile(it->first.c_str(), vars, 3, &err);
+            if (x && (x->type & TE_FUNCTION0)) {
+                out[x->binding.function] = it->second;
+            }
+            te_free(x);
+        }
+        return out;
+    }();
+    return ops;
+}
+
+}  // namespace
+
+const uint32_t batch_expr::block_size;
+
+std::shared_ptr<batch_expr> batch_expr::compile(const std::string &expr, const std::vector<std::string> &vars, int *err) {
+    // variables are bound to dummy addresses that identify them in the syntax tree
+    std::vector<double> var_addr(vars.size(), 1.0);
+    std::vector<te_variable> te_vars;
+    for (uint16_t i = 0; i < vars.size(); ++i) {
+        te_vars.push_back({vars[i].c_str(), &var_addr[i], TE_VARIABLE, nullptr});
+    }
+    te_expr *x = te_compile(expr.c_str(), te_vars.data(), te_vars.size(), err);
+    if (!x) {
+        return nullptr;
+    }
+
+    std::shared_ptr<batch_expr> out = std::shared_ptr<batch_expr>(new batch_expr());
+    out->_uses.resize(vars.size(), false);
+    try {
+        out->_result = out->compile_node(x, var_addr.data(), vars.size());
+    } catch (...) {
+        te_free(x);
+        throw;
+    }
+    te_free(x);
+
+    out->_regs.resize(std::size_t(out->_nregs) * block_size);
+    for (auto it = out->_constants.begin(); it != out->_constants.end(); ++it) {
+        std::fill(out->_regs.begin() + std::size_t(it->first) * block_size, out->_regs.begin() + std::size_t(it->first + 1) * block_size, it->second);
+    }
+    return out;
+}
+
+int64_t batch_expr::compile_node(const void *node, const double *var_addr, uint16_t nvars) {
+    const te_expr *n = (const te_expr *)node;
+    int type = te_type_mask(n->type);
+    if (type == TE_CONSTANT) {
+        _constants.push_back(std::make_pair(_nregs, n->binding.value));
+        return _nregs++;
+    }
+    if (type == TE_VARIABLE) {
+        int64_t var = n->binding.bound - var_addr;
+        if (var < 0 || var >= nvars) {
+            throw std::string("ERROR in batch_expr::compile(): unknown variable in expression");
+        }
+        _uses[var] = true;
+        return -1 - var;
+    }
+    if (type < TE_FUNCTION0 || type > TE_FUNCTION7) {
+        throw std::string("ERROR in batch_expr::compile(): closures are not supported");
+    }
+
+    instruction ins;
+    ins.arity = te_arity(n->type);
+    for (uint8_t i = 0; i < ins.arity; ++i) {
+        ins.args[i] = compile_node(n->parameters[i], var_addr, nvars);
+    }
+    auto op = known_functions().find(n->binding.function);
+    ins.op = (op == known_functions().end()) ? OP_CALL : op->second;
+    ins.function = n->binding.function;
+    ins.dst = _nregs++;
+    _code.push_back(ins);
+    return ins.dst;
+}
+
+void batch_expr::eval(const double *const *vars, uint32_t n, double *out) {
+    if (_result < 0) {
+        std::memcpy(out, vars[-1 - _result], sizeof(double) * n);
+        return;
+    }
+    if (_code.empty()) {  // constant
+        std::memcpy(out, _regs.data() + std::size_t(_result) * block_size, sizeof(double) * n);
+        return;
+    }
+
+    for (uint32_t ic = 0; ic < _code.size(); ++ic) {
+        const instruction &ins = _code[ic];
+        const double *a[7] = {nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr};
+        // the last instruction writes its result to the output buffer directly
+        double *r = (ic == _code.size() - 1) ? out : _regs.data() + std::size_t(ins.dst) * block_size;
+        for (uint8_t i = 0; i < ins.arity; ++i) {
+            a[i] = (ins.args[i] < 0) ? vars[-1 - ins.args[i]] : _regs.data() + std::size_t(ins.args[i]) * block_size;
+        }
+        const double *x = a[0];
+        const double *y = a[1];
+        switch (ins.op) {
+            case OP_ADD:
+                for (uint32_t k = 0; k < n; ++k) r[k] = x[k] + y[k];
+                break;
+            case OP_SUB:
+                for (uint32_t k = 0; k < n; ++k) r[k] = x[k] - y[k];
+                break;
+            case OP_MUL:
+                for (uint32_t k = 0; k < n; ++k) r[k] = x[k] * y[k];
+                break;
+            case OP_DIV:
+                for (uint32_t k = 0; k < n; ++k) r[k] = x[k] / y[k];
+                break;
+            case OP_NEG:
+                for (uint32_t k = 0; k < n; ++k) r[k] = -x[k];
+                break;
+            case OP_LT:
+                for (uint32_t k = 0; k < n; ++k) r[k] = x[k] < y[k];
+                break;
+            case OP_LTE:
+                for (uint32_t k = 0; k < n; ++k) r[k] = x[k] <= y[k];
+                break;
+            case OP_GT:
+                for (uint32_t k = 0; k < n; ++k) r[k] = x[k] > y[k];
+                break;
+            case OP_GTE:
+                for (uint32_t k = 0; k < n; ++k) r[k] = x[k] >= y[k];
+                break;
+            case OP_EQ:
+                for (uint32_t k = 0; k < n; ++k) r[k] = x[k] == y[k];
+                break;
+            case OP_NEQ:
+                for (uint32_t k = 0; k < n; ++k) r[k] = x[k] != y[k];
+                break;
+            case OP_AND:
+                for (uint32_t k = 0; k < n; ++k) r[k] = (int)(x[k]) && (int)(y[k]);
+                break;
+            case OP_OR:
+                for (uint32_t k = 0; k < n; ++k) r[k] = (int)(x[k]) || (int)(y[k]);
+                break;
+            case OP_IFELSE: {
+                const double *z = a[2];
+                for (uint32_t k = 0; k < n; ++k) r[k] = (int)(x[k]) ? y[k] : z[k];
+                break;
+            }
+            case OP_COMMA:
+                if (r != y) std::memcpy(r, y, sizeof(double) * n);
+                break;
+            case OP_ABS:
+                for (uint32_t k = 0; k < n; ++k) r[k] = std::fabs(x[k]);
+                break;
+            case OP_SQRT:
+                for (uint32_t k = 0; k < n; ++k) r[k] = std::sqrt(x[k]);
+                break;
+            case OP_FLOOR:
+                for (uint32_t k = 0; k < n; ++k) r[k] = std::floor(x[k]);
+                break;
+            case OP_CEIL:
+                for (uint32_t k = 0; k < n; ++k) r[k] = std::ceil(x[k]);
+                break;
+            case OP_ISNAN:
+                for (uint32_t k = 0; k < n; ++k) r[k] = std::isnan(x[k]);
+                break;
+            case OP_CALL:
+                switch (ins.arity) {
+                    case 0: {
+                        double v = ((double (*)(void))ins.function)();
+                        std::fill(r, r + n, v);
+                        break;
+                    }
+                    case 1:
+                        for (uint32_t k = 0; k < n; ++k) r[k] = ((double (*)(double))ins.function)(x[k]);
+                        break;
+                    case 2:
+                        for (uint32_t k = 0; k < n; ++k) r[k] = ((double (*)(double, double))ins.function)(x[k], y[k]);
+                        break;
+                    case 3:
+                        for (uint32_t k = 0; k < n; ++k) r[k] = ((double (*)(double, double, double))ins.function)(x[k], y[k], a[2][k]);
+                        break;
+                    case 4:
+                        for (uint32_t k = 0; k < n; ++k) r[k] = ((double (*)(double, double, double, double))ins.function)(x[k], y[k], a[2][k], a[3][k]);
+                        break;
+                    case 5:
+                        for (uint32_t k = 0; k < n; ++k) r[k] = ((double (*)(double, double, double, double, double))ins.function)(x[k], y[k], a[2][k], a[3][k], a[4][k]);
+                        break;
+                    case 6:
+                        for (uint32_t k = 0; k < n; ++k) r[k] = ((double (*)(double, double, double, double, double, double))ins.function)(x[k], y[k], a[2][k], a[3][k], a[4][k], a[5][k]);
+                        break;
+                    case 7:
+                        for (uint32_t k = 0; k < n; ++k) r[k] = ((double (*)(double, double, double, double, double, double, double))ins.function)(x[k], y[k], a[2][k], a[3][k], a[4][k], a[5][k], a[6][k]);
+                        break;
+                }
+                break;
+        }
+    }
+}
+
+}  // namespace gdalcubes
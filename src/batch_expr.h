@@ -0,0 +1,98 @@
+/*
+    MIT License
+
+    Copyright (c) 2019 Marius Appel <marius.appel@uni-muenster.de>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#ifndef BATCH_EXPR_H
+#define BATCH_EXPR_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace gdalcubes {
+
+/**
+ * @brief An arithmetic expression that is evaluated for blocks of pixels at once
+ *
+ * Expressions are parsed with tinyexpr and the resulting syntax tree is translated to a flat list of instructions.
+ * Each instruction computes an intermediate result for a whole block of pixels in a simple loop, such that the
+ * compiler can vectorize arithmetic operations and there are no recursive calls and no branches per pixel. Results
+ * are identical to te_eval().
+ *
+ * Objects hold buffers for intermediate results and must not be used by several threads at the same time.
+ */
+class batch_expr {
+   public:
+    /**
+     * @brief Maximum number of pixels per call of eval()
+     */
+    static const uint32_t block_size = 1024;
+
+    /**
+     * @brief Parse an expression
+     * @param expr expression
+     * @param vars names of the variables, variable i refers to the i-th pointer passed to eval()
+     * @param err set to the position of a parse error, if any
+     * @return compiled expression or nullptr if the expression cannot be parsed
+     */
+    static std::shared_ptr<batch_expr> compile(const std::string &expr, const std::vector<std::string> &vars, int *err);
+
+    /**
+     * @brief Check whether the expression refers to a variable
+     * @param var index of the variable
+     */
+    inline bool uses(uint16_t var) const { return var < _uses.size() && _uses[var]; }
+
+    /**
+     * @brief Evaluate the expression for a block of pixels
+     * @param vars pointers to n contiguous values per variable, pointers of variables that are not used may be null
+     * @param n number of pixels, at most block_size
+     * @param out output buffer of n values
+     */
+    void eval(const double *const *vars, uint32_t n, double *out);
+
+   private:
+    batch_expr() : _code(), _result(0), _nregs(0), _constants(), _regs(), _uses() {}
+
+    struct instruction {
+        uint8_t op;
+        uint8_t arity;
+        uint32_t dst;           // register
+        int64_t args[7];         // register (>= 0) or variable (-1 - index)
+        void (*function)(void);  // generic function calls only
+    };
+
+    int64_t compile_node(const void *node, const double *var_addr, uint16_t nvars);
+
+    std::vector<instruction> _code;
+    int64_t _result;  // register or variable of the result
+    uint32_t _nregs;
+    std::vector<std::pair<uint32_t, double>> _constants;
+    std::vector<double> _regs;  // block_size values per register, constants are filled once
+    std::vector<bool> _uses;
+};
+
+}  // namespace gdalcubes
+
+#endif  //BATCH_EXPR_H
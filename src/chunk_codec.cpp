@@ -0,0 +1,297 @@
+/*
+    MIT License
+
+    Copyright (c) 2019 Marius Appel <marius.appel@uni-muenster.de>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+
+#include "chunk_codec.h"
+
+#include <cpl_conv.h>
+
+#include <cmath>
+#include <cstring>
+#include <sstream>
+
+namespace gdalcubes {
+
+const uint32_t chunk_codec::MAGIC;
+const uint8_t chunk_codec::VERSION;
+const std::size_t chunk_codec::HEADER_SIZE;
+
+uint8_t chunk_codec::parse_encoding(std::string s) {
+    uint8_t out = RAW;
+    std::stringstream ss(s);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        // trim whitespace
+        item.erase(0, item.find_first_not_of(" \t"));
+        item.erase(item.find_last_not_of(" \t") + 1);
+        if (item == "float32") {
+            out |= FLOAT32;
+        } else if (item == "nanmask") {
+            out |= NANMASK;
+        } else if (item == "deflate") {
+            out |= DEFLATE;
+        }
+    }
+    return out;
+}
+
+std::string chunk_codec::encoding_string(uint8_t encoding) {
+    std::vector<std::string> items;
+    if (encoding & FLOAT32) items.push_back("float32");
+    if (encoding & NANMASK) items.push_back("nanmask");
+    if (encoding & DEFLATE) items.push_back("deflate");
+    if (items.empty()) return "raw";
+    std::string out = items[0];
+    for (uint16_t i = 1; i < items.size(); ++i) {
+        out += "," + items[i];
+    }
+    return out;
+}
+
+std::vector<unsigned char> chunk_codec::encode(std::shared_ptr<chunk_data> dat, uint8_t encoding, int deflate_level) {
+    // empty chunks are always transferred with zero size
+    uint32_t size[4] = {0, 0, 0, 0};
+    if (!dat->empty()) {
+        for (uint16_t i = 0; i < 4; ++i) size[i] = dat->size()[i];
+    }
+    uint64_t n = uint64_t(size[0]) * uint64_t(size[1]) * uint64_t(size[2]) * uint64_t(size[3]);
+    const double *values = (const double *)dat->buf();
+
+    if (encoding == RAW) {
+        std::vector<unsigned char> out(4 * sizeof(uint32_t) + n * sizeof(double));
+        std::memcpy(out.data(), size, 4 * sizeof(uint32_t));
+        if (n > 0) {
+            std::memcpy(out.data() + 4 * sizeof(uint32_t), values, n * sizeof(double));
+        }
+        return out;
+    }
+
+    uint8_t value_size = (encoding & FLOAT32) ? sizeof(float) : sizeof(double);
+
+    // payload
+    std::vector<unsigned char> payload;
+    if (encoding & NANMASK) {
+        uint64_t nmask = (n + 7) / 8;
+        payload.resize(nmask, 0);
+        uint64_t nvalid = 0;
+        for (uint64_t i = 0; i < n; ++i) {
+            if (!std::isnan(values[i])) {
+                payload[i / 8] |= (1 << (i % 8));
+                ++nvalid;
+            }
+        }
+        payload.resize(nmask + nvalid * value_size);
+        unsigned char *cur = payload.data() + nmask;
+        for (uint64_t i = 0; i < n; ++i) {
+            if (!std::isnan(values[i])) {
+                if (encoding & FLOAT32) {
+                    float v = (float)values[i];
+                    std::memcpy(cur, &v, sizeof(float));
+                } else {
+                    std::memcpy(cur, &values[i], sizeof(double));
+                }
+                cur += value_size;
+            }
+        }
+    } else {
+        payload.resize(n * value_size);
+        if (encoding & FLOAT32) {
+            float *cur = (float *)payload.data();
+            for (uint64_t i = 0; i < n; ++i) {
+                cur[i] = (float)values[i];
+            }
+        } else if (n > 0) {
+            std::memcpy(payload.data(), values, n * sizeof(double));
+        }
+    }
+
+    uint64_t payload_size = payload.size();
+    void *compressed = nullptr;
+    std::size_t ncompressed = 0;
+    if ((encoding & DEFLATE) && payload_size > 0) {
+        compressed = CPLZLibDeflate(payload.data(), payload.size(), deflate_level, nullptr, 0, &ncompressed);
+        if (compressed && ncompressed >= payload.size()) {
+            // not worth it
+            CPLFree(compressed);
+            compressed = nullptr;
+        }
+    }
+    if (!compressed) {
+        encoding &= ~DEFLATE;
+    }
+
+    std::vector<unsigned char> out(HEADER_SIZE + (compressed ? ncompressed : payload.size()));
+    uint32_t magic = MAGIC;
+    std::memcpy(out.data(), &magic, 4);
+    out[4] = VERSION;
+    out[5] = encoding;
+    out[6] = 0;
+    out[7] = 0;
+    std::memcpy(out.data() + 8, size, 4 * sizeof(uint32_t));
+    std::memcpy(out.data() + 24, &payload_size, sizeof(uint64_t));
+    if (compressed) {
+        std::memcpy(out.data() + HEADER_SIZE, compressed, ncompressed);
+        CPLFree(compressed);
+    } else if (!payload.empty()) {
+        std::memcpy(out.data() + HEADER_SIZE, payload.data(), payload.size());
+    }
+    return out;
+}
+
+std::shared_ptr<chunk_data> chunk_codec::decode(const unsigned char *buf, std::size_t n) {
+    std::shared_ptr<chunk_data> out = std::make_shared<chunk_data>();
+    if (n < 4 * sizeof(uint32_t)) {
+        throw std::string("ERROR in chunk_codec::decode(): invalid chunk data (too short)");
+    }
+    uint32_t magic;
+    std::memcpy(&magic, buf, 4);
+
+    if (magic != MAGIC) {
+        // raw format
+        std::array<uint32_t, 4> size;
+        std::memcpy(size.data(), buf, 4 * sizeof(uint32_t));
+        uint64_t ncells = uint64_t(size[0]) * uint64_t(size[1]) * uint64_t(size[2]) * uint64_t(size[3]);
+        if (ncells == 0) {
+            return out;
+        }
+        if (n != 4 * sizeof(uint32_t) + ncells * sizeof(double)) {
+            throw std::string("ERROR in chunk_codec::decode(): size of raw chunk data does not match chunk size");
+        }
+        out->size(size);
+        out->buf(std::malloc(ncells * sizeof(double)));
+        std::memcpy(out->buf(), buf + 4 * sizeof(uint32_t), ncells * sizeof(double));
+        return out;
+    }
+
+    if (n < HEADER_SIZE) {
+        throw std::string("ERROR in chunk_codec::decode(): invalid chunk data (incomplete header)");
+    }
+    if (buf[4] != VERSION) {
+        throw std::string("ERROR in chunk_codec::decode(): unsupported chunk encoding version " + std::to_string(buf[4]));
+    }
+    uint8_t encoding = buf[5];
+    std::array<uint32_t, 4> size;
+    std::memcpy(size.data(), buf + 8, 4 * sizeof(uint32_t));
+    uint64_t payload_size;
+    std::memcpy(&payload_size, buf + 24, sizeof(uint64_t));
+
+    uint64_t ncells = uint64_t(size[0]) * uint64_t(size[1]) * uint64_t(size[2]) * uint64_t(size[3]);
+    if (ncells == 0) {
+        return out;
+    }
+
+    const unsigned char *payload = buf + HEADER_SIZE;
+    std::vector<unsigned char> inflated;
+    if (encoding & DEFLATE) {
+        inflated.resize(payload_size);
+        std::size_t ninflated = 0;
+        if (!CPLZLibInflate(buf + HEADER_SIZE, n - HEADER_SIZE, inflated.data(), inflated.size(), &ninflated) || ninflated != payload_size) {
+            throw std::string("ERROR in chunk_codec::decode(): cannot decompress chunk data");
+        }
+        payload = inflated.data();
+    } else if (n - HEADER_SIZE != payload_size) {
+        throw std::string("ERROR in chunk_codec::decode(): size of chunk data does not match header");
+    }
+
+    uint8_t value_size = (encoding & FLOAT32) ? sizeof(float) : sizeof(double);
+    out->size(size);
+    out->buf(std::malloc(ncells * sizeof(double)));
+    double *values = (double *)out->buf();
+
+    if (encoding & NANMASK) {
+        uint64_t nmask = (ncells + 7) / 8;
+        if (payload_size < nmask) {
+            throw std::string("ERROR in chunk_codec::decode(): invalid validity mask");
+        }
+        const unsigned char *cur = payload + nmask;
+        const unsigned char *end = payload + payload_size;
+        for (uint64_t i = 0; i < ncells; ++i) {
+            if (payload[i / 8] & (1 << (i % 8))) {
+                if (cur + value_size > end) {
+                    throw std::string("ERROR in chunk_codec::decode(): validity mask does not match number of values");
+                }
+                if (encoding & FLOAT32) {
+                    float v;
+                    std::memcpy(&v, cur, sizeof(float));
+                    values[i] = v;
+                } else {
+                    std::memcpy(&values[i], cur, sizeof(double));
+                }
+                cur += value_size;
+            } else {
+                values[i] = NAN;
+            }
+        }
+    } else {
+        if (payload_size != ncells * value_size) {
+            throw std::string("ERROR in chunk_codec::decode(): size of chunk data does not match chunk size");
+        }
+        if (encoding & FLOAT32) {
+            const float *in = (const float *)payload;
+            for (uint64_t i = 0; i < ncells; ++i) {
+                values[i] = in[i];
+            }
+        } else {
+            std::memcpy(values, payload, ncells * sizeof(double));
+        }
+    }
+    return out;
+}
+
+std::vector<unsigned char> chunk_codec::encode_frame(uint32_t chunk_id, uint32_t status, const std::vector<unsigned char> &content) {
+    std::vector<unsigned char> out(FRAME_HEADER_SIZE + content.size());
+    uint64_t length = content.size();
+    std::memcpy(out.data(), &chunk_id, sizeof(uint32_t));
+    std::memcpy(out.data() + 4, &status, sizeof(uint32_t));
+    std::memcpy(out.data() + 8, &length, sizeof(uint64_t));
+    if (!content.empty()) {
+        std::memcpy(out.data() + FRAME_HEADER_SIZE, content.data(), content.size());
+    }
+    return out;
+}
+
+void chunk_frame_reader::feed(const unsigned char *buf, std::size_t n) {
+    _buf.insert(_buf.end(), buf, buf + n);
+    while (_buf.size() - _pos >= chunk_codec::FRAME_HEADER_SIZE) {
+        uint32_t chunk_id;
+        uint32_t status;
+        uint64_t length;
+        std::memcpy(&chunk_id, _buf.data() + _pos, sizeof(uint32_t));
+        std::memcpy(&status, _buf.data() + _pos + 4, sizeof(uint32_t));
+        std::memcpy(&length, _buf.data() + _pos + 8, sizeof(uint64_t));
+        if (_buf.size() - _pos - chunk_codec::FRAME_HEADER_SIZE < length) break;
+        _f(chunk_id, status, _buf.data() + _pos + chunk_codec::FRAME_HEADER_SIZE, length);
+        _pos += chunk_codec::FRAME_HEADER_SIZE + length;
+    }
+    // drop consumed frames
+    if (_pos == _buf.size()) {
+        _buf.clear();
+        _pos = 0;
+    } else if (_pos > _buf.size() / 2) {
+        _buf.erase(_buf.begin(), _buf.begin() + _pos);
+        _pos = 0;
+    }
+}
+
+}  // namespace gdalcubes
@@ -0,0 +1,149 @@
+/*
+    MIT License
+
+    Copyright (c) 2019 Marius Appel <marius.appel@uni-muenster.de>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+
+#ifndef CHUNK_CODEC_H
+#define CHUNK_CODEC_H
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "cube.h"
+
+namespace gdalcubes {
+
+/**
+ * @brief Binary encodings of chunk data for the transfer between gdalcubes_server and gdalcubes_swarm
+ *
+ * The default (raw) encoding, as returned by servers without encoding support, consists of the chunk size
+ * (4 x uint32) followed by the chunk buffer as doubles. Encoded chunks start with a header instead:
+ *
+ * | bytes | content                                                          |
+ * |-------|------------------------------------------------------------------|
+ * | 4     | magic number `GCCE`                                              |
+ * | 1     | format version (1)                                               |
+ * | 1     | encoding flags, combination of FLOAT32, NANMASK, and DEFLATE     |
+ * | 2     | reserved                                                         |
+ * | 16    | chunk size (4 x uint32, btyx)                                    |
+ * | 8     | size of the payload before compression (uint64)                  |
+ * | ...   | payload                                                          |
+ *
+ * With NANMASK, the payload starts with a validity bitmap (one bit per cell, 1 = not NAN) followed by the values of valid cells only.
+ * Values are either doubles or, with FLOAT32, floats. With DEFLATE, the whole payload is compressed with zlib.
+ * All numbers are in native byte order.
+ *
+ * Batch downloads (GET /cube/{cube_id}/download?chunks=...) return a stream of frames, one per chunk in the order
+ * of completion. Each frame consists of the chunk id (uint32), a status (uint32, FRAME_OK or FRAME_ERROR), and the
+ * length of the content (uint64), followed by the encoded chunk or an error message.
+ */
+class chunk_codec {
+   public:
+    enum encoding_flags : uint8_t {
+        RAW = 0,
+        FLOAT32 = 1,  // lossy conversion to single precision floating point numbers
+        NANMASK = 2,  // validity bitmap, NAN values are not transferred
+        DEFLATE = 4   // zlib compression of the payload
+    };
+
+    /**
+     * @brief Parse a comma-separated list of encodings such as "nanmask,deflate"
+     * @param s string, unknown entries are ignored
+     * @return combination of encoding flags
+     */
+    static uint8_t parse_encoding(std::string s);
+
+    /**
+     * @brief Convert encoding flags to a comma-separated string, as accepted by parse_encoding()
+     */
+    static std::string encoding_string(uint8_t encoding);
+
+    /**
+     * @brief Encode chunk data
+     * @param dat chunk data
+     * @param encoding combination of encoding flags, RAW produces the raw format without header
+     * @param deflate_level zlib compression level (1-9)
+     * @return encoded bytes
+     */
+    static std::vector<unsigned char> encode(std::shared_ptr<chunk_data> dat, uint8_t encoding, int deflate_level = 1);
+
+    /**
+     * @brief Decode chunk data from encoded bytes, or from the raw format if the magic number is missing
+     * @param buf pointer to encoded bytes
+     * @param n number of bytes
+     * @return chunk data
+     */
+    static std::shared_ptr<chunk_data> decode(const unsigned char *buf, std::size_t n);
+
+    /**
+     * @brief Create a frame of a batch download
+     * @param chunk_id chunk id
+     * @param status FRAME_OK or FRAME_ERROR
+     * @param content encoded chunk or error message
+     * @return frame bytes
+     */
+    static std::vector<unsigned char> encode_frame(uint32_t chunk_id, uint32_t status, const std::vector<unsigned char> &content);
+
+    enum frame_status : uint32_t {
+        FRAME_OK = 0,
+        FRAME_ERROR = 1
+    };
+
+    static const uint32_t MAGIC = 0x45434347;  // "GCCE" in little endian byte order
+    static const uint8_t VERSION = 1;
+    static const std::size_t HEADER_SIZE = 32;
+    static const std::size_t FRAME_HEADER_SIZE = 16;
+};
+
+/**
+ * @brief Incremental parser of batch download streams (see chunk_codec)
+ *
+ * Bytes are fed as they arrive from the network, the callback is called for each complete frame.
+ */
+class chunk_frame_reader {
+   public:
+    typedef std::function<void(uint32_t chunk_id, uint32_t status, const unsigned char *content, std::size_t n)> callback;
+
+    chunk_frame_reader(callback f) : _f(f), _buf(), _pos(0) {}
+
+    /**
+     * @brief Append bytes to the stream and call the callback for all frames completed by these bytes
+     */
+    void feed(const unsigned char *buf, std::size_t n);
+
+    /**
+     * @return true if the stream ends at a frame boundary
+     */
+    inline bool complete() const { return _pos == _buf.size(); }
+
+   private:
+    callback _f;
+    std::vector<unsigned char> _buf;
+    std::size_t _pos;  // start of the first incomplete frame in _buf
+};
+
+}  // namespace gdalcubes
+
+#endif  //CHUNK_CODEC_H
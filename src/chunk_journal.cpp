@@ -0,0 +1,200 @@
+/*
+    MIT License
+
+    Copyright (c) 2019 Marius Appel <marius.appel@uni-muenster.de>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#include "chunk_journal.h"
+
+#include <fstream>
+#include <sstream>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+#include "error.h"
+#include "filesystem.h"
+
+namespace gdalcubes {
+
+chunk_journal::chunk_journal(std::string path, std::string fingerprint, uint32_t nchunks, uint32_t sync_every_n, uint32_t sync_every_seconds)
+    : _path(path), _fingerprint(fingerprint), _nchunks(nchunks), _sync_every_n(sync_every_n), _sync_every_seconds(sync_every_seconds), _fp(nullptr), _done(), _pending(), _last_sync(std::chrono::steady_clock::now()), _sync_callback(nullptr), _mutex() {}
+
+chunk_journal::~chunk_journal() {
+    if (_fp) {
+        sync();
+        std::fclose(_fp);
+        _fp = nullptr;
+    }
+}
+
+bool chunk_journal::load() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _done.clear();
+    _pending.clear();
+
+    std::ifstream fin(_path);
+    if (!fin.good()) {
+        return false;
+    }
+
+    std::string line;
+    if (!std::getline(fin, line)) {
+        return false;
+    }
+    std::istringstream header(line);
+    std::string fp;
+    uint32_t n = 0;
+    if (!(header >> fp >> n) || fp != _fingerprint || n != _nchunks) {
+        GCBS_DEBUG("Journal file '" + _path + "' has been written for a different export and will be ignored");
+        return false;
+    }
+
+    // each completed chunk is written on a separate line, lines without trailing newline may be incomplete
+    while (std::getline(fin, line)) {
+        if (fin.eof()) break;
+        if (line.empty()) continue;
+        try {
+            std::size_t pos = 0;
+            unsigned long id = std::stoul(line, &pos);
+            if (pos != line.size() || id >= _nchunks) {
+                continue;
+            }
+            _done.insert((uint32_t)id);
+        } catch (...) {
+            continue;
+        }
+    }
+    return true;
+}
+
+void chunk_journal::open(bool append) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (_fp) {
+        std::fclose(_fp);
+        _fp = nullptr;
+    }
+    if (!append) {
+        _done.clear();
+        _pending.clear();
+    }
+    // rewrite the file instead of appending to avoid continuing an incompletely written line
+    _fp = std::fopen(_path.c_str(), "wb");
+    if (_fp) {
+        std::string content = _fingerprint + " " + std::to_string(_nchunks) + "\n";
+        for (auto it = _done.begin(); it != _done.end(); ++it) {
+            content += std::to_string(*it) + "\n";
+        }
+        std::fwrite(content.c_str(), 1, content.size(), _fp);
+        _pending.clear();
+    }
+    if (!_fp) {
+        GCBS_ERROR("Failed to open journal file '" + _path + "'");
+        throw std::string("ERROR in chunk_journal::open(): failed to open journal file '" + _path + "'");
+    }
+    _last_sync = std::chrono::steady_clock::now();
+    sync_unlocked();
+}
+
+void chunk_journal::add(uint32_t id) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _done.insert(id);
+    _pending.push_back(id);
+    if (_pending.size() >= _sync_every_n ||
+        std::chrono::steady_clock::now() - _last_sync >= std::chrono::seconds(_sync_every_seconds)) {
+        sync_unlocked();
+    }
+}
+
+void chunk_journal::sync() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    sync_unlocked();
+}
+
+void chunk_journal::sync_unlocked() {
+    if (!_fp) return;
+    if (!_pending.empty()) {
+        // make sure that data of pending chunks is in the output before recording them
+        if (_sync_callback) {
+            _sync_callback();
+        }
+        std::string entries;
+        for (uint32_t i = 0; i < _pending.size(); ++i) {
+            entries += std::to_string(_pending[i]) + "\n";
+        }
+        std::fwrite(entries.c_str(), 1, entries.size(), _fp);
+        _pending.clear();
+    }
+    std::fflush(_fp);
+#ifdef _WIN32
+    _commit(_fileno(_fp));
+#else
+    fsync(fileno(_fp));
+#endif
+    _last_sync = std::chrono::steady_clock::now();
+}
+
+void chunk_journal::sync_file(std::string path) {
+    std::FILE *fp = std::fopen(path.c_str(), "r+b");
+    if (!fp) {
+        GCBS_WARN("Failed to open '" + path + "' for syncing");
+        return;
+    }
+#ifdef _WIN32
+    _commit(_fileno(fp));
+#else
+    fsync(fileno(fp));
+#endif
+    std::fclose(fp);
+}
+
+void chunk_journal::remove() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (_fp) {
+        sync_unlocked();
+        std::fclose(_fp);
+        _fp = nullptr;
+    }
+    if (filesystem::exists(_path)) {
+        filesystem::remove(_path);
+    }
+}
+
+bool chunk_journal::is_done(uint32_t id) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _done.find(id) != _done.end();
+}
+
+std::vector<uint32_t> chunk_journal::missing() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    std::vector<uint32_t> out;
+    for (uint32_t i = 0; i < _nchunks; ++i) {
+        if (_done.find(i) == _done.end()) {
+            out.push_back(i);
+        }
+    }
+    return out;
+}
+
+}  // namespace gdalcubes
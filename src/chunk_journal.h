@@ -0,0 +1,158 @@
+/*
+    MIT License
+
+    Copyright (c) 2019 Marius Appel <marius.appel@uni-muenster.de>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#ifndef CHUNK_JOURNAL_H
+#define CHUNK_JOURNAL_H
+
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace gdalcubes {
+
+/**
+ * @brief Sidecar file recording which chunks of an export have been completely written
+ *
+ * Exports like cube::write_tif_collection() and cube::write_netcdf_file() write one journal entry
+ * per finished chunk. Entries are buffered in memory and only written to disk (and synced with fsync)
+ * periodically, after calling an optional sync callback that makes sure that the data of these chunks has been
+ * flushed to the output file(s) before. A chunk that is listed in the journal file is thus guaranteed to be
+ * present in the output, which allows to resume interrupted exports by computing only the missing chunks.
+ *
+ * The first line of a journal file contains a fingerprint of the export (e.g. a hash of the cube's JSON
+ * representation and export parameters) and the total number of chunks. Journals with a different fingerprint
+ * are ignored when resuming.
+ */
+class chunk_journal {
+   public:
+    /**
+     * @brief Create a journal object
+     * @param path location of the journal file
+     * @param fingerprint string identifying the export, must not contain whitespace
+     * @param nchunks total number of chunks of the exported cube
+     * @param sync_every_n write and sync the journal at least after this number of completed chunks
+     * @param sync_every_seconds write and sync the journal at least after this number of seconds
+     */
+    chunk_journal(std::string path, std::string fingerprint, uint32_t nchunks, uint32_t sync_every_n = 64, uint32_t sync_every_seconds = 10);
+
+    ~chunk_journal();
+
+    /**
+     * @brief Read completed chunks from an existing journal file
+     *
+     * Reading fails if the file does not exist, is not readable, or has been written for
+     * a different export (fingerprint or number of chunks do not match). Incompletely written
+     * trailing lines are ignored.
+     *
+     * @return true if the journal file has been read successfully
+     */
+    bool load();
+
+    /**
+     * @brief Open the journal file for writing
+     * @param append if true, keep entries read with load(), otherwise the journal starts empty
+     */
+    void open(bool append);
+
+    /**
+     * @brief Mark a chunk as completed
+     *
+     * This function is thread-safe. If a sync is due, the sync callback is executed
+     * from within this function before pending entries are written to the journal file.
+     * @param id chunk id
+     */
+    void add(uint32_t id);
+
+    /**
+     * @brief Write and sync all pending entries
+     */
+    void sync();
+
+    /**
+     * @brief Sync pending entries, close the journal file, and delete it
+     *
+     * This function should be called after an export has been completed successfully.
+     */
+    void remove();
+
+    /**
+     * @brief Check whether a chunk has been completed according to the journal
+     * @param id chunk id
+     * @return true if the chunk has been completed
+     */
+    bool is_done(uint32_t id);
+
+    /**
+     * @brief Get ids of all chunks that have not been completed yet
+     * @return vector of chunk ids in ascending order
+     */
+    std::vector<uint32_t> missing();
+
+    /**
+     * @brief Set a function that is called before pending entries are written to the journal
+     *
+     * The function should flush previously written data of output files to disk, e.g. by
+     * calling `nc_sync()`. It is called from within add() and hence must not lock the same mutex
+     * that surrounds calls to add().
+     * @param f sync callback function
+     */
+    inline void set_sync_callback(std::function<void()> f) { _sync_callback = f; }
+
+    /**
+     * @brief Get the path of the journal file
+     * @return path of the journal file
+     */
+    inline std::string path() { return _path; }
+
+    /**
+     * @brief Flush data of an output file that has already been closed to disk
+     *
+     * This is useful in sync callbacks of exports that write chunks to files that are reopened per chunk.
+     * @param path path of the file
+     */
+    static void sync_file(std::string path);
+
+   private:
+    void sync_unlocked();
+
+    std::string _path;
+    std::string _fingerprint;
+    uint32_t _nchunks;
+    uint32_t _sync_every_n;
+    uint32_t _sync_every_seconds;
+    std::FILE *_fp;
+    std::set<uint32_t> _done;
+    std::vector<uint32_t> _pending;
+    std::chrono::time_point<std::chrono::steady_clock> _last_sync;
+    std::function<void()> _sync_callback;
+    std::mutex _mutex;
+};
+
+}  // namespace gdalcubes
+
+#endif  //CHUNK_JOURNAL_H
@@ -39,11 +39,15 @@ config::config() : _chunk_processor(std::make_shared<chunk_processor_singlethrea
                    _error_handler(error_handler::default_error_handler),
                    _gdal_cache_max(1024 * 1024 * 256),         // 256 MiB
                    _server_chunkcache_max(1024 * 1024 * 512),  // 512 MiB
+                   _server_chunkcache_compression(false),
+                   _server_chunkcache_disk_max(0),
+                   _server_cube_ttl(3600),
                    _server_worker_threads_max(1),
                    _swarm_curl_verbose(false),
                    _gdal_num_threads(1),
                    _gdal_use_overviews(true),
                    _streaming_dir(filesystem::get_tempdir()),
+                   _streaming_shared_memory(false),
                    _collection_format_preset_dirs() {}
 
 version_info config::get_version_info() {
@@ -120,6 +120,44 @@ class config {
         return _server_chunkcache_max;
     }
 
+    /**
+     * @brief Enable or disable compression of chunks in the server chunk cache
+     * Compressed chunks need less memory, especially if they contain large NAN areas, but must be decompressed when read.
+     * @param compress true to compress chunks before adding them to the cache, defaults to false
+     */
+    inline void set_server_chunkcache_compression(bool compress) {
+        _server_chunkcache_compression = compress;
+    }
+
+    inline bool get_server_chunkcache_compression() {
+        return _server_chunkcache_compression;
+    }
+
+    /**
+     * @brief Set the maximum size of the disk tier of the server chunk cache
+     * Chunks evicted from memory are written to the working directory of gdalcubes_server and read back when requested.
+     * @param size_bytes maximum size of chunk files in bytes, 0 disables the disk tier (default)
+     */
+    inline void set_server_chunkcache_disk_max(uint64_t size_bytes) {
+        _server_chunkcache_disk_max = size_bytes;
+    }
+
+    inline uint64_t get_server_chunkcache_disk_max() {
+        return _server_chunkcache_disk_max;
+    }
+
+    /**
+     * @brief Set the time after which cubes without requests are removed from gdalcubes_server
+     * @param seconds time to live in seconds, 0 to never remove cubes, defaults to 3600
+     */
+    inline void set_server_cube_ttl(uint32_t seconds) {
+        _server_cube_ttl = seconds;
+    }
+
+    inline uint32_t get_server_cube_ttl() {
+        return _server_cube_ttl;
+    }
+
     inline void set_server_worker_threads_max(uint16_t max_threads) {
         _server_worker_threads_max = max_threads;
     }
@@ -139,6 +177,11 @@ class config {
     inline std::string get_streaming_dir() { return _streaming_dir; }
     inline void set_streaming_dir(std::string dir) { _streaming_dir = dir; }
 
+    // Get / set whether file-based streaming exchanges chunk data with external programs
+    // through POSIX shared memory objects instead of files in the streaming directory
+    inline bool get_streaming_shared_memory() { return _streaming_shared_memory; }
+    inline void set_streaming_shared_memory(bool shared_memory) { _streaming_shared_memory = shared_memory; }
+
     inline bool get_gdal_debug() { return _gdal_debug; }
     void set_gdal_debug(bool debug);
 
@@ -188,12 +231,16 @@ class config {
     error_action _error_handler;
     uint32_t _gdal_cache_max;
     uint32_t _server_chunkcache_max;
+    bool _server_chunkcache_compression;
+    uint64_t _server_chunkcache_disk_max;
+    uint32_t _server_cube_ttl;  // seconds
     uint16_t _server_worker_threads_max;  // number of threads for parallel chunk reads
     bool _swarm_curl_verbose;
     uint16_t _gdal_num_threads;
     bool _gdal_debug;
     bool _gdal_use_overviews;
     std::string _streaming_dir;
+    bool _streaming_shared_memory;
     std::vector<std::string> _collection_format_preset_dirs;
 
    private:
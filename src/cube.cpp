@@ -31,7 +31,17 @@ SOFTWARE.
 #include <fstream>
 #include <thread>
 
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "arrow_stream.h"
 #include "build_info.h"
+#include "chunk_journal.h"
 #include "filesystem.h"
 
 #if defined(R_PACKAGE) && defined(__sun) && defined(__SVR4)
@@ -44,7 +54,120 @@ SOFTWARE.
 
 namespace gdalcubes {
 
-void cube::write_chunks_gtiff(std::string dir, std::shared_ptr<chunk_processor> p) {
+/**
+ * Normalize a selection of chunks for exports
+ * @param chunks chunk ids, an empty vector selects all chunks
+ * @param nchunks total number of chunks of the cube
+ * @return sorted unique chunk ids
+ */
+static std::vector<chunkid_t> chunk_selection(std::vector<chunkid_t> chunks, uint32_t nchunks) {
+    if (chunks.empty()) {
+        chunks.resize(nchunks);
+        for (uint32_t i = 0; i < nchunks; ++i) {
+            chunks[i] = i;
+        }
+        return chunks;
+    }
+    std::sort(chunks.begin(), chunks.end());
+    chunks.erase(std::unique(chunks.begin(), chunks.end()), chunks.end());
+    if (chunks.back() >= nchunks) {
+        throw std::string("ERROR: chunk id " + std::to_string(chunks.back()) + " is out of range");
+    }
+    return chunks;
+}
+
+/**
+ * Downsample a single 2D image by a factor of two in both dimensions, computing the mean of non-NaN values per 2x2 block,
+ * as needed for overview levels
+ * @param in input image buffer with ny rows of nx values
+ * @param nx number of columns
+ * @param ny number of rows
+ * @return output image buffer with (ny + 1) / 2 rows of (nx + 1) / 2 values
+ */
+static std::vector<double> downsample_2x2(const double *in, uint32_t nx, uint32_t ny) {
+    uint32_t onx = (nx + 1) / 2;
+    uint32_t ony = (ny + 1) / 2;
+    std::vector<double> out(onx * ony, NAN);
+    for (uint32_t oy = 0; oy < ony; ++oy) {
+        for (uint32_t ox = 0; ox < onx; ++ox) {
+            double sum = 0;
+            uint16_t n = 0;
+            for (uint32_t iy = 2 * oy; iy < std::min(2 * oy + 2, ny); ++iy) {
+                for (uint32_t ix = 2 * ox; ix < std::min(2 * ox + 2, nx); ++ix) {
+                    double v = in[iy * nx + ix];
+                    if (!std::isnan(v)) {
+                        sum += v;
+                        ++n;
+                    }
+                }
+            }
+            if (n > 0) {
+                out[oy * onx + ox] = sum / n;
+            }
+        }
+    }
+    return out;
+}
+
+/**
+ * Downsample a single 2D image by nearest neighbor resampling, taking the pixel at the center of each fac x fac block
+ *
+ * Like GDAL's nearest neighbor overviews, each level is computed from the full resolution image, and the center of a block
+ * with even size is rounded to the pixel right / below of it. Results are identical to GDAL if the image size is
+ * a multiple of fac; otherwise, GDAL stretches the sampling grid over the whole image while blocks at the right and
+ * bottom edges are clamped here.
+ * @param in input image buffer with ny rows of nx values
+ * @param nx number of columns
+ * @param ny number of rows
+ * @param fac downsampling factor
+ * @return output image buffer with (ny + fac - 1) / fac rows of (nx + fac - 1) / fac values
+ */
+static std::vector<double> downsample_nearest(const double *in, uint32_t nx, uint32_t ny, uint32_t fac) {
+    uint32_t onx = (nx + fac - 1) / fac;
+    uint32_t ony = (ny + fac - 1) / fac;
+    std::vector<double> out(onx * ony, NAN);
+    for (uint32_t oy = 0; oy < ony; ++oy) {
+        uint32_t iy = std::min(oy * fac + fac / 2, ny - 1);
+        for (uint32_t ox = 0; ox < onx; ++ox) {
+            uint32_t ix = std::min(ox * fac + fac / 2, nx - 1);
+            out[oy * onx + ox] = in[iy * nx + ix];
+        }
+    }
+    return out;
+}
+
+std::vector<chunkid_t> cube::find_chunks(bounds_st range) {
+    std::vector<uint32_t> ct, cy, cx;
+    for (uint32_t i = 0; i < count_chunks_t(); ++i) {
+        bounds_nd<uint32_t, 3> climits = chunk_limits({i, 0, 0});
+        if (st_reference()->datetime_at_index(climits.low[0]) <= range.t1 && st_reference()->datetime_at_index(climits.high[0]) >= range.t0) {
+            ct.push_back(i);
+        }
+    }
+    for (uint32_t i = 0; i < count_chunks_y(); ++i) {
+        bounds_st cextent = bounds_from_chunk(chunk_id_from_coords({0, i, 0}));
+        if (cextent.s.bottom < range.s.top && cextent.s.top > range.s.bottom) {
+            cy.push_back(i);
+        }
+    }
+    for (uint32_t i = 0; i < count_chunks_x(); ++i) {
+        bounds_st cextent = bounds_from_chunk(chunk_id_from_coords({0, 0, i}));
+        if (cextent.s.left < range.s.right && cextent.s.right > range.s.left) {
+            cx.push_back(i);
+        }
+    }
+    std::vector<chunkid_t> out;
+    for (uint32_t it = 0; it < ct.size(); ++it) {
+        for (uint32_t iy = 0; iy < cy.size(); ++iy) {
+            for (uint32_t ix = 0; ix < cx.size(); ++ix) {
+                out.push_back(chunk_id_from_coords({ct[it], cy[iy], cx[ix]}));
+            }
+        }
+    }
+    return out;
+}
+
+void cube::write_chunks_gtiff(std::string dir, std::shared_ptr<chunk_processor> p, std::vector<chunkid_t> chunks) {
     if (!filesystem::exists(dir)) {
         filesystem::mkdir_recursive(dir);
     }
@@ -65,10 +188,13 @@ void cube::write_chunks_gtiff(std::string dir, std::shared_ptr<chunk_processor>
     // NOTE: the following will only work as long as all cube st reference types with regular spatial dimensions inherit from  cube_stref_regular class
     std::shared_ptr<cube_stref_regular> stref = std::dynamic_pointer_cast<cube_stref_regular>(_st_ref);
 
+    std::vector<chunkid_t> sel = chunk_selection(chunks, count_chunks());
+    double nsel = sel.size();
+
     std::shared_ptr<progress> prg = config::instance()->get_default_progress_bar()->get();
     prg->set(0);  // explicitly set to zero to show progress bar immediately
 
-    std::function<void(chunkid_t, std::shared_ptr<chunk_data>, std::mutex &)> f = [this, dir, prg, gtiff_driver, stref](chunkid_t id, std::shared_ptr<chunk_data> dat, std::mutex &m) {
+    std::function<void(chunkid_t, std::shared_ptr<chunk_data>, std::mutex &)> f = [this, dir, prg, gtiff_driver, stref, nsel](chunkid_t id, std::shared_ptr<chunk_data> dat, std::mutex &m) {
         bounds_st cextent = this->bounds_from_chunk(id);  // implemented in derived classes
         double affine[6];
         affine[0] = cextent.s.left;
@@ -105,10 +231,10 @@ void cube::write_chunks_gtiff(std::string dir, std::shared_ptr<chunk_processor>
                 GDALClose(gdal_out);
             }
         }
-        prg->increment((double)1 / (double)this->count_chunks());
+        prg->increment((double)1 / nsel);
     };
 
-    p->apply(shared_from_this(), f);
+    p->apply(shared_from_this(), sel, f);
     prg->finalize();
 }
 
@@ -118,7 +244,9 @@ void cube::write_tif_collection(std::string dir, std::string prefix,
                                 std::string overview_resampling,
                                 packed_export packing,
                                 bool drop_empty_slices,
-                                std::shared_ptr<chunk_processor> p) {
+                                std::shared_ptr<chunk_processor> p,
+                                bool resume,
+                                std::vector<chunkid_t> chunks) {
     if (!overviews && cog) {
         overviews = true;
     }
@@ -183,6 +311,9 @@ void cube::write_tif_collection(std::string dir, std::string prefix,
     // NOTE: the following will only work as long as all cube st reference types with regular spatial dimensions inherit from  cube_stref_regular class
     std::shared_ptr<cube_stref_regular> stref = std::dynamic_pointer_cast<cube_stref_regular>(_st_ref);
 
+    std::vector<chunkid_t> sel = chunk_selection(chunks, count_chunks());
+    double nsel = sel.size();
+
     std::shared_ptr<progress> prg = config::instance()->get_default_progress_bar()->get();
     prg->set(0);  // explicitly set to zero to show progress bar immediately
 
@@ -213,56 +344,183 @@ void cube::write_tif_collection(std::string dir, std::string prefix,
         out_co.AddNameValue(it->first.c_str(), it->second.c_str());
     }
 
-    // create all datasets
-    for (uint32_t it = 0; it < size_t(); ++it) {
-        std::string name = cog ? filesystem::join(dir, prefix + st_reference()->datetime_at_index(it).to_string() + "_temp.tif") : filesystem::join(dir, prefix + st_reference()->datetime_at_index(it).to_string() + ".tif");
+    // overview levels
+    std::vector<int> overview_list;
+    if (overviews) {
+        int n_overviews = (int)std::ceil(std::log2(std::fmax(double(size_x()), double(size_y())) / 256));
+        for (int i = 1; i <= n_overviews; ++i) {
+            overview_list.push_back(std::pow(2, i));
+        }
+    }
 
-        GDALDataset *gdal_out = gtiff_driver->Create(name.c_str(), size_x(), size_y(), size_bands(), ot, out_co.List());
-        char *wkt_out;
-        OGRSpatialReference srs_out;
-        srs_out.SetFromUserInput(_st_ref->srs().c_str());
-        srs_out.exportToWkt(&wkt_out);
-        GDALSetProjection(gdal_out, wkt_out);
+    // Overview levels are computed from chunk buffers directly as long as chunk boundaries
+    // align with overview pixels, further levels are derived from the coarsest of these levels afterwards
+    uint16_t n_overviews_chunkwise = 0;
+    std::string resampling_upper = overview_resampling;
+    std::transform(resampling_upper.begin(), resampling_upper.end(), resampling_upper.begin(), (int (*)(int))std::toupper);
+    if (resampling_upper == "NEAREST" || resampling_upper == "AVERAGE") {
+        for (uint16_t i = 0; i < overview_list.size(); ++i) {
+            uint32_t fac = overview_list[i];
+            bool aligned = true;
+            for (uint32_t cx = 0; cx < count_chunks_x() && aligned; ++cx) {
+                aligned = chunk_limits({0, 0, cx}).low[2] % fac == 0;
+            }
+            for (uint32_t cy = 0; cy < count_chunks_y() && aligned; ++cy) {
+                aligned = (size_y() - chunk_limits({0, cy, 0}).high[1] - 1) % fac == 0;
+            }
+            if (!aligned) break;
+            n_overviews_chunkwise = i + 1;
+        }
+    }
+    if (!overview_list.empty()) {
+        GCBS_DEBUG(std::to_string(n_overviews_chunkwise) + " of " + std::to_string(overview_list.size()) + " overview levels will be computed chunk-wise");
+    }
 
-        double affine[6];
-        affine[0] = st_reference()->left();
-        affine[3] = st_reference()->top();
-        affine[1] = stref->dx();
-        affine[5] = -stref->dy();
-        affine[2] = 0.0;
-        affine[4] = 0.0;
-        GDALSetGeoTransform(gdal_out, affine);
-        CPLFree(wkt_out);
+    // output files that have been written since the last sync of the journal, see below
+    std::set<std::string> unsynced;
+    std::mutex unsynced_mtx;
 
-        // Setting NoData value seems to be not needed for Float64 GeoTIFFs
-        //gdal_out->GetRasterBand(1)->SetNoDataValue(NAN); // GeoTIFF supports only one NoData value for all bands
-        if (packing.type != packed_export::packing_type::PACK_NONE) {
-            if (packing.scale.size() > 1) {
-                for (uint16_t ib = 0; ib < size_bands(); ++ib) {
-                    gdal_out->GetRasterBand(ib + 1)->SetNoDataValue(packing.nodata[ib]);
-                    gdal_out->GetRasterBand(ib + 1)->SetOffset(packing.offset[ib]);
-                    gdal_out->GetRasterBand(ib + 1)->SetScale(packing.scale[ib]);
-                    gdal_out->GetRasterBand(ib + 1)->Fill(packing.nodata[ib]);
+    // journal of completed chunks, makes it possible to resume interrupted exports
+    std::string export_params = prefix + "|" + std::to_string(cog) + "|" + std::to_string(overviews) + "|" + resampling_upper + "|" + std::to_string((int)packing.type);
+    for (uint16_t i = 0; i < packing.scale.size(); ++i) {
+        export_params += "|" + utils::dbl_to_string(packing.scale[i]) + "|" + utils::dbl_to_string(packing.offset[i]) + "|" + utils::dbl_to_string(packing.nodata[i]);
+    }
+    for (auto it = creation_options.begin(); it != creation_options.end(); ++it) {
+        export_params += "|" + it->first + "=" + it->second;
+    }
+    chunk_journal journal(filesystem::join(dir, prefix + "gdalcubes_export.journal"), utils::hash(make_constructible_json().dump() + export_params), count_chunks());
+
+    if (resume) {
+        if (!journal.load()) {
+            GCBS_WARN("No matching export journal found in '" + dir + "', existing files will be overwritten");
+            resume = false;
+        }
+    }
+    if (resume) {
+        // validate existing files, for COGs, time slices without temporary file may have been converted already
+        std::set<uint32_t> finished_slices;
+        for (uint32_t it = 0; it < size_t(); ++it) {
+            std::string name = cog ? filesystem::join(dir, prefix + st_reference()->datetime_at_index(it).to_string() + "_temp.tif") : filesystem::join(dir, prefix + st_reference()->datetime_at_index(it).to_string() + ".tif");
+            if (!filesystem::exists(name)) {
+                if (cog && filesystem::exists(filesystem::join(dir, prefix + st_reference()->datetime_at_index(it).to_string() + ".tif"))) {
+                    finished_slices.insert(it);
+                    continue;
+                }
+                resume = false;
+                break;
+            }
+            GDALDataset *gdal_in = (GDALDataset *)GDALOpen(name.c_str(), GA_ReadOnly);
+            if (!gdal_in) {
+                resume = false;
+                break;
+            }
+            if (gdal_in->GetRasterXSize() != (int)size_x() || gdal_in->GetRasterYSize() != (int)size_y() ||
+                gdal_in->GetRasterCount() != (int)size_bands() || gdal_in->GetRasterBand(1)->GetRasterDataType() != ot) {
+                resume = false;
+            }
+            GDALClose((GDALDatasetH)gdal_in);
+            if (!resume) break;
+        }
+        if (resume && !finished_slices.empty()) {
+            std::vector<chunkid_t> missing;
+            for (uint32_t i = 0; i < sel.size(); ++i) {
+                if (!journal.is_done(sel[i])) missing.push_back(sel[i]);
+            }
+            for (uint32_t i = 0; i < missing.size() && resume; ++i) {
+                for (uint32_t it = chunk_limits(missing[i]).low[0]; it <= chunk_limits(missing[i]).high[0]; ++it) {
+                    if (finished_slices.count(it) > 0) {
+                        resume = false;
+                        break;
+                    }
+                }
+            }
+        }
+        if (!resume) {
+            GCBS_WARN("Existing output files in '" + dir + "' do not match the export journal, existing files will be overwritten");
+        }
+    }
+    journal.open(resume);
+
+    // create all datasets
+    if (!resume) {
+        for (uint32_t it = 0; it < size_t(); ++it) {
+            std::string name = cog ? filesystem::join(dir, prefix + st_reference()->datetime_at_index(it).to_string() + "_temp.tif") : filesystem::join(dir, prefix + st_reference()->datetime_at_index(it).to_string() + ".tif");
+
+            GDALDataset *gdal_out = gtiff_driver->Create(name.c_str(), size_x(), size_y(), size_bands(), ot, out_co.List());
+            char *wkt_out;
+            OGRSpatialReference srs_out;
+            srs_out.SetFromUserInput(_st_ref->srs().c_str());
+            srs_out.exportToWkt(&wkt_out);
+            GDALSetProjection(gdal_out, wkt_out);
+
+            double affine[6];
+            affine[0] = st_reference()->left();
+            affine[3] = st_reference()->top();
+            affine[1] = stref->dx();
+            affine[5] = -stref->dy();
+            affine[2] = 0.0;
+            affine[4] = 0.0;
+            GDALSetGeoTransform(gdal_out, affine);
+            CPLFree(wkt_out);
+
+            // Setting NoData value seems to be not needed for Float64 GeoTIFFs
+            //gdal_out->GetRasterBand(1)->SetNoDataValue(NAN); // GeoTIFF supports only one NoData value for all bands
+            if (packing.type != packed_export::packing_type::PACK_NONE) {
+                if (packing.scale.size() > 1) {
+                    for (uint16_t ib = 0; ib < size_bands(); ++ib) {
+                        gdal_out->GetRasterBand(ib + 1)->SetNoDataValue(packing.nodata[ib]);
+                        gdal_out->GetRasterBand(ib + 1)->SetOffset(packing.offset[ib]);
+                        gdal_out->GetRasterBand(ib + 1)->SetScale(packing.scale[ib]);
+                        gdal_out->GetRasterBand(ib + 1)->Fill(packing.nodata[ib]);
+                    }
+                } else {
+                    for (uint16_t ib = 0; ib < size_bands(); ++ib) {
+                        gdal_out->GetRasterBand(ib + 1)->SetNoDataValue(packing.nodata[0]);
+                        gdal_out->GetRasterBand(ib + 1)->SetOffset(packing.offset[0]);
+                        gdal_out->GetRasterBand(ib + 1)->SetScale(packing.scale[0]);
+                        gdal_out->GetRasterBand(ib + 1)->Fill(packing.nodata[0]);
+                    }
                 }
             } else {
+                // Fill nodata value
                 for (uint16_t ib = 0; ib < size_bands(); ++ib) {
-                    gdal_out->GetRasterBand(ib + 1)->SetNoDataValue(packing.nodata[0]);
-                    gdal_out->GetRasterBand(ib + 1)->SetOffset(packing.offset[0]);
-                    gdal_out->GetRasterBand(ib + 1)->SetScale(packing.scale[0]);
-                    gdal_out->GetRasterBand(ib + 1)->Fill(packing.nodata[0]);
+                    gdal_out->GetRasterBand(ib + 1)->Fill(NAN);
                 }
             }
-        } else {
-            // Fill nodata value
-            for (uint16_t ib = 0; ib < size_bands(); ++ib) {
-                gdal_out->GetRasterBand(ib + 1)->Fill(NAN);
+
+            // create empty overview levels that are filled chunk-wise
+            if (n_overviews_chunkwise > 0) {
+                CPLErr res = GDALBuildOverviews(gdal_out, "NONE", overview_list.size(), overview_list.data(), 0, NULL, NULL, nullptr);
+                if (res != CE_None) {
+                    GCBS_WARN("GDALBuildOverviews failed for " + name);
+                }
+                for (uint16_t ib = 0; ib < size_bands(); ++ib) {
+                    double fill = NAN;
+                    if (packing.type != packed_export::packing_type::PACK_NONE) {
+                        fill = packing.scale.size() > 1 ? packing.nodata[ib] : packing.nodata[0];
+                    }
+                    for (int io = 0; io < gdal_out->GetRasterBand(ib + 1)->GetOverviewCount(); ++io) {
+                        gdal_out->GetRasterBand(ib + 1)->GetOverview(io)->Fill(fill);
+                    }
+                }
             }
-        }
 
-        GDALClose((GDALDatasetH)gdal_out);
+            GDALClose((GDALDatasetH)gdal_out);
+        }
     }
 
-    std::function<void(chunkid_t, std::shared_ptr<chunk_data>, std::mutex &)> f = [this, dir, prg, &mtx, &prefix, &packing, cog, overviews](chunkid_t id, std::shared_ptr<chunk_data> dat, std::mutex &m) {
+    // make sure that journaled chunks are written to disk, callback is executed from within journal.add(), see below
+    journal.set_sync_callback([&unsynced, &unsynced_mtx]() {
+        unsynced_mtx.lock();
+        for (auto it = unsynced.begin(); it != unsynced.end(); ++it) {
+            chunk_journal::sync_file(*it);
+        }
+        unsynced.clear();
+        unsynced_mtx.unlock();
+    });
+
+    std::function<void(chunkid_t, std::shared_ptr<chunk_data>, std::mutex &)> f = [this, dir, prg, &mtx, &prefix, &packing, cog, overviews, &journal, n_overviews_chunkwise, &resampling_upper, nsel, &unsynced, &unsynced_mtx](chunkid_t id, std::shared_ptr<chunk_data> dat, std::mutex &m) {
+        bool success = true;
         if (!dat->empty()) {
             for (uint32_t it = 0; it < dat->size()[1]; ++it) {
                 uint32_t cur_t_index = chunk_limits(id).low[0] + it;
@@ -273,9 +531,37 @@ void cube::write_tif_collection(std::string dir, std::string prefix,
                 if (!gdal_out) {
                     GCBS_WARN("GDAL failed to open " + name);
                     mtx[cur_t_index].unlock();
+                    success = false;
                     continue;
                 }
 
+                // compute overviews from unpacked data, ov_buf[band][level]
+                std::vector<std::vector<std::vector<double>>> ov_buf(size_bands());
+                std::vector<uint32_t> ov_nx;
+                std::vector<uint32_t> ov_ny;
+                if (n_overviews_chunkwise > 0) {
+                    for (uint16_t ib = 0; ib < size_bands(); ++ib) {
+                        const double *base = ((double *)dat->buf()) + (ib * dat->size()[1] * dat->size()[2] * dat->size()[3] + it * dat->size()[2] * dat->size()[3]);
+                        const double *src = base;
+                        uint32_t nx = dat->size()[3];
+                        uint32_t ny = dat->size()[2];
+                        for (uint16_t l = 0; l < n_overviews_chunkwise; ++l) {
+                            if (resampling_upper == "AVERAGE") {
+                                ov_buf[ib].push_back(downsample_2x2(src, nx, ny));
+                            } else {
+                                ov_buf[ib].push_back(downsample_nearest(base, dat->size()[3], dat->size()[2], 1 << (l + 1)));
+                            }
+                            src = ov_buf[ib].back().data();
+                            nx = (nx + 1) / 2;
+                            ny = (ny + 1) / 2;
+                            if (ib == 0) {
+                                ov_nx.push_back(nx);
+                                ov_ny.push_back(ny);
+                            }
+                        }
+                    }
+                }
+
                 // apply packing
                 if (packing.type != packed_export::packing_type::PACK_NONE) {
                     for (uint16_t ib = 0; ib < size_bands(); ++ib) {
@@ -316,6 +602,16 @@ void cube::write_tif_collection(std::string dir, std::string prefix,
                                 v = std::round((v - cur_offset) / cur_scale);  // use std::round to avoid truncation bias
                             }
                         }
+                        for (uint16_t l = 0; l < ov_buf[ib].size(); ++l) {
+                            for (uint32_t i = 0; i < ov_buf[ib][l].size(); ++i) {
+                                double &v = ov_buf[ib][l][i];
+                                if (std::isnan(v)) {
+                                    v = cur_nodata;
+                                } else {
+                                    v = std::round((v - cur_offset) / cur_scale);
+                                }
+                            }
+                        }
                     }
                 }  // if packing
 
@@ -325,23 +621,81 @@ void cube::write_tif_collection(std::string dir, std::string prefix,
                                                                            dat->size()[3], dat->size()[2], GDT_Float64, 0, 0, NULL);
                     if (res != CE_None) {
                         GCBS_WARN("RasterIO (write) failed for " + name);
+                        success = false;
                         break;
                     }
                 }
 
+                // write overviews, chunk boundaries are aligned to overview pixels
+                for (uint16_t ib = 0; ib < ov_buf.size() && success; ++ib) {
+                    for (uint16_t l = 0; l < ov_buf[ib].size(); ++l) {
+                        GDALRasterBand *ov = gdal_out->GetRasterBand(ib + 1)->GetOverview(l);
+                        if (!ov) {
+                            GCBS_WARN("Missing overview level " + std::to_string(l + 1) + " in " + name);
+                            success = false;
+                            break;
+                        }
+                        uint32_t fac = 1 << (l + 1);
+                        int xoff = chunk_limits(id).low[2] / fac;
+                        int yoff = (size_y() - chunk_limits(id).high[1] - 1) / fac;
+                        int nx = std::min((int)ov_nx[l], ov->GetXSize() - xoff);
+                        int ny = std::min((int)ov_ny[l], ov->GetYSize() - yoff);
+                        if (nx <= 0 || ny <= 0) continue;
+                        CPLErr res = ov->RasterIO(GF_Write, xoff, yoff, nx, ny, ov_buf[ib][l].data(), nx, ny, GDT_Float64, 0, ov_nx[l] * sizeof(double), NULL);
+                        if (res != CE_None) {
+                            GCBS_WARN("RasterIO (write) failed for overview level " + std::to_string(l + 1) + " of " + name);
+                            success = false;
+                            break;
+                        }
+                    }
+                }
+
                 GDALClose(gdal_out);
                 mtx[cur_t_index].unlock();
+                unsynced_mtx.lock();
+                unsynced.insert(name);
+                unsynced_mtx.unlock();
             }
         }
+        if (success) {
+            journal.add(id);
+        }
 
         if (overviews) {
-            prg->increment((double)0.5 / (double)this->count_chunks());
+            prg->increment((double)0.5 / nsel);
         } else {
-            prg->increment((double)1 / (double)this->count_chunks());
+            prg->increment((double)1 / nsel);
         }
     };
 
-    p->apply(shared_from_this(), f);
+    std::vector<chunkid_t> todo;
+    for (uint32_t i = 0; i < sel.size(); ++i) {
+        if (!journal.is_done(sel[i])) todo.push_back(sel[i]);
+    }
+    if (resume) {
+        GCBS_INFO("Resuming export to '" + dir + "', " + std::to_string(todo.size()) + " of " + std::to_string(sel.size()) + " chunks are missing");
+        double done = (double)(sel.size() - todo.size()) / nsel;
+        prg->set(overviews ? 0.5 * done : done);
+    }
+    p->apply(shared_from_this(), todo, f);
+
+    // do not postprocess incomplete files, keep the journal to resume later
+    journal.sync();
+    journal.set_sync_callback(nullptr);
+    std::vector<chunkid_t> missing;
+    for (uint32_t i = 0; i < todo.size(); ++i) {
+        if (!journal.is_done(todo[i])) missing.push_back(todo[i]);
+    }
+    if (!missing.empty()) {
+        GCBS_WARN("Export to '" + dir + "' is incomplete, " + std::to_string(missing.size()) + " chunk(s) failed; use resume = true to compute missing chunks only");
+        prg->finalize();
+        return;
+    }
+    // an explicitly selected subset of chunks is postprocessed like a complete export, other pixels remain empty
+    bool complete = journal.missing().empty();
+    if (!complete && cog) {
+        GCBS_WARN("Export to '" + dir + "' contains the selected chunks only; pixels of other chunks remain empty and cannot be added with resume = true after COG conversion");
+    }
 
     // build overviews and convert to COG (with IFDs of overviews at the beginning of the file)
     // TODO: use multiple threads
@@ -355,19 +709,29 @@ void cube::write_tif_collection(std::string dir, std::string prefix,
                 continue;
             }
 
-            int n_overviews = (int)std::ceil(std::log2(std::fmax(double(size_x()), double(size_y())) / 256));
-            std::vector<int> overview_list;
-            for (int i = 1; i <= n_overviews; ++i) {
-                overview_list.push_back(std::pow(2, i));
-            }
-
-            if (!overview_list.empty()) {
-                CPLErr res = GDALBuildOverviews(gdal_out, overview_resampling.c_str(), n_overviews, overview_list.data(), 0, NULL, NULL, nullptr);
+            if (!overview_list.empty() && n_overviews_chunkwise == 0) {
+                CPLErr res = GDALBuildOverviews(gdal_out, overview_resampling.c_str(), overview_list.size(), overview_list.data(), 0, NULL, NULL, nullptr);
                 if (res != CE_None) {
                     GCBS_WARN("GDALBuildOverviews failed for " + name);
                     GDALClose(gdal_out);
                     continue;
                 }
+            } else if (n_overviews_chunkwise > 0 && n_overviews_chunkwise < overview_list.size()) {
+                // derive remaining levels from the coarsest chunk-wise computed level instead of the full resolution image
+                CPLErr res = CE_None;
+                for (uint16_t ib = 0; ib < size_bands() && res == CE_None; ++ib) {
+                    GDALRasterBand *band = gdal_out->GetRasterBand(ib + 1);
+                    std::vector<GDALRasterBandH> targets;
+                    for (int io = n_overviews_chunkwise; io < band->GetOverviewCount(); ++io) {
+                        targets.push_back((GDALRasterBandH)band->GetOverview(io));
+                    }
+                    res = GDALRegenerateOverviews((GDALRasterBandH)band->GetOverview(n_overviews_chunkwise - 1), targets.size(), targets.data(), overview_resampling.c_str(), NULL, NULL);
+                }
+                if (res != CE_None) {
+                    GCBS_WARN("GDALRegenerateOverviews failed for " + name);
+                    GDALClose(gdal_out);
+                    continue;
+                }
             }
 
             if (cog) {
@@ -428,75 +792,21 @@ void cube::write_tif_collection(std::string dir, std::string prefix,
         }
     }
 
+    // temporary files of COGs are gone, remaining chunks of plain GeoTIFFs can still be added with resume = true
+    if (complete || cog) {
+        journal.remove();
+    }
     prg->set(1.0);
     prg->finalize();
 }
 
-void cube::write_netcdf_file(std::string path, uint8_t compression_level, bool with_VRT, bool write_bounds,
-                             packed_export packing, bool drop_empty_slices, std::shared_ptr<chunk_processor> p) {
-    std::string op = filesystem::make_absolute(path);
-
-    if (filesystem::is_directory(op)) {
-        throw std::string("ERROR in cube::write_netcdf_file(): output already exists and is a directory.");
-    }
-    if (filesystem::is_regular_file(op)) {
-        GCBS_INFO("Existing file '" + op + "' will be overwritten for NetCDF export");
-    }
-
-    if (!filesystem::exists(filesystem::parent(op))) {
-        filesystem::mkdir_recursive(filesystem::parent(op));
-    }
-
-    if (!_st_ref->has_regular_space()) {
-        throw std::string("ERROR: netCDF export currently does not support irregular spatial dimensions");
-    }
-
+void cube::create_netcdf_file(std::string op, uint8_t compression_level, bool write_bounds, packed_export packing, int ot, int &ncout, std::vector<int> &v_bands) {
     // NOTE: the following will only work as long as all cube st reference types with regular spatial dimensions inherit from  cube_stref_regular class
     std::shared_ptr<cube_stref_regular> stref = std::dynamic_pointer_cast<cube_stref_regular>(_st_ref);
 
-    std::shared_ptr<progress> prg = config::instance()->get_default_progress_bar()->get();
-    prg->set(0);  // explicitly set to zero to show progress bar immediately
-
-    int ot = NC_DOUBLE;
-    if (packing.type != packed_export::packing_type::PACK_NONE) {
-        if (packing.type == packed_export::packing_type::PACK_UINT8) {
-            ot = NC_UBYTE;
-        } else if (packing.type == packed_export::packing_type::PACK_UINT16) {
-            ot = NC_USHORT;
-        } else if (packing.type == packed_export::packing_type::PACK_UINT32) {
-            ot = NC_UINT;
-        } else if (packing.type == packed_export::packing_type::PACK_INT16) {
-            ot = NC_SHORT;
-        } else if (packing.type == packed_export::packing_type::PACK_INT32) {
-            ot = NC_INT;
-        } else if (packing.type == packed_export::packing_type::PACK_FLOAT32) {
-            ot = NC_FLOAT;
-            packing.offset = {0.0};
-            packing.scale = {1.0};
-            packing.nodata = {std::numeric_limits<float>::quiet_NaN()};
-        }
-
-        if (!(packing.scale.size() == 1 || packing.scale.size() == size_bands())) {
-            std::string msg;
-            if (size_bands() == 1) {
-                msg = "Packed export needs exactly 1 scale and offset value.";
-            } else {
-                msg = "Packed export needs either n or 1 scale / offset values for n bands.";
-            }
-            GCBS_ERROR(msg);
-            throw(msg);
-        }
-        if (packing.scale.size() != packing.offset.size()) {
-            std::string msg = "Unequal number of scale and offset values provided for packed export.";
-            GCBS_ERROR(msg);
-            throw(msg);
-        }
-        if (packing.scale.size() != packing.nodata.size()) {
-            std::string msg = "Unequal number of scale and nodata values provided for packed export.";
-            GCBS_ERROR(msg);
-            throw(msg);
-        }
-    }
+    OGRSpatialReference srs = st_reference()->srs_ogr();
+    std::string yname = srs.IsProjected() ? "y" : "latitude";
+    std::string xname = srs.IsProjected() ? "x" : "longitude";
 
     double *dim_x = (double *)std::calloc(size_x(), sizeof(double));
     double *dim_y = (double *)std::calloc(size_y(), sizeof(double));
@@ -512,11 +822,6 @@ void cube::write_netcdf_file(std::string path, uint8_t compression_level, bool w
         dim_t_bnds = (int *)std::calloc(size_t() * 2, sizeof(int));
     }
 
-    if (stref->dt().dt_unit == datetime_unit::WEEK) {
-        stref->dt_unit(datetime_unit::DAY);
-        stref->dt_interval(stref->dt_interval() * 7);  // UDUNIT does not support week
-    }
-
     if (stref->has_regular_time()) {
         for (uint32_t i = 0; i < size_t(); ++i) {
             dim_t[i] = (i * stref->dt().dt_interval);
@@ -557,12 +862,6 @@ void cube::write_netcdf_file(std::string path, uint8_t compression_level, bool w
         }
     }
 
-    OGRSpatialReference srs = st_reference()->srs_ogr();
-    std::string yname = srs.IsProjected() ? "y" : "latitude";
-    std::string xname = srs.IsProjected() ? "x" : "longitude";
-
-    int ncout;
-
 #if USE_NCDF4 == 1
     nc_create(op.c_str(), NC_NETCDF4, &ncout);
 #else
@@ -684,8 +983,6 @@ void cube::write_netcdf_file(std::string path, uint8_t compression_level, bool w
     CPLFree(wkt);
     int d_all[] = {d_t, d_y, d_x};
 
-    std::vector<int> v_bands;
-
     for (uint16_t i = 0; i < bands().count(); ++i) {
         int v;
         nc_def_var(ncout, bands().get(i).name.c_str(), ot, 3, d_all, &v);
@@ -755,8 +1052,156 @@ void cube::write_netcdf_file(std::string path, uint8_t compression_level, bool w
         if (dim_y_bnds) std::free(dim_y_bnds);
         if (dim_x_bnds) std::free(dim_x_bnds);
     }
+}
+
+void cube::write_netcdf_file(std::string path, uint8_t compression_level, bool with_VRT, bool write_bounds,
+                             packed_export packing, bool drop_empty_slices,
+                             std::shared_ptr<chunk_processor> p, bool resume, std::vector<chunkid_t> chunks) {
+    std::string op = filesystem::make_absolute(path);
+
+    if (filesystem::is_directory(op)) {
+        throw std::string("ERROR in cube::write_netcdf_file(): output already exists and is a directory.");
+    }
+    if (filesystem::is_regular_file(op)) {
+        GCBS_INFO("Existing file '" + op + "' will be overwritten for NetCDF export");
+    }
+
+    if (!filesystem::exists(filesystem::parent(op))) {
+        filesystem::mkdir_recursive(filesystem::parent(op));
+    }
+
+    if (!_st_ref->has_regular_space()) {
+        throw std::string("ERROR: netCDF export currently does not support irregular spatial dimensions");
+    }
+
+    // NOTE: the following will only work as long as all cube st reference types with regular spatial dimensions inherit from  cube_stref_regular class
+    std::shared_ptr<cube_stref_regular> stref = std::dynamic_pointer_cast<cube_stref_regular>(_st_ref);
+
+    std::vector<chunkid_t> sel = chunk_selection(chunks, count_chunks());
+    double nsel = sel.size();
+
+    std::shared_ptr<progress> prg = config::instance()->get_default_progress_bar()->get();
+    prg->set(0);  // explicitly set to zero to show progress bar immediately
+
+    int ot = NC_DOUBLE;
+    if (packing.type != packed_export::packing_type::PACK_NONE) {
+        if (packing.type == packed_export::packing_type::PACK_UINT8) {
+            ot = NC_UBYTE;
+        } else if (packing.type == packed_export::packing_type::PACK_UINT16) {
+            ot = NC_USHORT;
+        } else if (packing.type == packed_export::packing_type::PACK_UINT32) {
+            ot = NC_UINT;
+        } else if (packing.type == packed_export::packing_type::PACK_INT16) {
+            ot = NC_SHORT;
+        } else if (packing.type == packed_export::packing_type::PACK_INT32) {
+            ot = NC_INT;
+        } else if (packing.type == packed_export::packing_type::PACK_FLOAT32) {
+            ot = NC_FLOAT;
+            packing.offset = {0.0};
+            packing.scale = {1.0};
+            packing.nodata = {std::numeric_limits<float>::quiet_NaN()};
+        }
+
+        if (!(packing.scale.size() == 1 || packing.scale.size() == size_bands())) {
+            std::string msg;
+            if (size_bands() == 1) {
+                msg = "Packed export needs exactly 1 scale and offset value.";
+            } else {
+                msg = "Packed export needs either n or 1 scale / offset values for n bands.";
+            }
+            GCBS_ERROR(msg);
+            throw(msg);
+        }
+        if (packing.scale.size() != packing.offset.size()) {
+            std::string msg = "Unequal number of scale and offset values provided for packed export.";
+            GCBS_ERROR(msg);
+            throw(msg);
+        }
+        if (packing.scale.size() != packing.nodata.size()) {
+            std::string msg = "Unequal number of scale and nodata values provided for packed export.";
+            GCBS_ERROR(msg);
+            throw(msg);
+        }
+    }
 
-    std::function<void(chunkid_t, std::shared_ptr<chunk_data>, std::mutex &)> f = [this, op, prg, &v_bands, ncout, &packing](chunkid_t id, std::shared_ptr<chunk_data> dat, std::mutex &m) {
+    if (stref->dt().dt_unit == datetime_unit::WEEK) {
+        stref->dt_unit(datetime_unit::DAY);
+        stref->dt_interval(stref->dt_interval() * 7);  // UDUNIT does not support week
+    }
+
+    OGRSpatialReference srs = st_reference()->srs_ogr();
+    std::string yname = srs.IsProjected() ? "y" : "latitude";
+    std::string xname = srs.IsProjected() ? "x" : "longitude";
+
+    // journal of completed chunks, makes it possible to resume interrupted exports
+    std::string export_params = std::to_string(compression_level) + "|" + std::to_string(write_bounds) + "|" + std::to_string((int)packing.type);
+    for (uint16_t i = 0; i < packing.scale.size(); ++i) {
+        export_params += "|" + utils::dbl_to_string(packing.scale[i]) + "|" + utils::dbl_to_string(packing.offset[i]) + "|" + utils::dbl_to_string(packing.nodata[i]);
+    }
+    chunk_journal journal(op + ".journal", utils::hash(make_constructible_json().dump() + export_params), count_chunks());
+
+    int ncout;
+    std::vector<int> v_bands;
+
+    if (resume) {
+        if (!journal.load()) {
+            GCBS_WARN("No matching export journal found for '" + op + "', existing file will be overwritten");
+            resume = false;
+        }
+    }
+    if (resume) {
+        // validate dimensions and variables of the existing file
+        if (nc_open(op.c_str(), NC_WRITE, &ncout) != NC_NOERR) {
+            resume = false;
+        } else {
+            std::vector<std::pair<std::string, std::size_t>> dims = {{"time", size_t()}, {yname, size_y()}, {xname, size_x()}};
+            for (uint16_t i = 0; i < dims.size(); ++i) {
+                int d;
+                std::size_t len;
+                if (nc_inq_dimid(ncout, dims[i].first.c_str(), &d) != NC_NOERR || nc_inq_dimlen(ncout, d, &len) != NC_NOERR || len != dims[i].second) {
+                    resume = false;
+                    break;
+                }
+            }
+            for (uint16_t i = 0; i < bands().count() && resume; ++i) {
+                int v;
+                nc_type vtype;
+                if (nc_inq_varid(ncout, bands().get(i).name.c_str(), &v) != NC_NOERR || nc_inq_vartype(ncout, v, &vtype) != NC_NOERR || vtype != ot) {
+                    resume = false;
+                    break;
+                }
+                v_bands.push_back(v);
+            }
+            if (!resume) {
+                nc_close(ncout);
+                v_bands.clear();
+            }
+        }
+        if (!resume) {
+            GCBS_WARN("Existing file '" + op + "' does not match the export journal and will be overwritten");
+        }
+    }
+    journal.open(resume);
+
+    if (!resume) {
+        create_netcdf_file(op, compression_level, write_bounds, packing, ot, ncout, v_bands);
+    }
+
+    // make sure that journaled chunks are written to disk, callback is executed while m is locked, see below
+    journal.set_sync_callback([ncout, op]() {
+        nc_sync(ncout);
+        chunk_journal::sync_file(op);
+    });
+
+    std::function<void(chunkid_t, std::shared_ptr<chunk_data>, std::mutex &)> f = [this, op, prg, &v_bands, ncout, &packing, &journal, nsel](chunkid_t id, std::shared_ptr<chunk_data> dat, std::mutex &m) {
+        if (dat->empty()) {
+            // nothing to write, cells of empty chunks keep the fill value of the variables
+            m.lock();
+            journal.add(id);
+            m.unlock();
+            prg->increment((double)1 / nsel);
+            return;
+        }
         chunk_size_btyx csize = dat->size();
         bounds_nd<uint32_t, 3> climits = chunk_limits(id);
         std::size_t startp[] = {climits.low[0], size_y() - climits.high[1] - 1, climits.low[2]};
@@ -880,13 +1325,38 @@ void cube::write_netcdf_file(std::string path, uint8_t compression_level, bool w
                 m.unlock();
             }
         }
-        prg->increment((double)1 / (double)this->count_chunks());
+        m.lock();
+        journal.add(id);
+        m.unlock();
+        prg->increment((double)1 / nsel);
     };
 
-    p->apply(shared_from_this(), f);
+    std::vector<chunkid_t> todo;
+    for (uint32_t i = 0; i < sel.size(); ++i) {
+        if (!journal.is_done(sel[i])) todo.push_back(sel[i]);
+    }
+    if (resume) {
+        GCBS_INFO("Resuming export to '" + op + "', " + std::to_string(todo.size()) + " of " + std::to_string(sel.size()) + " chunks are missing");
+        prg->set((double)(sel.size() - todo.size()) / nsel);
+    }
+    p->apply(shared_from_this(), todo, f);
+    journal.sync();
+    journal.set_sync_callback(nullptr);
     nc_close(ncout);
     prg->finalize();
 
+    // keep the journal to resume later if chunks failed or only a subset of chunks has been written
+    std::vector<chunkid_t> missing;
+    for (uint32_t i = 0; i < todo.size(); ++i) {
+        if (!journal.is_done(todo[i])) missing.push_back(todo[i]);
+    }
+    if (journal.missing().empty()) {
+        journal.remove();
+    }
+    if (!missing.empty()) {
+        GCBS_WARN("Export to '" + op + "' is incomplete, " + std::to_string(missing.size()) + " chunk(s) failed; use resume = true to compute missing chunks only");
+    }
+
     // netCDF is now written, write additional per-time-slice VRT datasets if needed
 
     if (with_VRT) {
@@ -1132,7 +1602,7 @@ void cube::write_single_chunk_netcdf(gdalcubes::chunkid_t id, std::string path,
     nc_close(ncout);
 }
 
-void cube::write_chunks_netcdf(std::string dir, std::string name, uint8_t compression_level, std::shared_ptr<chunk_processor> p) {
+void cube::write_chunks_netcdf(std::string dir, std::string name, uint8_t compression_level, std::shared_ptr<chunk_processor> p, std::vector<chunkid_t> chunks) {
     if (name.empty()) {
         name = utils::generate_unique_filename();
     }
@@ -1147,10 +1617,18 @@ void cube::write_chunks_netcdf(std::string dir, std::string name, uint8_t compre
         filesystem::mkdir_recursive(dir);
     }
 
+    std::vector<chunkid_t> sel = chunk_selection(chunks, count_chunks());
+    double nsel = sel.size();
+
     std::shared_ptr<progress> prg = config::instance()->get_default_progress_bar()->get();
     prg->set(0);  // explicitly set to zero to show progress bar immediately
 
-    std::function<void(chunkid_t, std::shared_ptr<chunk_data>, std::mutex &)> f = [this, prg, &compression_level, &name, &dir](chunkid_t id, std::shared_ptr<chunk_data> dat, std::mutex &m) {
+    std::function<void(chunkid_t, std::shared_ptr<chunk_data>, std::mutex &)> f = [this, prg, &compression_level, &name, &dir, nsel](chunkid_t id, std::shared_ptr<chunk_data> dat, std::mutex &m) {
+        if (dat->empty()) {
+            // no file is written for empty chunks
+            prg->increment((double)1 / nsel);
+            return;
+        }
         std::string fname = filesystem::join(dir, name + "_" + std::to_string(id) + ".nc");
 
         if (!_st_ref->has_regular_space()) {
@@ -1349,40 +1827,202 @@ void cube::write_chunks_netcdf(std::string dir, std::string name, uint8_t compre
             nc_put_vara(ncout, v_bands[i], startp, countp, (void *)(((double *)dat->buf()) + (int)i * (int)dat->size()[1] * (int)dat->size()[2] * (int)dat->size()[3]));
         }
         nc_close(ncout);
-        prg->increment((double)1 / (double)this->count_chunks());
+        prg->increment((double)1 / nsel);
     };
 
-    p->apply(shared_from_this(), f);
+    p->apply(shared_from_this(), sel, f);
+    prg->finalize();
+}
+
+void cube::write_arrow_stream(std::string path, std::vector<chunkid_t> chunks, std::shared_ptr<chunk_processor> p) {
+    std::string op = filesystem::make_absolute(path);
+
+    if (filesystem::is_directory(op)) {
+        throw std::string("ERROR in cube::write_arrow_stream(): output already exists and is a directory.");
+    }
+    if (!filesystem::exists(filesystem::parent(op))) {
+        filesystem::mkdir_recursive(filesystem::parent(op));
+    }
+
+#ifdef _WIN32
+    int fd = _open(op.c_str(), _O_WRONLY | _O_CREAT | _O_TRUNC | _O_BINARY, _S_IREAD | _S_IWRITE);
+#else
+    int fd = open(op.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+#endif
+    if (fd < 0) {
+        throw std::string("ERROR in cube::write_arrow_stream(): cannot open output file '" + op + "'.");
+    }
+    try {
+        write_arrow_stream(fd, chunks, p);
+    } catch (...) {
+#ifdef _WIN32
+        _close(fd);
+#else
+        close(fd);
+#endif
+        throw;
+    }
+#ifdef _WIN32
+    _close(fd);
+#else
+    close(fd);
+#endif
+}
+
+void cube::write_arrow_stream(int fd, std::vector<chunkid_t> chunks, std::shared_ptr<chunk_processor> p) {
+    std::vector<chunkid_t> sel = chunk_selection(chunks, count_chunks());
+    double nsel = sel.size();
+
+    std::shared_ptr<progress> prg = config::instance()->get_default_progress_bar()->get();
+    prg->set(0);  // explicitly set to zero to show progress bar immediately
+
+    std::vector<std::string> columns;
+    json11::Json::array bands_json;
+    for (uint16_t i = 0; i < bands().count(); ++i) {
+        columns.push_back(bands().get(i).name);
+        json11::Json::object b;
+        b["name"] = bands().get(i).name;
+        b["unit"] = bands().get(i).unit;
+        b["offset"] = bands().get(i).offset;
+        b["scale"] = bands().get(i).scale;
+        b["type"] = bands().get(i).type;
+        bands_json.push_back(b);
+    }
+    json11::Json::array time_json;
+    for (uint32_t it = 0; it < size_t(); ++it) {
+        time_json.push_back(st_reference()->datetime_at_index(it).to_string());
+    }
+
+    json11::Json::object cube_json;
+    cube_json["size"] = json11::Json::array{(double)size_t(), (double)size_y(), (double)size_x()};
+    cube_json["chunk_size"] = json11::Json::array{(double)chunk_size()[0], (double)chunk_size()[1], (double)chunk_size()[2]};
+    cube_json["extent"] = json11::Json::object{{"left", st_reference()->left()}, {"right", st_reference()->right()}, {"bottom", st_reference()->bottom()}, {"top", st_reference()->top()}};
+    cube_json["srs"] = st_reference()->srs();
+    cube_json["time"] = time_json;
+    cube_json["bands"] = bands_json;
+    cube_json["cube"] = make_constructible_json();
+
+    arrow_stream_writer writer(fd);
+    writer.write_schema(columns, {{"gdalcubes", json11::Json(cube_json).dump()}});
+
+    std::function<void(chunkid_t, std::shared_ptr<chunk_data>, std::mutex &)> f = [this, prg, &writer, nsel](chunkid_t id, std::shared_ptr<chunk_data> dat, std::mutex &m) {
+        bounds_nd<uint32_t, 3> climits = chunk_limits(id);
+        bounds_st cextent = bounds_from_chunk(id);
+        coords_nd<uint32_t, 3> csize = chunk_size(id);
+
+        json11::Json::object chunk_json;
+        chunk_json["chunk_id"] = (double)id;
+        chunk_json["offset"] = json11::Json::array{(double)climits.low[0], (double)climits.low[1], (double)climits.low[2]};
+        chunk_json["size"] = json11::Json::array{(double)csize[0], (double)csize[1], (double)csize[2]};
+        chunk_json["extent"] = json11::Json::object{{"left", cextent.s.left}, {"right", cextent.s.right}, {"bottom", cextent.s.bottom}, {"top", cextent.s.top}, {"t0", cextent.t0.to_string()}, {"t1", cextent.t1.to_string()}};
+        chunk_json["empty"] = dat->empty();
+
+        uint64_t nrows = 0;
+        std::vector<const double *> cols(size_bands(), nullptr);
+        if (!dat->empty()) {
+            nrows = (uint64_t)dat->size()[1] * (uint64_t)dat->size()[2] * (uint64_t)dat->size()[3];
+            for (uint16_t i = 0; i < size_bands(); ++i) {
+                cols[i] = ((const double *)dat->buf()) + i * nrows;
+            }
+        }
+
+        m.lock();
+        try {
+            writer.write_record_batch(nrows, cols, {{"gdalcubes", json11::Json(chunk_json).dump()}});
+        } catch (...) {
+            m.unlock();
+            throw;
+        }
+        m.unlock();
+        prg->increment((double)1 / nsel);
+    };
+
+    p->apply(shared_from_this(), sel, f);
+    writer.write_eos();
     prg->finalize();
 }
 
 void chunk_processor_singlethread::apply(std::shared_ptr<cube> c,
                                          std::function<void(chunkid_t, std::shared_ptr<chunk_data>, std::mutex &)> f) {
+    std::vector<chunkid_t> chunks(c->count_chunks());
+    for (uint32_t i = 0; i < chunks.size(); ++i) {
+        chunks[i] = i;
+    }
+    apply(c, chunks, f);
+}
+
+void chunk_processor_singlethread::apply(std::shared_ptr<cube> c, std::vector<chunkid_t> chunks,
+                                         std::function<void(chunkid_t, std::shared_ptr<chunk_data>, std::mutex &)> f) {
     std::mutex mutex;
-    uint32_t nchunks = c->count_chunks();
-    for (uint32_t i = 0; i < nchunks; ++i) {
-        std::shared_ptr<chunk_data> dat = c->read_chunk(i);
-        f(i, dat, mutex);
+    uint32_t batch_size = std::max(uint32_t(1), c->read_batch_size());
+    for (uint32_t i = 0; i < chunks.size(); i += batch_size) {
+        std::vector<chunkid_t> ids(chunks.begin() + i, chunks.begin() + std::min(std::size_t(i + batch_size), chunks.size()));
+        std::vector<std::shared_ptr<chunk_data>> dat;
+        if (ids.size() > 1) {
+            try {
+                dat = c->read_chunks(ids);
+            } catch (std::string s) {
+                GCBS_ERROR(s);
+                GCBS_WARN("Reading a batch of " + std::to_string(ids.size()) + " chunks failed, reading chunks individually");
+                dat.clear();
+            } catch (...) {
+                GCBS_WARN("Reading a batch of " + std::to_string(ids.size()) + " chunks failed, reading chunks individually");
+                dat.clear();
+            }
+        }
+        for (uint32_t j = 0; j < ids.size(); ++j) {
+            f(ids[j], dat.empty() ? c->read_chunk(ids[j]) : dat[j], mutex);
+        }
     }
 }
 
 void chunk_processor_multithread::apply(std::shared_ptr<cube> c,
                                         std::function<void(chunkid_t, std::shared_ptr<chunk_data>, std::mutex &)> f) {
+    std::vector<chunkid_t> chunks(c->count_chunks());
+    for (uint32_t i = 0; i < chunks.size(); ++i) {
+        chunks[i] = i;
+    }
+    apply(c, chunks, f);
+}
+
+void chunk_processor_multithread::apply(std::shared_ptr<cube> c, std::vector<chunkid_t> chunks,
+                                        std::function<void(chunkid_t, std::shared_ptr<chunk_data>, std::mutex &)> f) {
     std::mutex mutex;
     std::vector<std::thread> workers;
     for (uint16_t it = 0; it < _nthreads; ++it) {
-        workers.push_back(std::thread([this, &c, f, it, &mutex](void) {
-            for (uint32_t i = it; i < c->count_chunks(); i += _nthreads) {
-                try {
-                    std::shared_ptr<chunk_data> dat = c->read_chunk(i);
-                    f(i, dat, mutex);
-                } catch (std::string s) {
-                    GCBS_ERROR(s);
-                    continue;
-                } catch (...) {
-                    GCBS_ERROR("unexpected exception while processing chunk " + std::to_string(i));
-                    continue;
+        workers.push_back(std::thread([this, &c, &chunks, f, it, &mutex](void) {
+            // chunks of this thread, read in batches if the cube prefers
+            uint32_t batch_size = std::max(uint32_t(1), c->read_batch_size());
+            std::vector<chunkid_t> ids;
+            for (uint32_t i = it; i < chunks.size(); i += _nthreads) {
+                ids.push_back(chunks[i]);
+                if (ids.size() < batch_size && i + _nthreads < chunks.size()) continue;
+
+                std::vector<std::shared_ptr<chunk_data>> dat;
+                if (ids.size() > 1) {
+                    try {
+                        dat = c->read_chunks(ids);
+                    } catch (std::string s) {
+                        GCBS_ERROR(s);
+                        GCBS_WARN("Reading a batch of " + std::to_string(ids.size()) + " chunks failed, reading chunks individually");
+                        dat.clear();
+                    } catch (...) {
+                        GCBS_WARN("Reading a batch of " + std::to_string(ids.size()) + " chunks failed, reading chunks individually");
+                        dat.clear();
+                    }
+                }
+                for (uint32_t j = 0; j < ids.size(); ++j) {
+                    try {
+                        f(ids[j], dat.empty() ? c->read_chunk(ids[j]) : dat[j], mutex);
+                    } catch (std::string s) {
+                        GCBS_ERROR(s);
+                        continue;
+                    } catch (...) {
+                        GCBS_ERROR("unexpected exception while processing chunk " + std::to_string(ids[j]));
+                        continue;
+                    }
                 }
+                ids.clear();
             }
         }));
     }
@@ -175,6 +175,15 @@ class chunk_processor {
      */
     virtual void
     apply(std::shared_ptr<cube> c, std::function<void(chunkid_t, std::shared_ptr<chunk_data>, std::mutex &)> f) = 0;
+
+    /**
+     * Apply a function f over a subset of chunks of a given data cube c
+     * @param c data cube
+     * @param chunks ids of the chunks to be processed
+     * @param f function to be applied over the selected chunks of c, see above
+     */
+    virtual void
+    apply(std::shared_ptr<cube> c, std::vector<chunkid_t> chunks, std::function<void(chunkid_t, std::shared_ptr<chunk_data>, std::mutex &)> f) = 0;
 };
 
 /**
@@ -194,6 +203,12 @@ class chunk_processor_singlethread : public chunk_processor {
      */
     void apply(std::shared_ptr<cube> c,
                std::function<void(chunkid_t, std::shared_ptr<chunk_data>, std::mutex &)> f) override;
+
+    /**
+     * @copydoc chunk_processor::apply(std::shared_ptr<cube>, std::vector<chunkid_t>, std::function<void(chunkid_t, std::shared_ptr<chunk_data>, std::mutex &)>)
+     */
+    void apply(std::shared_ptr<cube> c, std::vector<chunkid_t> chunks,
+               std::function<void(chunkid_t, std::shared_ptr<chunk_data>, std::mutex &)> f) override;
 };
 
 /**
@@ -220,6 +235,12 @@ class chunk_processor_multithread : public chunk_processor {
     void apply(std::shared_ptr<cube> c,
                std::function<void(chunkid_t, std::shared_ptr<chunk_data>, std::mutex &)> f) override;
 
+    /**
+     * @copydoc chunk_processor::apply(std::shared_ptr<cube>, std::vector<chunkid_t>, std::function<void(chunkid_t, std::shared_ptr<chunk_data>, std::mutex &)>)
+     */
+    void apply(std::shared_ptr<cube> c, std::vector<chunkid_t> chunks,
+               std::function<void(chunkid_t, std::shared_ptr<chunk_data>, std::mutex &)> f) override;
+
     /**
      * Query the number of threads to be used in parallel chunk processing
      * @return the number of threads
@@ -662,6 +683,15 @@ class cube : public std::enable_shared_from_this<cube> {
         return out_st;
     }
 
+    /**
+     * @brief Find chunks that intersect with a given spatiotemporal extent
+     *
+     * The result can be used to restrict chunk processing and exports to a region of interest.
+     * @param range spatiotemporal extent, spatial coordinates must be given in the cube's spatial reference system
+     * @return ids of intersecting chunks in ascending order
+     */
+    std::vector<chunkid_t> find_chunks(bounds_st range);
+
     /**
      * @brief Get the chunk size of the cube
      *
@@ -729,14 +759,51 @@ class cube : public std::enable_shared_from_this<cube> {
      */
     virtual std::shared_ptr<chunk_data> read_chunk(chunkid_t id) = 0;
 
+    /**
+     * @brief Read data of several chunks at once
+     *
+     * Chunk processors call this function with up to read_batch_size() chunks that they process anyway. Cubes
+     * that can compute several chunks more efficiently at once override this function, the default implementation
+     * calls read_chunk() for each chunk.
+     *
+     * @param ids ids of the requested chunks
+     * @return chunk data in the order of ids
+     */
+    virtual std::vector<std::shared_ptr<chunk_data>> read_chunks(std::vector<chunkid_t> ids) {
+        std::vector<std::shared_ptr<chunk_data>> out;
+        for (uint32_t i = 0; i < ids.size(); ++i) {
+            out.push_back(read_chunk(ids[i]));
+        }
+        return out;
+    }
+
+    /**
+     * @brief Preferred number of chunks per call of read_chunks()
+     * @return number of chunks, 1 (the default) if read_chunks() has no advantage over read_chunk()
+     */
+    virtual uint32_t read_batch_size() { return 1; }
+
+    /**
+     * @brief Check whether a chunk is known to be empty without reading it
+     * Derived classes should override this function if emptiness can be derived cheaply, e.g. from image collection
+     * metadata or by asking input cubes. Empty chunks are returned as chunk_data objects with no buffer from
+     * read_chunk(), all of their cells are considered to be NAN.
+     *
+     * @param id the id of the chunk
+     * @return true, if the chunk is guaranteed to be empty, false if it might contain data
+     */
+    virtual bool chunk_is_empty(chunkid_t id) { return false; }
+
     /**
      * @brief Write a data cube as a set of GeoTIFF files under a given directory
      *
      * @param dir directory where to store the files
      * @param p chunk processor instance, defaults to the global configuration
+     * @param chunks ids of chunks to be written, an empty vector (the default) selects all chunks
      */
     void write_chunks_gtiff(std::string dir,
-                            std::shared_ptr<chunk_processor> p = config::instance()->get_default_chunk_processor());
+                            std::shared_ptr<chunk_processor> p = config::instance()->get_default_chunk_processor(),
+                            std::vector<chunkid_t> chunks = std::vector<chunkid_t>());
 
     /**
      * @brief Writes a data cube as a collection of GeoTIFF files
@@ -752,6 +819,14 @@ class cube : public std::enable_shared_from_this<cube> {
      * @param packing reduce size of output tile with packing (apply scale + offset and use smaller integer data types)
      * @param drop_empty_slices if true, empty time slices will be skipped; not yet implemented
      * @param p chunk processor instance, defaults to the global configuration
+     * @param resume if true, continue an interrupted export by computing only chunks that are not listed in the export journal
+     * @param chunks ids of chunks to be computed, an empty vector (the default) selects all chunks; output pixels of other chunks remain empty.
+     * Overviews and COGs are created as for a complete export.
+     *
+     * @note During the export, completed chunks are recorded in a journal file `<prefix>gdalcubes_export.journal` in the
+     * output directory, which is removed after all chunks of the cube have been written successfully (or, for COGs, after a subset of
+     * chunks has been converted, which cannot be extended afterwards). If the journal is missing or does not
+     * match the cube, the export parameters, or existing files, `resume` is ignored and all files are written from scratch.
      *
      * @note Overview levels will be chosen by halving the number of pixels until the larger dimension
      * has less than 256 pixels.
@@ -760,7 +835,10 @@ class cube : public std::enable_shared_from_this<cube> {
      *
      * @note Depending on `overviews` and `cog` GeoTIFFs created and postprocessed stepwise:
      * 1. time slices of cubes of the cube are exported as tiled normal GeoTIFFs
-     * 2. Overviews are generated (internal)
+     * 2. Overviews are generated (internal). For `NEAREST` and `AVERAGE` resampling, overview levels are computed
+     * from the chunk buffers during step 1 as long as chunk boundaries align with overview pixels (i.e. chunk sizes are multiples of the
+     * overview factor), only remaining coarser levels are derived from the coarsest of these levels afterwards.
+     * Otherwise, overviews are built from the full resolution images after step 1.
      * 3. A new copy of the TIF with overviews is created, moving the IFDs of overviews to the beginning of the file (using gdal_translate -co COPY_SRC_OVERVIEWS=YES)
      * It seems not possible to generate COGs fomr in memory data without temporal copy, However,
      * improvements are very welcome (maybe the COG driver of GDAL > 3.1 helps?).
@@ -771,7 +849,9 @@ class cube : public std::enable_shared_from_this<cube> {
                               std::string overview_resampling = "NEAREST",
                               packed_export packing = packed_export::make_none(),
                               bool drop_empty_slices = false,
-                              std::shared_ptr<chunk_processor> p = config::instance()->get_default_chunk_processor());
+                              std::shared_ptr<chunk_processor> p = config::instance()->get_default_chunk_processor(),
+                              bool resume = false,
+                              std::vector<chunkid_t> chunks = std::vector<chunkid_t>());
 
     /**
      * Write a data cube as a single netCDF file
@@ -782,19 +862,60 @@ class cube : public std::enable_shared_from_this<cube> {
      * @param packing reduce size of output tile with packing (apply scale + offset and use smaller integer data types)
      * @param drop_empty_slices if true, empty time slices will be skipped
      * @param p chunk processor instance, defaults to the global configuration
+     * @param resume if true, continue an interrupted export by computing only chunks that are not listed in the export journal
+     * @param chunks ids of chunks to be computed, an empty vector (the default) selects all chunks; output pixels of other chunks remain empty
      *
      * @note argument `drop_empty_slices` is not yet implemented.
+     *
+     * @note During the export, completed chunks are recorded in a journal file `<path>.journal`, which is removed after all chunks
+     * of the cube have been written successfully. If the journal is missing or does not match the cube, the export parameters, or the existing file,
+     * `resume` is ignored and the file is written from scratch.
      */
     void write_netcdf_file(std::string path, uint8_t compression_level = 0,
                            bool with_VRT = false, bool write_bounds = true, packed_export packing = packed_export::make_none(),
                            bool drop_empty_slices = false,
-                           std::shared_ptr<chunk_processor> p = config::instance()->get_default_chunk_processor());
+                           std::shared_ptr<chunk_processor> p = config::instance()->get_default_chunk_processor(),
+                           bool resume = false,
+                           std::vector<chunkid_t> chunks = std::vector<chunkid_t>());
 
     void write_chunks_netcdf(std::string dir, std::string name = "", uint8_t compression_level = 0,
-                             std::shared_ptr<chunk_processor> p = config::instance()->get_default_chunk_processor());
+                             std::shared_ptr<chunk_processor> p = config::instance()->get_default_chunk_processor(),
+                             std::vector<chunkid_t> chunks = std::vector<chunkid_t>());
 
     void write_single_chunk_netcdf(chunkid_t id, std::string path, uint8_t compression_level = 0);
 
+    /**
+     * @brief Write a data cube as an Apache Arrow IPC stream
+     *
+     * The stream contains one record batch per chunk with one float64 column per band, where
+     * rows are ordered by time, y (from top to bottom), and x. Chunk data is written without copying.
+     * Each record batch has custom metadata with key `gdalcubes` that contains a JSON object with the chunk id,
+     * the chunk's offset and size (in the order t, y, x, where y counts from the bottom of the cube), and its
+     * spatiotemporal extent. Empty chunks are written as record batches with zero rows.
+     * The schema's custom metadata (key `gdalcubes`) contains the cube's size, chunk size, extent, spatial reference system, time labels,
+     * band metadata, and its JSON representation.
+     *
+     * Since chunks are written in the order they are computed, batches might be out of order when using a
+     * parallel chunk processor.
+     *
+     * @param path output file path, which may also refer to a named pipe
+     * @param chunks ids of chunks to be written, an empty vector (the default) selects all chunks
+     * @param p chunk processor instance, defaults to the global configuration
+     */
+    void write_arrow_stream(std::string path, std::vector<chunkid_t> chunks = std::vector<chunkid_t>(),
+                            std::shared_ptr<chunk_processor> p = config::instance()->get_default_chunk_processor());
+
+    /**
+     * @brief Write a data cube as an Apache Arrow IPC stream to an open file descriptor, e.g. of a pipe
+     *
+     * @param fd file descriptor, will not be closed after writing
+     * @param chunks ids of chunks to be written, an empty vector (the default) selects all chunks
+     * @param p chunk processor instance, defaults to the global configuration
+     * @see cube::write_arrow_stream(std::string, std::vector<chunkid_t>, std::shared_ptr<chunk_processor>)
+     */
+    void write_arrow_stream(int fd, std::vector<chunkid_t> chunks = std::vector<chunkid_t>(),
+                            std::shared_ptr<chunk_processor> p = config::instance()->get_default_chunk_processor());
+
     /**
      * Get the cube's bands
      * @return all bands of the cube object as band_collection
@@ -851,6 +972,20 @@ class cube : public std::enable_shared_from_this<cube> {
      * @brief List of cube instances that take this object as input (successors)
      */
     std::vector<std::weak_ptr<cube>> _succ;
+
+   private:
+    /**
+     * @brief Create a netCDF file with dimensions, coordinate variables, metadata, and one empty variable per band
+     * @param op path of the target file
+     * @param compression_level deflate level, 0 = no compression
+     * @param write_bounds boolean, if true, variables time_bnds, y_bnds, x_bnds will be added
+     * @param packing packing parameters, scale / offset / nodata must already be validated
+     * @param ot netCDF data type of band variables
+     * @param[out] ncout netCDF id of the created file, which is left open in data mode
+     * @param[out] v_bands variable ids of all bands
+     * @see cube::write_netcdf_file()
+     */
+    void create_netcdf_file(std::string op, uint8_t compression_level, bool write_bounds, packed_export packing, int ot, int &ncout, std::vector<int> &v_bands);
 };
 
 }  // namespace gdalcubes
@@ -43,6 +43,9 @@
 #include "stream_apply_time.h"
 #include "stream_reduce_space.h"
 #include "stream_reduce_time.h"
+#include "udf_apply_pixel.h"
+#include "udf_apply_time.h"
+#include "udf_reduce_time.h"
 #include "window_time.h"
 
 namespace gdalcubes {
@@ -174,7 +177,7 @@ void cube_factory::register_default() {
 
     cube_generators.insert(std::make_pair<std::string, std::function<std::shared_ptr<cube>(json11::Json&)>>(
         "stream", [](json11::Json& j) {
-            auto x = stream_cube::create(instance()->create_from_json(j["in_cube"]), j["command"].string_value(), j["file_streaming"].bool_value());
+            auto x = stream_cube::create(instance()->create_from_json(j["in_cube"]), j["command"].string_value(), j["file_streaming"].bool_value(), j["persistent"].bool_value(), stream_format::from_json(j));
             return x;
         }));
 
@@ -236,7 +239,7 @@ void cube_factory::register_default() {
             for (uint16_t i = 0; i < j["names"].array_items().size(); ++i) {
                 names.push_back(j["names"][i].string_value());
             }
-            auto x = stream_reduce_time_cube::create(instance()->create_from_json(j["in_cube"]), j["cmd"].string_value(), j["nbands"].int_value(), names);
+            auto x = stream_reduce_time_cube::create(instance()->create_from_json(j["in_cube"]), j["cmd"].string_value(), j["nbands"].int_value(), names, stream_format::from_json(j));
             return x;
         }));
 
@@ -246,7 +249,7 @@ void cube_factory::register_default() {
             for (uint16_t i = 0; i < j["names"].array_items().size(); ++i) {
                 names.push_back(j["names"][i].string_value());
             }
-            auto x = stream_reduce_space_cube::create(instance()->create_from_json(j["in_cube"]), j["cmd"].string_value(), j["nbands"].int_value(), names);
+            auto x = stream_reduce_space_cube::create(instance()->create_from_json(j["in_cube"]), j["cmd"].string_value(), j["nbands"].int_value(), names, stream_format::from_json(j));
             return x;
         }));
 
@@ -256,7 +259,7 @@ void cube_factory::register_default() {
             for (uint16_t i = 0; i < j["names"].array_items().size(); ++i) {
                 names.push_back(j["names"][i].string_value());
             }
-            auto x = stream_apply_pixel_cube::create(instance()->create_from_json(j["in_cube"]), j["cmd"].string_value(), j["nbands"].int_value(), names, j["keep_bands"].bool_value());
+            auto x = stream_apply_pixel_cube::create(instance()->create_from_json(j["in_cube"]), j["cmd"].string_value(), j["nbands"].int_value(), names, j["keep_bands"].bool_value(), stream_format::from_json(j), uint64_t(j["batch_bytes"].number_value()));
             return x;
         }));
     cube_generators.insert(std::make_pair<std::string, std::function<std::shared_ptr<cube>(json11::Json&)>>(
@@ -265,7 +268,34 @@ void cube_factory::register_default() {
             for (uint16_t i = 0; i < j["names"].array_items().size(); ++i) {
                 names.push_back(j["names"][i].string_value());
             }
-            auto x = stream_apply_time_cube::create(instance()->create_from_json(j["in_cube"]), j["cmd"].string_value(), j["nbands"].int_value(), names, j["keep_bands"].bool_value());
+            auto x = stream_apply_time_cube::create(instance()->create_from_json(j["in_cube"]), j["cmd"].string_value(), j["nbands"].int_value(), names, j["keep_bands"].bool_value(), stream_format::from_json(j), uint64_t(j["batch_bytes"].number_value()));
+            return x;
+        }));
+    cube_generators.insert(std::make_pair<std::string, std::function<std::shared_ptr<cube>(json11::Json&)>>(
+        "udf_apply_pixel", [](json11::Json& j) {
+            std::vector<std::string> names;
+            for (uint16_t i = 0; i < j["names"].array_items().size(); ++i) {
+                names.push_back(j["names"][i].string_value());
+            }
+            auto x = udf_apply_pixel_cube::create(instance()->create_from_json(j["in_cube"]), j["library"].string_value(), j["symbol"].string_value(), j["nbands"].int_value(), names, j["keep_bands"].bool_value());
+            return x;
+        }));
+    cube_generators.insert(std::make_pair<std::string, std::function<std::shared_ptr<cube>(json11::Json&)>>(
+        "udf_apply_time", [](json11::Json& j) {
+            std::vector<std::string> names;
+            for (uint16_t i = 0; i < j["names"].array_items().size(); ++i) {
+                names.push_back(j["names"][i].string_value());
+            }
+            auto x = udf_apply_time_cube::create(instance()->create_from_json(j["in_cube"]), j["library"].string_value(), j["symbol"].string_value(), j["nbands"].int_value(), names, j["keep_bands"].bool_value());
+            return x;
+        }));
+    cube_generators.insert(std::make_pair<std::string, std::function<std::shared_ptr<cube>(json11::Json&)>>(
+        "udf_reduce_time", [](json11::Json& j) {
+            std::vector<std::string> names;
+            for (uint16_t i = 0; i < j["names"].array_items().size(); ++i) {
+                names.push_back(j["names"][i].string_value());
+            }
+            auto x = udf_reduce_time_cube::create(instance()->create_from_json(j["in_cube"]), j["library"].string_value(), j["symbol"].string_value(), j["nbands"].int_value(), names);
             return x;
         }));
 }
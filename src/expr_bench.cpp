@@ -0,0 +1,170 @@
+/*
+    MIT License
+
+    Copyright (c) 2019 Marius Appel <marius.appel@uni-muenster.de>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+/**
+ * This file contains a benchmark of pixel-wise expression evaluation as used by apply_pixel_cube and
+ * filter_pixel_cube, comparing block-wise evaluation with batch_expr to evaluating the tinyexpr syntax tree per pixel.
+ */
+
+#include <boost/program_options.hpp>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <unordered_set>
+
+#include "batch_expr.h"
+#include "external/tinyexpr/tinyexpr.h"
+#include "timer.h"
+
+using namespace gdalcubes;
+
+void print_usage() {
+    std::cout << "Usage: gdalcubes_expr_bench [options]" << std::endl;
+    std::cout << std::endl;
+    std::cout << "Evaluate expressions on random band data of a chunk, per pixel with te_eval() as in previous versions of apply_pixel_cube "
+                 "and in blocks with batch_expr, and report pixels per second."
+              << std::endl;
+    std::cout << std::endl;
+    std::cout << "Options:" << std::endl;
+    std::cout << "  -e, --expr                  Expression over bands b1, b2, b3, and pixel index ix, can be given several times, defaults to a set of typical expressions" << std::endl;
+    std::cout << "  -p, --pixels                Number of pixels of the chunk, defaults to 1048576" << std::endl;
+    std::cout << "  -r, --repeat                Number of repetitions per expression, defaults to 10" << std::endl;
+    std::cout << std::endl;
+}
+
+/**
+ * Per-pixel evaluation as previously implemented in apply_pixel_cube::read_chunk(): gather band values of each pixel
+ * into the symbol table, compute additional variables if used, and evaluate the syntax tree
+ */
+void eval_per_pixel(const std::string &expr, const std::vector<double> &in, uint32_t nbands, uint32_t npixels, double *out) {
+    std::vector<double> values(nbands + 1, NAN);
+    std::vector<std::string> names = {"b1", "b2", "b3", "ix"};
+    std::vector<te_variable> vars;
+    for (uint16_t i = 0; i <= nbands; ++i) {
+        vars.push_back({names[i].c_str(), &values[i], TE_VARIABLE, nullptr});
+    }
+    int err;
+    te_expr *x = te_compile(expr.c_str(), vars.data(), vars.size(), &err);
+    std::unordered_set<std::string> var_usage;
+    if (expr.find("ix") != std::string::npos) var_usage.insert("ix");
+    for (uint32_t i = 0; i < npixels; ++i) {
+        for (uint16_t ib = 0; ib < nbands; ++ib) {
+            values[ib] = in[ib * npixels + i];
+        }
+        if (var_usage.count("ix") || var_usage.count("left") || var_usage.count("right")) {
+            values[nbands] = i % 256;
+        }
+        out[i] = te_eval(x);
+    }
+    te_free(x);
+}
+
+/**
+ * Block-wise evaluation as implemented in apply_pixel_cube::read_chunk()
+ */
+void eval_blocks(const std::string &expr, const std::vector<double> &in, uint32_t nbands, uint32_t npixels, double *out) {
+    int err;
+    std::shared_ptr<batch_expr> x = batch_expr::compile(expr, {"b1", "b2", "b3", "ix"}, &err);
+    std::vector<double> ix(batch_expr::block_size);
+    std::vector<const double *> vars(nbands + 1);
+    vars[nbands] = ix.data();
+    bool use_ix = x->uses(nbands);
+    for (uint32_t i0 = 0; i0 < npixels; i0 += batch_expr::block_size) {
+        uint32_t n = std::min(batch_expr::block_size, npixels - i0);
+        for (uint16_t ib = 0; ib < nbands; ++ib) {
+            vars[ib] = in.data() + ib * npixels + i0;
+        }
+        if (use_ix) {
+            for (uint32_t k = 0; k < n; ++k) ix[k] = (i0 + k) % 256;
+        }
+        x->eval(vars.data(), n, out + i0);
+    }
+}
+
+int main(int argc, char *argv[]) {
+    namespace po = boost::program_options;
+    po::options_description global_args("Options");
+    global_args.add_options()("help,h", "")("expr,e", po::value<std::vector<std::string>>(), "")("pixels,p", po::value<uint32_t>()->default_value(1048576), "")("repeat,r", po::value<uint16_t>()->default_value(10), "");
+
+    po::variables_map vm;
+    try {
+        po::store(po::command_line_parser(argc, argv).options(global_args).run(), vm);
+        if (vm.count("help")) {
+            print_usage();
+            return 0;
+        }
+    } catch (...) {
+        std::cout << "ERROR in gdalcubes_expr_bench: cannot parse arguments." << std::endl;
+        print_usage();
+        return 1;
+    }
+
+    std::vector<std::string> expr = {"(b1 - b2) / (b1 + b2)", "ifelse(b3 > 0.5, b1 * 2, sqrt(abs(b2)))",
+                                     "2.5 * (b1 - b2) / (b1 + 6 * b2 - 7.5 * b3 + 1)", "(b1 + b2 + b3) / 3 + ix * 0.001",
+                                     "b1 > 0.2 && b2 < 0.8 || isnan(b3)", "exp(b1) + ln(b2 + 1)"};
+    if (vm.count("expr")) {
+        expr = vm["expr"].as<std::vector<std::string>>();
+    }
+    uint32_t npixels = vm["pixels"].as<uint32_t>();
+    uint16_t repeat = vm["repeat"].as<uint16_t>();
+
+    // random band values with 5% missing values
+    const uint32_t nbands = 3;
+    std::vector<double> in(nbands * std::size_t(npixels));
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<double> u(0, 1);
+    for (std::size_t i = 0; i < in.size(); ++i) {
+        in[i] = u(rng) < 0.05 ? NAN : u(rng);
+    }
+
+    std::vector<double> out_pixel(npixels), out_block(npixels);
+    std::cout << std::left << std::setw(50) << "expression" << std::right << std::setw(16) << "te_eval [px/s]" << std::setw(16) << "batch [px/s]" << std::setw(10) << "speedup" << std::endl;
+    for (uint16_t ie = 0; ie < expr.size(); ++ie) {
+        int err;
+        if (!batch_expr::compile(expr[ie], {"b1", "b2", "b3", "ix"}, &err)) {
+            std::cout << "ERROR in gdalcubes_expr_bench: cannot parse expression '" << expr[ie] << "': error at token " << err << std::endl;
+            return 1;
+        }
+
+        timer t;
+        for (uint16_t r = 0; r < repeat; ++r) eval_per_pixel(expr[ie], in, nbands, npixels, out_pixel.data());
+        double time_pixel = t.time();
+        t.start();
+        for (uint16_t r = 0; r < repeat; ++r) eval_blocks(expr[ie], in, nbands, npixels, out_block.data());
+        double time_block = t.time();
+
+        for (uint32_t i = 0; i < npixels; ++i) {
+            if (!(out_pixel[i] == out_block[i] || (std::isnan(out_pixel[i]) && std::isnan(out_block[i])))) {
+                std::cout << "ERROR in gdalcubes_expr_bench: different results for '" << expr[ie] << "' at pixel " << i << std::endl;
+                return 1;
+            }
+        }
+
+        double n = double(npixels) * repeat;
+        std::cout << std::left << std::setw(50) << expr[ie] << std::right << std::scientific << std::setprecision(3) << std::setw(16) << n / time_pixel << std::setw(16) << n / time_block
+                  << std::fixed << std::setprecision(2) << std::setw(9) << time_pixel / time_block << "x" << std::endl;
+    }
+    return 0;
+}
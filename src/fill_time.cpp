@@ -13,13 +13,6 @@ std::shared_ptr<chunk_data> fill_time_cube::read_chunk(chunkid_t id) {
     coords_nd<uint32_t, 3> size_tyx = chunk_size(id);
 
     coords_nd<uint32_t, 4> size_btyx = {uint32_t(_bands.count()), size_tyx[0], size_tyx[1], size_tyx[2]};
-    out->size(size_btyx);
-
-    // Fill buffers accordingly
-    out->buf(std::calloc(size_btyx[0] * size_btyx[1] * size_btyx[2] * size_btyx[3], sizeof(double)));
-    double* begin = (double*)out->buf();
-    double* end = ((double*)out->buf()) + size_btyx[0] * size_btyx[1] * size_btyx[2] * size_btyx[3];
-    std::fill(begin, end, NAN);
 
     //std::shared_ptr<chunk_data> this_chunk = _in_cube->read_chunk(id);
     //std::vector<std::shared_ptr<chunk_data>> l_chunks;
@@ -28,6 +21,18 @@ std::shared_ptr<chunk_data> fill_time_cube::read_chunk(chunkid_t id) {
     std::unordered_map<chunkid_t, std::shared_ptr<chunk_data>> in_chunks;
     in_chunks.insert(std::pair<chunkid_t, std::shared_ptr<chunk_data>>(id, _in_cube->read_chunk(id)));
 
+    if (in_chunks[id]->empty() && chunk_is_empty(id)) {
+        return out;  // nothing to fill from, if all chunks of the time series are empty
+    }
+
+    out->size(size_btyx);
+
+    // Fill buffers accordingly
+    out->buf(std::calloc(size_btyx[0] * size_btyx[1] * size_btyx[2] * size_btyx[3], sizeof(double)));
+    double* begin = (double*)out->buf();
+    double* end = ((double*)out->buf()) + size_btyx[0] * size_btyx[1] * size_btyx[2] * size_btyx[3];
+    std::fill(begin, end, NAN);
+
     if (in_chunks[id]->empty()) {  // if input chunk is empty, fill with NANs
         in_chunks[id]->size(size_btyx);
         in_chunks[id]->buf(std::calloc(size_btyx[0] * size_btyx[1] * size_btyx[2] * size_btyx[3], sizeof(double)));
@@ -207,4 +212,16 @@ std::shared_ptr<chunk_data> fill_time_cube::read_chunk(chunkid_t id) {
     return out;
 }
 
+bool fill_time_cube::chunk_is_empty(chunkid_t id) {
+    if (id >= count_chunks())
+        return true;
+
+    // all chunks with the same spatial extent must be empty
+    chunkid_t n_xy = _in_cube->count_chunks_x() * _in_cube->count_chunks_y();
+    for (chunkid_t i = id % n_xy; i < _in_cube->count_chunks(); i += n_xy) {
+        if (!_in_cube->chunk_is_empty(i)) return false;
+    }
+    return true;
+}
+
 }  // namespace gdalcubes
@@ -53,6 +53,8 @@ class fill_time_cube : public cube {
 
     std::shared_ptr<chunk_data> read_chunk(chunkid_t id) override;
 
+    bool chunk_is_empty(chunkid_t id) override;
+
     json11::Json make_constructible_json() override {
         json11::Json::object out;
         out["cube_type"] = "fill_time";
@@ -24,6 +24,7 @@
 
 #include "filter_pixel.h"
 
+#include "batch_expr.h"
 #include "external/tinyexpr/tinyexpr.h"
 
 namespace gdalcubes {
@@ -36,32 +37,29 @@ std::shared_ptr<chunk_data> filter_pixel_cube::read_chunk(chunkid_t id) {
 
     std::shared_ptr<chunk_data> out = std::make_shared<chunk_data>();
 
-    // Parse expressions and create symbol table
-    std::vector<double> values;
-    values.resize(_in_cube->bands().count(), NAN);
-    // WARNING: never change size of values from now
-
-    // TODO: add further variables like x, y, t to symbol table
+    // propagate empty input chunks without parsing the predicate
+    std::shared_ptr<chunk_data> in = _in_cube->read_chunk(id);
+    if (in->empty()) {
+        return out;
+    }
 
-    std::vector<te_variable> vars;
+    // Compile predicate, variables are the bands of the input cube
+    // TODO: add further variables like x, y, t
+    std::vector<std::string> varnames;
     for (uint16_t i = 0; i < _in_cube->bands().count(); ++i) {
-        char* varname = new char[_in_cube->bands().get(i).name.length() + 1];
         std::string temp_name = _in_cube->bands().get(i).name;
         std::transform(temp_name.begin(), temp_name.end(), temp_name.begin(), ::tolower);
-        std::strncpy(varname, temp_name.c_str(), temp_name.length() + 1);
-        vars.push_back({varname, &values[i]});
+        varnames.push_back(temp_name);
     }
 
     int err;
-    te_expr* expr = te_compile(_pred.c_str(), vars.data(), vars.size(), &err);
+    std::shared_ptr<batch_expr> expr = batch_expr::compile(_pred, varnames, &err);
     if (!expr) {
         std::string msg = "Cannot parse predicate '" + _pred + "': error at token " + std::to_string(err);
         GCBS_ERROR(msg);
-        te_free(expr);
         return out;
     }
 
-    std::shared_ptr<chunk_data> in = _in_cube->read_chunk(id);
     out->size({_bands.count(), in->size()[1], in->size()[2], in->size()[3]});
     out->buf(std::calloc(_bands.count() * in->size()[1] * in->size()[2] * in->size()[3], sizeof(double)));
 
@@ -70,27 +68,25 @@ std::shared_ptr<chunk_data> filter_pixel_cube::read_chunk(chunkid_t id) {
     //double *end = ((double *)out->buf()) + size_btyx[0] * size_btyx[1] * size_btyx[2] * size_btyx[3];
     // std::fill(begin, end, NAN);
 
-    for (uint32_t i = 0; i < in->size()[1] * in->size()[2] * in->size()[3]; ++i) {
+    const uint32_t B = batch_expr::block_size;
+    uint32_t ntxy = in->size()[1] * in->size()[2] * in->size()[3];
+    std::vector<const double*> vars(in->size()[0]);
+    std::vector<double> mask(B);
+    for (uint32_t i0 = 0; i0 < ntxy; i0 += B) {
+        uint32_t n = std::min(B, ntxy - i0);
         for (uint16_t inb = 0; inb < in->size()[0]; ++inb) {
-            values[inb] = ((double*)in->buf())[inb * in->size()[1] * in->size()[2] * in->size()[3] + i];
+            vars[inb] = ((double*)in->buf()) + inb * ntxy + i0;
         }
-        if (te_eval(expr) != 0) {
-            for (uint16_t ib = 0; ib < _bands.count(); ++ib) {
-                ((double*)out->buf())[ib * in->size()[1] * in->size()[2] * in->size()[3] + i] = ((double*)in->buf())[ib * in->size()[1] * in->size()[2] * in->size()[3] + i];
-            }
-        } else {
-            for (uint16_t ib = 0; ib < _bands.count(); ++ib) {
-                ((double*)out->buf())[ib * in->size()[1] * in->size()[2] * in->size()[3] + i] = NAN;
+        expr->eval(vars.data(), n, mask.data());
+        for (uint16_t ib = 0; ib < _bands.count(); ++ib) {
+            const double* src = ((double*)in->buf()) + ib * ntxy + i0;
+            double* dst = ((double*)out->buf()) + ib * ntxy + i0;
+            for (uint32_t k = 0; k < n; ++k) {
+                dst[k] = (mask[k] != 0) ? src[k] : NAN;
             }
         }
     }
 
-    te_free(expr);
-
-    for (uint16_t i = 0; i < _in_cube->bands().count(); ++i) {  // only free name of actual variables (not functions)
-        delete[] vars[i].name;
-    }
-
     return out;
 }
 
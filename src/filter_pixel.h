@@ -84,6 +84,10 @@ class filter_pixel_cube : public cube {
 
     std::shared_ptr<chunk_data> read_chunk(chunkid_t id) override;
 
+    bool chunk_is_empty(chunkid_t id) override {
+        return _in_cube->chunk_is_empty(id);  // empty input chunks are propagated
+    }
+
     json11::Json make_constructible_json() override {
         json11::Json::object out;
         out["cube_type"] = "filter_pixel";
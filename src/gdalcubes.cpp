@@ -83,6 +83,7 @@ void print_usage(std::string command = "") {
         std::cout << "    , --deflate            Deflate compression level for output NetCDF file (0=no compression, 9=max compression), defaults to 1" << std::endl;
         std::cout << "  -t, --threads            Number of threads used for parallel chunk processing, defaults to 1" << std::endl;
         std::cout << "  -c, --chunk              Compute only one specific chunk, specified by its integer identifier" << std::endl;
+        std::cout << "      --resume             Continue an interrupted export and compute only chunks missing in DEST" << std::endl;
         std::cout << "      --swarm              Filename of a simple text file where each line points to a gdalcubes server API endpoint" << std::endl;
         std::cout << "  -d, --debug              Print debug messages" << std::endl;
         std::cout << std::endl;
@@ -281,6 +282,7 @@ int main(int argc, char* argv[]) {
             exec_desc.add_options()("threads,t", po::value<uint16_t>()->default_value(1), "");
             exec_desc.add_options()("swarm", po::value<std::string>(), "");
             exec_desc.add_options()("deflate", po::value<uint8_t>()->default_value(1), "");
+            exec_desc.add_options()("resume", "");
 
             po::positional_options_description exec_pos;
             exec_pos.add("input", 1);
@@ -315,7 +317,7 @@ int main(int argc, char* argv[]) {
             if (vm.count("chunk")) {
                 c->write_single_chunk_netcdf(vm["chunk"].as<chunkid_t>(), output, deflate);
             } else {
-                c->write_netcdf_file(output, deflate);
+                c->write_netcdf_file(output, deflate, false, true, packed_export::make_none(), false, config::instance()->get_default_chunk_processor(), vm.count("resume") > 0);
             }
 
         } else if (cmd == "addo") {
@@ -48,6 +48,9 @@
 #include "stream_reduce_space.h"
 #include "stream_reduce_time.h"
 #include "swarm.h"
+#include "udf_apply_pixel.h"
+#include "udf_apply_time.h"
+#include "udf_reduce_time.h"
 #include "utils.h"
 #include "vector_queries.h"
 #include "window_time.h"
@@ -1162,6 +1162,26 @@ std::vector<image_collection::find_range_st_row> image_collection::find_range_st
     return out;
 }
 
+bool image_collection::has_images_in_range_st(bounds_st range, std::string srs) {
+    bounds_2d<double> range_trans = (srs == "EPSG:4326") ? range.s : range.s.transform(srs, "EPSG:4326");
+    std::string sql =
+        "SELECT images.id FROM images INNER JOIN gdalrefs ON images.id = gdalrefs.image_id WHERE "
+        "strftime('%Y-%m-%dT%H:%M:%S', images.datetime) >= '" +
+        range.t0.to_string(datetime_unit::SECOND) + "' AND strftime('%Y-%m-%dT%H:%M:%S', images.datetime) <= '" + range.t1.to_string(datetime_unit::SECOND) +
+        "' AND NOT "
+        "(images.right < " +
+        std::to_string(range_trans.left) + " OR images.left > " + std::to_string(range_trans.right) + " OR images.bottom > " + std::to_string(range_trans.top) + " OR images.top < " + std::to_string(range_trans.bottom) + ") LIMIT 1;";
+
+    sqlite3_stmt* stmt;
+    sqlite3_prepare_v2(_db, sql.c_str(), -1, &stmt, NULL);
+    if (!stmt) {
+        throw std::string("ERROR in image_collection::has_images_in_range_st(): cannot prepare query statement");
+    }
+    bool out = sqlite3_step(stmt) == SQLITE_ROW;
+    sqlite3_finalize(stmt);
+    return out;
+}
+
 std::vector<image_collection::bands_row> image_collection::get_all_bands() {
     std::vector<image_collection::bands_row> out;
 
@@ -199,6 +199,15 @@ class image_collection {
         return find_range_st(range, srs, std::vector<std::string>(), order_by);
     };
 
+    /**
+     * Check whether at least one image of the collection intersects with a spatiotemporal extent.
+     * This is much cheaper than find_range_st() since the query stops after the first match.
+     * @param range spatiotemporal extent
+     * @param srs spatial reference system of range
+     * @return true if any image intersects with range
+     */
+    bool has_images_in_range_st(bounds_st range, std::string srs);
+
     /**
      * Return available bands of an image collection. Bands without
      * correspoding datasets are omitted.
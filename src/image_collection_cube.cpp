@@ -29,6 +29,7 @@
 #include <unordered_map>
 
 #include "error.h"
+#include "metrics.h"
 #include "utils.h"
 #include "warp.h"
 
@@ -305,6 +306,14 @@ struct aggregation_state_none : public aggregation_state {
     void finalize(void *buf) override {}
 };
 
+// checks the image index only, without opening any images
+bool image_collection_cube::chunk_has_images(chunkid_t id) {
+    if (id >= count_chunks()) {
+        return false;
+    }
+    return _collection->has_images_in_range_st(bounds_from_chunk(id), _st_ref->srs());
+}
+
 /*
  * The procedure to read data for a chunk is the following:
  * 1. Exclude images that are completely ouside the spatiotemporal chunk boundaries
@@ -423,6 +432,7 @@ std::shared_ptr<chunk_data> image_collection_cube::read_chunk(chunkid_t id) {
             if (!g) {
                 throw std::string("ERROR in image_collection_cube::read_chunk(): GDAL cannot open'" + it->first + "'");
             }
+            ++metrics::instance()->gdal_open;
 
             // If input dataset has more bands than requested
             bool create_band_subset_vrt = false;
@@ -515,6 +525,7 @@ std::shared_ptr<chunk_data> image_collection_cube::read_chunk(chunkid_t id) {
                 if (!g) {
                     throw std::string("ERROR in image_collection_cube::read_chunk(): GDAL cannot open'" + mask_dataset_band.first + "'");
                 }
+                ++metrics::instance()->gdal_open;
 
                 // If input dataset has more bands than requested
                 bool create_band_subset_vrt = false;
@@ -280,6 +280,20 @@ class image_collection_cube : public cube {
 
     std::shared_ptr<chunk_data> read_chunk(chunkid_t id) override;
 
+    /**
+     * @brief Check whether any image of the collection intersects with a chunk
+     *
+     * This does not read any data and can be used to skip empty chunks before allocating buffers,
+     * read_chunk() returns an empty chunk if this function returns false.
+     * @param id chunk id
+     * @return true if at least one image intersects with the chunk
+     */
+    bool chunk_has_images(chunkid_t id);
+
+    bool chunk_is_empty(chunkid_t id) override {
+        return !chunk_has_images(id);
+    }
+
     // image_collection_cube is the only class that supports changing chunk sizes from outside!
     // This is important for e.g. streaming.
     void set_chunk_size(uint32_t t, uint32_t y, uint32_t x) {
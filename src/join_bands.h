@@ -150,6 +150,8 @@ class join_bands_cube : public cube {
 
     std::shared_ptr<chunk_data> read_chunk(chunkid_t id) override;
 
+    bool chunk_is_empty(chunkid_t id) override;
+
     json11::Json make_constructible_json() override {
         json11::Json::object out;
         out["cube_type"] = "join_bands";
@@ -0,0 +1,85 @@
+/*
+    MIT License
+
+    Copyright (c) 2019 Marius Appel <marius.appel@uni-muenster.de>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#include "metrics.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <limits>
+#include <sstream>
+
+namespace gdalcubes {
+
+histogram::histogram(std::vector<double> bounds) : _bounds(bounds), _buckets(bounds.size() + 1), _count(0), _sum_micro(0) {
+    std::sort(_bounds.begin(), _bounds.end());
+    for (uint16_t i = 0; i < _buckets.size(); ++i) {
+        _buckets[i] = 0;
+    }
+}
+
+void histogram::observe(double x) {
+    if (std::isnan(x)) return;
+    std::size_t i = std::lower_bound(_bounds.begin(), _bounds.end(), x) - _bounds.begin();
+    ++_buckets[i];
+    ++_count;
+    if (x > 0) _sum_micro += uint64_t(std::llround(x * 1e6));
+}
+
+/**
+ * Format numbers as in the Prometheus text format, e.g. without exponents for small integers
+ */
+static std::string prometheus_number(double x) {
+    if (std::isinf(x)) return x > 0 ? "+Inf" : "-Inf";
+    std::stringstream ss;
+    ss << std::setprecision(std::numeric_limits<double>::digits10) << x;
+    return ss.str();
+}
+
+void histogram::write_prometheus(std::ostream& os, std::string name, std::string help) const {
+    os << "# HELP " << name << " " << help << "\n";
+    os << "# TYPE " << name << " histogram\n";
+    uint64_t cumulative = 0;
+    for (uint16_t i = 0; i < _buckets.size(); ++i) {
+        cumulative += _buckets[i];
+        std::string le = i < _bounds.size() ? prometheus_number(_bounds[i]) : "+Inf";
+        os << name << "_bucket{le=\"" << le << "\"} " << cumulative << "\n";
+    }
+    os << name << "_sum " << prometheus_number(sum()) << "\n";
+    os << name << "_count " << cumulative << "\n";
+}
+
+void metrics::write_prometheus_counter(std::ostream& os, std::string name, std::string help, double value) {
+    os << "# HELP " << name << " " << help << "\n";
+    os << "# TYPE " << name << " counter\n";
+    os << name << " " << prometheus_number(value) << "\n";
+}
+
+void metrics::write_prometheus_gauge(std::ostream& os, std::string name, std::string help, double value) {
+    os << "# HELP " << name << " " << help << "\n";
+    os << "# TYPE " << name << " gauge\n";
+    os << name << " " << prometheus_number(value) << "\n";
+}
+
+}  // namespace gdalcubes
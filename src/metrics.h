@@ -0,0 +1,116 @@
+/*
+    MIT License
+
+    Copyright (c) 2019 Marius Appel <marius.appel@uni-muenster.de>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <atomic>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace gdalcubes {
+
+/**
+ * @brief Histogram of durations with fixed buckets, observations are recorded without locks
+ *
+ * Counts of buckets are not cumulative internally but are reported cumulatively in the Prometheus text format.
+ */
+class histogram {
+   public:
+    /**
+     * @brief Create a histogram
+     * @param bounds upper bounds of buckets in ascending order, an additional bucket contains larger values
+     */
+    histogram(std::vector<double> bounds);
+
+    /**
+     * @brief Add an observation
+     * @param x value, e.g. duration in seconds
+     */
+    void observe(double x);
+
+    /**
+     * @brief Number of observations
+     */
+    inline uint64_t count() const { return _count; }
+
+    /**
+     * @brief Sum of all observations, accurate to one microunit
+     */
+    inline double sum() const { return double(_sum_micro) / 1e6; }
+
+    /**
+     * @brief Write the histogram in the Prometheus text exposition format
+     * @param os output stream
+     * @param name metric name
+     * @param help description of the metric
+     */
+    void write_prometheus(std::ostream& os, std::string name, std::string help) const;
+
+   private:
+    std::vector<double> _bounds;
+    std::vector<std::atomic<uint64_t>> _buckets;
+    std::atomic<uint64_t> _count;
+    std::atomic<uint64_t> _sum_micro;
+};
+
+/**
+ * @brief Process-wide counters for monitoring, e.g. by gdalcubes_server's GET /metrics
+ *
+ * All members can be updated concurrently without locks.
+ */
+class metrics {
+   public:
+    static metrics* instance() {
+        static metrics m;
+        return &m;
+    }
+
+    std::atomic<uint64_t> gdal_open;     // datasets opened by image_collection_cube::read_chunk()
+    std::atomic<uint64_t> gdal_warp;     // calls of gdalwarp_client::warp()
+    std::atomic<uint64_t> bytes_served;  // response bytes of chunk downloads by gdalcubes_server
+    std::atomic<uint64_t> chunk_reads;   // successful chunk reads by gdalcubes_server workers
+    std::atomic<uint64_t> chunk_errors;  // failed chunk reads by gdalcubes_server workers
+    histogram chunk_read_seconds;        // duration of chunk reads by gdalcubes_server workers
+
+    /**
+     * @brief Write a counter in the Prometheus text exposition format
+     */
+    static void write_prometheus_counter(std::ostream& os, std::string name, std::string help, double value);
+
+    /**
+     * @brief Write a gauge in the Prometheus text exposition format
+     */
+    static void write_prometheus_gauge(std::ostream& os, std::string name, std::string help, double value);
+
+   private:
+    metrics() : gdal_open(0), gdal_warp(0), bytes_served(0), chunk_reads(0), chunk_errors(0), chunk_read_seconds({0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1, 2.5, 5, 10, 30, 60, 120}) {}
+    metrics(const metrics&) = delete;
+};
+
+}  // namespace gdalcubes
+
+#endif  //METRICS_H
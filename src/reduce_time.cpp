@@ -454,6 +454,27 @@ struct sd_reducer_singleband : public var_reducer_singleband {
     }
 };
 
+/**
+ * @brief Check whether a reducer returns NAN for time series without any valid observation
+ * @param name name of the reducer
+ * @return false for reducers with defined results for empty time series (sum, count, prod), true otherwise
+ */
+static bool reducer_returns_nan_if_empty(std::string name) {
+    return name != "sum" && name != "count" && name != "prod";
+}
+
+bool reduce_time_cube::chunk_is_empty(chunkid_t id) {
+    if (id >= count_chunks())
+        return true;
+    for (uint16_t i = 0; i < _reducer_bands.size(); ++i) {
+        if (!reducer_returns_nan_if_empty(_reducer_bands[i].first)) return false;
+    }
+    for (chunkid_t i = id; i < _in_cube->count_chunks(); i += _in_cube->count_chunks_x() * _in_cube->count_chunks_y()) {
+        if (!_in_cube->chunk_is_empty(i)) return false;
+    }
+    return true;
+}
+
 std::shared_ptr<chunk_data> reduce_time_cube::read_chunk(chunkid_t id) {
     GCBS_TRACE("reduce_time_cube::read_chunk(" + std::to_string(id) + ")");
     std::shared_ptr<chunk_data> out = std::make_shared<chunk_data>();
@@ -510,20 +531,29 @@ std::shared_ptr<chunk_data> reduce_time_cube::read_chunk(chunkid_t id) {
     }
 
     // iterate over all chunks that must be read from the input cube to compute this chunk
+    bool allempty = true;
     for (chunkid_t i = id; i < _in_cube->count_chunks(); i += _in_cube->count_chunks_x() * _in_cube->count_chunks_y()) {
         std::shared_ptr<chunk_data> x = _in_cube->read_chunk(i);
+        if (x->empty()) continue;  // empty chunks do not contribute
+        allempty = false;
         for (uint16_t ib = 0; ib < _reducer_bands.size(); ++ib) {
             reducers[ib]->combine(out, x, i);
         }
     }
+    bool nan_if_empty = true;
     for (uint16_t i = 0; i < _reducer_bands.size(); ++i) {
         reducers[i]->finalize(out);
+        nan_if_empty = nan_if_empty && reducer_returns_nan_if_empty(_reducer_bands[i].first);
     }
 
     for (uint16_t i = 0; i < reducers.size(); ++i) {
         if (reducers[i] != nullptr) delete reducers[i];
     }
 
+    if (allempty && nan_if_empty) {
+        // propagate empty chunk if all input chunks are empty
+        return std::make_shared<chunk_data>();
+    }
     return out;
 }
 //
@@ -104,6 +104,8 @@ class reduce_time_cube : public cube {
 
     std::shared_ptr<chunk_data> read_chunk(chunkid_t id) override;
 
+    bool chunk_is_empty(chunkid_t id) override;
+
     /**
  * Combines all chunks and produces a single GDAL image
  * @param path path to output image file
@@ -40,6 +40,9 @@ std::shared_ptr<chunk_data> select_bands_cube::read_chunk(chunkid_t id) {
 
     // Fill buffers accordingly
     std::shared_ptr<chunk_data> out = std::make_shared<chunk_data>();
+    if (in->empty()) {
+        return out;
+    }
     out->size({_bands.count(), in->size()[1], in->size()[2], in->size()[3]});
     out->buf(std::calloc(_bands.count() * in->size()[1] * in->size()[2] * in->size()[3], sizeof(double)));
 
@@ -10,13 +10,6 @@ std::shared_ptr<chunk_data> select_time_cube::read_chunk(chunkid_t id) {
 
     coords_nd<uint32_t, 3> size_tyx = chunk_size(id);
     coords_nd<uint32_t, 4> size_btyx = {uint32_t(_bands.count()), size_tyx[0], size_tyx[1], size_tyx[2]};
-    out->size(size_btyx);
-
-    // Fill buffers accordingly
-    out->buf(std::calloc(size_btyx[0] * size_btyx[1] * size_btyx[2] * size_btyx[3], sizeof(double)));
-    double* begin = (double*)out->buf();
-    double* end = ((double*)out->buf()) + size_btyx[0] * size_btyx[1] * size_btyx[2] * size_btyx[3];
-    std::fill(begin, end, NAN);
 
     std::shared_ptr<chunk_data> in_chunk = nullptr;
     chunkid_t cur_input_chunk_id = 0;
@@ -44,6 +37,14 @@ std::shared_ptr<chunk_data> select_time_cube::read_chunk(chunkid_t id) {
 
             // for all bands
             if (!in_chunk->empty()) {
+                // allocate output buffer only if at least one input chunk is not empty
+                if (out->empty()) {
+                    out->size(size_btyx);
+                    out->buf(std::calloc(size_btyx[0] * size_btyx[1] * size_btyx[2] * size_btyx[3], sizeof(double)));
+                    double* begin = (double*)out->buf();
+                    double* end = ((double*)out->buf()) + size_btyx[0] * size_btyx[1] * size_btyx[2] * size_btyx[3];
+                    std::fill(begin, end, NAN);
+                }
                 for (uint16_t ib = 0; ib < size_btyx[0]; ++ib) {
                     //                assert(size_btyx[0] == in_chunk->size()[0]);
                     //                assert(size_btyx[2] == in_chunk->size()[2]);
@@ -60,4 +61,27 @@ std::shared_ptr<chunk_data> select_time_cube::read_chunk(chunkid_t id) {
     return out;
 }
 
+bool select_time_cube::chunk_is_empty(chunkid_t id) {
+    if (id >= count_chunks())
+        return true;
+
+    coords_nd<uint32_t, 3> size_tyx = chunk_size(id);
+    auto output_chunk_coords = chunk_coords_from_id(id);
+    chunkid_t last_input_chunk_id = _in_cube->count_chunks();
+    for (uint32_t it = 0; it < size_tyx[0]; ++it) {
+        datetime t = std::dynamic_pointer_cast<cube_stref_labeled_time>(_st_ref)->datetime_at_index(output_chunk_coords[0] * _chunk_size[0] + it);
+        uint32_t iin = _in_cube->st_reference()->index_at_datetime(t);
+        if (iin >= 0 && iin < _in_cube->size_t()) {
+            auto input_chunk_coords = output_chunk_coords;
+            input_chunk_coords[0] = iin / _in_cube->chunk_size()[0];
+            chunkid_t input_chunk_id = _in_cube->chunk_id_from_coords(input_chunk_coords);
+            if (input_chunk_id != last_input_chunk_id) {
+                if (!_in_cube->chunk_is_empty(input_chunk_id)) return false;
+                last_input_chunk_id = input_chunk_id;
+            }
+        }
+    }
+    return true;
+}
+
 }  // namespace gdalcubes
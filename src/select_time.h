@@ -99,6 +99,8 @@ class select_time_cube : public cube {
 
     std::shared_ptr<chunk_data> read_chunk(chunkid_t id) override;
 
+    bool chunk_is_empty(chunkid_t id) override;
+
     json11::Json make_constructible_json() override {
         std::vector<std::string> dt;
         for (uint32_t i = 0; i < _t.size(); ++i) {
@@ -25,23 +25,43 @@
 #include "server.h"
 
 #include <cpprest/filestream.h>
-#include <cpprest/rawptrstream.h>
+#include <cpprest/producerconsumerstream.h>
 
 #include <boost/program_options.hpp>
 #include <condition_variable>
+#include <cstdio>
+#include <fstream>
+
+#include <cpl_conv.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
 
 #include "build_info.h"
+#include "chunk_codec.h"
 #include "cube_factory.h"
 #include "image_collection.h"
+#include "metrics.h"
+#include "timer.h"
 #include "utils.h"
 /**
 GET  /version
+GET  /cache (chunk cache statistics as JSON)
+GET  /metrics (counters, gauges, and histograms in the Prometheus text format)
 POST /file (name query, body file)
-POST /cube (json process descr), return cube_id
+POST /file?name=...&hash=...&encoding=deflate (add file to the content-addressed store, optionally compressed with utils::deflate_block)
+POST /files/missing (JSON array of objects with name, hash, size), return JSON array of hashes missing in the content-addressed store
+POST /cube (json process descr), return cube_id, identical process graphs return the id of the existing cube
 GET /cube/{cube_id}
 POST /cube/{cube_id}/{chunk_id}/start
 GET /cube/{cube_id}/{chunk_id}/status status= "notrequested", "submitted" "queued" "running" "canceled" "finished" "error"
-GET /cube/{cube_id}/{chunk_id}/download
+GET /cube/{cube_id}/{chunk_id}/download?encoding=float32,nanmask,deflate (encoding is optional, see chunk_codec)
+POST /cube/{cube_id}/start (body: comma-separated chunk ids)
+GET /cube/{cube_id}/status?chunks=1,2,3 (JSON object chunk_id -> status)
+GET /cube/{cube_id}/download?chunks=1,2,3&encoding=... (stream of frames in order of completion, see chunk_codec)
 
 
  TODO:
@@ -52,8 +72,290 @@ GET /cube/{cube_id}/{chunk_id}/download
 
 namespace gdalcubes {
 
-server_chunk_cache* server_chunk_cache::_instance = nullptr;
-std::mutex server_chunk_cache::_singleton_mutex;
+/**
+ * Create the response of GET /cube/{cube_id}/{chunk_id}/download, the body contains the chunk
+ * encoded as requested by the client (see chunk_codec)
+ */
+static web::http::http_response make_chunk_response(std::shared_ptr<chunk_data> dat, uint8_t encoding) {
+    web::http::http_response res(web::http::status_codes::OK);
+    std::vector<unsigned char> body = chunk_codec::encode(dat, encoding);
+    metrics::instance()->bytes_served += body.size();
+    res.set_body(std::move(body));
+    res.headers().set_content_type("application/octet-stream");
+    res.headers().add("X-Gdalcubes-Chunk-Encoding", chunk_codec::encoding_string(encoding));
+    return res;
+}
+
+/**
+ * Parse a comma-separated list of chunk ids
+ */
+static std::vector<uint32_t> parse_chunk_ids(std::string s) {
+    std::vector<uint32_t> out;
+    std::stringstream ss(s);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        if (item.find_first_not_of(" \t\r\n") == std::string::npos) continue;
+        out.push_back(std::stoul(item));
+    }
+    return out;
+}
+
+/**
+ * Make the content of file from available as file to, as a hard link if possible and as a copy otherwise
+ * @return true on success
+ */
+static bool link_or_copy_file(std::string from, std::string to) {
+    // replace instead of overwriting, to may share its content with a file in the store
+    filesystem::remove(to);
+#ifdef _WIN32
+    if (CreateHardLinkA(to.c_str(), from.c_str(), NULL)) return true;
+#else
+    if (link(from.c_str(), to.c_str()) == 0) return true;
+#endif
+    return CPLCopyFile(to.c_str(), from.c_str()) == 0;
+}
+
+void gdalcubes_server::start_chunk_read(std::pair<uint32_t, uint32_t> key) {
+    // if already in queue, executing, or finished, do not compute again
+    std::unique_lock<std::mutex> lock(_mutex_chunk_read_requests);
+    if (!server_chunk_cache::instance()->has(key) &&
+        _chunk_read_requests_set.find(key) == _chunk_read_requests_set.end() &&
+        _chunk_read_executing.find(key) == _chunk_read_executing.end()) {
+        _chunk_read_errors.erase(key);
+        _chunk_ready[key] = pplx::task_completion_event<std::shared_ptr<chunk_data>>();
+        _chunk_read_requests.push_back(key);
+        _chunk_read_requests_set.insert(key);
+        lock.unlock();
+        _worker_cond.notify_one();
+    }
+}
+
+std::string gdalcubes_server::chunk_status(std::pair<uint32_t, uint32_t> key) {
+    std::lock_guard<std::mutex> lock(_mutex_chunk_read_requests);
+    if (server_chunk_cache::instance()->has(key)) {
+        return "finished";
+    } else if (_chunk_read_executing.find(key) != _chunk_read_executing.end()) {
+        return "running";
+    } else if (_chunk_read_requests_set.find(key) != _chunk_read_requests_set.end()) {
+        return "queued";
+    } else if (_chunk_read_errors.find(key) != _chunk_read_errors.end()) {
+        return "error";
+    }
+    return "notrequested";
+}
+
+/**
+ * Shared state of a batch download response, frames are written by continuations of different threads
+ */
+struct batch_download {
+    batch_download(uint32_t n) : buf(), remaining(n), m() {}
+
+    void write(uint32_t chunk_id, uint32_t status, const std::vector<unsigned char>& content) {
+        std::vector<unsigned char> frame = chunk_codec::encode_frame(chunk_id, status, content);
+        metrics::instance()->bytes_served += frame.size();
+        std::lock_guard<std::mutex> lock(m);
+        buf.putn_nocopy(frame.data(), frame.size()).wait();
+        if (--remaining == 0) {
+            buf.close(std::ios_base::out).wait();
+        }
+    }
+
+    void write_error(uint32_t chunk_id, std::string msg) {
+        write(chunk_id, chunk_codec::FRAME_ERROR, std::vector<unsigned char>(msg.begin(), msg.end()));
+    }
+
+    concurrency::streams::producer_consumer_buffer<uint8_t> buf;
+    uint32_t remaining;
+    std::mutex m;
+};
+
+void gdalcubes_server::reply_chunk_batch(web::http::http_request req, uint32_t cube_id, std::vector<uint32_t> chunk_ids, uint8_t encoding) {
+    std::shared_ptr<batch_download> b = std::make_shared<batch_download>(chunk_ids.size());
+    web::http::http_response res(web::http::status_codes::OK);
+    res.set_body(b->buf.create_istream(), "application/octet-stream");
+    res.headers().add("X-Gdalcubes-Chunk-Encoding", chunk_codec::encoding_string(encoding));
+    req.reply(res);
+    if (chunk_ids.empty()) {
+        b->buf.close(std::ios_base::out).wait();
+        return;
+    }
+
+    // frames are sent in the order of completion
+    for (uint32_t i = 0; i < chunk_ids.size(); ++i) {
+        uint32_t chunk_id = chunk_ids[i];
+        std::pair<uint32_t, uint32_t> key = std::make_pair(cube_id, chunk_id);
+        // chunks on disk are read without holding the lock, the cache is checked again if the chunk has been finished meanwhile
+        std::shared_ptr<chunk_data> dat = server_chunk_cache::instance()->get(key);
+        std::unique_lock<std::mutex> lock(_mutex_chunk_read_requests);
+        if (!dat && server_chunk_cache::instance()->has(key)) {
+            dat = server_chunk_cache::instance()->get(key);
+        }
+        if (dat) {
+            lock.unlock();
+            b->write(chunk_id, chunk_codec::FRAME_OK, chunk_codec::encode(dat, encoding));
+        } else if (_chunk_ready.find(key) != _chunk_ready.end()) {
+            pplx::create_task(_chunk_ready[key]).then([b, chunk_id, encoding](pplx::task<std::shared_ptr<chunk_data>> t) {
+                try {
+                    b->write(chunk_id, chunk_codec::FRAME_OK, chunk_codec::encode(t.get(), encoding));
+                } catch (std::exception& e) {
+                    b->write_error(chunk_id, e.what());
+                }
+            });
+            lock.unlock();
+        } else if (_chunk_read_errors.find(key) != _chunk_read_errors.end()) {
+            std::string err = _chunk_read_errors[key];
+            lock.unlock();
+            b->write_error(chunk_id, err);
+        } else {
+            lock.unlock();
+            b->write_error(chunk_id, "chunk read has not been requested yet");
+        }
+    }
+}
+
+std::string gdalcubes_server::cas_path(std::string hash) {
+    if (hash.size() != 64 || hash.find_first_not_of("0123456789abcdef") != std::string::npos) {
+        throw std::string("ERROR in gdalcubes_server::cas_path(): invalid hash '" + hash + "'");
+    }
+    return filesystem::join(filesystem::join(_workdir, ".cas"), hash);
+}
+
+bool gdalcubes_server::cas_materialize(std::string hash, std::string fname) {
+    std::string cas = cas_path(hash);
+    std::lock_guard<std::mutex> lock(_mutex_cas);
+    if (!filesystem::exists(cas)) {
+        // files uploaded without hash are adopted if their content matches
+        if (filesystem::exists(fname) && utils::sha256_file(fname) == hash) {
+            filesystem::mkdir_recursive(filesystem::parent(cas));
+            link_or_copy_file(fname, cas);
+            return true;
+        }
+        return false;
+    }
+    if (filesystem::exists(fname) && filesystem::file_size(fname) == filesystem::file_size(cas) && utils::sha256_file(fname) == hash) {
+        return true;
+    }
+    if (filesystem::exists(fname)) {
+        // cubes created before may refer to the previous file content
+        _cubestore.forget_hashes();
+    }
+    filesystem::mkdir_recursive(filesystem::parent(fname));
+    return link_or_copy_file(cas, fname);
+}
+
+void gdalcubes_server::evict_idle_cubes() {
+    uint32_t ttl = config::instance()->get_server_cube_ttl();
+    if (ttl == 0) return;
+
+    std::set<uint32_t> expired = _cubestore.idle(std::chrono::seconds(ttl));
+    if (expired.empty()) return;
+
+    // cubes with queued or running chunk reads are kept
+    _mutex_chunk_read_requests.lock();
+    for (auto it = _chunk_read_requests_set.begin(); it != _chunk_read_requests_set.end(); ++it) {
+        expired.erase(it->first);
+    }
+    for (auto it = _chunk_read_executing.begin(); it != _chunk_read_executing.end(); ++it) {
+        expired.erase(it->first);
+    }
+    for (auto it = _chunk_read_errors.begin(); it != _chunk_read_errors.end();) {
+        if (expired.count(it->first.first) > 0) {
+            it = _chunk_read_errors.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    _mutex_chunk_read_requests.unlock();
+
+    for (auto it = expired.begin(); it != expired.end(); ++it) {
+        if (_cubestore.remove_if_idle(*it, std::chrono::seconds(ttl))) {
+            GCBS_DEBUG("Removing cube " + std::to_string(*it) + " after " + std::to_string(ttl) + " s without requests");
+            server_chunk_cache::instance()->remove_cube(*it);
+        }
+    }
+}
+
+pplx::task<void> gdalcubes_server::open() {
+    std::unique_lock<std::mutex> lock(_mutex_chunk_read_requests);
+    _worker_stop = false;
+    uint16_t nthreads = std::max(uint16_t(1), config::instance()->get_server_worker_threads_max());
+    for (uint16_t i = _worker_threads.size(); i < nthreads; ++i) {
+        _worker_threads.push_back(std::thread(&gdalcubes_server::worker_loop, this));
+    }
+    lock.unlock();
+    return _listener.open();
+}
+
+pplx::task<void> gdalcubes_server::close() {
+    return _listener.close().then([this]() {
+        stop_workers();
+    });
+}
+
+void gdalcubes_server::stop_workers() {
+    std::unique_lock<std::mutex> lock(_mutex_chunk_read_requests);
+    _worker_stop = true;
+    lock.unlock();
+    _worker_cond.notify_all();
+    for (uint16_t i = 0; i < _worker_threads.size(); ++i) {
+        if (_worker_threads[i].joinable()) _worker_threads[i].join();
+    }
+    _worker_threads.clear();
+}
+
+void gdalcubes_server::worker_loop() {
+    while (1) {
+        std::unique_lock<std::mutex> lock(_mutex_chunk_read_requests);
+        _worker_cond.wait(lock, [this]() { return _worker_stop || !_chunk_read_requests.empty(); });
+        if (_worker_stop) {
+            return;
+        }
+        std::pair<uint32_t, uint32_t> key = _chunk_read_requests.front();
+        _chunk_read_requests.pop_front();
+        _chunk_read_requests_set.erase(key);
+        _chunk_read_executing.insert(key);
+        lock.unlock();
+
+        std::shared_ptr<cube> c = _cubestore.get(key.first);
+
+        std::shared_ptr<chunk_data> dat;
+        std::string err;
+        timer t;
+        try {
+            if (!c) {
+                throw std::string("ERROR in gdalcubes_server::worker_loop(): cube " + std::to_string(key.first) + " is not available");
+            }
+            dat = c->read_chunk(key.second);
+            metrics::instance()->chunk_read_seconds.observe(t.time());
+            server_chunk_cache::instance()->add(key, dat);
+        } catch (std::string s) {
+            err = s;
+        } catch (...) {
+            err = "unexpected exception while reading chunk " + std::to_string(key.second) + " of cube " + std::to_string(key.first);
+        }
+        if (!err.empty()) {
+            ++metrics::instance()->chunk_errors;
+            GCBS_ERROR(err);
+        } else {
+            ++metrics::instance()->chunk_reads;
+        }
+
+        // notify waiting download requests, replies are sent from continuations of the completion event
+        lock.lock();
+        _chunk_read_executing.erase(key);
+        pplx::task_completion_event<std::shared_ptr<chunk_data>> ready = _chunk_ready[key];
+        _chunk_ready.erase(key);
+        if (!err.empty()) {
+            _chunk_read_errors[key] = err;
+        }
+        lock.unlock();
+        if (err.empty()) {
+            ready.set(dat);
+        } else {
+            ready.set_exception(std::runtime_error(err));
+        }
+    }
+}
 
 void gdalcubes_server::handle_get(web::http::http_request req) {
     if (!_whitelist.empty()) {
@@ -66,6 +368,7 @@ void gdalcubes_server::handle_get(web::http::http_request req) {
     } else {
         GCBS_DEBUG("Incoming request from " + req.remote_address());
     }
+    evict_idle_cubes();
 
     std::vector<std::string> path = web::uri::split_path(web::uri::decode(req.relative_uri().path()));
     std::map<std::string, std::string> query_pars = web::uri::split_query(web::uri::decode(req.relative_uri().query()));
@@ -78,17 +381,99 @@ void gdalcubes_server::handle_get(web::http::http_request req) {
             std::stringstream ss;
             ss << "gdalcubes_server " << v.VERSION_MAJOR << "." << v.VERSION_MINOR << "." << v.VERSION_PATCH << " (" << v.GIT_COMMIT << ") built on " << v.BUILD_DATE << " " << v.BUILD_TIME;
             req.reply(web::http::status_codes::OK, ss.str().c_str(), "text/plain");
+        } else if (path[0] == "cache") {
+            GCBS_DEBUG("GET /cache");
+            server_chunk_cache_stats stats = server_chunk_cache::instance()->stats();
+            json11::Json::object out;
+            out["hits"] = (double)stats.hits;
+            out["misses"] = (double)stats.misses;
+            out["evictions"] = (double)stats.evictions;
+            out["resident_bytes"] = (double)stats.resident_bytes;
+            out["uncompressed_bytes"] = (double)stats.uncompressed_bytes;
+            out["count"] = (double)stats.count;
+            out["max_bytes"] = (double)config::instance()->get_server_chunkcache_max();
+            out["compression"] = config::instance()->get_server_chunkcache_compression();
+            out["disk_hits"] = (double)stats.disk_hits;
+            out["disk_spills"] = (double)stats.spills;
+            out["disk_bytes"] = (double)stats.disk_bytes;
+            out["disk_count"] = (double)stats.disk_count;
+            out["disk_max_bytes"] = (double)config::instance()->get_server_chunkcache_disk_max();
+            req.reply(web::http::status_codes::OK, json11::Json(out).dump(), "application/json");
+        } else if (path[0] == "metrics") {
+            GCBS_DEBUG("GET /metrics");
+            _mutex_chunk_read_requests.lock();
+            std::size_t queued = _chunk_read_requests.size();
+            std::size_t running = _chunk_read_executing.size();
+            _mutex_chunk_read_requests.unlock();
+            std::size_t ncubes = _cubestore.size();
+            server_chunk_cache_stats stats = server_chunk_cache::instance()->stats();
+            metrics* m = metrics::instance();
+
+            std::stringstream ss;
+            metrics::write_prometheus_gauge(ss, "gdalcubes_chunk_queue_length", "Number of queued chunk reads", queued);
+            metrics::write_prometheus_gauge(ss, "gdalcubes_workers_running", "Number of worker threads currently reading chunks", running);
+            metrics::write_prometheus_gauge(ss, "gdalcubes_workers_max", "Number of worker threads", _worker_threads.size());
+            metrics::write_prometheus_gauge(ss, "gdalcubes_cubes", "Number of cubes in the cube store", ncubes);
+            metrics::write_prometheus_counter(ss, "gdalcubes_chunk_reads_total", "Number of successful chunk reads", m->chunk_reads);
+            metrics::write_prometheus_counter(ss, "gdalcubes_chunk_read_errors_total", "Number of failed chunk reads", m->chunk_errors);
+            m->chunk_read_seconds.write_prometheus(ss, "gdalcubes_chunk_read_seconds", "Duration of successful chunk reads");
+            metrics::write_prometheus_counter(ss, "gdalcubes_cache_hits_total", "Chunk cache hits", stats.hits);
+            metrics::write_prometheus_counter(ss, "gdalcubes_cache_misses_total", "Chunk cache misses", stats.misses);
+            metrics::write_prometheus_counter(ss, "gdalcubes_cache_evictions_total", "Chunks evicted from memory", stats.evictions);
+            metrics::write_prometheus_gauge(ss, "gdalcubes_cache_bytes", "Memory consumed by cached chunks", stats.resident_bytes);
+            metrics::write_prometheus_gauge(ss, "gdalcubes_cache_max_bytes", "Maximum memory of cached chunks", config::instance()->get_server_chunkcache_max());
+            metrics::write_prometheus_gauge(ss, "gdalcubes_cache_chunks", "Number of chunks cached in memory", stats.count);
+            metrics::write_prometheus_counter(ss, "gdalcubes_cache_disk_hits_total", "Chunks read from the disk cache", stats.disk_hits);
+            metrics::write_prometheus_counter(ss, "gdalcubes_cache_disk_spills_total", "Chunks written to the disk cache", stats.spills);
+            metrics::write_prometheus_gauge(ss, "gdalcubes_cache_disk_bytes", "Size of chunk files in the disk cache", stats.disk_bytes);
+            metrics::write_prometheus_counter(ss, "gdalcubes_served_bytes_total", "Bytes of chunk download responses", m->bytes_served);
+            metrics::write_prometheus_counter(ss, "gdalcubes_gdal_open_total", "Number of datasets opened with GDAL to read chunks", m->gdal_open);
+            metrics::write_prometheus_counter(ss, "gdalcubes_gdal_warp_total", "Number of GDAL warp operations", m->gdal_warp);
+            req.reply(web::http::status_codes::OK, ss.str(), "text/plain; version=0.0.4");
         } else if (path[0] == "cube") {
             if (path.size() == 2) {
                 uint32_t cube_id = std::stoi(path[1]);
                 GCBS_DEBUG("GET /cube" + std::to_string(cube_id));
 
-                if (_cubestore.find(cube_id) == _cubestore.end()) {
+                std::shared_ptr<cube> c = _cubestore.get(cube_id);
+                if (!c) {
                     req.reply(web::http::status_codes::NotFound, "ERROR in /GET /cube/{cube_id}: cube with given id is not available.", "text/plain");
                 } else {
-                    req.reply(web::http::status_codes::OK, _cubestore[cube_id]->make_constructible_json().dump().c_str(),
+                    req.reply(web::http::status_codes::OK, c->make_constructible_json().dump().c_str(),
                               "application/json");
                 }
+            } else if (path.size() == 3 && (path[2] == "status" || path[2] == "download")) {
+                // batch requests for several chunks, e.g. ?chunks=1,2,3
+                uint32_t cube_id = std::stoi(path[1]);
+                std::string cmd = path[2];
+                GCBS_DEBUG("GET /cube/" + std::to_string(cube_id) + "/" + cmd);
+                std::vector<uint32_t> chunk_ids;
+                try {
+                    if (query_pars.find("chunks") != query_pars.end()) {
+                        chunk_ids = parse_chunk_ids(query_pars["chunks"]);
+                    }
+                } catch (...) {
+                    req.reply(web::http::status_codes::BadRequest, "ERROR in /GET /cube/{cube_id}/" + cmd + ": invalid list of chunk ids", "text/plain");
+                    return;
+                }
+                std::shared_ptr<cube> c = _cubestore.get(cube_id);
+                if (!c) {
+                    req.reply(web::http::status_codes::NotFound, "ERROR in /GET /cube/{cube_id}/" + cmd + ": cube is not available", "text/plain");
+                } else if (std::find_if(chunk_ids.begin(), chunk_ids.end(), [&c](uint32_t id) { return id >= c->count_chunks(); }) != chunk_ids.end()) {
+                    req.reply(web::http::status_codes::NotFound, "ERROR in /GET /cube/{cube_id}/" + cmd + ": invalid chunk_id given", "text/plain");
+                } else if (cmd == "status") {
+                    json11::Json::object out;
+                    for (uint32_t i = 0; i < chunk_ids.size(); ++i) {
+                        out[std::to_string(chunk_ids[i])] = chunk_status(std::make_pair(cube_id, chunk_ids[i]));
+                    }
+                    req.reply(web::http::status_codes::OK, json11::Json(out).dump(), "application/json");
+                } else {
+                    uint8_t encoding = chunk_codec::RAW;
+                    if (query_pars.find("encoding") != query_pars.end()) {
+                        encoding = chunk_codec::parse_encoding(query_pars["encoding"]);
+                    }
+                    reply_chunk_batch(req, cube_id, chunk_ids, encoding);
+                }
             } else if (path.size() == 4) {
                 uint32_t cube_id = std::stoi(path[1]);
                 uint32_t chunk_id = std::stoi(path[2]);
@@ -96,53 +481,58 @@ void gdalcubes_server::handle_get(web::http::http_request req) {
                 std::string cmd = path[3];
                 if (cmd == "download") {
                     GCBS_DEBUG("GET /cube/" + std::to_string(cube_id) + "/" + std::to_string(chunk_id) + "/download");
-                    if (_cubestore.find(cube_id) == _cubestore.end()) {
+                    std::shared_ptr<cube> c = _cubestore.get(cube_id);
+                    if (!c) {
                         req.reply(web::http::status_codes::NotFound, "ERROR in /GET /cube/{cube_id}/{chunk_id}/download: cube is not available", "text/plain");
-                    } else if (chunk_id >= _cubestore[cube_id]->count_chunks()) {
+                    } else if (chunk_id >= c->count_chunks()) {
                         req.reply(web::http::status_codes::NotFound, "ERROR in /GET /cube/{cube_id}/{chunk_id}/download: invalid chunk_id given", "text/plain");
                     }
-                    // if not in queue, executing, or finished, return 404
-                    else if (!server_chunk_cache::instance()->has(std::make_pair(cube_id, chunk_id)) &&
-                             _chunk_read_requests_set.find(std::make_pair(cube_id, chunk_id)) == _chunk_read_requests_set.end() &&
-                             _chunk_read_executing.find(std::make_pair(cube_id, chunk_id)) == _chunk_read_executing.end()) {
-                        req.reply(web::http::status_codes::NotFound, "ERROR in /GET /cube/{cube_id}/{chunk_id}/download: chunk read has not been requested yet", "text/plain");
-                    } else {
-                        while (!server_chunk_cache::instance()->has(std::make_pair(cube_id, chunk_id))) {
-                            // req.reply(web::http::status_codes::NotFound, "ERROR in /GET /cube/{cube_id}/{chunk_id}/download: chunk is not available.", "text/plain");
-                            std::unique_lock<std::mutex> lck(_chunk_cond[std::make_pair(cube_id, chunk_id)].second);
-                            _chunk_cond[std::make_pair(cube_id, chunk_id)].first.wait(lck);
+                    else {
+                        // optional encoding, e.g. ?encoding=nanmask,deflate
+                        uint8_t encoding = chunk_codec::RAW;
+                        if (query_pars.find("encoding") != query_pars.end()) {
+                            encoding = chunk_codec::parse_encoding(query_pars["encoding"]);
                         }
-                        std::shared_ptr<chunk_data> dat = server_chunk_cache::instance()->get(std::make_pair(cube_id, chunk_id));
-
-                        uint8_t* rawdata = (uint8_t*)std::malloc(4 * sizeof(uint32_t) + dat->total_size_bytes());
-                        memcpy((void*)rawdata, (void*)(dat->size().data()), 4 * sizeof(uint32_t));
-                        if (!dat->empty()) {
-                            memcpy(rawdata + 4 * sizeof(uint32_t), dat->buf(), dat->total_size_bytes());
+                        std::pair<uint32_t, uint32_t> key = std::make_pair(cube_id, chunk_id);
+                        // chunks on disk are read without holding the lock, the cache is checked again if the chunk has been finished meanwhile
+                        std::shared_ptr<chunk_data> dat = server_chunk_cache::instance()->get(key);
+                        std::unique_lock<std::mutex> lock(_mutex_chunk_read_requests);
+                        if (!dat && server_chunk_cache::instance()->has(key)) {
+                            dat = server_chunk_cache::instance()->get(key);
+                        }
+                        if (dat) {
+                            lock.unlock();
+                            req.reply(make_chunk_response(dat, encoding));
+                        } else if (_chunk_ready.find(key) != _chunk_ready.end()) {
+                            // reply as soon as the chunk is available without blocking the current thread
+                            pplx::create_task(_chunk_ready[key]).then([req, encoding](pplx::task<std::shared_ptr<chunk_data>> t) {
+                                try {
+                                    req.reply(make_chunk_response(t.get(), encoding));
+                                } catch (std::exception& e) {
+                                    req.reply(web::http::status_codes::InternalError, "ERROR in /GET /cube/{cube_id}/{chunk_id}/download: " + std::string(e.what()), "text/plain");
+                                }
+                            });
+                            lock.unlock();
+                        } else if (_chunk_read_errors.find(key) != _chunk_read_errors.end()) {
+                            std::string err = _chunk_read_errors[key];
+                            lock.unlock();
+                            req.reply(web::http::status_codes::InternalError, "ERROR in /GET /cube/{cube_id}/{chunk_id}/download: " + err, "text/plain");
+                        } else {
+                            // if not in queue, executing, or finished, return 404
+                            lock.unlock();
+                            req.reply(web::http::status_codes::NotFound, "ERROR in /GET /cube/{cube_id}/{chunk_id}/download: chunk read has not been requested yet", "text/plain");
                         }
-
-                        concurrency::streams::basic_istream<uint8_t> is = concurrency::streams::rawptr_stream<uint8_t>::open_istream(rawdata, 4 * sizeof(uint32_t) + dat->total_size_bytes());
-                        req.reply(web::http::status_codes::OK, is, 4 * sizeof(uint32_t) + dat->total_size_bytes(), "application/octet-stream").then([&is, &rawdata]() {
-                            is.close();
-                            std::free(rawdata); });
                     }
 
                 } else if (cmd == "status") {
                     GCBS_DEBUG("GET /cube/" + std::to_string(cube_id) + "/" + std::to_string(chunk_id) + "/status");
-                    if (_cubestore.find(cube_id) == _cubestore.end()) {
+                    std::shared_ptr<cube> c = _cubestore.get(cube_id);
+                    if (!c) {
                         req.reply(web::http::status_codes::NotFound, "ERROR in /GET /cube/{cube_id}/{chunk_id}/status: cube is not available", "text/plain");
-                    } else if (chunk_id >= _cubestore[cube_id]->count_chunks()) {
+                    } else if (chunk_id >= c->count_chunks()) {
                         req.reply(web::http::status_codes::NotFound, "ERROR in /GET /cube/{cube_id}/{chunk_id}/status: invalid chunk_id given", "text/plain");
-                    }
-
-                    if (server_chunk_cache::instance()->has(std::make_pair(cube_id, chunk_id))) {
-                        req.reply(web::http::status_codes::OK, "finished", "text/plain");
-                    } else if (_chunk_read_executing.find(std::make_pair(cube_id, chunk_id)) !=
-                               _chunk_read_executing.end()) {
-                        req.reply(web::http::status_codes::OK, "running", "text/plain");
-                    } else if (_chunk_read_requests_set.find(std::make_pair(cube_id, chunk_id)) != _chunk_read_requests_set.end()) {
-                        req.reply(web::http::status_codes::OK, "queued", "text/plain");
                     } else {
-                        req.reply(web::http::status_codes::OK, "notrequested", "text/plain");
+                        req.reply(web::http::status_codes::OK, chunk_status(std::make_pair(cube_id, chunk_id)), "text/plain");
                     }
 
                 } else {
@@ -172,6 +562,7 @@ void gdalcubes_server::handle_post(web::http::http_request req) {
     } else {
         GCBS_DEBUG("Incoming request from " + req.remote_address());
     }
+    evict_idle_cubes();
 
     std::vector<std::string> path = web::uri::split_path(web::uri::decode(req.relative_uri().path()));
     std::map<std::string, std::string> query_pars = web::uri::split_query(web::uri::decode(req.relative_uri().query()));
@@ -179,7 +570,85 @@ void gdalcubes_server::handle_post(web::http::http_request req) {
     //    std::for_each(query_pars.begin(), query_pars.end(), [](std::pair<std::string, std::string> s) { std::cout << s.first << ":" << s.second << std::endl; });
 
     if (!path.empty()) {
-        if (path[0] == "file") {
+        if (path[0] == "file" && query_pars.find("hash") != query_pars.end()) {
+            GCBS_DEBUG("POST /file?hash=" + query_pars["hash"] + " " + req.remote_address());
+            if (query_pars.find("name") == query_pars.end()) {
+                req.reply(web::http::status_codes::BadRequest, "ERROR in /POST /file: missing name", "text/plain");
+                return;
+            }
+            std::string hash = query_pars["hash"];
+            std::string fname = filesystem::join(_workdir, query_pars["name"]);
+            bool deflate = query_pars.find("encoding") != query_pars.end() && query_pars["encoding"] == "deflate";
+            try {
+                std::string cas = cas_path(hash);
+                if (!filesystem::exists(cas)) {
+                    // write to a temporary file, verify the hash and move to the store
+                    filesystem::mkdir_recursive(filesystem::parent(cas));
+                    std::string tmp = cas + "." + utils::generate_unique_filename();
+                    std::ofstream os(tmp, std::ios::out | std::ios::binary);
+                    sha256 h;
+                    auto write = [&os, &h](const unsigned char* data, std::size_t n) {
+                        os.write((const char*)data, n);
+                        h.update(data, n);
+                    };
+                    block_inflater inflater(write);
+                    concurrency::streams::istream indata = req.body();
+                    std::vector<unsigned char> buf(1024 * 1024 * 8);  // Read up to 8MiB
+                    std::size_t n;
+                    while ((n = indata.streambuf().getn(buf.data(), buf.size()).get()) > 0) {
+                        if (deflate) {
+                            inflater.feed(buf.data(), n);
+                        } else {
+                            write(buf.data(), n);
+                        }
+                    }
+                    os.close();
+                    if (deflate && !inflater.complete()) {
+                        filesystem::remove(tmp);
+                        throw std::string("ERROR in /POST /file: incomplete compressed data");
+                    }
+                    if (h.hexdigest() != hash) {
+                        filesystem::remove(tmp);
+                        req.reply(web::http::status_codes::BadRequest, "ERROR in /POST /file: hash of received data does not match", "text/plain");
+                        return;
+                    }
+                    _mutex_cas.lock();
+                    std::rename(tmp.c_str(), cas.c_str());
+                    _mutex_cas.unlock();
+                }
+                if (!cas_materialize(hash, fname)) {
+                    throw std::string("ERROR in /POST /file: cannot create '" + fname + "'");
+                }
+            } catch (std::string s) {
+                GCBS_ERROR(s);
+                req.reply(web::http::status_codes::InternalError, s, "text/plain");
+                return;
+            }
+            req.reply(web::http::status_codes::OK, fname.c_str(), "text/plain");
+        } else if (path[0] == "files" && path.size() == 2 && path[1] == "missing") {
+            GCBS_DEBUG("POST /files/missing");
+            std::string err;
+            json11::Json files = json11::Json::parse(req.extract_string(true).get(), err);
+            if (!err.empty() || !files.is_array()) {
+                req.reply(web::http::status_codes::BadRequest, "ERROR in /POST /files/missing: expected JSON array", "text/plain");
+                return;
+            }
+            // files available in the store are linked (or copied) to their name and not reported as missing
+            json11::Json::array missing;
+            try {
+                for (uint32_t i = 0; i < files.array_items().size(); ++i) {
+                    std::string hash = files[i]["hash"].string_value();
+                    std::string fname = filesystem::join(_workdir, files[i]["name"].string_value());
+                    if (!cas_materialize(hash, fname)) {
+                        missing.push_back(hash);
+                    }
+                }
+            } catch (std::string s) {
+                req.reply(web::http::status_codes::BadRequest, s, "text/plain");
+                return;
+            }
+            req.reply(web::http::status_codes::OK, json11::Json(missing).dump(), "application/json");
+        } else if (path[0] == "file") {
             GCBS_DEBUG("POST /file " + req.remote_address());
             std::string fname;
             if (query_pars.find("name") != query_pars.end()) {
@@ -222,13 +691,32 @@ void gdalcubes_server::handle_post(web::http::http_request req) {
                 std::string err;
                 req.extract_string(true).then([&id, this, &err](std::string s) {
                                             std::shared_ptr<cube> c = cube_factory::instance()->create_from_json(json11::Json::parse(s, err));
-                                            id = get_unique_id();
-                                            _mutex_cubestore.lock();
-                                            _cubestore.insert(std::make_pair(id, c));
-                                            _mutex_cubestore.unlock();
+                                            id = _cubestore.add(c);
                                         })
                     .wait();
                 req.reply(web::http::status_codes::OK, std::to_string(id), "text/plain");
+            } else if (path.size() == 3 && path[2] == "start") {
+                // batch start, body contains a comma-separated list of chunk ids
+                uint32_t cube_id = std::stoi(path[1]);
+                GCBS_DEBUG("POST /cube/" + std::to_string(cube_id) + "/start");
+                std::vector<uint32_t> chunk_ids;
+                try {
+                    chunk_ids = parse_chunk_ids(req.extract_string(true).get());
+                } catch (...) {
+                    req.reply(web::http::status_codes::BadRequest, "ERROR in /POST /cube/{cube_id}/start: invalid list of chunk ids", "text/plain");
+                    return;
+                }
+                std::shared_ptr<cube> c = _cubestore.get(cube_id);
+                if (!c) {
+                    req.reply(web::http::status_codes::NotFound, "ERROR in /POST /cube/{cube_id}/start: cube is not available", "text/plain");
+                } else if (std::find_if(chunk_ids.begin(), chunk_ids.end(), [&c](uint32_t id) { return id >= c->count_chunks(); }) != chunk_ids.end()) {
+                    req.reply(web::http::status_codes::NotFound, "ERROR in /POST /cube/{cube_id}/start: invalid chunk_id given", "text/plain");
+                } else {
+                    for (uint32_t i = 0; i < chunk_ids.size(); ++i) {
+                        start_chunk_read(std::make_pair(cube_id, chunk_ids[i]));
+                    }
+                    req.reply(web::http::status_codes::OK);
+                }
             } else if (path.size() == 4) {
                 uint32_t cube_id = std::stoi(path[1]);
                 uint32_t chunk_id = std::stoi(path[2]);
@@ -237,79 +725,16 @@ void gdalcubes_server::handle_post(web::http::http_request req) {
                 if (cmd == "start") {
                     GCBS_DEBUG("POST /cube/" + std::to_string(cube_id) + "/" + std::to_string(chunk_id) + "/start");
 
-                    if (_cubestore.find(cube_id) == _cubestore.end()) {
+                    std::shared_ptr<cube> c = _cubestore.get(cube_id);
+                    if (!c) {
                         req.reply(web::http::status_codes::NotFound, "ERROR in /POST /cube/{cube_id}/{chunk_id}/start: cube is not available", "text/plain");
-                    } else if (chunk_id >= _cubestore[cube_id]->count_chunks()) {
+                    } else if (chunk_id >= c->count_chunks()) {
                         req.reply(web::http::status_codes::NotFound, "ERROR in /POST /cube/{cube_id}/{chunk_id}/start: invalid chunk_id given", "text/plain");
                     }
 
-                    // if already in queue, executing, or finished, do not compute again
-                    else if (server_chunk_cache::instance()->has(std::make_pair(cube_id, chunk_id)) ||
-                             _chunk_read_requests_set.find(std::make_pair(cube_id, chunk_id)) != _chunk_read_requests_set.end() ||
-                             _chunk_read_executing.find(std::make_pair(cube_id, chunk_id)) != _chunk_read_executing.end()) {
+                    else {
+                        start_chunk_read(std::make_pair(cube_id, chunk_id));
                         req.reply(web::http::status_codes::OK);
-                    } else {
-                        _mutex_worker_threads.lock();
-                        if (_worker_threads.size() < config::instance()->get_server_worker_threads_max()) {
-                            // immediately start a thread
-
-                            _worker_threads.push_back(std::thread([this, cube_id, chunk_id]() {
-                                _mutex_chunk_read_requests.lock();
-                                _chunk_read_requests.push_back(std::make_pair(cube_id, chunk_id));
-                                _chunk_read_requests_set.insert(std::make_pair(cube_id, chunk_id));
-                                _mutex_chunk_read_requests.unlock();
-                                while (1) {
-                                    _mutex_chunk_read_requests.lock();
-                                    while (!_chunk_read_requests.empty()) {
-                                        _mutex_chunk_read_executing.lock();
-                                        uint32_t xcube_id = _chunk_read_requests.front().first;
-                                        uint32_t xchunk_id = _chunk_read_requests.front().second;
-                                        _chunk_read_executing.insert(_chunk_read_requests.front());
-                                        _chunk_read_requests_set.erase(_chunk_read_requests.front());
-                                        _chunk_read_requests.pop_front();
-                                        _mutex_chunk_read_requests.unlock();
-                                        _mutex_chunk_read_executing.unlock();
-
-                                        _mutex_cubestore.lock();
-                                        std::shared_ptr<cube> c = _cubestore[xcube_id];
-                                        _mutex_cubestore.unlock();
-
-                                        std::shared_ptr<chunk_data> dat = c->read_chunk(xchunk_id);
-
-                                        server_chunk_cache::instance()->add(std::make_pair(xcube_id, xchunk_id), dat);
-
-                                        _mutex_chunk_read_executing.lock();
-                                        _chunk_read_executing.erase(std::make_pair(xcube_id, xchunk_id));
-                                        _mutex_chunk_read_executing.unlock();
-
-                                        // notify waiting download requests
-                                        if (_chunk_cond.find(std::make_pair(xcube_id, xchunk_id)) != _chunk_cond.end()) {
-                                            _chunk_cond[std::make_pair(xcube_id, xchunk_id)].first.notify_all();
-                                        }
-
-                                        _mutex_chunk_read_requests.lock();
-                                    }
-                                    _mutex_chunk_read_requests.unlock();
-
-                                    std::unique_lock<std::mutex> lock(_mutex_worker_cond);
-                                    _worker_cond.wait(lock);
-                                }
-                            }));
-
-                            _mutex_worker_threads.unlock();
-                            req.reply(web::http::status_codes::OK);
-                        }
-
-                        else {
-                            _mutex_worker_threads.unlock();
-                            std::lock_guard<std::mutex> lock(_mutex_worker_cond);
-                            // add to queue
-                            _mutex_chunk_read_requests.lock();
-                            _chunk_read_requests.push_back(std::make_pair(cube_id, chunk_id));
-                            _mutex_chunk_read_requests.unlock();
-                            _worker_cond.notify_all();
-                            req.reply(web::http::status_codes::OK);
-                        }
                     }
                 } else {
                     req.reply(web::http::status_codes::NotFound);
@@ -337,6 +762,7 @@ void gdalcubes_server::handle_head(web::http::http_request req) {
     } else {
         GCBS_DEBUG("Incoming request from " + req.remote_address());
     }
+    evict_idle_cubes();
 
     std::vector<std::string> path = web::uri::split_path(web::uri::decode(req.relative_uri().path()));
     std::map<std::string, std::string> query_pars = web::uri::split_query(web::uri::decode(req.relative_uri().query()));
@@ -383,6 +809,9 @@ void print_usage() {
     std::cout << "  -D, --dir                   Working directory where files are stored, defaults to {TEMPDIR}/gdalcubes" << std::endl;
     std::cout << "      --ssl                   Use HTTPS (currently not implemented)" << std::endl;
     std::cout << "  -w, --whitelist             Optional path to a whitelist text file with a list of acceptable clients" << std::endl;
+    std::cout << "      --cache_compression     Compress chunks in the in-memory chunk cache" << std::endl;
+    std::cout << "      --cache_disk            Size in MiB of the disk cache for chunks evicted from memory, defaults to 0 (disabled)" << std::endl;
+    std::cout << "      --cube_ttl              Seconds after which cubes without requests are removed, 0 to keep all cubes, defaults to 3600" << std::endl;
     std::cout << "  -d, --debug                 Print debug messages" << std::endl;
     std::cout << std::endl;
 }
@@ -397,7 +826,7 @@ int main(int argc, char* argv[]) {
     // see https://stackoverflow.com/questions/15541498/how-to-implement-subcommands-using-boost-program-options
 
     po::options_description global_args("Options");
-    global_args.add_options()("help,h", "")("version", "")("debug,d", "")("basepath,b", po::value<std::string>()->default_value("/gdalcubes/api"), "")("port,p", po::value<uint16_t>()->default_value(1111), "")("ssl", "")("worker_threads,t", po::value<uint16_t>()->default_value(1), "")("dir,D", po::value<std::string>()->default_value((filesystem::join(filesystem::get_tempdir(), "gdalcubes")), ""))("whitelist,w", po::value<std::string>(), "");
+    global_args.add_options()("help,h", "")("version", "")("debug,d", "")("basepath,b", po::value<std::string>()->default_value("/gdalcubes/api"), "")("port,p", po::value<uint16_t>()->default_value(1111), "")("ssl", "")("worker_threads,t", po::value<uint16_t>()->default_value(1), "")("dir,D", po::value<std::string>()->default_value((filesystem::join(filesystem::get_tempdir(), "gdalcubes")), ""))("whitelist,w", po::value<std::string>(), "")("cache_compression", "")("cube_ttl", po::value<uint32_t>()->default_value(3600), "")("cache_disk", po::value<uint32_t>()->default_value(0), "");
 
     po::variables_map vm;
 
@@ -436,6 +865,9 @@ int main(int argc, char* argv[]) {
                              vm["dir"].as<std::string>(), whitelist));
 
     config::instance()->set_server_worker_threads_max(vm["worker_threads"].as<uint16_t>());
+    config::instance()->set_server_chunkcache_compression(vm.count("cache_compression") > 0);
+    config::instance()->set_server_cube_ttl(vm["cube_ttl"].as<uint32_t>());
+    config::instance()->set_server_chunkcache_disk_max(uint64_t(vm["cache_disk"].as<uint32_t>()) * 1024 * 1024);
 
     srv->open().wait();
     std::cout << "gdalcubes_server waiting for incoming HTTP requests on " << srv->get_service_url() << "." << std::endl;
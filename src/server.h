@@ -28,174 +28,21 @@
 #include <cpprest/http_listener.h>
 #include <cpprest/uri_builder.h>
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <list>
 #include <mutex>
 #include <queue>
-#include <list>
 #include <thread>
+#include <unordered_map>
 
 #include "cube.h"
+#include "server_chunk_cache.h"
+#include "server_cube_store.h"
 
 namespace gdalcubes {
 
-/**
- * @brief An in-memory singleton cache for successfully read / computed chunks
- *
- * Chunks are identified by std::pair<cube_id, chunk_id>
- */
-class server_chunk_cache {
-   public:
-    /**
-     * @brief Get the singleton instance
-     * @return pointer to the singleton instance
-     */
-    static server_chunk_cache* instance() {
-        static GC g;
-        _singleton_mutex.lock();
-        if (!_instance) {
-            _instance = new server_chunk_cache();
-        }
-        _singleton_mutex.unlock();
-        return _instance;
-    }
-
-    /**
-     * @brief Remove a chunk from the cache
-     * @param key
-     */
-    void remove(std::pair<uint32_t, uint32_t> key) {
-        _m.lock();
-        auto it = _cache.find(key);
-        if (it != _cache.end()) {
-            _size_bytes -= it->second->total_size_bytes();
-            _cache.erase(it);
-        }
-
-        auto it_2 = _prio_forward.find(key);
-        uint32_t p = it_2->second;
-        if (it_2 != _prio_forward.end()) {
-            _prio_forward.erase(it_2);
-        }
-
-        auto it_3 = _prio_backward.find(p);
-        if (it_3 != _prio_backward.end()) {
-            _prio_backward.erase(it_3);
-        }
-        _m.unlock();
-    }
-
-    /**
-     * Add chunk data to the cache
-     * @param key chunk identifier (cube_id, chunk_id)
-     * @param value chunk data to add
-     */
-    void add(std::pair<uint32_t, uint32_t> key, std::shared_ptr<chunk_data> value) {
-        if (!has(key)) {
-            _m.lock();
-            while (_size_bytes + value->total_size_bytes() > config::instance()->get_server_chunkcache_max()) {
-                auto it = _prio_backward.lower_bound(0);  // lowest value greater than or equal to 0
-
-                // remove it from the data
-                remove(it->second);
-            }
-
-            _cache[key] = value;
-            _size_bytes += value->total_size_bytes();
-
-            uint64_t p = inc_prio();  // synchronize?
-
-            _prio_forward[key] = p;
-            _prio_backward[p] = key;
-
-            _size_bytes += value->total_size_bytes();
-            _m.unlock();
-        }
-    }
-
-    /**
-     * Check whether a chunk is cached
-     * @param key chunk key (cube_id, chunk_id)
-     * @return true, if the chunk is cached
-     */
-    inline bool has(std::pair<uint32_t, uint32_t> key) {
-        return _cache.find(key) != _cache.end();
-    }
-
-    /**
-     * Get chunk data from the cache
-     * @param key chunk key (cube_id, chunk_id)
-     * @return chunk data as shared_ptr
-     */
-    std::shared_ptr<chunk_data> get(std::pair<uint32_t, uint32_t> key) {
-        if (!has(key)) {
-            throw std::string("ERROR: in server_chunk_cache::get(): requested chunk is not available");
-        }
-        _m.lock();
-        uint64_t pnew = inc_prio();
-        auto it_1 = _prio_forward.find(key);
-        if (it_1 != _prio_forward.end()) {
-            uint32_t pold = it_1->second;
-            it_1->second = pnew;
-
-            auto it_2 = _prio_backward.find(pold);
-            if (it_2 != _prio_backward.end()) {
-                _prio_backward.erase(it_2);  // remove old
-                _prio_backward[pnew] = key;  // add new
-            }
-        }
-        _m.unlock();
-        return _cache[key];
-    }
-
-    /**
-     * @brief Get the total amount of memory currently consumed by the cache
-     * @return Size of the cache in bytes
-     */
-    inline uint32_t total_size_bytes() {
-        return _size_bytes;
-    }
-
-   private:
-    const uint64_t inc_prio() {
-        if (_cur_priority == std::numeric_limits<uint64_t>::max()) {
-            uint64_t newp = 0;
-            for (auto it = _prio_forward.begin(); it != _prio_forward.end(); ++it) {
-                it->second = newp++;
-                _prio_backward.insert(std::make_pair(it->second, it->first));
-            }
-            _cur_priority = newp;
-        } else {
-            ++_cur_priority;
-        }
-        return _cur_priority;
-    }
-
-    std::map<std::pair<uint32_t, uint32_t>, std::shared_ptr<chunk_data>> _cache;
-    std::map<uint64_t, std::pair<uint32_t, uint32_t>> _prio_backward;
-    std::map<std::pair<uint32_t, uint32_t>, uint64_t> _prio_forward;
-
-    std::mutex _m;
-    uint64_t _size_bytes;
-
-    static std::mutex _singleton_mutex;
-    uint64_t _cur_priority;
-
-   private:
-    server_chunk_cache() : _cache(), _prio_backward(), _prio_forward(), _m(), _size_bytes(0), _cur_priority(0) {}
-    ~server_chunk_cache() {}
-    server_chunk_cache(const server_chunk_cache&) = delete;
-    static server_chunk_cache* _instance;
-
-    class GC {
-       public:
-        ~GC() {
-            if (server_chunk_cache::_instance) {
-                delete server_chunk_cache::_instance;
-                server_chunk_cache::_instance = nullptr;
-            }
-        }
-    };
-};
-
 /**
  * @brief Serve gdalcubes functionality as a REST-like API over HTTP on a provided host, port, and endpoint
  *
@@ -209,9 +56,9 @@ class gdalcubes_server {
                                                                                                                                                                                                                                                        _basepath(basepath),
                                                                                                                                                                                                                                                        _ssl(ssl),
                                                                                                                                                                                                                                                        _workdir(workdir),
-                                                                                                                                                                                                                                                       _cubestore(),
-                                                                                                                                                                                                                                                       _cur_id(0),
-                                                                                                                                                                                                                                                       _chunk_cond(),
+                                                                                                                                                                                                                                                       _chunk_ready(),
+                                                                                                                                                                                                                                                       _chunk_read_errors(),
+                                                                                                                                                                                                                                                       _worker_stop(false),
                                                                                                                                                                                                                                                        _whitelist(whitelist) {
         if (filesystem::exists(_workdir) && filesystem::is_directory(_workdir)) {
             // boost::filesystem::remove_all(_workdir); // TODO: uncomment after testing
@@ -220,6 +67,7 @@ class gdalcubes_server {
         }
 
         filesystem::mkdir(_workdir);
+        server_chunk_cache::instance()->set_disk_dir(filesystem::join(_workdir, ".chunkcache"));
 
         std::string url = ssl ? "https://" : "http://";
         url += host + ":" + std::to_string(port);
@@ -233,9 +81,22 @@ class gdalcubes_server {
         _listener.support(web::http::methods::HEAD, std::bind(&gdalcubes_server::handle_head, this, std::placeholders::_1));
     }
 
+    ~gdalcubes_server() {
+        stop_workers();
+    }
+
    public:
-    inline pplx::task<void> open() { return _listener.open(); }
-    inline pplx::task<void> close() { return _listener.close(); }
+    /**
+     * @brief Start worker threads and listening for incoming requests
+     *
+     * The number of worker threads is taken from config::get_server_worker_threads_max().
+     */
+    pplx::task<void> open();
+
+    /**
+     * @brief Stop listening for incoming requests and wait for running chunk reads to finish
+     */
+    pplx::task<void> close();
 
     inline std::string get_service_url() { return _listener.uri().to_string(); }
 
@@ -244,14 +105,47 @@ class gdalcubes_server {
     void handle_post(web::http::http_request req);
     void handle_head(web::http::http_request req);
 
-    web::http::experimental::listener::http_listener _listener;
+    /**
+     * @brief Main loop of worker threads, takes chunk read requests from the queue until the server is closed
+     */
+    void worker_loop();
 
-    inline uint32_t get_unique_id() {
-        _mutex_id.lock();
-        uint32_t id = _cur_id++;
-        _mutex_id.unlock();
-        return id;
-    }
+    void stop_workers();
+
+    /**
+     * @brief Queue a chunk read unless the chunk is already queued, being computed, or cached
+     */
+    void start_chunk_read(std::pair<uint32_t, uint32_t> key);
+
+    /**
+     * @brief Get the status of a chunk ("notrequested", "queued", "running", "finished", or "error")
+     */
+    std::string chunk_status(std::pair<uint32_t, uint32_t> key);
+
+    /**
+     * @brief Reply to a batch download with a stream of chunk frames, sent as soon as chunks are available
+     */
+    void reply_chunk_batch(web::http::http_request req, uint32_t cube_id, std::vector<uint32_t> chunk_ids, uint8_t encoding);
+
+    /**
+     * @brief Path of a file in the content-addressed store, i.e. {workdir}/.cas/{sha256}
+     */
+    std::string cas_path(std::string hash);
+
+    /**
+     * @brief Make a file from the content-addressed store available under the given path
+     * @return false if the store does not contain the hash
+     */
+    bool cas_materialize(std::string hash, std::string fname);
+
+    /**
+     * @brief Remove cubes without requests for longer than config::get_server_cube_ttl() and their cached chunks
+     *
+     * This function is called at the beginning of every request.
+     */
+    void evict_idle_cubes();
+
+    web::http::experimental::listener::http_listener _listener;
 
     const uint16_t _port;
     const std::string _host;
@@ -259,28 +153,26 @@ class gdalcubes_server {
     const bool _ssl;
     const std::string _workdir;
 
-    std::map<uint32_t, std::shared_ptr<cube>> _cubestore;
-
-    uint16_t _cur_id;
-    std::mutex _mutex_id;
-    std::mutex _mutex_cubestore;
+    server_cube_store _cubestore;
 
-    uint16_t _worker_thread_count;
+    std::mutex _mutex_cas;
 
+    // the following members describe the state of chunk read requests and must only be accessed while holding _mutex_chunk_read_requests
     std::mutex _mutex_chunk_read_requests;
     std::list<std::pair<uint32_t, uint32_t>> _chunk_read_requests;
     std::set<std::pair<uint32_t, uint32_t>> _chunk_read_requests_set;
-
-    std::mutex _mutex_chunk_read_executing;
     std::set<std::pair<uint32_t, uint32_t>> _chunk_read_executing;
 
-    std::vector<std::thread> _worker_threads;
-    std::mutex _mutex_worker_threads;
+    // completion events of queued or running chunk reads, download requests attach continuations instead of waiting
+    std::map<std::pair<uint32_t, uint32_t>, pplx::task_completion_event<std::shared_ptr<chunk_data>>> _chunk_ready;
 
-    std::condition_variable _worker_cond;
-    std::mutex _mutex_worker_cond;
+    // error messages of failed chunk reads, cleared if the chunk is requested again
+    std::map<std::pair<uint32_t, uint32_t>, std::string> _chunk_read_errors;
 
-    std::map<std::pair<uint32_t, uint32_t>, std::pair<std::condition_variable, std::mutex>> _chunk_cond;
+    // fixed pool of worker threads, woken up by _worker_cond if new requests are queued
+    std::vector<std::thread> _worker_threads;
+    std::condition_variable _worker_cond;
+    bool _worker_stop;
 
     std::set<std::string> _whitelist;
 };
@@ -0,0 +1,363 @@
+/*
+    MIT License
+
+    Copyright (c) 2019 Marius Appel <marius.appel@uni-muenster.de>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#include "server_chunk_cache.h"
+
+#include <cpl_conv.h>
+
+#include <fstream>
+
+#include "chunk_codec.h"
+
+namespace gdalcubes {
+
+server_chunk_cache* server_chunk_cache::_instance = nullptr;
+std::mutex server_chunk_cache::_singleton_mutex;
+const uint16_t server_chunk_cache::NSHARDS;
+
+void server_chunk_cache::add(key_type key, std::shared_ptr<chunk_data> value) {
+    entry e;
+    e.key = key;
+    e.size = value->size();
+    e.size_bytes_uncompressed = value->total_size_bytes();
+    e.size_bytes = e.size_bytes_uncompressed;
+    e.data = value;
+
+    if (config::instance()->get_server_chunkcache_compression() && !value->empty()) {
+        // fast deflate, keep the uncompressed buffer if compression does not reduce size
+        std::size_t nout = 0;
+        void* out = CPLZLibDeflate(value->buf(), value->total_size_bytes(), 1, nullptr, 0, &nout);
+        if (out) {
+            if (nout < value->total_size_bytes()) {
+                e.compressed = std::make_shared<std::vector<uint8_t>>((uint8_t*)out, (uint8_t*)out + nout);
+                e.size_bytes = nout;
+                e.data = nullptr;
+            }
+            CPLFree(out);
+        }
+    }
+
+    uint64_t max_bytes = config::instance()->get_server_chunkcache_max();
+    if (e.size_bytes > max_bytes) {
+        return;
+    }
+
+    // a recomputed chunk replaces its copy on disk
+    remove_disk(key);
+
+    uint16_t ishard = shard_index(key);
+    shard& s = _shards[ishard];
+    s.m.lock();
+    auto it = s.index.find(key);
+    if (it != s.index.end()) {
+        // replace existing entry
+        _size_bytes -= it->second->size_bytes;
+        _size_bytes_uncompressed -= it->second->size_bytes_uncompressed;
+        s.lru.erase(it->second);
+        s.index.erase(it);
+        --_count;
+    }
+    s.lru.push_front(e);
+    s.index[key] = s.lru.begin();
+    _size_bytes += e.size_bytes;
+    _size_bytes_uncompressed += e.size_bytes_uncompressed;
+    ++_count;
+    s.m.unlock();
+
+    // evict from other shards first, the new chunk is the most recently used one of its shard
+    uint16_t nempty = 0;
+    uint16_t i = (ishard + 1) % NSHARDS;
+    while (_size_bytes > max_bytes && nempty < NSHARDS) {
+        if (evict_one(i)) {
+            nempty = 0;
+        } else {
+            ++nempty;
+        }
+        i = (i + 1) % NSHARDS;
+    }
+}
+
+bool server_chunk_cache::evict_one(uint16_t ishard) {
+    shard& s = _shards[ishard];
+    s.m.lock();
+    if (s.lru.empty()) {
+        s.m.unlock();
+        return false;
+    }
+    entry e = s.lru.back();
+    _size_bytes -= e.size_bytes;
+    _size_bytes_uncompressed -= e.size_bytes_uncompressed;
+    --_count;
+    ++_evictions;
+    s.index.erase(e.key);
+    s.lru.pop_back();
+    s.m.unlock();
+
+    // write to the disk tier outside of the lock
+    if (config::instance()->get_server_chunkcache_disk_max() > 0 && !_disk_dir.empty()) {
+        std::shared_ptr<chunk_data> dat = entry_data(e);
+        if (dat) spill(e.key, dat);
+    }
+    return true;
+}
+
+std::shared_ptr<chunk_data> server_chunk_cache::entry_data(const entry& e) {
+    if (!e.compressed) {
+        return e.data;
+    }
+    std::shared_ptr<chunk_data> out = std::make_shared<chunk_data>();
+    out->size(e.size);
+    out->buf(std::malloc(e.size_bytes_uncompressed));
+    std::size_t nout = 0;
+    if (!CPLZLibInflate(e.compressed->data(), e.compressed->size(), out->buf(), e.size_bytes_uncompressed, &nout) || nout != e.size_bytes_uncompressed) {
+        GCBS_ERROR("Failed to decompress cached chunk " + std::to_string(e.key.second) + " of cube " + std::to_string(e.key.first));
+        return nullptr;
+    }
+    return out;
+}
+
+void server_chunk_cache::set_disk_dir(std::string dir) {
+    std::lock_guard<std::mutex> lock(_disk_mutex);
+    // files of a previous process refer to other cube ids
+    if (filesystem::exists(dir)) {
+        filesystem::iterate_directory(dir, [](const std::string& p) {
+            if (filesystem::extension(p) == "gcc") filesystem::remove(p);
+        });
+    } else {
+        filesystem::mkdir_recursive(dir);
+    }
+    for (auto it = _disk_lru.begin(); it != _disk_lru.end(); ++it) {
+        filesystem::remove(disk_path(it->key));
+    }
+    _disk_lru.clear();
+    _disk_index.clear();
+    _disk_size_bytes = 0;
+    _disk_dir = dir;
+}
+
+std::string server_chunk_cache::disk_path(key_type key) {
+    return filesystem::join(_disk_dir, std::to_string(key.first) + "_" + std::to_string(key.second) + ".gcc");
+}
+
+void server_chunk_cache::spill(key_type key, std::shared_ptr<chunk_data> dat) {
+    uint64_t max_bytes = config::instance()->get_server_chunkcache_disk_max();
+    std::vector<unsigned char> bytes = chunk_codec::encode(dat, chunk_codec::NANMASK | chunk_codec::DEFLATE);
+    if (bytes.size() > max_bytes) {
+        return;
+    }
+
+    // the file is added to the index after it has been written completely
+    std::string path = disk_path(key);
+    std::ofstream os(path, std::ios::out | std::ios::binary | std::ios::trunc);
+    os.write((const char*)bytes.data(), bytes.size());
+    os.close();
+    if (os.fail()) {
+        GCBS_WARN("Failed to write chunk " + std::to_string(key.second) + " of cube " + std::to_string(key.first) + " to '" + path + "'");
+        filesystem::remove(path);
+        return;
+    }
+
+    std::vector<key_type> evicted;
+    _disk_mutex.lock();
+    auto it = _disk_index.find(key);
+    if (it != _disk_index.end()) {
+        _disk_size_bytes -= it->second->size_bytes;
+        _disk_lru.erase(it->second);
+        _disk_index.erase(it);
+    }
+    disk_entry e;
+    e.key = key;
+    e.size_bytes = bytes.size();
+    _disk_lru.push_front(e);
+    _disk_index[key] = _disk_lru.begin();
+    _disk_size_bytes += e.size_bytes;
+    ++_spills;
+    while (_disk_size_bytes > max_bytes && _disk_lru.size() > 1) {
+        disk_entry& last = _disk_lru.back();
+        _disk_size_bytes -= last.size_bytes;
+        _disk_index.erase(last.key);
+        evicted.push_back(last.key);
+        _disk_lru.pop_back();
+    }
+    _disk_mutex.unlock();
+
+    for (uint32_t i = 0; i < evicted.size(); ++i) {
+        filesystem::remove(disk_path(evicted[i]));
+    }
+}
+
+bool server_chunk_cache::remove_disk(key_type key) {
+    _disk_mutex.lock();
+    auto it = _disk_index.find(key);
+    if (it == _disk_index.end()) {
+        _disk_mutex.unlock();
+        return false;
+    }
+    _disk_size_bytes -= it->second->size_bytes;
+    _disk_lru.erase(it->second);
+    _disk_index.erase(it);
+    _disk_mutex.unlock();
+    filesystem::remove(disk_path(key));
+    return true;
+}
+
+std::shared_ptr<chunk_data> server_chunk_cache::promote(key_type key) {
+    // take the entry out of the index first, such that the file is not removed while reading
+    _disk_mutex.lock();
+    auto it = _disk_index.find(key);
+    if (it == _disk_index.end()) {
+        _disk_mutex.unlock();
+        return nullptr;
+    }
+    uint64_t size_bytes = it->second->size_bytes;
+    _disk_size_bytes -= size_bytes;
+    _disk_lru.erase(it->second);
+    _disk_index.erase(it);
+    _disk_mutex.unlock();
+
+    std::string path = disk_path(key);
+    std::vector<unsigned char> bytes(size_bytes);
+    std::ifstream is(path, std::ios::in | std::ios::binary);
+    is.read((char*)bytes.data(), size_bytes);
+    bool ok = is.gcount() == (std::streamsize)size_bytes;
+    is.close();
+    filesystem::remove(path);
+
+    std::shared_ptr<chunk_data> out;
+    if (ok) {
+        try {
+            out = chunk_codec::decode(bytes.data(), bytes.size());
+        } catch (std::string s) {
+            GCBS_ERROR(s);
+        }
+    }
+    if (!out) {
+        GCBS_ERROR("Failed to read chunk " + std::to_string(key.second) + " of cube " + std::to_string(key.first) + " from '" + path + "'");
+        return nullptr;
+    }
+    ++_disk_hits;
+    add(key, out);
+    return out;
+}
+
+void server_chunk_cache::remove(key_type key) {
+    shard& s = _shards[shard_index(key)];
+    std::lock_guard<std::mutex> lock(s.m);
+    auto it = s.index.find(key);
+    if (it != s.index.end()) {
+        _size_bytes -= it->second->size_bytes;
+        _size_bytes_uncompressed -= it->second->size_bytes_uncompressed;
+        --_count;
+        s.lru.erase(it->second);
+        s.index.erase(it);
+    }
+    remove_disk(key);
+}
+
+void server_chunk_cache::remove_cube(uint32_t cube_id) {
+    for (uint16_t i = 0; i < NSHARDS; ++i) {
+        shard& s = _shards[i];
+        std::lock_guard<std::mutex> lock(s.m);
+        for (auto it = s.lru.begin(); it != s.lru.end();) {
+            if (it->key.first == cube_id) {
+                _size_bytes -= it->size_bytes;
+                _size_bytes_uncompressed -= it->size_bytes_uncompressed;
+                --_count;
+                s.index.erase(it->key);
+                it = s.lru.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+
+    std::vector<key_type> removed;
+    _disk_mutex.lock();
+    for (auto it = _disk_lru.begin(); it != _disk_lru.end();) {
+        if (it->key.first == cube_id) {
+            _disk_size_bytes -= it->size_bytes;
+            _disk_index.erase(it->key);
+            removed.push_back(it->key);
+            it = _disk_lru.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    _disk_mutex.unlock();
+    for (uint32_t i = 0; i < removed.size(); ++i) {
+        filesystem::remove(disk_path(removed[i]));
+    }
+}
+
+bool server_chunk_cache::has(key_type key) {
+    {
+        shard& s = _shards[shard_index(key)];
+        std::lock_guard<std::mutex> lock(s.m);
+        if (s.index.find(key) != s.index.end()) return true;
+    }
+    std::lock_guard<std::mutex> lock(_disk_mutex);
+    return _disk_index.find(key) != _disk_index.end();
+}
+
+std::shared_ptr<chunk_data> server_chunk_cache::get(key_type key) {
+    shard& s = _shards[shard_index(key)];
+    s.m.lock();
+    auto it = s.index.find(key);
+    if (it == s.index.end()) {
+        s.m.unlock();
+        std::shared_ptr<chunk_data> out = promote(key);
+        if (!out) ++_misses;
+        return out;
+    }
+    s.lru.splice(s.lru.begin(), s.lru, it->second);  // mark as most recently used, iterators stay valid
+    entry e = *(it->second);
+    s.m.unlock();
+    ++_hits;
+
+    // decompress outside of the lock
+    std::shared_ptr<chunk_data> out = entry_data(e);
+    if (!out) {
+        remove(key);
+    }
+    return out;
+}
+
+server_chunk_cache_stats server_chunk_cache::stats() {
+    server_chunk_cache_stats out;
+    out.hits = _hits;
+    out.misses = _misses;
+    out.evictions = _evictions;
+    out.resident_bytes = _size_bytes;
+    out.uncompressed_bytes = _size_bytes_uncompressed;
+    out.count = _count;
+    out.disk_hits = _disk_hits;
+    out.spills = _spills;
+    out.disk_bytes = _disk_size_bytes;
+    _disk_mutex.lock();
+    out.disk_count = _disk_lru.size();
+    _disk_mutex.unlock();
+    return out;
+}
+
+}  // namespace gdalcubes
@@ -0,0 +1,238 @@
+/*
+    MIT License
+
+    Copyright (c) 2019 Marius Appel <marius.appel@uni-muenster.de>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#ifndef SERVER_CHUNK_CACHE_H
+#define SERVER_CHUNK_CACHE_H
+
+#include <atomic>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+
+#include "cube.h"
+
+namespace gdalcubes {
+
+/**
+ * @brief Counters of the server chunk cache
+ */
+struct server_chunk_cache_stats {
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t evictions;
+    uint64_t resident_bytes;  // bytes consumed by cached chunk buffers, compressed size if compression is enabled
+    uint64_t uncompressed_bytes;  // bytes of cached chunks before compression
+    uint32_t count;
+    uint64_t disk_hits;   // chunks promoted from disk
+    uint64_t spills;      // chunks written to disk
+    uint64_t disk_bytes;  // size of chunk files on disk
+    uint32_t disk_count;
+};
+
+/**
+ * @brief An in-memory singleton cache for successfully read / computed chunks
+ *
+ * Chunks are identified by std::pair<cube_id, chunk_id>. The cache is split into shards with independent locks,
+ * each shard implements a least recently used (LRU) eviction strategy with constant time operations. The total size of
+ * cached buffers is limited by config::get_server_chunkcache_max(). Chunk buffers are optionally compressed
+ * (see config::set_server_chunkcache_compression()).
+ *
+ * If config::get_server_chunkcache_disk_max() is larger than zero and a directory has been set with set_disk_dir(),
+ * evicted chunks are written to files (see chunk_codec) instead of being dropped. The disk tier has its own LRU index
+ * and size limit, chunks are moved back to memory when they are accessed.
+ */
+class server_chunk_cache {
+   public:
+    typedef std::pair<uint32_t, uint32_t> key_type;
+
+    /**
+     * @brief Get the singleton instance
+     * @return pointer to the singleton instance
+     */
+    static server_chunk_cache* instance() {
+        static GC g;
+        _singleton_mutex.lock();
+        if (!_instance) {
+            _instance = new server_chunk_cache();
+        }
+        _singleton_mutex.unlock();
+        return _instance;
+    }
+
+    /**
+     * @brief Remove a chunk from the cache
+     * @param key chunk identifier (cube_id, chunk_id)
+     */
+    void remove(key_type key);
+
+    /**
+     * Add chunk data to the cache, the least recently used chunks are removed if needed.
+     * Chunks larger than the maximum cache size are not added.
+     * @param key chunk identifier (cube_id, chunk_id)
+     * @param value chunk data to add
+     */
+    void add(key_type key, std::shared_ptr<chunk_data> value);
+
+    /**
+     * Check whether a chunk is cached
+     * @param key chunk key (cube_id, chunk_id)
+     * @return true, if the chunk is cached
+     */
+    bool has(key_type key);
+
+    /**
+     * Get chunk data from the cache
+     * @param key chunk key (cube_id, chunk_id)
+     * @return chunk data as shared_ptr, or nullptr if the chunk is not cached
+     */
+    std::shared_ptr<chunk_data> get(key_type key);
+
+    /**
+     * @brief Remove all chunks of a cube from the cache
+     * @param cube_id cube identifier
+     */
+    void remove_cube(uint32_t cube_id);
+
+    /**
+     * @brief Set the directory of the disk tier, existing chunk files in the directory are removed
+     * @param dir path of the directory, created if needed
+     */
+    void set_disk_dir(std::string dir);
+
+    /**
+     * @brief Get the total amount of memory currently consumed by cached chunk buffers
+     * @return Size of the cache in bytes
+     */
+    inline uint64_t total_size_bytes() {
+        return _size_bytes;
+    }
+
+    /**
+     * @brief Get cache hits, misses, evictions, and sizes
+     */
+    server_chunk_cache_stats stats();
+
+   private:
+    struct key_hash {
+        std::size_t operator()(const key_type& k) const {
+            return std::hash<uint64_t>()((uint64_t(k.first) << 32) | uint64_t(k.second));
+        }
+    };
+
+    struct entry {
+        key_type key;
+        std::shared_ptr<chunk_data> data;                     // nullptr if compressed
+        std::shared_ptr<std::vector<uint8_t>> compressed;  // nullptr if not compressed
+        chunk_size_btyx size;
+        uint64_t size_bytes;        // resident size
+        uint64_t size_bytes_uncompressed;
+    };
+
+    struct shard {
+        std::mutex m;
+        std::list<entry> lru;  // most recently used first
+        std::unordered_map<key_type, std::list<entry>::iterator, key_hash> index;
+    };
+
+    static const uint16_t NSHARDS = 16;
+
+    inline uint16_t shard_index(key_type key) {
+        return key_hash()(key) % NSHARDS;
+    }
+
+    struct disk_entry {
+        key_type key;
+        uint64_t size_bytes;  // file size
+    };
+
+    /**
+     * Remove the least recently used chunk of a shard and write it to the disk tier if enabled
+     * @return false, if the shard is empty
+     */
+    bool evict_one(uint16_t ishard);
+
+    /**
+     * Get the (decompressed) chunk data of an entry
+     * @return chunk data or nullptr if decompression fails
+     */
+    std::shared_ptr<chunk_data> entry_data(const entry& e);
+
+    std::string disk_path(key_type key);
+
+    /**
+     * Write a chunk to the disk tier, the least recently used files are removed if needed
+     */
+    void spill(key_type key, std::shared_ptr<chunk_data> dat);
+
+    /**
+     * Read a chunk from the disk tier, remove its file, and add it to memory
+     * @return chunk data or nullptr if the chunk is not on disk
+     */
+    std::shared_ptr<chunk_data> promote(key_type key);
+
+    /**
+     * Remove a chunk from the disk tier
+     * @return false, if the chunk is not on disk
+     */
+    bool remove_disk(key_type key);
+
+    shard _shards[NSHARDS];
+    std::atomic<uint64_t> _size_bytes;
+    std::atomic<uint64_t> _size_bytes_uncompressed;
+    std::atomic<uint32_t> _count;
+    std::atomic<uint64_t> _hits;
+    std::atomic<uint64_t> _misses;
+    std::atomic<uint64_t> _evictions;
+
+    // disk tier, index members must only be accessed while holding _disk_mutex
+    std::string _disk_dir;
+    std::mutex _disk_mutex;
+    std::list<disk_entry> _disk_lru;  // most recently used first
+    std::unordered_map<key_type, std::list<disk_entry>::iterator, key_hash> _disk_index;
+    std::atomic<uint64_t> _disk_size_bytes;
+    std::atomic<uint64_t> _disk_hits;
+    std::atomic<uint64_t> _spills;
+
+    static std::mutex _singleton_mutex;
+
+   private:
+    server_chunk_cache() : _size_bytes(0), _size_bytes_uncompressed(0), _count(0), _hits(0), _misses(0), _evictions(0), _disk_dir(), _disk_mutex(), _disk_lru(), _disk_index(), _disk_size_bytes(0), _disk_hits(0), _spills(0) {}
+    ~server_chunk_cache() {}
+    server_chunk_cache(const server_chunk_cache&) = delete;
+    static server_chunk_cache* _instance;
+
+    class GC {
+       public:
+        ~GC() {
+            if (server_chunk_cache::_instance) {
+                delete server_chunk_cache::_instance;
+                server_chunk_cache::_instance = nullptr;
+            }
+        }
+    };
+};
+
+}  // namespace gdalcubes
+
+#endif  //SERVER_CHUNK_CACHE_H
@@ -0,0 +1,102 @@
+/*
+    MIT License
+
+    Copyright (c) 2019 Marius Appel <marius.appel@uni-muenster.de>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+#include "server_cube_store.h"
+
+#include "utils.h"
+
+namespace gdalcubes {
+
+uint32_t server_cube_store::add(std::shared_ptr<cube> c) {
+    // json11 objects are ordered maps, i.e. the serialization is canonical
+    sha256 h;
+    std::string json = c->make_constructible_json().dump();
+    h.update(json.data(), json.size());
+    std::string hash = h.hexdigest();
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto it = _ids.find(hash);
+    if (it != _ids.end() && _cubes.find(it->second) != _cubes.end()) {
+        GCBS_DEBUG("Reusing cube " + std::to_string(it->second) + " with identical process graph");
+        _last_access[it->second] = std::chrono::steady_clock::now();
+        return it->second;
+    }
+    uint32_t id = _cur_id++;
+    _cubes.insert(std::make_pair(id, c));
+    _hashes[id] = hash;
+    _ids[hash] = id;
+    _last_access[id] = std::chrono::steady_clock::now();
+    return id;
+}
+
+std::shared_ptr<cube> server_cube_store::get(uint32_t id) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto it = _cubes.find(id);
+    if (it == _cubes.end()) {
+        return nullptr;
+    }
+    _last_access[id] = std::chrono::steady_clock::now();
+    return it->second;
+}
+
+std::size_t server_cube_store::size() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _cubes.size();
+}
+
+void server_cube_store::forget_hashes() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _ids.clear();
+}
+
+std::set<uint32_t> server_cube_store::idle(std::chrono::steady_clock::duration max_idle) {
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    std::set<uint32_t> out;
+    std::lock_guard<std::mutex> lock(_mutex);
+    for (auto it = _last_access.begin(); it != _last_access.end(); ++it) {
+        if (now - it->second >= max_idle) {
+            out.insert(it->first);
+        }
+    }
+    return out;
+}
+
+bool server_cube_store::remove_if_idle(uint32_t id, std::chrono::steady_clock::duration max_idle) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto it_access = _last_access.find(id);
+    // the cube might have been accessed after idle() has been called
+    if (it_access == _last_access.end() || std::chrono::steady_clock::now() - it_access->second < max_idle) {
+        return false;
+    }
+    auto it_hash = _hashes.find(id);
+    if (it_hash != _hashes.end()) {
+        auto it_id = _ids.find(it_hash->second);
+        if (it_id != _ids.end() && it_id->second == id) _ids.erase(it_id);
+        _hashes.erase(it_hash);
+    }
+    _last_access.erase(it_access);
+    _cubes.erase(id);
+    return true;
+}
+
+}  // namespace gdalcubes
@@ -0,0 +1,97 @@
+/*
+    MIT License
+
+    Copyright (c) 2019 Marius Appel <marius.appel@uni-muenster.de>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+#ifndef SERVER_CUBE_STORE_H
+#define SERVER_CUBE_STORE_H
+
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <set>
+
+#include "cube.h"
+
+namespace gdalcubes {
+
+/**
+ * @brief Thread-safe store of cubes created by clients of gdalcubes_server
+ *
+ * Cubes are identified by the SHA-256 hash of their constructible JSON representation, adding a cube with
+ * an identical process graph returns the id of the existing cube such that cached chunks are reused.
+ * The store records when each cube has been accessed last, which allows to remove idle cubes.
+ */
+class server_cube_store {
+   public:
+    server_cube_store() : _cubes(), _ids(), _hashes(), _last_access(), _cur_id(0), _mutex() {}
+
+    /**
+     * @brief Add a cube unless a cube with identical process graph exists
+     * @param c cube
+     * @return id of the new or existing cube
+     */
+    uint32_t add(std::shared_ptr<cube> c);
+
+    /**
+     * @brief Get a cube by id and update its last access time
+     * @param id cube id
+     * @return cube or nullptr if no cube with the given id exists
+     */
+    std::shared_ptr<cube> get(uint32_t id);
+
+    /**
+     * @brief Get the number of cubes in the store
+     */
+    std::size_t size();
+
+    /**
+     * @brief Stop reusing existing cubes for identical process graphs, e.g. after input files have been replaced
+     */
+    void forget_hashes();
+
+    /**
+     * @brief Get ids of cubes that have not been accessed for at least the given duration
+     * @param max_idle duration
+     * @return set of cube ids
+     */
+    std::set<uint32_t> idle(std::chrono::steady_clock::duration max_idle);
+
+    /**
+     * @brief Remove a cube if it has not been accessed for at least the given duration
+     * @param id cube id
+     * @param max_idle duration
+     * @return true if the cube has been removed
+     */
+    bool remove_if_idle(uint32_t id, std::chrono::steady_clock::duration max_idle);
+
+   private:
+    std::map<uint32_t, std::shared_ptr<cube>> _cubes;
+    std::map<std::string, uint32_t> _ids;
+    std::map<uint32_t, std::string> _hashes;
+    std::map<uint32_t, std::chrono::steady_clock::time_point> _last_access;
+    uint32_t _cur_id;
+    std::mutex _mutex;
+};
+
+}  // namespace gdalcubes
+
+#endif  //SERVER_CUBE_STORE_H
@@ -26,9 +26,10 @@
 
 #include <stdlib.h>
 
-#include <fstream>
+#include <sstream>
 
 #include "external/tiny-process-library/process.hpp"
+#include "stream_transport.h"
 
 namespace gdalcubes {
 
@@ -41,7 +42,9 @@ std::shared_ptr<chunk_data> stream_cube::read_chunk(chunkid_t id) {
         return out;
     }
 
-    if (_file_streaming) {
+    if (_persistent) {
+        out = stream_chunk_persistent(_in_cube->read_chunk(id), id);
+    } else if (_file_streaming) {
         out = stream_chunk_file(_in_cube->read_chunk(id), id);
     } else {
         out = stream_chunk_stdin(_in_cube->read_chunk(id), id);
@@ -63,75 +66,28 @@ std::shared_ptr<chunk_data> stream_cube::stream_chunk_stdin(std::shared_ptr<chun
 
     // 1. new process with env "GDALCUBES_STREAMING=1"
     std::string errstr;
-    uint32_t databytes_read = 0;
-
-#ifdef _WIN32
-    _putenv("GDALCUBES_STREAMING=1");
-    _putenv((std::string("GDALCUBES_STREAMING_CHUNK_ID") + "=" + std::to_string(id)).c_str());
-#else
-    setenv("GDALCUBES_STREAMING", "1", 1);
-    setenv("GDALCUBES_STREAMING_CHUNK_ID", std::to_string(id).c_str(), 1);
-#endif
+    std::string parse_error;
+    stream_output_reader reader;
+    std::deque<std::shared_ptr<chunk_data>> results;
 
     TinyProcessLib::Process process(
-        _cmd, "", [out, &databytes_read](const char *bytes, std::size_t n) {
-
-        if (databytes_read == 0) {
-            // Assumption is that at least 4 integers with chunk size area always contained in the first call of this function
-            if (n >= 4 * sizeof(int)) {
-                chunk_size_btyx out_size = {(uint32_t)(((int *)bytes)[0]), (uint32_t)(((int *)bytes)[1]),
-                                            (uint32_t)(((int *)bytes)[2]), (uint32_t)(((int *)bytes)[3])};
-                out->size(out_size);
-                // Fill buffers accordingly
-                out->buf(std::calloc(out_size[0] * out_size[1] * out_size[2] * out_size[3], sizeof(double)));
-                memcpy(out->buf(), bytes + (4 * sizeof(int)), n -  4 * sizeof(int));
-                databytes_read += n - (4 * sizeof(int));
-            } else {
-                GCBS_WARN("Cannot read streaming result, returning empty chunk");
-                databytes_read = std::numeric_limits<uint32_t>::max(); // prevent further calls to write anything into the chunk buffer
-            }
-        } else {
-            // buffer overflow check
-            if ((char*)(out->buf()) + databytes_read + n <= (char*)(out->buf()) + out->size()[0] * out->size()[1] * out->size()[2] * out->size()[3] * sizeof(double)) {
-                memcpy((char*)(out->buf()) + databytes_read, bytes, n);
-                databytes_read += n;
-            }
+        _cmd, "", stream_transport::child_environment({{"GDALCUBES_STREAMING", "1"}, {"GDALCUBES_STREAMING_CHUNK_ID", std::to_string(id)}}), [&reader, &results, &parse_error](const char *bytes, std::size_t n) {
+        if (!parse_error.empty()) return;
+        try {
+            reader.read(bytes, n, results);
+        } catch (std::string s) {
+            parse_error = s;
         } }, [&errstr](const char *bytes, std::size_t n) {
     errstr = std::string(bytes, n);
     GCBS_DEBUG(errstr); }, true);
 
     // Write to stdin
-    std::string proj = _in_cube->st_reference()->srs();
-    process.write((char *)(size), sizeof(int) * 4);
-    for (uint16_t i = 0; i < _in_cube->bands().count(); ++i) {
-        int str_size = _in_cube->bands().get(i).name.size();
-        process.write((char *)(&str_size), sizeof(int));
-        process.write(_in_cube->bands().get(i).name.c_str(), sizeof(char) * str_size);
-    }
-
-    if (!_in_cube->st_reference()->has_regular_space()) {
-        throw std::string("ERROR: chunk streaming currently does not support irregular spatial dimensions");
-    }
-    // NOTE: the following will only work as long as all cube st reference types with regular spatial dimensions inherit from  cube_stref_regular class
-    std::shared_ptr<cube_stref_regular> stref_in = std::dynamic_pointer_cast<cube_stref_regular>(_in_cube->st_reference());
-
-    double *dims = (double *)std::calloc(size[1] + size[2] + size[3], sizeof(double));
-    for (int i = 0; i < size[1]; ++i) {
-        dims[i] = stref_in->datetime_at_index(_in_cube->chunk_limits(id).low[0] + i).to_double();
-    }
-    for (int i = size[1]; i < size[1] + size[2]; ++i) {
-        dims[i] = stref_in->win().bottom + i * _in_cube->st_reference()->dy();
-    }
-    for (int i = size[1] + size[2]; i < size[1] + size[2] + size[3]; ++i) {
-        dims[i] = stref_in->win().left + i * _in_cube->st_reference()->dx();
+    std::string header = stream_header(data, id);
+    std::shared_ptr<stream_payload> payload = _format.payload(data, _format.band_indexes(_in_cube->bands()));
+    process.write(header.data(), header.size());
+    for (auto it = payload->segments.begin(); it != payload->segments.end(); ++it) {
+        process.write(it->first, it->second);
     }
-    process.write((char *)(dims), sizeof(double) * (size[1] + size[2] + size[3]));
-    std::free(dims);
-
-    int str_size = proj.size();
-    process.write((char *)(&str_size), sizeof(int));
-    process.write(proj.c_str(), sizeof(char) * str_size);
-    process.write(((char *)(data->buf())), sizeof(double) * data->size()[0] * data->size()[1] * data->size()[2] * data->size()[3]);
 
     process.close_stdin();  // needed?
 
@@ -141,123 +97,88 @@ std::shared_ptr<chunk_data> stream_cube::stream_chunk_stdin(std::shared_ptr<chun
         GCBS_ERROR("Child process output: " + errstr);
         throw std::string("ERROR in stream_cube::read_chunk(): external program returned exit code " + std::to_string(exit_status));
     }
-    return out;
-}
-
-std::shared_ptr<chunk_data> stream_cube::stream_chunk_file(std::shared_ptr<chunk_data> data, chunkid_t id) {
-    std::shared_ptr<chunk_data> out = std::make_shared<chunk_data>();
-
-    int size[] = {(int)data->size()[0], (int)data->size()[1], (int)data->size()[2], (int)data->size()[3]};
-    if (size[0] * size[1] * size[2] * size[3] == 0) {
+    if (!parse_error.empty()) {
+        GCBS_ERROR(parse_error);
+        throw std::string("ERROR in stream_cube::read_chunk(): cannot read output of external program");
+    }
+    if (results.empty()) {
+        GCBS_WARN("Cannot read streaming result, returning empty chunk");
         return out;
     }
+    return results.front();
+}
 
-    // generate in and out filename
-    std::string f_in = filesystem::join(config::instance()->get_streaming_dir(), utils::generate_unique_filename(12, ".stream_", "_in"));
-    std::string f_out = filesystem::join(config::instance()->get_streaming_dir(), utils::generate_unique_filename(12, ".stream_", "_out"));
-
-    std::string errstr;  // capture error string
-
-    // write input data
-    std::ofstream f_in_stream(f_in, std::ios::out | std::ios::binary | std::ios::trunc);
-    if (!f_in_stream.is_open()) {
-        GCBS_ERROR("Cannot write streaming input data to file '" + f_in + "'");
-        throw std::string("ERROR in stream_cube::stream_chunk_file(): cannot write streaming input data to file '" + f_in + "'");
+std::string stream_cube::stream_header(std::shared_ptr<chunk_data> data, chunkid_t id) {
+    int size[] = {(int)data->size()[0], (int)data->size()[1], (int)data->size()[2], (int)data->size()[3]};
+    std::vector<uint16_t> band_idx = _format.band_indexes(_in_cube->bands());
+    size[0] = band_idx.size();
+    std::stringstream ss;
+    std::string proj = _in_cube->st_reference()->srs();
+    ss << _format.header_prefix();
+    ss.write((char *)(size), sizeof(int) * 4);
+    for (uint16_t i = 0; i < band_idx.size(); ++i) {
+        int str_size = _in_cube->bands().get(band_idx[i]).name.size();
+        ss.write((char *)(&str_size), sizeof(int));
+        ss.write(_in_cube->bands().get(band_idx[i]).name.c_str(), sizeof(char) * str_size);
     }
 
-    std::string proj = _in_cube->st_reference()->srs();
-    f_in_stream.write((char *)(size), sizeof(int) * 4);
-    for (uint16_t i = 0; i < _in_cube->bands().count(); ++i) {
-        int str_size = _in_cube->bands().get(i).name.size();
-        f_in_stream.write((char *)(&str_size), sizeof(int));
-        f_in_stream.write(_in_cube->bands().get(i).name.c_str(), sizeof(char) * str_size);
+    if (!_in_cube->st_reference()->has_regular_space()) {
+        throw std::string("ERROR: chunk streaming currently does not support irregular spatial dimensions");
     }
+    // NOTE: the following will only work as long as all cube st reference types with regular spatial dimensions inherit from  cube_stref_regular class
+    std::shared_ptr<cube_stref_regular> stref_in = std::dynamic_pointer_cast<cube_stref_regular>(_in_cube->st_reference());
 
     double *dims = (double *)std::calloc(size[1] + size[2] + size[3], sizeof(double));
     int i = 0;
     for (int it = 0; it < size[1]; ++it) {
-        dims[i] = (_in_cube->st_reference()->datetime_at_index(it + _in_cube->chunk_size()[0] * _in_cube->chunk_limits(id).low[0])).to_double();
+        dims[i] = stref_in->datetime_at_index(_in_cube->chunk_limits(id).low[0] + it).to_double();
         ++i;
     }
-    bounds_st cextent = this->bounds_from_chunk(id);  // implemented in derived classes
+    bounds_st cextent = _in_cube->bounds_from_chunk(id);
     for (int iy = 0; iy < size[2]; ++iy) {
-        dims[i] = cextent.s.bottom + chunk_size(id)[1] * st_reference()->dy() - (iy + 0.5) * st_reference()->dy();  // cell center
+        dims[i] = cextent.s.top - (iy + 0.5) * stref_in->dy();  // cell center
         ++i;
     }
     for (int ix = 0; ix < size[3]; ++ix) {
-        dims[i] = cextent.s.left + (ix + 0.5) * st_reference()->dx();
+        dims[i] = cextent.s.left + (ix + 0.5) * stref_in->dx();
         ++i;
     }
-
-    f_in_stream.write((char *)(dims), sizeof(double) * (size[1] + size[2] + size[3]));
+    ss.write((char *)(dims), sizeof(double) * (size[1] + size[2] + size[3]));
     std::free(dims);
 
     int str_size = proj.size();
-    f_in_stream.write((char *)(&str_size), sizeof(int));
-    f_in_stream.write(proj.c_str(), sizeof(char) * str_size);
-    f_in_stream.write(((char *)(data->buf())), sizeof(double) * data->size()[0] * data->size()[1] * data->size()[2] * data->size()[3]);
-    f_in_stream.close();
-
-    /* setenv / _putenv is not thread-safe, we need to get a mutex until the child process has been started. */
-    static std::mutex mtx;
-    mtx.lock();
-#ifdef _WIN32
-    _putenv("GDALCUBES_STREAMING=1");
-    //_putenv((std::string("GDALCUBES_STREAMING_DIR") + "=" + config::instance()->get_streaming_dir().c_str()).c_str());
-    _putenv((std::string("GDALCUBES_STREAMING_CHUNK_ID") + "=" + std::to_string(id)).c_str());
-    _putenv((std::string("GDALCUBES_STREAMING_FILE_IN") + "=" + f_in.c_str()).c_str());
-    _putenv((std::string("GDALCUBES_STREAMING_FILE_OUT") + "=" + f_out.c_str()).c_str());
-#else
-    setenv("GDALCUBES_STREAMING", "1", 1);
-    // setenv("GDALCUBES_STREAMING_DIR", config::instance()->get_streaming_dir().c_str(), 1);
-    setenv("GDALCUBES_STREAMING_CHUNK_ID", std::to_string(id).c_str(), 1);
-    setenv("GDALCUBES_STREAMING_FILE_IN", f_in.c_str(), 1);
-    setenv("GDALCUBES_STREAMING_FILE_OUT", f_out.c_str(), 1);
-#endif
+    ss.write((char *)(&str_size), sizeof(int));
+    ss.write(proj.c_str(), sizeof(char) * str_size);
+    return ss.str();
+}
 
-    // start process
-    TinyProcessLib::Process process(
-        _cmd, "", [](const char *bytes, std::size_t n) {}, [&errstr](const char *bytes, std::size_t n) {
-        errstr = std::string(bytes, n);
-        GCBS_DEBUG(errstr); }, false);
-    mtx.unlock();
-    auto exit_status = process.get_exit_status();
-    filesystem::remove(f_in);
-    if (exit_status != 0) {
-        GCBS_ERROR("Child process failed with exit code " + std::to_string(exit_status));
-        GCBS_ERROR("Child process output: " + errstr);
-        if (filesystem::exists(f_out)) {
-            filesystem::remove(f_out);
-        }
-        throw std::string("ERROR in stream_cube::read_chunk(): external program returned exit code " + std::to_string(exit_status));
+std::shared_ptr<chunk_data> stream_cube::stream_chunk_persistent(std::shared_ptr<chunk_data> data, chunkid_t id) {
+    int size[] = {(int)data->size()[0], (int)data->size()[1], (int)data->size()[2], (int)data->size()[3]};
+    if (size[0] * size[1] * size[2] * size[3] == 0) {
+        return std::make_shared<chunk_data>();
     }
-
-    // read output data
-    std::ifstream f_out_stream(f_out, std::ios::in | std::ios::binary);
-    if (!f_out_stream.is_open()) {
-        GCBS_ERROR("Cannot read streaming output data from file '" + f_out + "'");
-        throw std::string("ERROR in stream_cube::stream_chunk_file(): cannot read streaming output data from file '" + f_out + "'");
+    // each chunk is preceded by its id
+    int chunk_id = id;
+    std::string header = std::string((char *)(&chunk_id), sizeof(int)) + stream_header(data, id);
+    try {
+        return _workers->process(header, *_format.payload(data, _format.band_indexes(_in_cube->bands())));
+    } catch (std::string s) {
+        GCBS_ERROR(s);
+        throw std::string("ERROR in stream_cube::read_chunk(): persistent worker failed to process chunk " + std::to_string(id));
     }
+}
 
-    f_out_stream.seekg(0, f_out_stream.end);
-    int length = f_out_stream.tellg();
-    f_out_stream.seekg(0, f_out_stream.beg);
-    char *buffer = (char *)std::calloc(length, sizeof(char));
-    f_out_stream.read(buffer, length);
-    f_out_stream.close();
-
-    chunk_size_btyx out_size = {(uint32_t)(((int *)buffer)[0]), (uint32_t)(((int *)buffer)[1]),
-                                (uint32_t)(((int *)buffer)[2]), (uint32_t)(((int *)buffer)[3])};
-    out->size(out_size);
-    out->buf(std::calloc(out_size[0] * out_size[1] * out_size[2] * out_size[3], sizeof(double)));
-    std::memcpy(out->buf(), buffer + (4 * sizeof(int)), length - 4 * sizeof(int));
-    std::free(buffer);
+std::shared_ptr<chunk_data> stream_cube::stream_chunk_file(std::shared_ptr<chunk_data> data, chunkid_t id) {
+    std::shared_ptr<chunk_data> out = std::make_shared<chunk_data>();
 
-    if (filesystem::exists(f_out)) {
-        filesystem::remove(f_out);
+    int size[] = {(int)data->size()[0], (int)data->size()[1], (int)data->size()[2], (int)data->size()[3]};
+    if (size[0] * size[1] * size[2] * size[3] == 0) {
+        return out;
     }
 
-    return out;
+    // run external program with files or shared memory
+    std::shared_ptr<stream_output> res = stream_transport::run(_cmd, id, stream_header(data, id), *_format.payload(data, _format.band_indexes(_in_cube->bands())));
+    return stream_format::decode_output(res->data(), res->size());
 }
 
 }  // namespace gdalcubes
\ No newline at end of file
@@ -25,6 +25,8 @@
 #define STREAM_H
 
 #include "cube.h"
+#include "stream_format.h"
+#include "stream_worker.h"
 
 namespace gdalcubes {
 
@@ -47,17 +49,27 @@ class stream_cube : public cube {
      * @param in_cube input data cube
      * @param cmd external program call
      * @param log_output what to to with the output of the external program, either empty, "stdout", "stderr", or a filename
-     * @param file_streaming boolean, shall chunk data be shared as files (e.g. on /dev/shm) instead of using std streams?
+     * @param file_streaming boolean, shall chunk data be shared as files or shared memory objects (see stream_transport) instead of using std streams?
+     * @param persistent boolean, shall chunks be streamed to a pool of long-lived processes (see stream_worker) instead of starting a new process per chunk?
+     * @param format bands and value type of the streamed input chunks
      * @return a shared pointer to the created data cube instance
      */
-    static std::shared_ptr<stream_cube> create(std::shared_ptr<cube> in_cube, std::string cmd, bool file_streaming = false) {
-        std::shared_ptr<stream_cube> out = std::make_shared<stream_cube>(in_cube, cmd, file_streaming);
+    static std::shared_ptr<stream_cube> create(std::shared_ptr<cube> in_cube, std::string cmd, bool file_streaming = false, bool persistent = false, stream_format format = stream_format()) {
+        std::shared_ptr<stream_cube> out = std::make_shared<stream_cube>(in_cube, cmd, file_streaming, persistent, format);
         in_cube->add_child_cube(out);
         out->add_parent_cube(in_cube);
         return out;
     }
 
-    stream_cube(std::shared_ptr<cube> in_cube, std::string cmd, bool file_streaming = false) : cube(in_cube->st_reference()->copy()), _in_cube(in_cube), _cmd(cmd), _file_streaming(file_streaming), _keep_input_nt(false), _keep_input_ny(false), _keep_input_nx(false) {  // it is important to duplicate st reference here, otherwise changes will affect input cube as well
+    stream_cube(std::shared_ptr<cube> in_cube, std::string cmd, bool file_streaming = false, bool persistent = false, stream_format format = stream_format()) : cube(in_cube->st_reference()->copy()), _in_cube(in_cube), _cmd(cmd), _file_streaming(file_streaming), _persistent(persistent), _format(format), _workers(), _keep_input_nt(false), _keep_input_ny(false), _keep_input_nx(false) {  // it is important to duplicate st reference here, otherwise changes will affect input cube as well
+        if (_persistent && _file_streaming) {
+            throw std::string("ERROR in stream_cube::stream_cube(): persistent worker processes do not support file streaming");
+        }
+        _format.band_indexes(_in_cube->bands());  // throws if selected bands do not exist
+        if (_persistent) {
+            _workers = std::make_shared<stream_worker_pool>(_cmd, config::instance()->get_default_chunk_processor()->max_threads());
+        }
+
         // Test CMD and find out what size comes out.
         cube_size_tyx tmp = _in_cube->chunk_size(0);
         cube_size_btyx csize_in = {_in_cube->bands().count(), tmp[0], tmp[1], tmp[2]};
@@ -74,7 +86,9 @@ class stream_cube : public cube {
         dummy_chunk->buf(std::calloc(csize_in[0] * csize_in[1] * csize_in[2] * csize_in[3], sizeof(double)));
 
         std::shared_ptr<chunk_data> c0;
-        if (_file_streaming) {
+        if (_persistent) {
+            c0 = stream_chunk_persistent(dummy_chunk, 0);
+        } else if (_file_streaming) {
             c0 = stream_chunk_file(dummy_chunk, 0);
         } else {
             c0 = stream_chunk_stdin(dummy_chunk, 0);
@@ -137,6 +151,8 @@ class stream_cube : public cube {
         out["command"] = _cmd;
         out["in_cube"] = _in_cube->make_constructible_json();
         out["file_streaming"] = _file_streaming;
+        out["persistent"] = _persistent;
+        _format.to_json(out);
         return out;
     }
 
@@ -144,6 +160,9 @@ class stream_cube : public cube {
     std::shared_ptr<cube> _in_cube;
     std::string _cmd;
     bool _file_streaming;
+    bool _persistent;
+    stream_format _format;
+    std::shared_ptr<stream_worker_pool> _workers;  // nullptr unless _persistent
 
     // Variables to help deriving the size when view changes without testing with a dummy chunk
     bool _keep_input_nt;
@@ -154,6 +173,13 @@ class stream_cube : public cube {
     std::shared_ptr<chunk_data> stream_chunk_stdin(std::shared_ptr<chunk_data> data, chunkid_t id);
 
     std::shared_ptr<chunk_data> stream_chunk_file(std::shared_ptr<chunk_data> data, chunkid_t id);
+
+    std::shared_ptr<chunk_data> stream_chunk_persistent(std::shared_ptr<chunk_data> data, chunkid_t id);
+
+    /**
+     * @brief Serialize chunk size, band names, dimension values, and spatial reference system as sent before the chunk data to stdin
+     */
+    std::string stream_header(std::shared_ptr<chunk_data> data, chunkid_t id);
 };
 
 }  // namespace gdalcubes
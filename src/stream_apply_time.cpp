@@ -1,29 +1,41 @@
 #include "stream_apply_time.h"
 
-#include <fstream>
+#include <sstream>
 
-#include "external/tiny-process-library/process.hpp"
+#include "stream_transport.h"
 
 namespace gdalcubes {
 
 std::shared_ptr<chunk_data> stream_apply_time_cube::read_chunk(chunkid_t id) {
     GCBS_TRACE("stream_apply_time_cube::read_chunk(" + std::to_string(id) + ")");
-    std::shared_ptr<chunk_data> out = std::make_shared<chunk_data>();
     if (id >= count_chunks())
-        return out;  // chunk is outside of the view, we don't need to read anything.
+        return std::make_shared<chunk_data>();  // chunk is outside of the view, we don't need to read anything.
 
-    coords_nd<uint32_t, 3> size_tyx = chunk_size(id);
-    coords_nd<uint32_t, 4> size_btyx = {_bands.count(), size_tyx[0], size_tyx[1], size_tyx[2]};
-    out->size(size_btyx);
+    return stream_chunks({id})[0];
+}
 
-    // Fill buffers accordingly
-    out->buf(std::calloc(size_btyx[0] * size_btyx[1] * size_btyx[2] * size_btyx[3], sizeof(double)));
-    double *begin = (double *)out->buf();
-    double *end = ((double *)out->buf()) + size_btyx[0] * size_btyx[1] * size_btyx[2] * size_btyx[3];
-    std::fill(begin, end, NAN);
+std::vector<std::shared_ptr<chunk_data>> stream_apply_time_cube::read_chunks(std::vector<chunkid_t> ids) {
+    GCBS_TRACE("stream_apply_time_cube::read_chunks(" + std::to_string(ids.size()) + " chunks)");
+    std::vector<chunkid_t> valid;
+    for (uint32_t i = 0; i < ids.size(); ++i) {
+        if (ids[i] < count_chunks()) valid.push_back(ids[i]);
+    }
+    std::vector<std::shared_ptr<chunk_data>> res;
+    if (!valid.empty()) {
+        res = stream_chunks(valid);
+    }
+    std::vector<std::shared_ptr<chunk_data>> out;
+    uint32_t j = 0;
+    for (uint32_t i = 0; i < ids.size(); ++i) {
+        out.push_back(ids[i] < count_chunks() ? res[j++] : std::make_shared<chunk_data>());  // chunks outside of the view are empty
+    }
+    return out;
+}
 
+std::string stream_apply_time_cube::read_input(chunkid_t id, const std::vector<uint16_t> &band_idx, std::shared_ptr<chunk_data> &inbuf) {
     // 1. read everything to input buffer (for first version, can be memory-intensive, same as rechunk_merge_time)
-    std::shared_ptr<chunk_data> inbuf = std::make_shared<chunk_data>();
+    coords_nd<uint32_t, 3> size_tyx = chunk_size(id);
+    inbuf = std::make_shared<chunk_data>();
     coords_nd<uint32_t, 4> in_size_btyx = {uint32_t(_in_cube->size_bands()), _in_cube->size_t(), size_tyx[1],
                                            size_tyx[2]};
     inbuf->size(in_size_btyx);
@@ -52,33 +64,19 @@ std::shared_ptr<chunk_data> stream_apply_time_cube::read_chunk(chunkid_t id) {
         ++ichunk;
     }
 
-    // generate in and out filename
-    std::string f_in = filesystem::join(config::instance()->get_streaming_dir(),
-                                        utils::generate_unique_filename(12, ".stream_", "_in"));
-    std::string f_out = filesystem::join(config::instance()->get_streaming_dir(),
-                                         utils::generate_unique_filename(12, ".stream_", "_out"));
-
-    std::string errstr;  // capture error string
-
-    // write input data
-    std::ofstream f_in_stream(f_in, std::ios::out | std::ios::binary | std::ios::trunc);
-    if (!f_in_stream.is_open()) {
-        GCBS_ERROR("Cannot write streaming input data to file '" + f_in + "'");
-        throw std::string(
-            "ERROR in stream_apply_time_cube::stream_chunk_file(): cannot write streaming input data to file '" + f_in +
-            "'");
-    }
-
     int size[] = {(int)in_size_btyx[0], (int)in_size_btyx[1], (int)in_size_btyx[2], (int)in_size_btyx[3]};
     if (size[0] * size[1] * size[2] * size[3] == 0) {
-        return out;
+        return "";
     }
+    size[0] = band_idx.size();
+    std::stringstream ss;
     std::string proj = _in_cube->st_reference()->srs();
-    f_in_stream.write((char *)(size), sizeof(int) * 4);
-    for (uint16_t i = 0; i < _in_cube->bands().count(); ++i) {
-        int str_size = _in_cube->bands().get(i).name.size();
-        f_in_stream.write((char *)(&str_size), sizeof(int));
-        f_in_stream.write(_in_cube->bands().get(i).name.c_str(), sizeof(char) * str_size);
+    ss << _format.header_prefix();
+    ss.write((char *)(size), sizeof(int) * 4);
+    for (uint16_t i = 0; i < band_idx.size(); ++i) {
+        int str_size = _in_cube->bands().get(band_idx[i]).name.size();
+        ss.write((char *)(&str_size), sizeof(int));
+        ss.write(_in_cube->bands().get(band_idx[i]).name.c_str(), sizeof(char) * str_size);
     }
     double *dims = (double *)std::calloc(size[1] + size[2] + size[3], sizeof(double));
     int i = 0;
@@ -95,84 +93,71 @@ std::shared_ptr<chunk_data> stream_apply_time_cube::read_chunk(chunkid_t id) {
         dims[i] = cextent.s.left + (ix + 0.5) * st_reference()->dx();
         ++i;
     }
-    f_in_stream.write((char *)(dims), sizeof(double) * (size[1] + size[2] + size[3]));
+    ss.write((char *)(dims), sizeof(double) * (size[1] + size[2] + size[3]));
     std::free(dims);
 
     int str_size = proj.size();
-    f_in_stream.write((char *)(&str_size), sizeof(int));
-    f_in_stream.write(proj.c_str(), sizeof(char) * str_size);
-    f_in_stream.write(((char *)(inbuf->buf())),
-                      sizeof(double) * inbuf->size()[0] * inbuf->size()[1] * inbuf->size()[2] * inbuf->size()[3]);
-    f_in_stream.close();
-
-    /* setenv / _putenv is not thread-safe, we need to get a mutex until the child process has been started. */
-    static std::mutex mtx;
-    mtx.lock();
-#ifdef _WIN32
-    _putenv("GDALCUBES_STREAMING=1");
-    //_putenv((std::string("GDALCUBES_STREAMING_DIR") + "=" + config::instance()->get_streaming_dir().c_str()).c_str());
-    _putenv((std::string("GDALCUBES_STREAMING_CHUNK_ID") + "=" + std::to_string(id)).c_str());
-    _putenv((std::string("GDALCUBES_STREAMING_FILE_IN") + "=" + f_in.c_str()).c_str());
-    _putenv((std::string("GDALCUBES_STREAMING_FILE_OUT") + "=" + f_out.c_str()).c_str());
-#else
-    setenv("GDALCUBES_STREAMING", "1", 1);
-    // setenv("GDALCUBES_STREAMING_DIR", config::instance()->get_streaming_dir().c_str(), 1);
-    setenv("GDALCUBES_STREAMING_CHUNK_ID", std::to_string(id).c_str(), 1);
-    setenv("GDALCUBES_STREAMING_FILE_IN", f_in.c_str(), 1);
-    setenv("GDALCUBES_STREAMING_FILE_OUT", f_out.c_str(), 1);
-#endif
-
-    // start process
-    TinyProcessLib::Process process(
-        _cmd, "", [](const char *bytes, std::size_t n) {},
-        [&errstr](const char *bytes, std::size_t n) {
-            errstr = std::string(bytes, n);
-            GCBS_DEBUG(errstr);
-        },
-        false);
-    mtx.unlock();
-    auto exit_status = process.get_exit_status();
-    filesystem::remove(f_in);
-    if (exit_status != 0) {
-        GCBS_ERROR("Child process failed with exit code " + std::to_string(exit_status));
-        GCBS_ERROR("Child process output: " + errstr);
-        if (filesystem::exists(f_out)) {
-            filesystem::remove(f_out);
-        }
-        throw std::string("ERROR in stream_apply_time_cube::read_chunk(): external program returned exit code " +
-                          std::to_string(exit_status));
-    }
+    ss.write((char *)(&str_size), sizeof(int));
+    ss.write(proj.c_str(), sizeof(char) * str_size);
+    return ss.str();
+}
 
-    // read output data
-    std::ifstream f_out_stream(f_out, std::ios::in | std::ios::binary);
-    if (!f_out_stream.is_open()) {
-        GCBS_ERROR("Cannot read streaming output data from file '" + f_out + "'");
-        throw std::string(
-            "ERROR in stream_apply_time_cube::read_chunk(): cannot read streaming output data from file '" +
-            f_out + "'");
+std::vector<std::shared_ptr<chunk_data>> stream_apply_time_cube::stream_chunks(std::vector<chunkid_t> ids) {
+    std::vector<uint16_t> band_idx = _format.band_indexes(_in_cube->bands());
+
+    std::vector<std::shared_ptr<chunk_data>> out(ids.size());
+    std::vector<std::shared_ptr<chunk_data>> inbuf(ids.size());
+    std::vector<uint32_t> offset(ids.size(), 0);
+
+    // ids, headers, and data of the chunks that are actually streamed
+    std::vector<chunkid_t> stream_ids;
+    std::vector<std::string> headers;
+    std::vector<std::shared_ptr<stream_payload>> data;
+    std::vector<uint32_t> stream_idx;
+
+    for (uint32_t i = 0; i < ids.size(); ++i) {
+        out[i] = std::make_shared<chunk_data>();
+        coords_nd<uint32_t, 3> size_tyx = chunk_size(ids[i]);
+        coords_nd<uint32_t, 4> size_btyx = {_bands.count(), size_tyx[0], size_tyx[1], size_tyx[2]};
+        out[i]->size(size_btyx);
+
+        // Fill buffers accordingly
+        out[i]->buf(std::calloc(size_btyx[0] * size_btyx[1] * size_btyx[2] * size_btyx[3], sizeof(double)));
+        double *begin = (double *)out[i]->buf();
+        double *end = ((double *)out[i]->buf()) + size_btyx[0] * size_btyx[1] * size_btyx[2] * size_btyx[3];
+        std::fill(begin, end, NAN);
+
+        std::string header = read_input(ids[i], band_idx, inbuf[i]);
+        if (header.empty()) continue;
+
+        if (_keep_bands) {
+            offset[i] = inbuf[i]->size()[0] * inbuf[i]->size()[1] * inbuf[i]->size()[2] * inbuf[i]->size()[3];
+            std::memcpy(out[i]->buf(), inbuf[i]->buf(), sizeof(double) * offset[i]);
+        }
+        stream_ids.push_back(ids[i]);
+        headers.push_back(header);
+        data.push_back(_format.payload(inbuf[i], band_idx));
+        stream_idx.push_back(i);
     }
-
-    f_out_stream.seekg(0, f_out_stream.end);
-    int length = f_out_stream.tellg();
-    f_out_stream.seekg(0, f_out_stream.beg);
-    char *buffer = (char *)std::calloc(length, sizeof(char));
-    f_out_stream.read(buffer, length);
-    f_out_stream.close();
-
-    // Copy results to chunk buffer, at most the size of the output
-    uint32_t offset = _keep_bands ? (inbuf->size()[0] * inbuf->size()[1] * inbuf->size()[2] * inbuf->size()[3]) : 0;
-    if (_keep_bands) {
-        std::memcpy(out->buf(), inbuf->buf(),
-                    sizeof(double) * offset);
+    if (stream_ids.empty()) {
+        return out;
     }
-    std::memcpy(((double *)(out->buf())) + offset, buffer + (4 * sizeof(int)), std::min(length - 4 * sizeof(int), size_btyx[0] * size_btyx[1] * size_btyx[2] * size_btyx[3] * sizeof(double)));
-    std::free(buffer);
 
-    if (filesystem::exists(f_out)) {
-        filesystem::remove(f_out);
+    // Copy results to chunk buffers, at most the size of the output
+    if (stream_ids.size() == 1) {
+        // run external program with files or shared memory
+        std::shared_ptr<stream_output> res = stream_transport::run(_cmd, stream_ids[0], headers[0], *data[0]);
+        uint32_t i = stream_idx[0];
+        stream_format::read_output(res->data(), res->size(), ((double *)(out[i]->buf())) + offset[i], out[i]->total_size_bytes() / sizeof(double) - offset[i]);
+    } else {
+        std::vector<std::shared_ptr<chunk_data>> res = stream_transport::run_batch(_cmd, stream_ids, headers, data);
+        for (uint32_t j = 0; j < res.size(); ++j) {
+            uint32_t i = stream_idx[j];
+            std::size_t n = std::min(res[j]->total_size_bytes() / sizeof(double), out[i]->total_size_bytes() / sizeof(double) - offset[i]);
+            if (n > 0) std::memcpy(((double *)(out[i]->buf())) + offset[i], res[j]->buf(), sizeof(double) * n);
+        }
     }
-
     return out;
 }
 
-}  // namespace gdalcubes
\ No newline at end of file
+}  // namespace gdalcubes
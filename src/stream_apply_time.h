@@ -4,6 +4,7 @@
 #define STREAM_APPLY_TIME_H
 
 #include "cube.h"
+#include "stream_format.h"
 
 namespace gdalcubes {
 
@@ -26,13 +27,17 @@ class stream_apply_time_cube : public cube {
         * @param names string vector of output band names, must have the size nbands or empty (the default). If empty,
         * output bands will be named "band1", "band2", ...
         * @param keep_bands if true, bands will be added to the existing bands of the input cube, otherwise (default) they are dropped
+        * @param format bands and value type of the streamed input chunks
+        * @param batch_bytes if > 0, chunks that a chunk processor reads anyway are streamed in batches of approximately this
+        * number of input bytes per call of the external program, which then must process all chunks of its input
+        * (see stream_transport::run_batch())
         * @return a shared pointer to the created data cube instance
         */
     static std::shared_ptr<stream_apply_time_cube>
     create(std::shared_ptr<cube> in, std::string cmd, uint16_t nbands,
-           std::vector<std::string> names = std::vector<std::string>(), bool keep_bands = false) {
+           std::vector<std::string> names = std::vector<std::string>(), bool keep_bands = false, stream_format format = stream_format(), uint64_t batch_bytes = 0) {
         std::shared_ptr<stream_apply_time_cube> out = std::make_shared<stream_apply_time_cube>(in, cmd, nbands,
-                                                                                               names, keep_bands);
+                                                                                               names, keep_bands, format, batch_bytes);
         in->add_child_cube(out);
         out->add_parent_cube(in);
         return out;
@@ -40,7 +45,13 @@ class stream_apply_time_cube : public cube {
 
    public:
     stream_apply_time_cube(std::shared_ptr<cube> in, std::string cmd, uint16_t nbands,
-                           std::vector<std::string> names = std::vector<std::string>(), bool keep_bands = false) : cube(in->st_reference()->copy()), _in_cube(in), _cmd(cmd), _nbands(nbands), _names(names), _keep_bands(keep_bands) {  // it is important to duplicate st reference here, otherwise changes will affect input cube as well
+                           std::vector<std::string> names = std::vector<std::string>(), bool keep_bands = false, stream_format format = stream_format(), uint64_t batch_bytes = 0) : cube(in->st_reference()->copy()), _in_cube(in), _cmd(cmd), _nbands(nbands), _names(names), _keep_bands(keep_bands), _format(format), _batch_bytes(batch_bytes), _batch_size(1) {  // it is important to duplicate st reference here, otherwise changes will affect input cube as well
+        std::vector<uint16_t> band_idx = _format.band_indexes(_in_cube->bands());  // throws if selected bands do not exist
+        if (_batch_bytes > 0) {
+            std::size_t chunk_bytes = band_idx.size() * _in_cube->size_t() * _in_cube->chunk_size()[1] * _in_cube->chunk_size()[2] * (_format.float32() ? sizeof(float) : sizeof(double));
+            _batch_size = std::max(uint64_t(1), chunk_bytes == 0 ? 1 : _batch_bytes / chunk_bytes);
+        }
+
 
         _chunk_size[0] = _in_cube->size_t();
         _chunk_size[1] = _in_cube->chunk_size()[1];
@@ -76,6 +87,10 @@ class stream_apply_time_cube : public cube {
 
     std::shared_ptr<chunk_data> read_chunk(chunkid_t id) override;
 
+    std::vector<std::shared_ptr<chunk_data>> read_chunks(std::vector<chunkid_t> ids) override;
+
+    uint32_t read_batch_size() override { return _batch_size; }
+
     json11::Json make_constructible_json() override {
         json11::Json::object out;
         out["cube_type"] = "stream_apply_time_cube";
@@ -84,6 +99,10 @@ class stream_apply_time_cube : public cube {
         out["names"] = _names;
         out["keep_bands"] = _keep_bands;
         out["in_cube"] = _in_cube->make_constructible_json();
+        _format.to_json(out);
+        if (_batch_bytes > 0) {
+            out["batch_bytes"] = double(_batch_bytes);
+        }
         return out;
     }
 
@@ -93,6 +112,25 @@ class stream_apply_time_cube : public cube {
     uint16_t _nbands;
     std::vector<std::string> _names;
     bool _keep_bands;
+    stream_format _format;
+    uint64_t _batch_bytes;
+    uint32_t _batch_size;  // chunks per call of the external program
+
+    /**
+     * @brief Read an input chunk and serialize its header
+     * @param id chunk id
+     * @param band_idx indexes of the streamed bands
+     * @param inbuf input chunk, empty chunks are replaced with NAN values
+     * @return header of the streamed chunk or an empty string if the chunk has no cells
+     */
+    std::string read_input(chunkid_t id, const std::vector<uint16_t> &band_idx, std::shared_ptr<chunk_data> &inbuf);
+
+    /**
+     * @brief Compute chunks with a single call of the external program
+     * @param ids chunk ids
+     * @return result chunks in the order of ids
+     */
+    std::vector<std::shared_ptr<chunk_data>> stream_chunks(std::vector<chunkid_t> ids);
 };
 
 }  // namespace gdalcubes
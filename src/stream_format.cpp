@@ -0,0 +1,227 @@
+/*
+    MIT License
+
+    Copyright (c) 2019 Marius Appel <marius.appel@uni-muenster.de>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#include "stream_format.h"
+
+#include <cstring>
+
+namespace gdalcubes {
+
+stream_format stream_format::from_json(json11::Json j) {
+    std::vector<std::string> bands;
+    for (uint16_t i = 0; i < j["input_bands"].array_items().size(); ++i) {
+        bands.push_back(j["input_bands"][i].string_value());
+    }
+    std::string type = j["input_type"].is_string() ? j["input_type"].string_value() : "float64";
+    if (type != "float64" && type != "float32") {
+        throw std::string("ERROR in stream_format::from_json(): unsupported input type '" + type + "', expected float64 or float32");
+    }
+    return stream_format(bands, type == "float32");
+}
+
+void stream_format::to_json(json11::Json::object &j) {
+    j["input_bands"] = _bands;
+    j["input_type"] = _float32 ? "float32" : "float64";
+}
+
+std::vector<uint16_t> stream_format::band_indexes(band_collection in) {
+    std::vector<uint16_t> out;
+    if (_bands.empty()) {
+        for (uint16_t i = 0; i < in.count(); ++i) {
+            out.push_back(i);
+        }
+        return out;
+    }
+    for (uint16_t i = 0; i < _bands.size(); ++i) {
+        if (!in.has(_bands[i])) {
+            GCBS_ERROR("Input data cube has no band '" + _bands[i] + "'");
+            throw std::string("ERROR in stream_format::band_indexes(): input data cube has no band '" + _bands[i] + "'");
+        }
+        out.push_back(in.get_index(_bands[i]));
+    }
+    return out;
+}
+
+std::string stream_format::header_prefix() {
+    if (is_default()) {
+        return "";
+    }
+    int prefix[] = {-VERSION, _float32 ? int(sizeof(float)) : int(sizeof(double))};
+    return std::string((char *)prefix, 2 * sizeof(int));
+}
+
+std::shared_ptr<stream_payload> stream_format::payload(std::shared_ptr<chunk_data> c, const std::vector<uint16_t> &band_idx) {
+    std::shared_ptr<stream_payload> out = std::make_shared<stream_payload>();
+    if (c->empty()) {
+        return out;
+    }
+    std::size_t nband = c->size()[1] * c->size()[2] * c->size()[3];
+    if (_float32) {
+        out->values_float32.resize(band_idx.size() * nband);
+        for (uint16_t i = 0; i < band_idx.size(); ++i) {
+            const double *in = (const double *)c->buf() + band_idx[i] * nband;
+            float *dst = out->values_float32.data() + i * nband;
+            for (std::size_t j = 0; j < nband; ++j) {
+                dst[j] = (float)in[j];
+            }
+        }
+    }
+    for (uint16_t i = 0; i < band_idx.size(); ++i) {
+        if (_float32) {
+            out->segments.push_back(std::make_pair((const char *)(out->values_float32.data() + i * nband), nband * sizeof(float)));
+        } else {
+            out->segments.push_back(std::make_pair((const char *)c->buf() + band_idx[i] * nband * sizeof(double), nband * sizeof(double)));
+        }
+    }
+    return out;
+}
+
+std::size_t stream_format::parse_output_header(const char *bytes, std::size_t n, chunk_size_btyx &size, uint16_t &value_bytes) {
+    if (n < sizeof(int)) {
+        return 0;
+    }
+    int first;
+    std::memcpy(&first, bytes, sizeof(int));
+    std::size_t header_size = 4 * sizeof(int);
+    value_bytes = sizeof(double);
+    if (first < 0) {
+        if (-first != VERSION) {
+            throw std::string("ERROR in stream_format::parse_output_header(): unsupported streaming format version " + std::to_string(-first));
+        }
+        header_size = 6 * sizeof(int);
+        if (n < header_size) {
+            return 0;
+        }
+        int vb;
+        std::memcpy(&vb, bytes + sizeof(int), sizeof(int));
+        if (vb != sizeof(float) && vb != sizeof(double)) {
+            throw std::string("ERROR in stream_format::parse_output_header(): unsupported value size of " + std::to_string(vb) + " bytes, expected 4 or 8");
+        }
+        value_bytes = vb;
+    }
+    if (n < header_size) {
+        return 0;
+    }
+    int s[4];
+    std::memcpy(s, bytes + header_size - 4 * sizeof(int), 4 * sizeof(int));
+    for (uint16_t i = 0; i < 4; ++i) {
+        size[i] = s[i] > 0 ? uint32_t(s[i]) : 0;
+    }
+    return header_size;
+}
+
+chunk_size_btyx stream_format::read_output(const char *bytes, std::size_t n, double *out, std::size_t max_values) {
+    chunk_size_btyx size = {0, 0, 0, 0};
+    uint16_t value_bytes;
+    std::size_t header_size = parse_output_header(bytes, n, size, value_bytes);
+    if (header_size == 0) {
+        throw std::string("ERROR in stream_format::read_output(): incomplete streaming output");
+    }
+    std::size_t nvalues = std::min(std::size_t(size[0]) * size[1] * size[2] * size[3], std::min((n - header_size) / value_bytes, max_values));
+    if (value_bytes == sizeof(double)) {
+        std::memcpy(out, bytes + header_size, nvalues * sizeof(double));
+    } else {
+        const char *in = bytes + header_size;
+        for (std::size_t i = 0; i < nvalues; ++i) {
+            float v;
+            std::memcpy(&v, in + i * sizeof(float), sizeof(float));
+            out[i] = v;
+        }
+    }
+    return size;
+}
+
+std::shared_ptr<chunk_data> stream_format::decode_output(const char *bytes, std::size_t n) {
+    std::shared_ptr<chunk_data> out = std::make_shared<chunk_data>();
+    chunk_size_btyx size = {0, 0, 0, 0};
+    uint16_t value_bytes;
+    if (parse_output_header(bytes, n, size, value_bytes) == 0) {
+        throw std::string("ERROR in stream_format::decode_output(): incomplete streaming output");
+    }
+    std::size_t nvalues = std::size_t(size[0]) * size[1] * size[2] * size[3];
+    if (nvalues == 0) {
+        return out;
+    }
+    out->size(size);
+    out->buf(std::calloc(nvalues, sizeof(double)));
+    read_output(bytes, n, (double *)out->buf(), nvalues);
+    return out;
+}
+
+void stream_output_reader::read(const char *bytes, std::size_t n, std::deque<std::shared_ptr<chunk_data>> &results) {
+    while (n > 0) {
+        if (!_current) {
+            // the header has 16 bytes in version 1 and 24 bytes in version 2, which is only known after the first integer
+            std::size_t target = _header_size > 0 ? _header_size : (_header_read < sizeof(int) ? sizeof(int) : 6 * sizeof(int));
+            std::size_t k = std::min(n, target - _header_read);
+            std::memcpy(_header + _header_read, bytes, k);
+            _header_read += k;
+            bytes += k;
+            n -= k;
+            chunk_size_btyx size = {0, 0, 0, 0};
+            _header_size = stream_format::parse_output_header(_header, _header_read, size, _value_bytes);
+            if (_header_size == 0 || _header_read < _header_size) {
+                if (_header_read >= sizeof(int) && _header_size == 0) {
+                    int first;
+                    std::memcpy(&first, _header, sizeof(int));
+                    if (first >= 0) _header_size = 4 * sizeof(int);  // version 1, wait for the remaining size integers
+                }
+                continue;
+            }
+            _current = std::make_shared<chunk_data>();
+            _current_read = 0;
+            std::size_t nvalues = std::size_t(size[0]) * size[1] * size[2] * size[3];
+            if (nvalues > 0) {
+                _current->size(size);
+                _current->buf(std::calloc(nvalues, sizeof(double)));
+            }
+        }
+        std::size_t nbytes = _current->empty() ? 0 : _current->size()[0] * _current->size()[1] * _current->size()[2] * _current->size()[3] * _value_bytes;
+        std::size_t k = std::min(n, nbytes - _current_read);
+        if (k > 0) {
+            std::memcpy((char *)_current->buf() + _current_read, bytes, k);
+            _current_read += k;
+            bytes += k;
+            n -= k;
+        }
+        if (_current_read == nbytes) {
+            if (_value_bytes == sizeof(float) && nbytes > 0) {
+                // convert in place from the back, double i overlaps floats 2i and 2i + 1 which are already converted
+                char *buf = (char *)_current->buf();
+                for (std::size_t i = nbytes / sizeof(float); i-- > 0;) {
+                    float v;
+                    std::memcpy(&v, buf + i * sizeof(float), sizeof(float));
+                    double d = v;
+                    std::memcpy(buf + i * sizeof(double), &d, sizeof(double));
+                }
+            }
+            results.push_back(_current);
+            _current = nullptr;
+            _header_read = 0;
+            _header_size = 0;
+        }
+    }
+}
+
+}  // namespace gdalcubes
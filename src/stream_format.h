@@ -0,0 +1,185 @@
+/*
+    MIT License
+
+    Copyright (c) 2019 Marius Appel <marius.appel@uni-muenster.de>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#ifndef STREAM_FORMAT_H
+#define STREAM_FORMAT_H
+
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "cube.h"
+
+namespace gdalcubes {
+
+/**
+ * @brief Chunk data as sent to an external program, i.e. a sequence of contiguous byte ranges
+ */
+struct stream_payload {
+    stream_payload() : segments(), values_float32() {}
+
+    /**
+     * @brief Payload of a single contiguous buffer, which is not copied
+     */
+    stream_payload(const void *data, std::size_t n) : segments(), values_float32() {
+        segments.push_back(std::make_pair((const char *)data, n));
+    }
+
+    /**
+     * @brief Total number of bytes
+     */
+    std::size_t size() const {
+        std::size_t n = 0;
+        for (auto it = segments.begin(); it != segments.end(); ++it) n += it->second;
+        return n;
+    }
+
+    std::vector<std::pair<const char *, std::size_t>> segments;
+    std::vector<float> values_float32;  // owned buffer of converted values, if any
+};
+
+/**
+ * @brief Options of the wire format that is used to stream chunk data to external programs
+ *
+ * By default, all bands of a chunk are streamed as double values with the original (version 1) header, starting
+ * with four 32 bit integers with the chunk size. Programs that only need some of the bands or do not need double precision
+ * can request a subset of bands and / or 32 bit floating point values. In this case, the input is
+ * preceded by two 32 bit integers: the negative format version (-2) and the number of bytes per value (4 or 8),
+ * followed by the version 1 header with the size and names of the selected bands and the data of the selected bands only.
+ *
+ * The output of an external program may use the same versioned header to return 32 bit floating point values, i.e.
+ * -2, the number of bytes per value, four integers with the chunk size, and the values. Otherwise, the output
+ * starts with the chunk size followed by double values as before.
+ */
+class stream_format {
+   public:
+    static const int VERSION = 2;
+
+    stream_format() : _bands(), _float32(false) {}
+
+    /**
+     * @param bands names of the bands that are streamed, all bands if empty
+     * @param float32 stream values as 32 bit floating point numbers instead of doubles
+     */
+    stream_format(std::vector<std::string> bands, bool float32) : _bands(bands), _float32(float32) {}
+
+    /**
+     * @brief Read options from the "input_bands" and "input_type" fields of a cube JSON object
+     */
+    static stream_format from_json(json11::Json j);
+
+    /**
+     * @brief Write options to the "input_bands" and "input_type" fields of a cube JSON object
+     */
+    void to_json(json11::Json::object &j);
+
+    inline std::vector<std::string> bands() { return _bands; }
+    inline bool float32() { return _float32; }
+
+    /**
+     * @brief Check whether chunks are streamed in the original (version 1) format
+     */
+    inline bool is_default() { return _bands.empty() && !_float32; }
+
+    /**
+     * @brief Indexes of the streamed bands
+     * @param in bands of the input data cube
+     * @throws std::string if a selected band does not exist
+     */
+    std::vector<uint16_t> band_indexes(band_collection in);
+
+    /**
+     * @brief Bytes that precede the version 1 header, empty for the default format
+     */
+    std::string header_prefix();
+
+    /**
+     * @brief Select bands and convert values of a chunk as streamed to an external program
+     *
+     * The payload contains one segment per streamed band. Double values are referenced without copying, i.e. the
+     * chunk must outlive the payload.
+     * @param c input chunk
+     * @param band_idx indexes of the streamed bands, see band_indexes()
+     */
+    std::shared_ptr<stream_payload> payload(std::shared_ptr<chunk_data> c, const std::vector<uint16_t> &band_idx);
+
+    /**
+     * @brief Parse the header of the output of an external program
+     * @param bytes output bytes
+     * @param n number of available bytes
+     * @param size result chunk size
+     * @param value_bytes number of bytes per value, 4 or 8
+     * @return size of the header in bytes or 0 if n is too small to contain the complete header
+     * @throws std::string if the header has an unsupported version or value size
+     */
+    static std::size_t parse_output_header(const char *bytes, std::size_t n, chunk_size_btyx &size, uint16_t &value_bytes);
+
+    /**
+     * @brief Copy values of the output of an external program to a double buffer
+     * @param bytes output bytes, including the header
+     * @param n number of output bytes
+     * @param out destination buffer
+     * @param max_values maximum number of values written to out
+     * @return size of the result chunk as given in the header
+     */
+    static chunk_size_btyx read_output(const char *bytes, std::size_t n, double *out, std::size_t max_values);
+
+    /**
+     * @brief Create a chunk from the output of an external program
+     */
+    static std::shared_ptr<chunk_data> decode_output(const char *bytes, std::size_t n);
+
+   private:
+    std::vector<std::string> _bands;
+    bool _float32;
+};
+
+/**
+ * @brief Incremental parser of a sequence of result chunks from the output stream of an external program
+ */
+class stream_output_reader {
+   public:
+    stream_output_reader() : _header(), _header_read(0), _header_size(0), _value_bytes(8), _current(), _current_read(0) {}
+
+    /**
+     * @brief Consume output bytes
+     * @param bytes output bytes
+     * @param n number of bytes
+     * @param results completed result chunks are appended
+     */
+    void read(const char *bytes, std::size_t n, std::deque<std::shared_ptr<chunk_data>> &results);
+
+   private:
+    char _header[6 * sizeof(int)];
+    std::size_t _header_read;
+    std::size_t _header_size;  // 0 if unknown yet
+    uint16_t _value_bytes;
+    std::shared_ptr<chunk_data> _current;
+    std::size_t _current_read;
+};
+
+}  // namespace gdalcubes
+
+#endif  //STREAM_FORMAT_H
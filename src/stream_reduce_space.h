@@ -4,6 +4,7 @@
 #define STREAM_REDUCE_SPACE_H
 
 #include "cube.h"
+#include "stream_format.h"
 
 namespace gdalcubes {
 
@@ -22,13 +23,14 @@ class stream_reduce_space_cube : public cube {
         * @param nbands number of bands in the output cube
         * @param names string vector of output band names, must have the size nbands or empty (the default). If empty,
         * output bands will be named "band1", "band2", ...
+        * @param format bands and value type of the streamed input chunks
         * @return a shared pointer to the created data cube instance
         */
     static std::shared_ptr<stream_reduce_space_cube>
     create(std::shared_ptr<cube> in, std::string cmd, uint16_t nbands,
-           std::vector<std::string> names = std::vector<std::string>()) {
+           std::vector<std::string> names = std::vector<std::string>(), stream_format format = stream_format()) {
         std::shared_ptr<stream_reduce_space_cube> out = std::make_shared<stream_reduce_space_cube>(in, cmd, nbands,
-                                                                                                   names);
+                                                                                                   names, format);
         in->add_child_cube(out);
         out->add_parent_cube(in);
         return out;
@@ -36,7 +38,9 @@ class stream_reduce_space_cube : public cube {
 
    public:
     stream_reduce_space_cube(std::shared_ptr<cube> in, std::string cmd, uint16_t nbands,
-                             std::vector<std::string> names = std::vector<std::string>()) : cube(in->st_reference()->copy()), _in_cube(in), _cmd(cmd), _nbands(nbands), _names(names) {  // it is important to duplicate st reference here, otherwise changes will affect input cube as well
+                             std::vector<std::string> names = std::vector<std::string>(), stream_format format = stream_format()) : cube(in->st_reference()->copy()), _in_cube(in), _cmd(cmd), _nbands(nbands), _names(names), _format(format) {  // it is important to duplicate st reference here, otherwise changes will affect input cube as well
+        _format.band_indexes(_in_cube->bands());  // throws if selected bands do not exist
+
         if (cube_stref::type_string(_st_ref) == "cube_stref_regular") {
             std::shared_ptr<cube_stref_regular> stref = std::dynamic_pointer_cast<cube_stref_regular>(_st_ref);
             stref->nx(1);
@@ -80,6 +84,7 @@ class stream_reduce_space_cube : public cube {
         out["nbands"] = _nbands;
         out["names"] = _names;
         out["in_cube"] = _in_cube->make_constructible_json();
+        _format.to_json(out);
         return out;
     }
 
@@ -88,6 +93,7 @@ class stream_reduce_space_cube : public cube {
     std::string _cmd;
     uint16_t _nbands;
     std::vector<std::string> _names;
+    stream_format _format;
 };
 
 }  // namespace gdalcubes
@@ -0,0 +1,317 @@
+/*
+    MIT License
+
+    Copyright (c) 2019 Marius Appel <marius.appel@uni-muenster.de>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#include "stream_transport.h"
+
+#include <stdlib.h>
+
+#include <algorithm>
+#include <fstream>
+
+#if defined(__APPLE__)
+#include <crt_externs.h>
+#elif !defined(_WIN32)
+extern char **environ;
+#endif
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace gdalcubes {
+
+stream_output::~stream_output() {
+#ifndef _WIN32
+    if (_mapped) {
+        munmap(_buf, _size);
+        return;
+    }
+#endif
+    if (_buf) std::free(_buf);
+}
+
+std::shared_ptr<stream_output> stream_transport::run(std::string cmd, chunkid_t id, const std::string &header, const stream_payload &data) {
+    return run(cmd, id, header, data.size(), [&data](sink write) {
+        std::size_t offset = 0;
+        for (auto it = data.segments.begin(); it != data.segments.end(); ++it) {
+            write(offset, it->first, it->second);
+            offset += it->second;
+        }
+    });
+}
+
+std::shared_ptr<stream_output> stream_transport::run(std::string cmd, chunkid_t id, const std::string &header, std::size_t n, std::function<void(sink)> writer,
+                                                     const std::vector<std::pair<std::string, std::string>> &env) {
+    if (config::instance()->get_streaming_shared_memory()) {
+#ifdef _WIN32
+        GCBS_WARN("Shared memory streaming is not supported on Windows, using files in the streaming directory");
+#else
+        return run_shared_memory(cmd, id, header, n, writer, env);
+#endif
+    }
+    return run_file(cmd, id, header, n, writer, env);
+}
+
+std::vector<std::shared_ptr<chunk_data>> stream_transport::run_batch(std::string cmd, const std::vector<chunkid_t> &ids, const std::vector<std::string> &headers,
+                                                                     const std::vector<std::shared_ptr<stream_payload>> &data) {
+    std::size_t n = 0;
+    std::string chunk_ids;
+    for (uint32_t i = 0; i < ids.size(); ++i) {
+        n += headers[i].size() + data[i]->size();
+        chunk_ids += (i > 0 ? "," : "") + std::to_string(ids[i]);
+    }
+    std::shared_ptr<stream_output> res = run(
+        cmd, ids[0], "", n, [&headers, &data](sink write) {
+            std::size_t offset = 0;
+            for (uint32_t i = 0; i < headers.size(); ++i) {
+                write(offset, headers[i].data(), headers[i].size());
+                offset += headers[i].size();
+                for (auto it = data[i]->segments.begin(); it != data[i]->segments.end(); ++it) {
+                    write(offset, it->first, it->second);
+                    offset += it->second;
+                }
+            }
+        },
+        {{"GDALCUBES_STREAMING_BATCH", std::to_string(ids.size())}, {"GDALCUBES_STREAMING_CHUNK_IDS", chunk_ids}});
+
+    stream_output_reader reader;
+    std::deque<std::shared_ptr<chunk_data>> results;
+    reader.read(res->data(), res->size(), results);
+    if (results.size() != ids.size()) {
+        GCBS_ERROR("External program returned " + std::to_string(results.size()) + " results for a batch of " + std::to_string(ids.size()) + " chunks");
+        throw std::string("ERROR in stream_transport::run_batch(): external program returned an incomplete batch");
+    }
+    return std::vector<std::shared_ptr<chunk_data>>(results.begin(), results.end());
+}
+
+TinyProcessLib::Process::environment_type stream_transport::child_environment(const std::vector<std::pair<std::string, std::string>> &vars) {
+#if defined(_WIN32)
+    char **env = _environ;
+#elif defined(__APPLE__)
+    char **env = *_NSGetEnviron();
+#else
+    char **env = environ;
+#endif
+    TinyProcessLib::Process::environment_type out;
+    for (char **e = env; e && *e; ++e) {
+        std::string kv(*e);
+        std::size_t pos = kv.find('=');
+        if (pos == std::string::npos || pos == 0) continue;  // e.g. "=C:=C:\\" on Windows
+        out[kv.substr(0, pos)] = kv.substr(pos + 1);
+    }
+    for (auto it = vars.begin(); it != vars.end(); ++it) {
+        out[it->first] = it->second;
+    }
+    return out;
+}
+
+void stream_transport::run_process(std::string cmd, const std::vector<std::pair<std::string, std::string>> &env) {
+    std::string errstr;  // capture error string
+
+    // start process
+    TinyProcessLib::Process process(
+        cmd, "", child_environment(env), [](const char *bytes, std::size_t n) {},
+        [&errstr](const char *bytes, std::size_t n) {
+            errstr = std::string(bytes, n);
+            GCBS_DEBUG(errstr);
+        },
+        false);
+    auto exit_status = process.get_exit_status();
+    if (exit_status != 0) {
+        GCBS_ERROR("Child process failed with exit code " + std::to_string(exit_status));
+        GCBS_ERROR("Child process output: " + errstr);
+        throw std::string("ERROR in stream_transport::run(): external program returned exit code " + std::to_string(exit_status));
+    }
+}
+
+std::shared_ptr<stream_output> stream_transport::run_file(std::string cmd, chunkid_t id, const std::string &header, std::size_t n, std::function<void(sink)> writer,
+                                                          const std::vector<std::pair<std::string, std::string>> &env) {
+    // generate in and out filename
+    std::string f_in = filesystem::join(config::instance()->get_streaming_dir(), utils::generate_unique_filename(12, ".stream_", "_in"));
+    std::string f_out = filesystem::join(config::instance()->get_streaming_dir(), utils::generate_unique_filename(12, ".stream_", "_out"));
+
+    // write input data
+    std::ofstream f_in_stream(f_in, std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!f_in_stream.is_open()) {
+        GCBS_ERROR("Cannot write streaming input data to file '" + f_in + "'");
+        throw std::string("ERROR in stream_transport::run(): cannot write streaming input data to file '" + f_in + "'");
+    }
+    f_in_stream.write(header.data(), header.size());
+    try {
+        std::size_t pos = header.size();  // current write position
+        std::size_t end = header.size();  // end of the file
+        writer([&f_in_stream, &header, &pos, &end](std::size_t offset, const char *bytes, std::size_t k) {
+            if (header.size() + offset != pos) {
+                f_in_stream.seekp(header.size() + offset);
+            }
+            f_in_stream.write(bytes, k);
+            pos = header.size() + offset + k;
+            end = std::max(end, pos);
+        });
+        if (end < header.size() + n) {
+            // extend the file to the expected size if the last part has not been written
+            f_in_stream.seekp(header.size() + n - 1);
+            f_in_stream.put(0);
+        }
+        if (!f_in_stream) {
+            throw std::string("ERROR in stream_transport::run(): cannot write streaming input data to file '" + f_in + "'");
+        }
+    } catch (...) {
+        f_in_stream.close();
+        filesystem::remove(f_in);
+        throw;
+    }
+    f_in_stream.close();
+
+    try {
+        std::vector<std::pair<std::string, std::string>> vars = {{"GDALCUBES_STREAMING", "1"},
+                                                                 {"GDALCUBES_STREAMING_CHUNK_ID", std::to_string(id)},
+                                                                 {"GDALCUBES_STREAMING_FILE_IN", f_in},
+                                                                 {"GDALCUBES_STREAMING_FILE_OUT", f_out}};
+        vars.insert(vars.end(), env.begin(), env.end());
+        run_process(cmd, vars);
+    } catch (std::string s) {
+        filesystem::remove(f_in);
+        if (filesystem::exists(f_out)) {
+            filesystem::remove(f_out);
+        }
+        throw s;
+    }
+    filesystem::remove(f_in);
+
+    // read output data
+    std::ifstream f_out_stream(f_out, std::ios::in | std::ios::binary);
+    if (!f_out_stream.is_open()) {
+        GCBS_ERROR("Cannot read streaming output data from file '" + f_out + "'");
+        throw std::string("ERROR in stream_transport::run(): cannot read streaming output data from file '" + f_out + "'");
+    }
+
+    std::shared_ptr<stream_output> out(new stream_output());
+    f_out_stream.seekg(0, f_out_stream.end);
+    out->_size = f_out_stream.tellg();
+    f_out_stream.seekg(0, f_out_stream.beg);
+    out->_buf = (char *)std::calloc(out->_size, sizeof(char));
+    f_out_stream.read(out->_buf, out->_size);
+    f_out_stream.close();
+
+    if (filesystem::exists(f_out)) {
+        filesystem::remove(f_out);
+    }
+    if (out->_size < 4 * sizeof(int)) {
+        throw std::string("ERROR in stream_transport::run(): streaming output data in file '" + f_out + "' is incomplete");
+    }
+    return out;
+}
+
+std::shared_ptr<stream_output> stream_transport::run_shared_memory(std::string cmd, chunkid_t id, const std::string &header, std::size_t n, std::function<void(sink)> writer,
+                                                                   const std::vector<std::pair<std::string, std::string>> &env) {
+#ifdef _WIN32
+    throw std::string("ERROR in stream_transport::run(): shared memory streaming is not supported on Windows");
+#else
+    // object names must start with a slash and must not contain any other slashes
+    std::string shm_in = utils::generate_unique_filename(12, "/gdalcubes_stream_", "_in");
+    std::string shm_out = utils::generate_unique_filename(12, "/gdalcubes_stream_", "_out");
+
+    // write input data directly to the mapped object
+    int fd = shm_open(shm_in.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd < 0) {
+        GCBS_ERROR("Cannot create shared memory object '" + shm_in + "'");
+        throw std::string("ERROR in stream_transport::run(): cannot create shared memory object '" + shm_in + "'");
+    }
+    std::size_t size_in = header.size() + n;
+    void *in = MAP_FAILED;
+    if (ftruncate(fd, size_in) == 0) {
+        in = mmap(nullptr, size_in, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+    if (in == MAP_FAILED) {
+        shm_unlink(shm_in.c_str());
+        GCBS_ERROR("Cannot map shared memory object '" + shm_in + "' with " + std::to_string(size_in) + " bytes");
+        throw std::string("ERROR in stream_transport::run(): cannot map shared memory object '" + shm_in + "'");
+    }
+    std::memcpy(in, header.data(), header.size());
+    char *data = (char *)in + header.size();
+    try {
+        writer([data, n](std::size_t offset, const char *bytes, std::size_t k) {
+            if (offset + k > n) {
+                throw std::string("ERROR in stream_transport::run(): streaming input data exceeds the expected size");
+            }
+            std::memcpy(data + offset, bytes, k);
+        });
+    } catch (...) {
+        munmap(in, size_in);
+        shm_unlink(shm_in.c_str());
+        throw;
+    }
+    munmap(in, size_in);
+
+    // programs that expect files can use the objects in /dev/shm directly (Linux)
+    std::vector<std::pair<std::string, std::string>> vars = {{"GDALCUBES_STREAMING", "1"},
+                                                             {"GDALCUBES_STREAMING_CHUNK_ID", std::to_string(id)},
+                                                             {"GDALCUBES_STREAMING_SHM_IN", shm_in},
+                                                             {"GDALCUBES_STREAMING_SHM_OUT", shm_out}};
+    if (filesystem::is_directory("/dev/shm")) {
+        vars.push_back({"GDALCUBES_STREAMING_FILE_IN", "/dev/shm" + shm_in});
+        vars.push_back({"GDALCUBES_STREAMING_FILE_OUT", "/dev/shm" + shm_out});
+    }
+    vars.insert(vars.end(), env.begin(), env.end());
+
+    try {
+        run_process(cmd, vars);
+    } catch (std::string s) {
+        shm_unlink(shm_in.c_str());
+        shm_unlink(shm_out.c_str());
+        throw s;
+    }
+    shm_unlink(shm_in.c_str());
+
+    // map output data, the object can be unlinked immediately as the mapping remains valid
+    fd = shm_open(shm_out.c_str(), O_RDONLY, 0);
+    if (fd < 0) {
+        GCBS_ERROR("Cannot open shared memory object '" + shm_out + "'");
+        throw std::string("ERROR in stream_transport::run(): cannot read streaming output data from shared memory object '" + shm_out + "'");
+    }
+    shm_unlink(shm_out.c_str());
+    struct stat st;
+    if (fstat(fd, &st) != 0 || std::size_t(st.st_size) < 4 * sizeof(int)) {
+        close(fd);
+        throw std::string("ERROR in stream_transport::run(): streaming output data in shared memory object '" + shm_out + "' is incomplete");
+    }
+    void *buf = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (buf == MAP_FAILED) {
+        throw std::string("ERROR in stream_transport::run(): cannot map shared memory object '" + shm_out + "'");
+    }
+    std::shared_ptr<stream_output> out(new stream_output());
+    out->_buf = (char *)buf;
+    out->_size = st.st_size;
+    out->_mapped = true;
+    return out;
+#endif
+}
+
+}  // namespace gdalcubes
@@ -0,0 +1,163 @@
+/*
+    MIT License
+
+    Copyright (c) 2019 Marius Appel <marius.appel@uni-muenster.de>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#ifndef STREAM_TRANSPORT_H
+#define STREAM_TRANSPORT_H
+
+#include <functional>
+#include <memory>
+#include <string>
+
+#include "cube.h"
+#include "stream_format.h"
+#include "external/tiny-process-library/process.hpp"
+
+namespace gdalcubes {
+
+/**
+ * @brief Output of an external program in file-based streaming, i.e. the chunk size followed by the chunk data
+ * (see stream_format)
+ *
+ * Depending on the transport, the buffer either has been read from a file or is a read-only mapping of a
+ * shared memory object.
+ */
+class stream_output {
+    friend class stream_transport;
+
+   public:
+    ~stream_output();
+
+    /**
+     * @brief Pointer to the first byte of the output (the chunk size header)
+     */
+    inline const char *data() { return _buf; }
+
+    /**
+     * @brief Total number of bytes of the output, including the chunk size header
+     */
+    inline std::size_t size() { return _size; }
+
+   private:
+    stream_output() : _buf(nullptr), _size(0), _mapped(false) {}
+    char *_buf;
+    std::size_t _size;
+    bool _mapped;
+};
+
+/**
+ * @brief Exchange data of a single chunk with an external program that is started per chunk
+ *
+ * The input (header and chunk data) is made available to the external program either as a file in the
+ * streaming directory or, if config::get_streaming_shared_memory() is set, as a POSIX shared memory object.
+ * The program is started with the following environment variables:
+ *
+ * - `GDALCUBES_STREAMING=1`
+ * - `GDALCUBES_STREAMING_CHUNK_ID`: id of the chunk
+ * - `GDALCUBES_STREAMING_FILE_IN` / `GDALCUBES_STREAMING_FILE_OUT`: paths of the input and output files; for shared
+ *   memory, these point to the objects in `/dev/shm` if available such that existing programs work unchanged
+ * - `GDALCUBES_STREAMING_SHM_IN` / `GDALCUBES_STREAMING_SHM_OUT`: names of the input and output shared memory objects
+ *   (shared memory only), which can be opened with `shm_open()`; the program must create the output object
+ * - `GDALCUBES_STREAMING_BATCH` / `GDALCUBES_STREAMING_CHUNK_IDS`: number of chunks and comma-separated chunk ids
+ *   (batches only, see run_batch())
+ *
+ * With shared memory, the input is written with a single copy into the mapped object and the output is mapped
+ * instead of read, avoiding any file I/O.
+ */
+class stream_transport {
+   public:
+    /**
+     * @brief Run an external program on a single chunk
+     * @param cmd external program call
+     * @param id chunk id
+     * @param header serialized chunk size, band names, dimension values, and spatial reference system
+     * @param data chunk data that follows the header
+     * @return output of the external program
+     */
+    static std::shared_ptr<stream_output> run(std::string cmd, chunkid_t id, const std::string &header, const stream_payload &data);
+
+    /**
+     * @brief Function to write a part of the chunk data at a given byte offset relative to the end of the header
+     */
+    typedef std::function<void(std::size_t offset, const char *bytes, std::size_t n)> sink;
+
+    /**
+     * @brief Run an external program on a single chunk whose data is written in pieces and in arbitrary order
+     *
+     * The data is written directly to the input file or the mapped shared memory object as produced by the writer,
+     * e.g. input chunk by input chunk, such that it never needs to be assembled in memory. Parts that are not written
+     * are filled with zeros.
+     * @param cmd external program call
+     * @param id chunk id
+     * @param header serialized chunk size, band names, dimension values, and spatial reference system
+     * @param n total number of bytes of chunk data that follows the header
+     * @param writer function that receives a sink and writes all chunk data
+     * @param env additional environment variables of the external program
+     * @return output of the external program
+     */
+    static std::shared_ptr<stream_output> run(std::string cmd, chunkid_t id, const std::string &header, std::size_t n, std::function<void(sink)> writer,
+                                              const std::vector<std::pair<std::string, std::string>> &env = {});
+
+    /**
+     * @brief Run an external program once for a batch of chunks
+     *
+     * The input consists of the usual input (header and data) of all chunks one after another, the output must
+     * contain the results of all chunks one after another in the same order. The program is started with the
+     * additional environment variables `GDALCUBES_STREAMING_BATCH` (number of chunks) and
+     * `GDALCUBES_STREAMING_CHUNK_IDS` (comma-separated chunk ids), `GDALCUBES_STREAMING_CHUNK_ID` is the first id.
+     * @param cmd external program call
+     * @param ids chunk ids
+     * @param headers input headers per chunk
+     * @param data input data per chunk
+     * @return result chunks in the order of ids
+     */
+    static std::vector<std::shared_ptr<chunk_data>> run_batch(std::string cmd, const std::vector<chunkid_t> &ids, const std::vector<std::string> &headers,
+                                                              const std::vector<std::shared_ptr<stream_payload>> &data);
+
+    /**
+     * @brief Environment of an external program in streaming mode, i.e. the environment of the calling process
+     * plus the given variables
+     *
+     * Child processes are started with an explicit environment block instead of modifying the environment of the
+     * calling process with setenv(), which is not thread-safe and would require serializing process start-up.
+     * @param vars variables that are added to or replace variables of the calling process
+     * @return environment to be passed to the TinyProcessLib::Process constructor
+     */
+    static TinyProcessLib::Process::environment_type child_environment(const std::vector<std::pair<std::string, std::string>> &vars);
+
+   private:
+    static std::shared_ptr<stream_output> run_file(std::string cmd, chunkid_t id, const std::string &header, std::size_t n, std::function<void(sink)> writer,
+                                                   const std::vector<std::pair<std::string, std::string>> &env);
+    static std::shared_ptr<stream_output> run_shared_memory(std::string cmd, chunkid_t id, const std::string &header, std::size_t n, std::function<void(sink)> writer,
+                                                            const std::vector<std::pair<std::string, std::string>> &env);
+
+    /**
+     * @brief Start an external program with the given streaming environment variables and wait until it finishes,
+     * throws if the program returns a nonzero exit code
+     */
+    static void run_process(std::string cmd, const std::vector<std::pair<std::string, std::string>> &env);
+};
+
+}  // namespace gdalcubes
+
+#endif  //STREAM_TRANSPORT_H
@@ -0,0 +1,224 @@
+/*
+    MIT License
+
+    Copyright (c) 2019 Marius Appel <marius.appel@uni-muenster.de>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#include "stream_worker.h"
+
+#include <cstring>
+#include <thread>
+
+#ifndef _WIN32
+#include <signal.h>
+#endif
+
+#include "external/tiny-process-library/process.hpp"
+#include "stream_transport.h"
+
+namespace gdalcubes {
+
+stream_worker::stream_worker(std::string cmd) : _process(), _cmd(cmd), _nprocessed(0), _mutex(), _cv(), _reader(), _results(), _stderr(), _error(), _exited(false), _exit_status(0) {
+    _process = std::unique_ptr<TinyProcessLib::Process>(new TinyProcessLib::Process(
+        _cmd, "", stream_transport::child_environment({{"GDALCUBES_STREAMING", "1"}, {"GDALCUBES_STREAMING_PERSISTENT", "1"}}),
+        [this](const char *bytes, std::size_t n) { read_stdout(bytes, n); }, [this](const char *bytes, std::size_t n) {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _stderr = std::string(bytes, n);
+            GCBS_DEBUG(_stderr); }, true));
+    if (_process->get_id() <= 0) {
+        throw std::string("ERROR in stream_worker::stream_worker(): cannot start external program '" + _cmd + "'");
+    }
+    GCBS_DEBUG("Started persistent streaming worker with process id " + std::to_string(_process->get_id()));
+}
+
+stream_worker::~stream_worker() {
+    _process->close_stdin();
+    for (uint16_t i = 0; i < 50 && alive(); ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+    kill();
+}
+
+bool stream_worker::alive() {
+    if (_exited || !_error.empty()) return false;
+    int status = 0;
+    // joins the output reader threads if the process has exited, i.e. all output has been parsed afterwards
+    if (_process->try_get_exit_status(status)) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _exited = true;
+        _exit_status = status;
+        _cv.notify_all();
+        return false;
+    }
+    return true;
+}
+
+void stream_worker::kill() {
+    // workers with invalid output are not alive but their process must still be terminated and reaped
+    if (_exited || _process->get_id() <= 0) return;
+    GCBS_DEBUG("Killing persistent streaming worker with process id " + std::to_string(_process->get_id()));
+    _process->kill(true);
+    int status = _process->get_exit_status();
+    std::lock_guard<std::mutex> lock(_mutex);
+    _exited = true;
+    _exit_status = status;
+    _cv.notify_all();
+}
+
+void stream_worker::read_stdout(const char *bytes, std::size_t n) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (!_error.empty()) return;
+    std::size_t nresults = _results.size();
+    try {
+        _reader.read(bytes, n, _results);
+    } catch (std::string s) {
+        // the output cannot be parsed any longer, the worker is not usable afterwards
+        _error = s;
+        _cv.notify_all();
+        return;
+    }
+    if (_results.size() > nresults) {
+        _cv.notify_all();
+    }
+}
+
+bool stream_worker::write(const char *bytes, std::size_t n) {
+#ifdef _WIN32
+    return _process->write(bytes, n);
+#else
+    // a broken pipe must not raise SIGPIPE, which would terminate the calling process
+    sigset_t set, old;
+    sigemptyset(&set);
+    sigaddset(&set, SIGPIPE);
+    pthread_sigmask(SIG_BLOCK, &set, &old);
+    bool ok = true;
+    while (ok && n > 0) {
+        std::size_t k = std::min(n, std::size_t(1024 * 1024));
+        ok = _process->write(bytes, k);
+        bytes += k;
+        n -= k;
+    }
+    sigset_t pending;
+    sigpending(&pending);
+    if (sigismember(&pending, SIGPIPE)) {
+        int sig;
+        sigwait(&set, &sig);
+    }
+    pthread_sigmask(SIG_SETMASK, &old, nullptr);
+    return ok;
+#endif
+}
+
+std::shared_ptr<chunk_data> stream_worker::process(const std::string &header, const stream_payload &data) {
+    if (!alive()) {
+        throw std::string("ERROR in stream_worker::process(): external program exited with code " + std::to_string(_exit_status));
+    }
+    bool ok = write(header.data(), header.size());
+    for (auto it = data.segments.begin(); ok && it != data.segments.end(); ++it) {
+        ok = write(it->first, it->second);
+    }
+    if (!ok) {
+        alive();
+        throw std::string("ERROR in stream_worker::process(): cannot write to external program");
+    }
+
+    // wait for the result, regularly checking whether the process is still running
+    std::unique_lock<std::mutex> lock(_mutex);
+    while (_results.empty()) {
+        if (!_error.empty()) {
+            lock.unlock();
+            kill();
+            throw std::string("ERROR in stream_worker::process(): invalid output of external program: " + _error);
+        }
+        if (_exited) {
+            throw std::string("ERROR in stream_worker::process(): external program exited with code " + std::to_string(_exit_status) + ": " + _stderr);
+        }
+        _cv.wait_for(lock, std::chrono::milliseconds(100));
+        if (_results.empty() && !_exited) {
+            lock.unlock();
+            alive();
+            lock.lock();
+        }
+    }
+    std::shared_ptr<chunk_data> out = _results.front();
+    _results.pop_front();
+    ++_nprocessed;
+    return out;
+}
+
+std::unique_ptr<stream_worker> stream_worker_pool::acquire() {
+    std::unique_lock<std::mutex> lock(_mutex);
+    _cv.wait(lock, [this]() { return !_idle.empty() || _nworkers < _max_workers; });
+    while (!_idle.empty()) {
+        std::unique_ptr<stream_worker> w = std::move(_idle.front());
+        _idle.pop_front();
+        if (w->alive()) {
+            return w;
+        }
+        // replace workers that exited while idle
+        GCBS_WARN("Persistent streaming worker exited unexpectedly after " + std::to_string(w->nprocessed()) + " chunks, starting a new process");
+        --_nworkers;
+    }
+    ++_nworkers;
+    lock.unlock();
+    try {
+        return std::unique_ptr<stream_worker>(new stream_worker(_cmd));
+    } catch (...) {
+        lock.lock();
+        --_nworkers;
+        _cv.notify_one();
+        throw;
+    }
+}
+
+void stream_worker_pool::release(std::unique_ptr<stream_worker> w) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (w) {
+        _idle.push_back(std::move(w));
+    } else {
+        --_nworkers;
+    }
+    _cv.notify_one();
+}
+
+std::shared_ptr<chunk_data> stream_worker_pool::process(const std::string &header, const stream_payload &data) {
+    std::string err;
+    for (uint16_t attempt = 0; attempt < 2; ++attempt) {
+        std::unique_ptr<stream_worker> w = acquire();
+        try {
+            std::shared_ptr<chunk_data> out = w->process(header, data);
+            release(std::move(w));
+            return out;
+        } catch (std::string s) {
+            err = s;
+        } catch (std::exception &e) {
+            err = "ERROR in stream_worker_pool::process(): " + std::string(e.what());
+        }
+        GCBS_WARN(err);
+        // input and output streams of the worker might be out of sync, a new worker retries the chunk
+        w->kill();
+        w.reset();
+        release(nullptr);
+    }
+    throw err;
+}
+
+}  // namespace gdalcubes
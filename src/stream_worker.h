@@ -0,0 +1,153 @@
+/*
+    MIT License
+
+    Copyright (c) 2019 Marius Appel <marius.appel@uni-muenster.de>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#ifndef STREAM_WORKER_H
+#define STREAM_WORKER_H
+
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+
+#include "cube.h"
+#include "stream_format.h"
+
+namespace TinyProcessLib {
+class Process;
+}
+
+namespace gdalcubes {
+
+/**
+ * @brief A long-lived external process that receives a sequence of chunks over stdin and returns results over stdout
+ *
+ * The process is started with the environment variables GDALCUBES_STREAMING=1 and GDALCUBES_STREAMING_PERSISTENT=1.
+ * For each chunk, it receives the chunk id as a 32 bit integer followed by the same input as in stream_cube's
+ * stdin mode (chunk size, band names, dimension values, spatial reference system, and data) and must write
+ * a result chunk in the usual format (see stream_format) to stdout. The process
+ * should exit when stdin is closed.
+ */
+class stream_worker {
+   public:
+    /**
+     * @brief Start a worker process
+     * @param cmd external program call
+     */
+    stream_worker(std::string cmd);
+
+    /**
+     * @brief Close stdin of the process and wait a few seconds for it to exit before it is killed
+     */
+    ~stream_worker();
+
+    stream_worker(const stream_worker &) = delete;
+    void operator=(const stream_worker &) = delete;
+
+    /**
+     * @brief Send a chunk to the process and wait for the result
+     * @param header bytes preceding the chunk data, including the chunk id
+     * @param data chunk data
+     * @return result chunk
+     * @throws std::string if the process exits, cannot receive data, or returns invalid output, the worker is then no longer alive
+     */
+    std::shared_ptr<chunk_data> process(const std::string &header, const stream_payload &data);
+
+    /**
+     * @brief Check whether the process is still running
+     */
+    bool alive();
+
+    /**
+     * @brief Terminate the external program immediately, the worker is not usable afterwards
+     */
+    void kill();
+
+    /**
+     * @brief Number of chunks processed by this worker
+     */
+    inline uint32_t nprocessed() { return _nprocessed; }
+
+   private:
+    /**
+     * Parse result chunks from stdout of the process, called by the stdout reader thread
+     */
+    void read_stdout(const char *bytes, std::size_t n);
+
+    /**
+     * Write to stdin of the process without terminating the calling process if the pipe is broken
+     */
+    bool write(const char *bytes, std::size_t n);
+
+    std::unique_ptr<TinyProcessLib::Process> _process;
+    std::string _cmd;
+    uint32_t _nprocessed;
+
+    // state of the stdout parser and finished results, protected by _mutex
+    std::mutex _mutex;
+    std::condition_variable _cv;
+    stream_output_reader _reader;
+    std::deque<std::shared_ptr<chunk_data>> _results;
+    std::string _stderr;
+    std::string _error;  // output parsing error
+    bool _exited;
+    int _exit_status;
+};
+
+/**
+ * @brief A pool of persistent stream_worker processes running the same command
+ *
+ * Workers are started lazily, up to the given maximum number of workers. Workers that exited (e.g. crashed) are
+ * detected before use and replaced by new processes. If processing a chunk fails for any reason (e.g. a broken pipe or a
+ * partial result while the program is still running), the worker is killed and the chunk is retried once with a new worker.
+ */
+class stream_worker_pool {
+   public:
+    /**
+     * @brief Create a pool without starting workers
+     * @param cmd external program call
+     * @param max_workers maximum number of concurrent workers, typically the number of threads of the chunk processor
+     */
+    stream_worker_pool(std::string cmd, uint16_t max_workers) : _cmd(cmd), _max_workers(std::max(uint16_t(1), max_workers)), _nworkers(0), _idle(), _mutex(), _cv() {}
+
+    /**
+     * @brief Process a chunk with an idle worker, waits until a worker is available
+     * @see stream_worker::process()
+     */
+    std::shared_ptr<chunk_data> process(const std::string &header, const stream_payload &data);
+
+   private:
+    std::unique_ptr<stream_worker> acquire();
+    void release(std::unique_ptr<stream_worker> w);
+
+    std::string _cmd;
+    uint16_t _max_workers;
+    uint16_t _nworkers;  // number of started workers, including busy workers
+    std::deque<std::unique_ptr<stream_worker>> _idle;
+    std::mutex _mutex;
+    std::condition_variable _cv;
+};
+
+}  // namespace gdalcubes
+
+#endif  //STREAM_WORKER_H
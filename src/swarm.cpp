@@ -24,92 +24,326 @@
 
 #include "swarm.h"
 
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <deque>
 #include <fstream>
+#include <set>
 #include <thread>
 
+#include "timer.h"
+#include "utils.h"
+
 namespace gdalcubes {
 
+/**
+ * Counts finished requests of a group of asynchronous requests and collects error messages
+ */
+struct request_group {
+    request_group(uint32_t n) : remaining(n), errors(), failed_servers(), m(), cv() {}
+
+    void done(std::string error = "", int32_t server = -1) {
+        std::lock_guard<std::mutex> lock(m);
+        if (!error.empty()) errors.push_back(error);
+        if (server >= 0) failed_servers.insert(server);
+        --remaining;
+        cv.notify_all();
+    }
+
+    void add(uint32_t n) {
+        std::lock_guard<std::mutex> lock(m);
+        remaining += n;
+    }
+
+    void wait() {
+        std::unique_lock<std::mutex> lock(m);
+        cv.wait(lock, [this]() { return remaining == 0; });
+    }
+
+    uint32_t remaining;
+    std::vector<std::string> errors;
+    std::set<uint16_t> failed_servers;
+    std::mutex m;
+    std::condition_variable cv;
+};
+
+struct swarm_http_client::transfer {
+    transfer() : req(), handle(nullptr), headers(nullptr), upload(), block(), block_pos(0) {}
+    std::shared_ptr<request> req;
+    CURL *handle;
+    struct curl_slist *headers;
+    std::shared_ptr<std::ifstream> upload;
+    std::vector<unsigned char> block;  // compressed block of the upload file, if upload_deflate is set
+    std::size_t block_pos;             // number of bytes of block that have been sent already
+};
+
 size_t post_file_read_callback(char *buffer, size_t size, size_t nitems, void *userdata) {
     std::ifstream *is = ((std::ifstream *)userdata);
     is->read(buffer, size * nitems);  // or use readsome() ?
     return is->gcount();
 }
 
-std::shared_ptr<gdalcubes_swarm> gdalcubes_swarm::from_txtfile(std::string path) {
-    std::ifstream file(path);
-    std::vector<std::string> urllist;
-    std::string line;
-    while (std::getline(file, line)) {
-        // TODO: check if valid URL
-        if (!line.empty()) urllist.push_back(line);
+size_t swarm_http_client::deflate_read_callback(char *buffer, size_t size, size_t nitems, void *userdata) {
+    transfer *t = (transfer *)userdata;
+    if (t->block_pos == t->block.size()) {
+        // compress the next block of the file, files are read in blocks of 1 MiB
+        static const std::size_t BLOCK_SIZE = 1024 * 1024;
+        std::vector<char> in(BLOCK_SIZE);
+        t->upload->read(in.data(), BLOCK_SIZE);
+        std::streamsize n = t->upload->gcount();
+        if (n <= 0) return 0;
+        t->block = utils::deflate_block(in.data(), (uint32_t)n);
+        t->block_pos = 0;
     }
+    std::size_t n = std::min(size * nitems, t->block.size() - t->block_pos);
+    std::memcpy(buffer, t->block.data() + t->block_pos, n);
+    t->block_pos += n;
+    return n;
+}
 
-    file.close();
-    return gdalcubes_swarm::from_urls(urllist);
+size_t swarm_http_client::write_callback(char *buffer, size_t size, size_t nitems, void *userdata) {
+    transfer *t = (transfer *)userdata;
+    if (t->req->data) {
+        // stream successful responses, collect error messages
+        long status = 0;
+        curl_easy_getinfo(t->handle, CURLINFO_RESPONSE_CODE, &status);
+        if (status == 200) {
+            t->req->data(buffer, size * nitems);
+            return size * nitems;
+        }
+    }
+    t->req->response.insert(t->req->response.end(), buffer, buffer + (size * nitems));
+    return size * nitems;
 }
 
-void gdalcubes_swarm::post_file(std::string path, uint16_t server_index) {
-    if (_server_handles[server_index]) {
-        curl_easy_reset(_server_handles[server_index]);
+swarm_http_client::swarm_http_client(uint16_t nservers, uint16_t max_requests_per_server) : _multi(curl_multi_init()),
+                                                                                            _thread(),
+                                                                                            _mutex(),
+                                                                                            _stop(false),
+                                                                                            _max_requests_per_server(max_requests_per_server),
+                                                                                            _pending(nservers),
+                                                                                            _running_count(nservers, 0),
+                                                                                            _running(),
+                                                                                            _idle_handles() {
+    if (!_multi) {
+        throw std::string("ERROR in swarm_http_client::swarm_http_client(): cannot initialize curl multi handle");
+    }
+    _thread = std::thread(&swarm_http_client::loop, this);
+}
 
-        // Step 1: send a HEAD HTTP request to check whether the file already exists on the server
-        curl_easy_setopt(_server_handles[server_index], CURLOPT_URL, (_server_uris[server_index] + "/file" + "?name=" + path + "&size=" + std::to_string(filesystem::file_size(path))).c_str());
-        curl_easy_setopt(_server_handles[server_index], CURLOPT_CUSTOMREQUEST, "HEAD");
-        curl_easy_setopt(_server_handles[server_index], CURLOPT_VERBOSE, config::instance()->get_swarm_curl_verbose() ? 1L : 0L);
-
-        CURLcode res = curl_easy_perform(_server_handles[server_index]);
-        long response_code;
-        if (res != CURLE_OK) {
-            throw std::string("ERROR in gdalcubes_swarm::post_file(): HEAD /file?name='" + path + "' to '" + _server_uris[server_index] + "' failed");
-        } else {
-            curl_easy_getinfo(_server_handles[server_index], CURLINFO_RESPONSE_CODE, &response_code);
-        }
+swarm_http_client::~swarm_http_client() {
+    _mutex.lock();
+    _stop = true;
+    _mutex.unlock();
+    wakeup();
+    if (_thread.joinable()) _thread.join();
 
-        if (response_code == 200) {
-            // already exists on server
-            return;
-        } else if (response_code == 204 || response_code == 409) {
-            // file does not exist or has different size
+    for (auto it = _running.begin(); it != _running.end(); ++it) {
+        curl_multi_remove_handle(_multi, it->first);
+        if (it->second->headers) curl_slist_free_all(it->second->headers);
+        curl_easy_cleanup(it->first);
+    }
+    for (uint32_t i = 0; i < _idle_handles.size(); ++i) {
+        curl_easy_cleanup(_idle_handles[i]);
+    }
+    curl_multi_cleanup(_multi);
+}
 
-            // Step 2: if not upload
+void swarm_http_client::wakeup() {
+#if LIBCURL_VERSION_NUM >= 0x074400  // 7.68.0
+    curl_multi_wakeup(_multi);
+#endif
+}
 
-            std::ifstream is(path, std::ifstream::in | std::ifstream::binary);
-            if (!is.is_open()) {
-                throw std::string("ERROR in gdalcubes_swarm::push_execution_context(): cannot open file '" + path + "'");
-            }
+void swarm_http_client::set_max_requests_per_server(uint16_t n) {
+    _mutex.lock();
+    _max_requests_per_server = std::max(uint16_t(1), n);
+    _mutex.unlock();
+    wakeup();
+}
 
-            curl_easy_setopt(_server_handles[server_index], CURLOPT_URL, (_server_uris[server_index] + "/file" + "?name=" + path).c_str());
+void swarm_http_client::submit(std::shared_ptr<request> r) {
+    if (r->server >= _pending.size()) {
+        throw std::string("ERROR in swarm_http_client::submit(): invalid server index");
+    }
+    _mutex.lock();
+    _pending[r->server].push_back(r);
+    _mutex.unlock();
+    wakeup();
+}
 
-            //struct curl_slist *header = NULL;
-            //header = curl_slist_append(header, "Content-Type: application/octet-stream");
-            // curl_easy_setopt(curl, CURLOPT_HTTPHEADER, header);
+std::shared_ptr<swarm_http_client::request> swarm_http_client::perform(std::shared_ptr<request> r) {
+    std::shared_ptr<request_group> g = std::make_shared<request_group>(1);
+    std::function<void(std::shared_ptr<request>)> f = r->done;
+    r->done = [g, f](std::shared_ptr<request> x) {
+        if (f) f(x);
+        g->done();
+    };
+    submit(r);
+    g->wait();
+    return r;
+}
 
-            curl_easy_setopt(_server_handles[server_index], CURLOPT_UPLOAD, 1L);
-            curl_easy_setopt(_server_handles[server_index], CURLOPT_POST, 1L);
-            curl_easy_setopt(_server_handles[server_index], CURLOPT_CUSTOMREQUEST, "POST");  // for whatever reason all requests are PUT if not set
+CURL *swarm_http_client::start_transfer(std::shared_ptr<request> r) {
+    CURL *h;
+    if (_idle_handles.empty()) {
+        h = curl_easy_init();
+    } else {
+        h = _idle_handles.back();
+        _idle_handles.pop_back();
+        curl_easy_reset(h);
+    }
+    if (!h) return nullptr;
 
-            // This will most likely work only as long as curl_easy_perform is synchronous, otherwise &is might become invalid
-            curl_easy_setopt(_server_handles[server_index], CURLOPT_READDATA, &is);
-            curl_easy_setopt(_server_handles[server_index], CURLOPT_READFUNCTION, &post_file_read_callback);
+    std::shared_ptr<transfer> t = std::make_shared<transfer>();
+    t->req = r;
+    t->handle = h;
+    r->response.clear();
 
-            curl_easy_setopt(_server_handles[server_index], CURLOPT_INFILESIZE_LARGE, (curl_off_t)filesystem::file_size(path));
+    curl_easy_setopt(h, CURLOPT_URL, r->url.c_str());
+    curl_easy_setopt(h, CURLOPT_TCP_KEEPALIVE, 1L);
+    curl_easy_setopt(h, CURLOPT_NOSIGNAL, 1L);
+    curl_easy_setopt(h, CURLOPT_CONNECTTIMEOUT_MS, 10000L);
+    if (r->timeout_ms > 0) curl_easy_setopt(h, CURLOPT_TIMEOUT_MS, r->timeout_ms);
+    curl_easy_setopt(h, CURLOPT_VERBOSE, config::instance()->get_swarm_curl_verbose() ? 1L : 0L);
+    curl_easy_setopt(h, CURLOPT_WRITEFUNCTION, &swarm_http_client::write_callback);
+    curl_easy_setopt(h, CURLOPT_WRITEDATA, t.get());
 
-            curl_easy_setopt(_server_handles[server_index], CURLOPT_VERBOSE, config::instance()->get_swarm_curl_verbose() ? 1L : 0L);
+    t->headers = curl_slist_append(t->headers, "Expect:");  // avoid waiting for 100-Continue
+    for (uint16_t i = 0; i < r->headers.size(); ++i) {
+        t->headers = curl_slist_append(t->headers, r->headers[i].c_str());
+    }
+    curl_easy_setopt(h, CURLOPT_HTTPHEADER, t->headers);
 
-            CURLcode res = curl_easy_perform(_server_handles[server_index]);
-            if (res != CURLE_OK) {
-                if (is.is_open()) is.close();
-                throw std::string("ERROR in gdalcubes_swarm::post_file(): uploading '" + path + "' to '" + _server_uris[server_index] + "' failed");
+    if (r->method == "HEAD") {
+        curl_easy_setopt(h, CURLOPT_NOBODY, 1L);
+    } else if (r->method == "POST") {
+        if (!r->upload_file.empty()) {
+            t->upload = std::make_shared<std::ifstream>(r->upload_file, std::ifstream::in | std::ifstream::binary);
+            if (!t->upload->is_open()) {
+                GCBS_ERROR("Cannot open file '" + r->upload_file + "'");
+                if (t->headers) curl_slist_free_all(t->headers);
+                _idle_handles.push_back(h);
+                return nullptr;
+            }
+            curl_easy_setopt(h, CURLOPT_UPLOAD, 1L);
+            curl_easy_setopt(h, CURLOPT_POST, 1L);
+            curl_easy_setopt(h, CURLOPT_CUSTOMREQUEST, "POST");  // for whatever reason all requests are PUT if not set
+            if (r->upload_deflate) {
+                // size of the compressed body is unknown in advance
+                curl_easy_setopt(h, CURLOPT_READDATA, t.get());
+                curl_easy_setopt(h, CURLOPT_READFUNCTION, &swarm_http_client::deflate_read_callback);
+                t->headers = curl_slist_append(t->headers, "Transfer-Encoding: chunked");
+                curl_easy_setopt(h, CURLOPT_HTTPHEADER, t->headers);
+            } else {
+                curl_easy_setopt(h, CURLOPT_READDATA, t->upload.get());
+                curl_easy_setopt(h, CURLOPT_READFUNCTION, &post_file_read_callback);
+                curl_easy_setopt(h, CURLOPT_INFILESIZE_LARGE, (curl_off_t)filesystem::file_size(r->upload_file));
             }
-            if (is.is_open()) is.close();
         } else {
-            throw std::string("ERROR in gdalcubes_swarm::post_file(): HEAD /file?name='" + path + "' to '" + _server_uris[server_index] + "' returned HTTP code " + std::to_string(response_code));
+            curl_easy_setopt(h, CURLOPT_POST, 1L);
+            curl_easy_setopt(h, CURLOPT_POSTFIELDS, r->body.c_str());
+            curl_easy_setopt(h, CURLOPT_POSTFIELDSIZE_LARGE, (curl_off_t)r->body.size());
         }
+    } else {
+        curl_easy_setopt(h, CURLOPT_HTTPGET, 1L);
+    }
+
+    if (curl_multi_add_handle(_multi, h) != CURLM_OK) {
+        if (t->headers) curl_slist_free_all(t->headers);
+        _idle_handles.push_back(h);
+        return nullptr;
     }
+    _running[h] = t;
+    return h;
+}
+
+void swarm_http_client::loop() {
+    while (1) {
+        // start queued requests, considering the maximum number of concurrent requests per server
+        std::vector<std::shared_ptr<request>> to_start;
+        _mutex.lock();
+        if (_stop) {
+            _mutex.unlock();
+            break;
+        }
+        for (uint16_t is = 0; is < _pending.size(); ++is) {
+            while (_running_count[is] < _max_requests_per_server && !_pending[is].empty()) {
+                to_start.push_back(_pending[is].front());
+                _pending[is].pop_front();
+                _running_count[is]++;
+            }
+        }
+        _mutex.unlock();
+
+        for (uint32_t i = 0; i < to_start.size(); ++i) {
+            if (!start_transfer(to_start[i])) {
+                to_start[i]->result = CURLE_FAILED_INIT;
+                _mutex.lock();
+                _running_count[to_start[i]->server]--;
+                _mutex.unlock();
+                if (to_start[i]->done) to_start[i]->done(to_start[i]);
+            }
+        }
+
+        int still_running = 0;
+        curl_multi_perform(_multi, &still_running);
+
+        // collect finished transfers
+        int nmsg = 0;
+        CURLMsg *msg;
+        while ((msg = curl_multi_info_read(_multi, &nmsg))) {
+            if (msg->msg != CURLMSG_DONE) continue;
+            CURL *h = msg->easy_handle;
+            CURLcode res = msg->data.result;
+            std::shared_ptr<transfer> t = _running[h];
+            _running.erase(h);
+            curl_multi_remove_handle(_multi, h);
+
+            t->req->result = res;
+            curl_easy_getinfo(h, CURLINFO_RESPONSE_CODE, &(t->req->status));
+            curl_easy_getinfo(h, CURLINFO_TOTAL_TIME, &(t->req->seconds));
+            // downloads long-poll until the chunk is available, the response starts when the server begins sending
+            double t_first_byte = 0;
+            curl_easy_getinfo(h, CURLINFO_STARTTRANSFER_TIME, &t_first_byte);
+            t->req->transfer_seconds = t->req->seconds - t_first_byte;
+            if (t->headers) curl_slist_free_all(t->headers);
+            _idle_handles.push_back(h);  // keep handle for reuse
+
+            _mutex.lock();
+            _running_count[t->req->server]--;
+            _mutex.unlock();
+
+            if (t->req->done) t->req->done(t->req);
+        }
+
+#if LIBCURL_VERSION_NUM >= 0x074400  // 7.68.0
+        curl_multi_poll(_multi, nullptr, 0, 1000, nullptr);  // returns early after curl_multi_wakeup()
+#else
+        curl_multi_wait(_multi, nullptr, 0, 10, nullptr);
+#endif
+    }
+}
+
+std::shared_ptr<gdalcubes_swarm> gdalcubes_swarm::from_txtfile(std::string path) {
+    std::ifstream file(path);
+    std::vector<std::string> urllist;
+    std::string line;
+    while (std::getline(file, line)) {
+        // TODO: check if valid URL
+        if (!line.empty()) urllist.push_back(line);
+    }
+
+    file.close();
+    return gdalcubes_swarm::from_urls(urllist);
 }
 
 void gdalcubes_swarm::push_execution_context(bool recursive) {
     std::string p = filesystem::get_working_dir();
+    if (_server_available.size() != _server_uris.size()) {
+        _server_available = std::vector<bool>(_server_uris.size(), true);
+    }
 
     std::vector<std::string> file_list;
     if (recursive) {
@@ -126,172 +360,730 @@ void gdalcubes_swarm::push_execution_context(bool recursive) {
         });
     }
 
-    // TODO: parallel upload
-    for (auto it_f = file_list.begin(); it_f != file_list.end(); ++it_f) {
+    // files are identified by their SHA-256 hash, servers that already have files with the same content
+    // (e.g. from previous runs or other file names) do not need to receive them again
+    std::vector<std::string> hashes;
+    json11::Json::array files;
+    for (uint32_t i = 0; i < file_list.size(); ++i) {
+        hashes.push_back(utils::sha256_file(file_list[i]));
+        files.push_back(json11::Json::object{{"name", file_list[i]}, {"hash", hashes[i]}, {"size", (double)filesystem::file_size(file_list[i])}});
+    }
+    std::string files_json = json11::Json(files).dump();
+
+    // servers without support for content-addressed uploads check each file with a HEAD request
+    std::function<void(uint16_t, std::string, std::shared_ptr<request_group>)> push_file = [this](uint16_t is, std::string path, std::shared_ptr<request_group> g) {
+        std::string url = _server_uris[is];
+
+        // Step 1: send a HEAD HTTP request to check whether the file already exists on the server
+        std::shared_ptr<swarm_http_client::request> r_head = std::make_shared<swarm_http_client::request>();
+        r_head->server = is;
+        r_head->method = "HEAD";
+        r_head->url = url + "/file" + "?name=" + path + "&size=" + std::to_string(filesystem::file_size(path));
+        r_head->done = [this, g, path, url, is](std::shared_ptr<swarm_http_client::request> r) {
+            if (r->result != CURLE_OK) {
+                g->done("HEAD /file?name='" + path + "' to '" + url + "' failed", is);
+            } else if (r->status == 200) {
+                g->done();  // already exists on server
+            } else if (r->status == 204 || r->status == 409) {
+                // Step 2: file does not exist or has different size, upload
+                std::shared_ptr<swarm_http_client::request> r_post = std::make_shared<swarm_http_client::request>();
+                r_post->server = is;
+                r_post->method = "POST";
+                r_post->url = url + "/file" + "?name=" + path;
+                r_post->upload_file = path;
+                r_post->done = [g, path, url, is](std::shared_ptr<swarm_http_client::request> r) {
+                    if (!r->ok()) {
+                        g->done("uploading '" + path + "' to '" + url + "' failed", is);
+                    } else {
+                        g->done();
+                    }
+                };
+                _http->submit(r_post);
+            } else {
+                g->done("HEAD /file?name='" + path + "' to '" + url + "' returned HTTP code " + std::to_string(r->status), is);
+            }
+        };
+        _http->submit(r_head);
+    };
+
+    // all servers are asked for missing files in parallel, missing files are uploaded compressed
+    std::vector<uint16_t> servers;
+    for (uint16_t is = 0; is < _server_uris.size(); ++is) {
+        if (_server_available[is]) servers.push_back(is);
+    }
+    std::shared_ptr<request_group> g = std::make_shared<request_group>(servers.size());
+    for (auto it_s = servers.begin(); it_s != servers.end(); ++it_s) {
+        uint16_t is = *it_s;
+        std::string url = _server_uris[is];
+        std::shared_ptr<swarm_http_client::request> r_missing = std::make_shared<swarm_http_client::request>();
+        r_missing->server = is;
+        r_missing->method = "POST";
+        r_missing->url = url + "/files/missing";
+        r_missing->headers.push_back("Content-Type: application/json");
+        r_missing->body = files_json;
+        r_missing->done = [this, g, is, url, file_list, hashes, push_file](std::shared_ptr<swarm_http_client::request> r) {
+            if (r->result != CURLE_OK) {
+                g->done("POST /files/missing to '" + url + "' failed", is);
+                return;
+            }
+            if (r->status != 200) {
+                GCBS_DEBUG("Server '" + url + "' does not support content-addressed uploads, checking files individually");
+                g->add(file_list.size());
+                for (uint32_t i = 0; i < file_list.size(); ++i) {
+                    push_file(is, file_list[i], g);
+                }
+                g->done();
+                return;
+            }
+            std::string err;
+            json11::Json missing = json11::Json::parse(std::string(r->response.begin(), r->response.end()), err);
+            if (!err.empty() || !missing.is_array()) {
+                g->done("POST /files/missing to '" + url + "' returned invalid JSON", is);
+                return;
+            }
+            std::set<std::string> missing_hashes;
+            for (uint32_t i = 0; i < missing.array_items().size(); ++i) {
+                missing_hashes.insert(missing[i].string_value());
+            }
+            for (uint32_t i = 0; i < file_list.size(); ++i) {
+                if (missing_hashes.count(hashes[i]) == 0) continue;
+                std::string path = file_list[i];
+                std::shared_ptr<swarm_http_client::request> r_post = std::make_shared<swarm_http_client::request>();
+                r_post->server = is;
+                r_post->method = "POST";
+                r_post->url = url + "/file" + "?name=" + path + "&hash=" + hashes[i] + "&encoding=deflate";
+                r_post->upload_file = path;
+                r_post->upload_deflate = true;
+                r_post->done = [g, path, url, is](std::shared_ptr<swarm_http_client::request> r) {
+                    if (!r->ok()) {
+                        g->done("uploading '" + path + "' to '" + url + "' failed", is);
+                    } else {
+                        g->done();
+                    }
+                };
+                g->add(1);
+                _http->submit(r_post);
+            }
+            g->done();
+        };
+        _http->submit(r_missing);
+    }
+    g->wait();
+
+    // servers without complete execution context are not used
+    for (uint32_t i = 0; i < g->errors.size(); ++i) {
+        GCBS_WARN(g->errors[i]);
+    }
+    for (auto it = g->failed_servers.begin(); it != g->failed_servers.end(); ++it) {
+        GCBS_WARN("Server '" + _server_uris[*it] + "' will be ignored");
+        _server_available[*it] = false;
+    }
+    if (std::find(_server_available.begin(), _server_available.end(), true) == _server_available.end()) {
+        throw std::string("ERROR in gdalcubes_swarm::push_execution_context(): no server available");
+    }
+}
+
+void gdalcubes_swarm::push_cube(std::shared_ptr<cube> c) {
+    _cube = c;  // Does this require a mutex?
+    std::string json = c->make_constructible_json().dump();
+    if (_server_available.size() != _server_uris.size()) {
+        _server_available = std::vector<bool>(_server_uris.size(), true);
+    }
+
+    // create cube on all available servers in parallel
+    std::vector<std::shared_ptr<swarm_http_client::request>> requests(_server_uris.size(), nullptr);
+    for (uint16_t is = 0; is < _server_uris.size(); ++is) {
+        if (!_server_available[is]) continue;
+        std::shared_ptr<swarm_http_client::request> r = std::make_shared<swarm_http_client::request>();
+        r->server = is;
+        r->method = "POST";
+        r->url = _server_uris[is] + "/cube";
+        r->headers.push_back("Content-Type: application/json");
+        r->body = json;
+        requests[is] = r;
+    }
+    std::shared_ptr<request_group> g = std::make_shared<request_group>(std::count(_server_available.begin(), _server_available.end(), true));
+    for (uint16_t is = 0; is < requests.size(); ++is) {
+        if (!requests[is]) continue;
+        requests[is]->done = [g](std::shared_ptr<swarm_http_client::request> r) { g->done(); };
+        _http->submit(requests[is]);
+    }
+    g->wait();
+
+    _cube_ids = std::vector<uint32_t>(_server_uris.size(), 0);
+    for (uint16_t is = 0; is < requests.size(); ++is) {
+        if (!requests[is]) continue;
+        if (!requests[is]->ok()) {
+            GCBS_WARN("POST /cube to '" + _server_uris[is] + "' failed; server will be ignored");
+            _server_available[is] = false;
+            continue;
+        }
+        std::string response_body(requests[is]->response.begin(), requests[is]->response.end());
+        _cube_ids[is] = std::stoi(response_body);
+    }
+    if (std::find(_server_available.begin(), _server_available.end(), true) == _server_available.end()) {
+        throw std::string("ERROR in gdalcubes_swarm::push_cube(): no server available");
+    }
+
+    // check which servers support batch requests, older servers return 404
+    _server_batch = std::vector<bool>(_server_uris.size(), false);
+    if (_batch_size > 1) {
+        std::vector<std::shared_ptr<swarm_http_client::request>> probes(_server_uris.size(), nullptr);
         for (uint16_t is = 0; is < _server_uris.size(); ++is) {
-            post_file(*it_f, is);
+            if (!_server_available[is]) continue;
+            probes[is] = std::make_shared<swarm_http_client::request>();
+            probes[is]->server = is;
+            probes[is]->method = "GET";
+            probes[is]->url = _server_uris[is] + "/cube/" + std::to_string(_cube_ids[is]) + "/status?chunks=";
+        }
+        std::shared_ptr<request_group> gp = std::make_shared<request_group>(std::count(_server_available.begin(), _server_available.end(), true));
+        for (uint16_t is = 0; is < probes.size(); ++is) {
+            if (!probes[is]) continue;
+            probes[is]->done = [gp](std::shared_ptr<swarm_http_client::request> r) { gp->done(); };
+            _http->submit(probes[is]);
+        }
+        gp->wait();
+        for (uint16_t is = 0; is < probes.size(); ++is) {
+            _server_batch[is] = probes[is] && probes[is]->ok();
         }
     }
 }
 
-size_t post_cube_read_callback(char *buffer, size_t size, size_t nitems, void *userdata) {
-    std::istringstream *is = (std::istringstream *)userdata;
-    is->readsome(buffer, size * nitems);  // or use readsome() ?
-    return is->gcount();
+std::shared_ptr<swarm_http_client::request> gdalcubes_swarm::make_start_request(uint32_t chunk_id, uint16_t server_index) {
+    std::shared_ptr<swarm_http_client::request> r = std::make_shared<swarm_http_client::request>();
+    r->server = server_index;
+    r->method = "POST";
+    r->url = _server_uris[server_index] + "/cube/" + std::to_string(_cube_ids[server_index]) + "/" + std::to_string(chunk_id) + "/start";
+    return r;
 }
 
-size_t post_cube_write_callback(char *buffer, size_t size, size_t nitems, void *userdata) {
-    std::vector<char> *x = (std::vector<char> *)userdata;
-    x->insert(x->end(), buffer, buffer + (size * nitems));
-    return size * nitems;
+std::shared_ptr<swarm_http_client::request> gdalcubes_swarm::make_download_request(uint32_t chunk_id, uint16_t server_index) {
+    std::shared_ptr<swarm_http_client::request> r = std::make_shared<swarm_http_client::request>();
+    r->server = server_index;
+    r->method = "GET";
+    r->url = _server_uris[server_index] + "/cube/" + std::to_string(_cube_ids[server_index]) + "/" + std::to_string(chunk_id) + "/download";
+    if (_chunk_encoding != chunk_codec::RAW) {
+        r->url += "?encoding=" + chunk_codec::encoding_string(_chunk_encoding);
+    }
+    r->timeout_ms = (long)(_download_timeout_seconds * 1000);
+    return r;
 }
 
-uint32_t gdalcubes_swarm::post_cube(std::string json, uint16_t server_index) {
-    std::istringstream is(json);
-    if (_server_handles[server_index]) {
-        curl_easy_reset(_server_handles[server_index]);
-        curl_easy_setopt(_server_handles[server_index], CURLOPT_URL, (_server_uris[server_index] + "/cube").c_str());
+std::shared_ptr<chunk_data> gdalcubes_swarm::decode_download(std::shared_ptr<swarm_http_client::request> r) {
+    if (r->result != CURLE_OK) {
+        throw std::string("ERROR in gdalcubes_swarm::decode_download(): GET /cube/{cube_id}/{chunk_id}/download to '" + _server_uris[r->server] + "' failed");
+    }
+    if (r->status != 200) {
+        throw std::string("ERROR in gdalcubes_swarm::decode_download(): GET /cube/{cube_id}/{chunk_id}/download to '" + _server_uris[r->server] + "' returned HTTP code " + std::to_string(r->status));
+    }
 
-        // TODO: Disable Expect: 100-Continue header?
+    // construct chunk_data from (encoded) byte vector
+    std::shared_ptr<chunk_data> out = chunk_codec::decode((const unsigned char *)r->response.data(), r->response.size());
 
-        curl_easy_setopt(_server_handles[server_index], CURLOPT_UPLOAD, 1L);
-        curl_easy_setopt(_server_handles[server_index], CURLOPT_POST, 1L);
-        curl_easy_setopt(_server_handles[server_index], CURLOPT_CUSTOMREQUEST, "POST");  // for whatever reason all requests are PUT if not set
+    _mutex_transfer_stats.lock();
+    _transfer_stats.chunks++;
+    _transfer_stats.bytes_received += r->response.size();
+    _transfer_stats.bytes_decoded += out->total_size_bytes();
+    _transfer_stats.transfer_seconds += r->transfer_seconds;
+    _mutex_transfer_stats.unlock();
 
-        struct curl_slist *header = NULL;
-        header = curl_slist_append(header, "Content-Type: application/json");
-        header = curl_slist_append(header, "Expect:");
-        curl_easy_setopt(_server_handles[server_index], CURLOPT_HTTPHEADER, header);
+    return out;
+}
 
-        curl_easy_setopt(_server_handles[server_index], CURLOPT_READFUNCTION, &post_cube_read_callback);
+void gdalcubes_swarm::apply(std::shared_ptr<cube> c, std::function<void(chunkid_t, std::shared_ptr<chunk_data>, std::mutex &)> f) {
+    std::vector<chunkid_t> chunks(c->count_chunks());
+    for (uint32_t i = 0; i < chunks.size(); ++i) {
+        chunks[i] = i;
+    }
+    apply(c, chunks, f);
+}
 
-        // This will most likely work only as long as curl_easy_perform is synchronous, otherwise &is might become invalid
-        curl_easy_setopt(_server_handles[server_index], CURLOPT_READDATA, &is);
+/**
+ * Scheduling state of gdalcubes_swarm::apply(), shared by request callbacks of the event loop, the scheduling thread,
+ * and worker threads consuming downloaded chunks
+ */
+struct swarm_apply_state {
+    typedef std::chrono::steady_clock clock;
 
-        //curl_easy_setopt(_server_handles[server_index], CURLOPT_INFILESIZE, json.size() + 1);
+    /**
+     * State of a chunk without result
+     */
+    struct chunk_state {
+        chunk_state() : servers(), attempts(0), queued(true) {}
+        std::map<uint16_t, clock::time_point> servers;  // servers currently computing the chunk and dispatch time
+        uint16_t attempts;                              // number of failed attempts
+        bool queued;                                    // waiting in pending or delayed queue
+    };
 
-        curl_easy_setopt(_server_handles[server_index], CURLOPT_WRITEFUNCTION, &post_cube_write_callback);
+    swarm_apply_state(const std::vector<chunkid_t> &chunks, const std::vector<bool> &available) : pending(chunks.begin(), chunks.end()),
+                                                                                                   delayed(),
+                                                                                                   active(),
+                                                                                                   outstanding(available.size(), 0),
+                                                                                                   blacklisted(available.size(), false),
+                                                                                                   consecutive_errors(available.size(), 0),
+                                                                                                   health_check_running(available.size(), false),
+                                                                                                   last_contact(available.size(), clock::now()),
+                                                                                                   stats(available.size(), swarm_server_stats()),
+                                                                                                   results(),
+                                                                                                   remaining(chunks.size()),
+                                                                                                   ncompleted(0),
+                                                                                                   sum_chunk_seconds(0),
+                                                                                                   finished(chunks.empty()),
+                                                                                                   m(),
+                                                                                                   cv() {
+        for (uint32_t i = 0; i < chunks.size(); ++i) {
+            active[chunks[i]] = chunk_state();
+        }
+        for (uint16_t is = 0; is < available.size(); ++is) {
+            blacklisted[is] = !available[is];
+        }
+    }
 
-        // This will most likely work only as long as curl_easy_perform is synchronous, otherwise &response_body_bytes might become invalid
-        std::vector<char> response_body_bytes;
-        curl_easy_setopt(_server_handles[server_index], CURLOPT_WRITEDATA, &response_body_bytes);
+    /**
+     * Find a running chunk for a speculative copy on the given server, i.e. the chunk with the longest running time
+     * that exceeds factor times the average chunk duration, is not running on the server already, and has no other copy yet.
+     * Must be called while holding m.
+     */
+    bool find_speculative(uint16_t server, double factor, chunkid_t &id) {
+        if (factor <= 0 || ncompleted == 0) return false;
+        double threshold = factor * sum_chunk_seconds / ncompleted;
+        clock::time_point now = clock::now();
+        double max_elapsed = 0;
+        bool found = false;
+        for (auto it = active.begin(); it != active.end(); ++it) {
+            if (it->second.servers.size() != 1 || it->second.servers.count(server) > 0) continue;
+            double elapsed = std::chrono::duration<double>(now - it->second.servers.begin()->second).count();
+            if (elapsed > threshold && elapsed > max_elapsed) {
+                max_elapsed = elapsed;
+                id = it->first;
+                found = true;
+            }
+        }
+        return found;
+    }
 
-        curl_easy_setopt(_server_handles[server_index], CURLOPT_VERBOSE, config::instance()->get_swarm_curl_verbose() ? 1L : 0L);
+    /**
+     * Retry a chunk after a failed attempt with exponential backoff, or pass it to worker threads as failed if the maximum
+     * number of retries has been reached. Must be called while holding m.
+     */
+    void retry(chunkid_t id, std::shared_ptr<swarm_http_client::request> r, uint16_t max_retries, double backoff_seconds) {
+        auto it = active.find(id);
+        if (it == active.end() || it->second.queued || !it->second.servers.empty()) return;
+        it->second.attempts++;
+        if (it->second.attempts > max_retries) {
+            results.push_back(std::make_pair(id, r));
+            active.erase(it);
+            return;
+        }
+        double wait = std::min(60.0, backoff_seconds * (1 << std::min(16, it->second.attempts - 1)));
+        delayed.insert(std::make_pair(clock::now() + std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(wait)), id));
+        it->second.queued = true;
+    }
 
-        CURLcode res = curl_easy_perform(_server_handles[server_index]);
-        if (res != CURLE_OK) {
-            throw std::string("ERROR in gdalcubes_swarm::post_cube(): POST /cube to '" + _server_uris[server_index] + "' failed");
+    /**
+     * Stop sending requests to a server and requeue its chunks. If no servers are left, all chunks without result fail.
+     * Must be called while holding m.
+     */
+    void blacklist(uint16_t server) {
+        if (blacklisted[server]) return;
+        blacklisted[server] = true;
+        for (auto it = active.begin(); it != active.end(); ++it) {
+            if (it->second.servers.erase(server) > 0 && it->second.servers.empty() && !it->second.queued) {
+                pending.push_front(it->first);
+                it->second.queued = true;
+            }
+        }
+        if (std::find(blacklisted.begin(), blacklisted.end(), false) == blacklisted.end()) {
+            for (auto it = active.begin(); it != active.end(); ++it) {
+                results.push_back(std::make_pair(it->first, nullptr));
+            }
+            active.clear();
         }
-        std::string response_body(response_body_bytes.begin(), response_body_bytes.end());
-        return std::stoi(response_body);
-    } else {
-        throw std::string("ERROR in gdalcubes_swarm::post_cube(): no connection with given server index available");
     }
-}
 
-void gdalcubes_swarm::push_cube(std::shared_ptr<cube> c) {
-    _cube = c;  // Does this require a mutex?
-    std::string json = c->make_constructible_json().dump();
+    std::deque<chunkid_t> pending;                              // chunks ready to be dispatched, may contain chunks with result
+    std::multimap<clock::time_point, chunkid_t> delayed;        // chunks to be retried after a given time
+    std::map<chunkid_t, chunk_state> active;                    // chunks without result
+    std::vector<uint16_t> outstanding;                          // number of dispatched chunks per server
+    std::vector<bool> blacklisted;                              // servers not receiving further requests
+    std::vector<uint16_t> consecutive_errors;                   // failed requests per server since the last successful request
+    std::vector<bool> health_check_running;
+    std::vector<clock::time_point> last_contact;                // time of the last successful request per server
+    std::vector<swarm_server_stats> stats;
+    std::list<std::pair<chunkid_t, std::shared_ptr<swarm_http_client::request>>> results;
+    uint32_t remaining;  // chunks not yet consumed by worker threads
+    uint32_t ncompleted;
+    double sum_chunk_seconds;
+    bool finished;  // all chunks have a result, no further requests will be dispatched
+    std::mutex m;
+    std::condition_variable cv;
+};
 
-    _cube_ids.clear();
+void gdalcubes_swarm::schedule(std::shared_ptr<swarm_apply_state> state) {
+    std::map<uint16_t, std::vector<chunkid_t>> to_start;
+    state->m.lock();
+    if (state->finished) {
+        state->m.unlock();
+        return;
+    }
 
-    // TODO: parallelize requests
-    for (uint16_t is = 0; is < _server_uris.size(); ++is) {
-        _cube_ids.push_back(post_cube(json, is));
+    // move chunks whose backoff has expired to the pending queue
+    swarm_apply_state::clock::time_point now = swarm_apply_state::clock::now();
+    while (!state->delayed.empty() && state->delayed.begin()->first <= now) {
+        state->pending.push_front(state->delayed.begin()->second);
+        state->delayed.erase(state->delayed.begin());
     }
-}
 
-void gdalcubes_swarm::post_start(uint32_t chunk_id, uint16_t server_index) {
-    if (_server_handles[server_index]) {
-        // TODO: URLencode?
-        curl_easy_reset(_server_handles[server_index]);
-        curl_easy_setopt(_server_handles[server_index], CURLOPT_URL, (_server_uris[server_index] + "/cube/" + std::to_string(_cube_ids[server_index]) + "/" + std::to_string(chunk_id) + "/start").c_str());
-        curl_easy_setopt(_server_handles[server_index], CURLOPT_POST, 1L);
-        curl_easy_setopt(_server_handles[server_index], CURLOPT_CUSTOMREQUEST, "POST");
-        curl_easy_setopt(_server_handles[server_index], CURLOPT_VERBOSE, config::instance()->get_swarm_curl_verbose() ? 1L : 0L);
+    for (uint16_t is = 0; is < state->outstanding.size(); ++is) {
+        if (state->blacklisted[is]) continue;
+        bool batch = _batch_size > 1 && _server_batch.size() > is && _server_batch[is];
+        uint32_t limit = batch ? (uint32_t)_chunks_per_server * _batch_size : _chunks_per_server;
 
-        CURLcode res = curl_easy_perform(_server_handles[server_index]);
-        if (res != CURLE_OK) {
-            throw std::string("ERROR in gdalcubes_swarm::post_start(): POST /cube/{cube_id}/{chunk_id}/start to '" + _server_uris[server_index] + "' failed");
+        // servers supporting batches receive full batches unless they are idle or only few chunks are left
+        if (batch && state->outstanding[is] > 0 && limit - state->outstanding[is] < _batch_size && state->pending.size() >= _batch_size) {
+            continue;
+        }
+        while (state->outstanding[is] < limit) {
+            chunkid_t id;
+            if (!state->pending.empty()) {
+                id = state->pending.front();
+                state->pending.pop_front();
+                auto it = state->active.find(id);
+                if (it == state->active.end() || !it->second.queued) continue;  // has been computed in the meantime
+                it->second.queued = false;
+            } else if (state->find_speculative(is, _speculation_factor, id)) {
+                state->stats[is].speculative++;
+                GCBS_DEBUG("Speculatively dispatching chunk " + std::to_string(id) + " to '" + _server_uris[is] + "'");
+            } else {
+                break;
+            }
+            state->active[id].servers[is] = now;
+            state->outstanding[is]++;
+            to_start[is].push_back(id);
+        }
+    }
+    state->m.unlock();
+
+    for (auto it = to_start.begin(); it != to_start.end(); ++it) {
+        uint16_t is = it->first;
+        const std::vector<chunkid_t> &ids = it->second;
+        if (ids.size() == 1 || _server_batch.size() <= is || !_server_batch[is]) {
+            for (uint32_t i = 0; i < ids.size(); ++i) {
+                dispatch(state, ids[i], is);
+            }
+        } else {
+            for (uint32_t i = 0; i < ids.size(); i += _batch_size) {
+                dispatch_batch(state, std::vector<chunkid_t>(ids.begin() + i, ids.begin() + std::min((uint32_t)ids.size(), i + _batch_size)), is);
+            }
         }
-        return;
     }
 }
 
-size_t get_download_callback(char *buffer, size_t size, size_t nitems, void *userdata) {
-    std::vector<char> *x = (std::vector<char> *)userdata;
-    x->insert(x->end(), buffer, buffer + (size * nitems));
-    return size * nitems;
+void gdalcubes_swarm::dispatch(std::shared_ptr<swarm_apply_state> state, chunkid_t id, uint16_t server_index) {
+    uint16_t is = server_index;
+    std::shared_ptr<swarm_http_client::request> r_start = make_start_request(id, is);
+    r_start->done = [this, state, id, is](std::shared_ptr<swarm_http_client::request> r) {
+        if (!r->ok()) {
+            complete(state, id, is, r);
+            return;
+        }
+        // skip the download if another server has been faster or the chunk has been requeued
+        state->m.lock();
+        auto it = state->active.find(id);
+        bool skip = state->finished || it == state->active.end() || it->second.servers.count(is) == 0;
+        state->m.unlock();
+        if (skip) {
+            complete(state, id, is, nullptr);
+            return;
+        }
+        std::shared_ptr<swarm_http_client::request> r_download = make_download_request(id, is);
+        r_download->done = [this, state, id, is](std::shared_ptr<swarm_http_client::request> r) {
+            complete(state, id, is, r);
+        };
+        _http->submit(r_download);
+    };
+    _http->submit(r_start);
 }
 
-std::shared_ptr<chunk_data> gdalcubes_swarm::get_download(uint32_t chunk_id, uint16_t server_index) {
-    if (_server_handles[server_index]) {
-        // TODO: URLencode?
-        curl_easy_reset(_server_handles[server_index]);
-        curl_easy_setopt(_server_handles[server_index], CURLOPT_URL, (_server_uris[server_index] + "/cube/" + std::to_string(_cube_ids[server_index]) + "/" + std::to_string(chunk_id) + "/download").c_str());
-        curl_easy_setopt(_server_handles[server_index], CURLOPT_HTTPGET, 1L);
-        curl_easy_setopt(_server_handles[server_index], CURLOPT_CUSTOMREQUEST, "GET");
-        curl_easy_setopt(_server_handles[server_index], CURLOPT_WRITEFUNCTION, &get_download_callback);
+void gdalcubes_swarm::dispatch_batch(std::shared_ptr<swarm_apply_state> state, std::vector<chunkid_t> ids, uint16_t server_index) {
+    uint16_t is = server_index;
+    std::string id_list;
+    for (uint32_t i = 0; i < ids.size(); ++i) {
+        if (i > 0) id_list += ",";
+        id_list += std::to_string(ids[i]);
+    }
 
-        // This will most likely work only as long as curl_easy_perform is synchronous, otherwise &response_body_bytes might become invalid
-        std::vector<char> response_body_bytes;
-        curl_easy_setopt(_server_handles[server_index], CURLOPT_WRITEDATA, &response_body_bytes);
+    std::shared_ptr<swarm_http_client::request> r_start = std::make_shared<swarm_http_client::request>();
+    r_start->server = is;
+    r_start->method = "POST";
+    r_start->url = _server_uris[is] + "/cube/" + std::to_string(_cube_ids[is]) + "/start";
+    r_start->headers.push_back("Content-Type: text/plain");
+    r_start->body = id_list;
+    r_start->done = [this, state, ids, is](std::shared_ptr<swarm_http_client::request> r) {
+        if (!r->ok()) {
+            for (uint32_t i = 0; i < ids.size(); ++i) {
+                complete(state, ids[i], is, r);
+            }
+            return;
+        }
 
-        curl_easy_setopt(_server_handles[server_index], CURLOPT_VERBOSE, config::instance()->get_swarm_curl_verbose() ? 1L : 0L);
+        // skip downloads of chunks that have been computed by other servers or requeued in the meantime
+        std::vector<chunkid_t> needed;
+        std::vector<chunkid_t> skipped;
+        state->m.lock();
+        for (uint32_t i = 0; i < ids.size(); ++i) {
+            auto it = state->active.find(ids[i]);
+            if (state->finished || it == state->active.end() || it->second.servers.count(is) == 0) {
+                skipped.push_back(ids[i]);
+            } else {
+                needed.push_back(ids[i]);
+            }
+        }
+        state->m.unlock();
+        for (uint32_t i = 0; i < skipped.size(); ++i) {
+            complete(state, skipped[i], is, nullptr);
+        }
+        if (needed.empty()) return;
 
-        CURLcode res = curl_easy_perform(_server_handles[server_index]);
-        if (res != CURLE_OK) {
-            throw std::string("ERROR in gdalcubes_swarm::get_download(): GET /cube/{cube_id}/{chunk_id}/download to '" + _server_uris[server_index] + "' failed");
+        std::string id_list;
+        for (uint32_t i = 0; i < needed.size(); ++i) {
+            if (i > 0) id_list += ",";
+            id_list += std::to_string(needed[i]);
+        }
+        std::shared_ptr<swarm_http_client::request> r_download = std::make_shared<swarm_http_client::request>();
+        r_download->server = is;
+        r_download->method = "GET";
+        r_download->url = _server_uris[is] + "/cube/" + std::to_string(_cube_ids[is]) + "/download?chunks=" + id_list;
+        if (_chunk_encoding != chunk_codec::RAW) {
+            r_download->url += "&encoding=" + chunk_codec::encoding_string(_chunk_encoding);
         }
+        r_download->timeout_ms = (long)(_download_timeout_seconds * 1000);
+
+        // chunks are passed on as soon as their frame has been received
+        std::shared_ptr<std::set<chunkid_t>> delivered = std::make_shared<std::set<chunkid_t>>();
+        std::set<chunkid_t> expected(needed.begin(), needed.end());
+        swarm_apply_state::clock::time_point t0 = swarm_apply_state::clock::now();
+        // arrival of the first byte of the current frame, frames are sent as soon as a chunk has been computed
+        std::shared_ptr<swarm_apply_state::clock::time_point> t_frame = std::make_shared<swarm_apply_state::clock::time_point>(t0);
+        std::shared_ptr<chunk_frame_reader> reader = std::make_shared<chunk_frame_reader>(
+            [this, state, is, delivered, expected, t0, t_frame](uint32_t id, uint32_t status, const unsigned char *content, std::size_t n) {
+                if (expected.count(id) == 0 || delivered->count(id) > 0) return;
+                delivered->insert(id);
+                std::shared_ptr<swarm_http_client::request> rc = std::make_shared<swarm_http_client::request>();
+                rc->server = is;
+                rc->method = "GET";
+                rc->url = _server_uris[is] + "/cube/" + std::to_string(_cube_ids[is]) + "/" + std::to_string(id) + "/download";
+                rc->status = (status == chunk_codec::FRAME_OK) ? 200 : 500;
+                rc->response.assign(content, content + n);
+                swarm_apply_state::clock::time_point now = swarm_apply_state::clock::now();
+                rc->seconds = std::chrono::duration<double>(now - t0).count();
+                rc->transfer_seconds = std::chrono::duration<double>(now - *t_frame).count();
+                *t_frame = now;  // the next frame may start within the same piece of data
+                complete(state, id, is, rc);
+            });
+        r_download->data = [reader, t_frame](const char *buf, std::size_t n) {
+            if (reader->complete()) *t_frame = swarm_apply_state::clock::now();
+            reader->feed((const unsigned char *)buf, n);
+        };
+        r_download->done = [this, state, needed, is, delivered](std::shared_ptr<swarm_http_client::request> r) {
+            // chunks missing in the response have failed
+            for (uint32_t i = 0; i < needed.size(); ++i) {
+                if (delivered->count(needed[i]) > 0) continue;
+                std::shared_ptr<swarm_http_client::request> rc = r;
+                if (r->ok()) {
+                    rc = std::make_shared<swarm_http_client::request>();
+                    rc->server = is;
+                    rc->method = "GET";
+                    rc->status = 500;
+                }
+                complete(state, needed[i], is, rc);
+            }
+        };
+        _http->submit(r_download);
+    };
+    _http->submit(r_start);
+}
 
-        // construct chunk_data from byte vector
-        std::shared_ptr<chunk_data> out = std::make_shared<chunk_data>();
-        std::array<uint32_t, 4> size = {((uint32_t *)response_body_bytes.data())[0], ((uint32_t *)response_body_bytes.data())[1], ((uint32_t *)response_body_bytes.data())[2], ((uint32_t *)response_body_bytes.data())[3]};
-        out->size(size);
-        if (size[0] * size[1] * size[2] * size[3] > 0) {
-            out->buf(std::malloc(out->size()[0] * out->size()[1] * out->size()[2] * out->size()[3] * sizeof(double)));
-            std::copy(response_body_bytes.begin() + sizeof(std::array<uint32_t, 4>), response_body_bytes.end(),
-                      (char *)out->buf());
+void gdalcubes_swarm::complete(std::shared_ptr<swarm_apply_state> state, chunkid_t id, uint16_t server_index, std::shared_ptr<swarm_http_client::request> r) {
+    bool check = false;
+    state->m.lock();
+    state->outstanding[server_index]--;
+    if (r && r->ok()) {
+        state->consecutive_errors[server_index] = 0;
+        state->last_contact[server_index] = swarm_apply_state::clock::now();
+    }
+    auto it = state->active.find(id);
+    if (it == state->active.end()) {
+        if (r && r->ok()) state->stats[server_index].wasted++;  // another server has been faster
+    } else if (r && r->ok()) {
+        // accept results even if the server has been blacklisted or the chunk has been requeued in the meantime
+        auto it_s = it->second.servers.find(server_index);
+        if (it_s != it->second.servers.end()) {
+            double seconds = std::chrono::duration<double>(swarm_apply_state::clock::now() - it_s->second).count();
+            state->stats[server_index].busy_seconds += seconds;
+            state->ncompleted++;
+            state->sum_chunk_seconds += seconds;
         }
+        state->stats[server_index].chunks++;
+        state->stats[server_index].bytes_received += r->response.size();
+        state->results.push_back(std::make_pair(id, r));
+        state->active.erase(it);
+    } else if (it->second.servers.erase(server_index) > 0 && r) {
+        state->stats[server_index].errors++;
+        state->consecutive_errors[server_index]++;
+        GCBS_DEBUG("Request for chunk " + std::to_string(id) + " to '" + _server_uris[server_index] + "' failed (attempt " + std::to_string(it->second.attempts + 1) + ", " +
+                   (r->result != CURLE_OK ? std::string(curl_easy_strerror(r->result)) : "HTTP code " + std::to_string(r->status)) + ")");
+        state->retry(id, r, _max_retries, _retry_backoff_seconds);
 
-        return out;
-    } else {
-        throw std::string("ERROR in gdalcubes_swarm::get_download(): no connection with given server index available");
+        // server might be down
+        if (state->consecutive_errors[server_index] >= 3 && !state->blacklisted[server_index] && !state->health_check_running[server_index]) {
+            state->health_check_running[server_index] = true;
+            check = true;
+        }
     }
+    if (state->active.empty()) {
+        state->finished = true;
+    }
+    state->cv.notify_all();
+    bool finished = state->finished;
+    state->m.unlock();
+
+    if (finished) return;
+    if (check) check_server(state, server_index);
+    schedule(state);
 }
 
-void gdalcubes_swarm::apply(std::shared_ptr<cube> c, std::function<void(chunkid_t, std::shared_ptr<chunk_data>, std::mutex &)> f) {
-    uint32_t nthreads = 1;
-    // try whether default chunk processor is multithread and read number of threads if successful
-    if (std::dynamic_pointer_cast<chunk_processor_multithread>(config::instance()->get_default_chunk_processor())) {
-        nthreads = std::dynamic_pointer_cast<chunk_processor_multithread>(config::instance()->get_default_chunk_processor())->get_threads();
-    }
+void gdalcubes_swarm::check_server(std::shared_ptr<swarm_apply_state> state, uint16_t server_index) {
+    std::shared_ptr<swarm_http_client::request> r_version = std::make_shared<swarm_http_client::request>();
+    r_version->server = server_index;
+    r_version->method = "GET";
+    r_version->url = _server_uris[server_index] + "/version";
+    r_version->timeout_ms = (long)(_health_check_timeout_seconds * 1000);
+    r_version->done = [this, state, server_index](std::shared_ptr<swarm_http_client::request> r) {
+        state->m.lock();
+        state->health_check_running[server_index] = false;
+        if (state->finished) {
+            state->m.unlock();
+            return;
+        }
+        if (r->ok()) {
+            state->consecutive_errors[server_index] = 0;
+            state->last_contact[server_index] = swarm_apply_state::clock::now();
+        } else {
+            GCBS_WARN("Health check of server '" + _server_uris[server_index] + "' failed; its chunks will be computed by other servers");
+            state->blacklist(server_index);
+            if (state->active.empty()) {
+                state->finished = true;
+            }
+            state->cv.notify_all();
+        }
+        bool finished = state->finished;
+        state->m.unlock();
+        if (!finished) schedule(state);
+    };
+    _http->submit(r_version);
+}
+
+void gdalcubes_swarm::apply(std::shared_ptr<cube> c, std::vector<chunkid_t> chunks, std::function<void(chunkid_t, std::shared_ptr<chunk_data>, std::mutex &)> f) {
+    timer t_apply;
+    _transfer_stats = swarm_transfer_stats();
+
+    // chunks are tracked by id, duplicates would never complete
+    std::set<chunkid_t> seen;
+    chunks.erase(std::remove_if(chunks.begin(), chunks.end(), [&seen](chunkid_t id) { return !seen.insert(id).second; }), chunks.end());
 
+    _server_available = std::vector<bool>(_server_uris.size(), true);
     push_execution_context(false);
     push_cube(c);
 
-    // TODO: what if servers fail?
-    std::map<uint16_t, std::vector<uint32_t>> chunk_distr;
-    for (uint32_t i = 0; i < c->count_chunks(); ++i) {
-        post_start(i, i % _server_uris.size());  // start computations on remote servers
-        chunk_distr[i % _server_uris.size()].push_back(i);
-    }
+    // Each server pulls new chunks as soon as one of its outstanding chunks has been downloaded. A start request is followed
+    // by a download request, which returns as soon as the chunk has been computed on the server.
+    std::shared_ptr<swarm_apply_state> state = std::make_shared<swarm_apply_state>(chunks, _server_available);
+    schedule(state);
+
+    // decode downloaded chunks and call f in parallel
     std::mutex mutex;
     std::vector<std::thread> workers;
-    for (uint16_t it = 0; it < nthreads; ++it) {
-        workers.push_back(std::thread([this, c, &chunk_distr, &f, it, &mutex](void) {
-            // One remote server is processed by a single thread for now, changing this will require to using the multi interface of curl
-            for (uint32_t iserver = it; iserver < _server_uris.size(); iserver += _server_uris.size()) {
-                for (uint32_t ichunk = 0; ichunk < chunk_distr[iserver].size(); ++ichunk) {
-                    std::shared_ptr<chunk_data> dat = get_download(chunk_distr[iserver][ichunk], iserver);
-                    f(chunk_distr[iserver][ichunk], dat, mutex);
+    for (uint16_t it = 0; it < std::max(uint16_t(1), _nthreads); ++it) {
+        workers.push_back(std::thread([this, state, &f, &mutex](void) {
+            while (1) {
+                std::unique_lock<std::mutex> lock(state->m);
+                state->cv.wait(lock, [state]() { return state->remaining == 0 || !state->results.empty(); });
+                if (state->results.empty()) {
+                    break;  // all chunks have been processed
+                }
+                chunkid_t id = state->results.front().first;
+                std::shared_ptr<swarm_http_client::request> r = state->results.front().second;
+                state->results.pop_front();
+                if (--state->remaining == 0) {
+                    state->cv.notify_all();
+                }
+                lock.unlock();
+
+                try {
+                    if (!r) {
+                        throw std::string("ERROR in gdalcubes_swarm::apply(): chunk " + std::to_string(id) + " could not be computed, no server available");
+                    }
+                    if (r->method == "POST") {
+                        throw std::string("ERROR in gdalcubes_swarm::apply(): POST /cube/{cube_id}/{chunk_id}/start to '" + _server_uris[r->server] + "' failed");
+                    }
+                    std::shared_ptr<chunk_data> dat = decode_download(r);
+                    f(id, dat, mutex);
+                } catch (std::string s) {
+                    GCBS_ERROR(s);
+                    continue;
+                } catch (...) {
+                    GCBS_ERROR("unexpected exception while processing chunk " + std::to_string(id));
+                    continue;
                 }
             }
         }));
     }
-    for (uint16_t it = 0; it < nthreads; ++it) {
+
+    // periodically retry delayed chunks, look for slow chunks that may be dispatched speculatively to idle servers,
+    // and check the health of servers that did not respond for a while
+    while (1) {
+        std::unique_lock<std::mutex> lock(state->m);
+        state->cv.wait_for(lock, std::chrono::milliseconds(250), [state]() { return state->finished; });
+        if (state->finished) break;
+        std::vector<uint16_t> check;
+        swarm_apply_state::clock::time_point now = swarm_apply_state::clock::now();
+        for (uint16_t is = 0; is < state->outstanding.size(); ++is) {
+            if (state->blacklisted[is] || state->health_check_running[is] || state->outstanding[is] == 0) continue;
+            if (std::chrono::duration<double>(now - state->last_contact[is]).count() > _health_check_interval_seconds) {
+                state->health_check_running[is] = true;
+                check.push_back(is);
+            }
+        }
+        lock.unlock();
+        for (uint16_t i = 0; i < check.size(); ++i) {
+            check_server(state, check[i]);
+        }
+        schedule(state);
+    }
+
+    for (uint16_t it = 0; it < workers.size(); ++it) {
         workers[it].join();
     }
-}
 
-}  // namespace gdalcubes
\ No newline at end of file
+    state->m.lock();
+    _server_stats = state->stats;
+    state->m.unlock();
+
+    _transfer_stats.wall_seconds = t_apply.time();
+    GCBS_INFO("Downloaded " + std::to_string(_transfer_stats.chunks) + " chunks (" +
+              std::to_string((double)_transfer_stats.bytes_received / (1024 * 1024)) + " MiB received, " +
+              std::to_string((double)_transfer_stats.bytes_decoded / (1024 * 1024)) + " MiB decoded) in " +
+              std::to_string(_transfer_stats.wall_seconds) + " s, effective throughput " +
+              std::to_string((double)_transfer_stats.bytes_decoded / (1024 * 1024) / _transfer_stats.wall_seconds) + " MiB/s");
+    for (uint16_t is = 0; is < _server_stats.size(); ++is) {
+        const swarm_server_stats &s = _server_stats[is];
+        GCBS_INFO("Server '" + _server_uris[is] + "': " + std::to_string(s.chunks) + " chunks (" +
+                  std::to_string(s.speculative) + " speculative, " + std::to_string(s.wasted) + " wasted, " +
+                  std::to_string(s.errors) + " errors), " +
+                  std::to_string(s.chunks / _transfer_stats.wall_seconds) + " chunks/s, " +
+                  std::to_string((double)s.bytes_received / (1024 * 1024)) + " MiB received" +
+                  (state->blacklisted[is] ? ", blacklisted" : ""));
+    }
+}
+}  // namespace gdalcubes
@@ -27,35 +27,155 @@
 
 #include <curl/curl.h>
 
+#include <condition_variable>
+#include <functional>
+#include <list>
+#include <map>
+#include <thread>
+
+#include "chunk_codec.h"
 #include "cube.h"
 
 namespace gdalcubes {
 
+/**
+ * @brief Asynchronous HTTP client based on the curl multi interface
+ *
+ * All requests are performed by a single event loop thread. Requests are queued per server and the number of
+ * concurrent requests per server is limited. Since all transfers share the connection cache of one multi handle,
+ * connections to the same server are kept alive and reused.
+ */
+class swarm_http_client {
+   public:
+    /**
+     * @brief HTTP request and its response
+     */
+    struct request {
+        request() : server(0), method("GET"), url(), headers(), body(), upload_file(), upload_deflate(false), timeout_ms(0), result(CURLE_OK), status(0), response(), seconds(0), transfer_seconds(0), data(), done() {}
+
+        uint16_t server;  // index of the server, used to limit concurrent requests per server
+        std::string method;  // GET, HEAD, or POST
+        std::string url;
+        std::vector<std::string> headers;
+        std::string body;         // request body, ignored if upload_file is not empty
+        std::string upload_file;  // path of a file to be streamed as request body
+        bool upload_deflate;      // compress upload_file block-wise on the fly, see utils::deflate_block()
+        long timeout_ms;          // maximum duration of the request, 0 for no limit
+
+        CURLcode result;  // CURLE_OK if the request has been performed, even if status is not 200
+        long status;      // HTTP status code
+        std::vector<char> response;
+        double seconds;           // total time of the request
+        double transfer_seconds;  // time from the first response byte to the end of the request
+
+        /**
+         * Optional callback executed by the event loop thread for each piece of a successful (HTTP status 200) response
+         * body as it arrives, the body is then not stored in response
+         */
+        std::function<void(const char *, std::size_t)> data;
+
+        /**
+         * Callback executed by the event loop thread after the request has finished, must not block
+         */
+        std::function<void(std::shared_ptr<request>)> done;
+
+        /**
+         * @return true if the request has been performed and the server returned HTTP status 200
+         */
+        inline bool ok() { return result == CURLE_OK && status == 200; }
+    };
+
+    swarm_http_client(uint16_t nservers, uint16_t max_requests_per_server = 8);
+    ~swarm_http_client();
+
+    /**
+     * @brief Queue a request, returns immediately
+     */
+    void submit(std::shared_ptr<request> r);
+
+    /**
+     * @brief Queue a request and wait until it has been finished
+     */
+    std::shared_ptr<request> perform(std::shared_ptr<request> r);
+
+    /**
+     * @brief Set the maximum number of concurrent requests per server
+     */
+    void set_max_requests_per_server(uint16_t n);
+
+   private:
+    struct transfer;
+
+    static size_t write_callback(char *buffer, size_t size, size_t nitems, void *userdata);
+    static size_t deflate_read_callback(char *buffer, size_t size, size_t nitems, void *userdata);
+
+    void loop();
+    void wakeup();
+    CURL *start_transfer(std::shared_ptr<request> r);
+
+    CURLM *_multi;
+    std::thread _thread;
+    std::mutex _mutex;
+    bool _stop;
+    uint16_t _max_requests_per_server;
+    std::vector<std::list<std::shared_ptr<request>>> _pending;
+    std::vector<uint16_t> _running_count;
+    std::map<CURL *, std::shared_ptr<transfer>> _running;
+    std::vector<CURL *> _idle_handles;
+};
+
+/**
+ * @brief Statistics of chunk downloads from gdalcubes_server instances
+ */
+struct swarm_transfer_stats {
+    uint32_t chunks;
+    uint64_t bytes_received;  // encoded bytes as received over the network
+    uint64_t bytes_decoded;   // size of decoded chunk buffers
+    double transfer_seconds;  // sum of download durations from the first response byte, excludes waiting for remote computations
+    double wall_seconds;      // real time of the last apply() call
+};
+
+/**
+ * @brief Per-server statistics of the last gdalcubes_swarm::apply() call
+ */
+struct swarm_server_stats {
+    uint32_t chunks;          // chunks delivered by the server and passed to the callback
+    uint32_t speculative;     // speculative copies of slow chunks dispatched to the server
+    uint32_t wasted;          // chunks delivered by the server after another server had been faster
+    uint32_t errors;          // failed requests
+    uint64_t bytes_received;  // encoded bytes as received over the network
+    double busy_seconds;      // sum of the durations of chunk requests, from start to end of download
+};
+
+struct swarm_apply_state;
+
 /**
  * @brief Chunk processor implementation for distributed processing by connecting to gdalcubes_server instances
  *
- * This class connects the several gdalcubes_server instances in order to distribute read_chunk() operations
+ * This class connects the several gdalcubes_server instances in order to distribute read_chunk() operations.
+ * Requests are sent asynchronously, with up to set_max_requests_per_server() concurrent requests to each server.
+ *
+ * Chunks are not assigned to servers in advance. Instead, each server is kept busy with set_chunks_per_server()
+ * outstanding chunks and receives the next chunk as soon as one of its chunks has been downloaded, such that faster servers
+ * process more chunks. When no chunks are left, idle servers speculatively compute copies of chunks that have been running
+ * considerably longer than the average chunk (see set_speculation_factor()); whichever copy arrives first is used.
+ * Servers supporting batch requests receive chunks in batches (see set_batch_size()), which are started with one
+ * request and streamed back in a single response.
+ * Failed chunks are retried with exponential backoff (see set_retry()) and servers failing health checks are blacklisted
+ * (see set_health_check()).
  *
  * @todo implement add / remove method for workers
  */
 class gdalcubes_swarm : public chunk_processor {
    public:
-    gdalcubes_swarm(std::vector<std::string> urls) : _cube(nullptr), _cube_ids(), _server_handles(), _server_uris(urls), _nthreads(1) {
-        for (uint16_t i = 0; i < _server_uris.size(); ++i)
-            _server_handles.push_back(curl_easy_init());
-    }
-
-    ~gdalcubes_swarm() {
-        for (uint16_t i = 0; i < _server_uris.size(); ++i)
-            curl_easy_cleanup(_server_handles[i]);
-    }
+    gdalcubes_swarm(std::vector<std::string> urls) : _cube(nullptr), _cube_ids(), _server_uris(urls), _http(new swarm_http_client(urls.size())), _nthreads(1), _chunks_per_server(2), _speculation_factor(2.0), _max_retries(3), _retry_backoff_seconds(0.5), _health_check_interval_seconds(10), _health_check_timeout_seconds(5), _download_timeout_seconds(3600), _batch_size(8), _server_available(), _server_batch(), _chunk_encoding(chunk_codec::NANMASK | chunk_codec::DEFLATE), _transfer_stats(), _server_stats(), _mutex_transfer_stats() {}
 
     inline static std::shared_ptr<gdalcubes_swarm> from_urls(std::vector<std::string> urls) { return std::make_shared<gdalcubes_swarm>(urls); }
 
     // Create from txt file where each line is a uri
     static std::shared_ptr<gdalcubes_swarm> from_txtfile(std::string path);
 
-    // upload execution context to all servers
+    // upload execution context to all servers, files already known to a server by their hash are not transferred
     void push_execution_context(bool recursive = false);
 
     // create cube on all servers
@@ -64,29 +184,160 @@ class gdalcubes_swarm : public chunk_processor {
     // Mimic cube::apply with distributed calls to cube::read_chunk()
     void apply(std::shared_ptr<cube> c, std::function<void(chunkid_t, std::shared_ptr<chunk_data>, std::mutex &)> f) override;
 
+    // Mimic cube::apply with distributed calls to cube::read_chunk() for a subset of chunks, duplicate ids are processed once
+    void apply(std::shared_ptr<cube> c, std::vector<chunkid_t> chunks, std::function<void(chunkid_t, std::shared_ptr<chunk_data>, std::mutex &)> f) override;
+
     /**
     * @copydoc chunk_processor::max_threads
     */
     uint32_t max_threads() override {
         return _nthreads;
     }
+
+    /**
+     * @brief Set the number of threads decoding downloaded chunks and calling the function passed to apply()
+     */
     inline void set_threads(uint16_t threads) { _nthreads = threads; }
 
+    /**
+     * @brief Set the maximum number of concurrent HTTP requests per server, defaults to 8
+     */
+    inline void set_max_requests_per_server(uint16_t n) { _http->set_max_requests_per_server(n); }
+
+    /**
+     * @brief Set the number of chunks each server is working on at the same time, defaults to 2
+     *
+     * Every outstanding chunk needs up to two concurrent HTTP requests, the value should hence not exceed half of
+     * the maximum number of requests per server.
+     */
+    inline void set_chunks_per_server(uint16_t n) { _chunks_per_server = std::max(uint16_t(1), n); }
+
+    /**
+     * @brief Set the factor by which the running time of a chunk must exceed the average chunk duration before a copy is dispatched to an idle server
+     *
+     * Values <= 0 disable speculative execution, defaults to 2.
+     */
+    inline void set_speculation_factor(double f) { _speculation_factor = f; }
+
+    /**
+     * @brief Set the maximum number of chunks started and downloaded with a single request
+     *
+     * Batches are only used for servers supporting batch requests. Each server then works on up to
+     * set_chunks_per_server() batches at the same time. A value of 1 disables batch requests, defaults to 8.
+     */
+    inline void set_batch_size(uint16_t n) { _batch_size = std::max(uint16_t(1), n); }
+
+    /**
+     * @brief Set how often failed chunks are retried
+     *
+     * Failed chunks are requeued and may be computed by any healthy server. The n-th retry is delayed by
+     * backoff_seconds * 2^(n-1) seconds (at most 60 seconds).
+     * @param max_retries maximum number of retries per chunk, defaults to 3
+     * @param backoff_seconds initial delay, defaults to 0.5 seconds
+     */
+    inline void set_retry(uint16_t max_retries, double backoff_seconds = 0.5) {
+        _max_retries = max_retries;
+        _retry_backoff_seconds = backoff_seconds;
+    }
+
+    /**
+     * @brief Set parameters of server health checks
+     *
+     * Servers are checked with GET /version after three consecutive failed requests, or if they have outstanding chunks
+     * but did not successfully respond within the given interval. Servers failing the health check are blacklisted
+     * for the remaining apply() call and their chunks are computed by other servers.
+     * @param interval_seconds defaults to 10 seconds
+     * @param timeout_seconds defaults to 5 seconds
+     */
+    inline void set_health_check(double interval_seconds, double timeout_seconds = 5) {
+        _health_check_interval_seconds = interval_seconds;
+        _health_check_timeout_seconds = timeout_seconds;
+    }
+
+    /**
+     * @brief Set the maximum duration of download requests
+     *
+     * Downloads return as soon as the chunks have been computed, the timeout must hence include the computation time.
+     * Chunks of timed out downloads are retried (see set_retry()), servers continue computations of chunks requested before.
+     * @param timeout_seconds defaults to 3600 seconds, 0 for no limit
+     */
+    inline void set_download_timeout(double timeout_seconds) { _download_timeout_seconds = timeout_seconds; }
+
+    /**
+     * @brief Set the encoding of downloaded chunks
+     *
+     * Servers without encoding support ignore this setting and send raw chunk data.
+     * @param encoding comma-separated list of encodings (see chunk_codec::parse_encoding()), defaults to "nanmask,deflate"
+     */
+    inline void set_chunk_encoding(std::string encoding) { _chunk_encoding = chunk_codec::parse_encoding(encoding); }
+
+    /**
+     * @brief Get statistics of chunk downloads during the last call of apply()
+     */
+    inline swarm_transfer_stats transfer_stats() { return _transfer_stats; }
+
+    /**
+     * @brief Get per-server statistics of the last call of apply(), in the order of server URLs
+     */
+    inline std::vector<swarm_server_stats> server_stats() { return _server_stats; }
+
    private:
-    void post_file(std::string path, uint16_t server_index);
+    std::shared_ptr<swarm_http_client::request> make_start_request(uint32_t chunk_id, uint16_t server_index);
+    std::shared_ptr<swarm_http_client::request> make_download_request(uint32_t chunk_id, uint16_t server_index);
+
+    /**
+     * @brief Decode the response of a download request and update transfer statistics
+     */
+    std::shared_ptr<chunk_data> decode_download(std::shared_ptr<swarm_http_client::request> r);
 
-    void post_start(uint32_t chunk_id, uint16_t server_index);
-    std::shared_ptr<chunk_data> get_download(uint32_t chunk_id, uint16_t server_index);
+    /**
+     * @brief Dispatch pending (or speculative copies of slow) chunks to servers with less than _chunks_per_server outstanding chunks
+     */
+    void schedule(std::shared_ptr<swarm_apply_state> state);
 
-    uint32_t post_cube(std::string json, uint16_t server_index);
+    /**
+     * @brief Record the result of a chunk request on a server and schedule further chunks
+     * @param r finished download or failed start request, nullptr if the download has been skipped
+     */
+    void complete(std::shared_ptr<swarm_apply_state> state, chunkid_t id, uint16_t server_index, std::shared_ptr<swarm_http_client::request> r);
+
+    /**
+     * @brief Start and download a single chunk
+     */
+    void dispatch(std::shared_ptr<swarm_apply_state> state, chunkid_t id, uint16_t server_index);
+
+    /**
+     * @brief Start several chunks with one request and receive them in a single streamed response
+     */
+    void dispatch_batch(std::shared_ptr<swarm_apply_state> state, std::vector<chunkid_t> ids, uint16_t server_index);
+
+    /**
+     * @brief Send a GET /version request to a server and blacklist the server if it does not respond
+     */
+    void check_server(std::shared_ptr<swarm_apply_state> state, uint16_t server_index);
 
     std::shared_ptr<cube> _cube;
     std::vector<uint32_t> _cube_ids;  // IDs of the cube for each server
 
-    std::vector<CURL *> _server_handles;
     std::vector<std::string> _server_uris;
+    std::unique_ptr<swarm_http_client> _http;
 
     uint16_t _nthreads;
+    uint16_t _chunks_per_server;
+    double _speculation_factor;
+    uint16_t _max_retries;
+    double _retry_backoff_seconds;
+    double _health_check_interval_seconds;
+    double _health_check_timeout_seconds;
+    double _download_timeout_seconds;
+    uint16_t _batch_size;
+    std::vector<bool> _server_available;  // servers with execution context and cube
+    std::vector<bool> _server_batch;      // servers supporting batch requests
+
+    uint8_t _chunk_encoding;
+    swarm_transfer_stats _transfer_stats;
+    std::vector<swarm_server_stats> _server_stats;
+    std::mutex _mutex_transfer_stats;
 };
 
 }  // namespace gdalcubes
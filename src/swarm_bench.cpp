@@ -0,0 +1,403 @@
+/*
+    MIT License
+
+    Copyright (c) 2019 Marius Appel <marius.appel@uni-muenster.de>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+/**
+ * This file contains a benchmark of gdalcubes_swarm, starting several gdalcubes_server processes on localhost.
+ */
+
+#include <boost/algorithm/string.hpp>
+#include <boost/program_options.hpp>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <thread>
+
+#include <cpl_string.h>
+#include <gdal_priv.h>
+#include <ogr_spatialref.h>
+
+#include "apply_pixel.h"
+#include "build_info.h"
+#include "filesystem.h"
+#include "image_collection_cube.h"
+#include "reduce_time.h"
+#include "swarm.h"
+#include "timer.h"
+
+#ifndef _WIN32
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+using namespace gdalcubes;
+
+void print_usage() {
+    std::cout << "Usage: gdalcubes_swarm_bench [options]" << std::endl;
+    std::cout << std::endl;
+    std::cout << "Start gdalcubes_server instances on localhost, process a reference data cube (NDVI of a generated image collection, reduced over time) "
+                 "with gdalcubes_swarm, and report throughput, per-server utilization, and transfer overhead for different numbers of servers."
+              << std::endl;
+    std::cout << std::endl;
+    std::cout << "Options:" << std::endl;
+    std::cout << "  -n, --servers               Comma-separated numbers of servers to benchmark, defaults to 1,2,4" << std::endl;
+    std::cout << "  -s, --server                Path of the gdalcubes_server executable, defaults to gdalcubes_server in the directory of this executable" << std::endl;
+    std::cout << "  -p, --port                  Port of the first server, further servers use consecutive ports, defaults to 11111" << std::endl;
+    std::cout << "  -t, --worker_threads        Number of worker threads per server, defaults to 1" << std::endl;
+    std::cout << "  -D, --dir                   Directory of the generated image collection and server working directories, defaults to {TEMPDIR}/gdalcubes_swarm_bench" << std::endl;
+    std::cout << "      --images                Number of generated images, defaults to 16" << std::endl;
+    std::cout << "      --size                  Number of pixels of generated images in x and y direction, defaults to 2048" << std::endl;
+    std::cout << "      --chunk_size            Spatial chunk size in pixels, defaults to 256" << std::endl;
+    std::cout << "      --batch_size            Batch size of gdalcubes_swarm, 1 disables batch requests, defaults to 8" << std::endl;
+    std::cout << "      --encoding              Chunk encoding of downloads, defaults to nanmask,deflate" << std::endl;
+    std::cout << "  -d, --debug                 Print debug messages" << std::endl;
+    std::cout << std::endl;
+}
+
+/**
+ * Generate a collection of two-band GeoTIFF images with daily time stamps, unless it already exists
+ * @return path of the image collection file
+ */
+std::string generate_collection(std::string dir, uint16_t nimages, uint32_t size) {
+    std::string icfile = filesystem::join(dir, "collection_" + std::to_string(nimages) + "_" + std::to_string(size) + ".db");
+    if (filesystem::exists(icfile)) {
+        return icfile;
+    }
+    std::string imgdir = filesystem::join(dir, "images_" + std::to_string(size));
+    filesystem::mkdir_recursive(imgdir);
+
+    GDALDriver *drv = GetGDALDriverManager()->GetDriverByName("GTiff");
+    if (!drv) {
+        throw std::string("ERROR in generate_collection(): GDAL GTiff driver is not available");
+    }
+    OGRSpatialReference srs;
+    srs.importFromEPSG(3857);
+    char *wkt = nullptr;
+    srs.exportToWkt(&wkt);
+
+    std::vector<std::string> files;
+    std::vector<std::string> datetimes;
+    std::vector<int16_t> buf(size_t(size) * size);
+    for (uint16_t i = 0; i < nimages; ++i) {
+        datetime d = datetime::from_string("2020-01-01") + duration(i, datetime_unit::DAY);
+        std::string f = filesystem::join(imgdir, "img_" + std::to_string(i) + ".tif");
+        files.push_back(f);
+        datetimes.push_back(d.to_string(datetime_unit::DAY));
+        if (filesystem::exists(f)) continue;
+
+        char **opts = nullptr;
+        opts = CSLSetNameValue(opts, "TILED", "YES");
+        opts = CSLSetNameValue(opts, "COMPRESS", "DEFLATE");
+        GDALDataset *ds = drv->Create(f.c_str(), size, size, 2, GDT_Int16, opts);
+        CSLDestroy(opts);
+        if (!ds) {
+            throw std::string("ERROR in generate_collection(): cannot create '" + f + "'");
+        }
+        double gt[6] = {0, 10, 0, double(size) * 10, 0, -10};
+        ds->SetGeoTransform(gt);
+        ds->SetProjection(wkt);
+        for (uint16_t b = 0; b < 2; ++b) {
+            // smooth patterns with a cloud-like nodata area that moves over time
+            for (uint32_t y = 0; y < size; ++y) {
+                for (uint32_t x = 0; x < size; ++x) {
+                    double v = 1000 + 500 * std::sin(0.01 * x + 0.3 * i) * std::cos(0.013 * y) + 300 * b;
+                    bool cloud = std::hypot(double(x) - (i * 97) % size, double(y) - (i * 61) % size) < size / 8;
+                    buf[size_t(y) * size + x] = cloud ? -9999 : int16_t(v);
+                }
+            }
+            GDALRasterBand *band = ds->GetRasterBand(b + 1);
+            band->SetNoDataValue(-9999);
+            if (band->RasterIO(GF_Write, 0, 0, size, size, buf.data(), size, size, GDT_Int16, 0, 0, nullptr) != CE_None) {
+                GDALClose(ds);
+                throw std::string("ERROR in generate_collection(): cannot write '" + f + "'");
+            }
+        }
+        GDALClose(ds);
+    }
+    CPLFree(wkt);
+
+    std::shared_ptr<image_collection> ic = image_collection::create(files, datetimes, {"red", "nir"});
+    ic->write(icfile);
+    return icfile;
+}
+
+#ifndef _WIN32
+
+struct bench_server {
+    pid_t pid;
+    int stdin_fd;  // gdalcubes_server exits when its standard input is closed
+    std::string url;
+};
+
+bench_server start_server(std::string exe, uint16_t port, std::string dir, uint16_t threads, bool debug) {
+    int fds[2];
+    if (pipe(fds) != 0) {
+        throw std::string("ERROR in start_server(): cannot create pipe");
+    }
+    std::string port_str = std::to_string(port);
+    std::string threads_str = std::to_string(threads);
+    pid_t pid = fork();
+    if (pid < 0) {
+        throw std::string("ERROR in start_server(): fork failed");
+    }
+    if (pid == 0) {
+        dup2(fds[0], STDIN_FILENO);
+        close(fds[0]);
+        close(fds[1]);
+        if (!debug) {
+            FILE *devnull = fopen("/dev/null", "w");
+            if (devnull) {
+                dup2(fileno(devnull), STDOUT_FILENO);
+                dup2(fileno(devnull), STDERR_FILENO);
+            }
+        }
+        std::vector<const char *> args = {exe.c_str(), "-p", port_str.c_str(), "-D", dir.c_str(), "-t", threads_str.c_str()};
+        if (debug) args.push_back("-d");
+        args.push_back(nullptr);
+        execv(exe.c_str(), (char *const *)args.data());
+        _exit(127);
+    }
+    close(fds[0]);
+    bench_server s;
+    s.pid = pid;
+    s.stdin_fd = fds[1];
+    s.url = "http://127.0.0.1:" + port_str + "/gdalcubes/api";
+    return s;
+}
+
+size_t discard_callback(char *, size_t size, size_t nitems, void *) {
+    return size * nitems;
+}
+
+/**
+ * Poll GET /version until the server responds
+ */
+bool wait_server(bench_server s, double timeout_seconds) {
+    timer t;
+    CURL *h = curl_easy_init();
+    bool ok = false;
+    while (!ok && t.time() < timeout_seconds) {
+        int status = 0;
+        if (waitpid(s.pid, &status, WNOHANG) == s.pid) break;  // server exited
+        curl_easy_reset(h);
+        curl_easy_setopt(h, CURLOPT_URL, (s.url + "/version").c_str());
+        curl_easy_setopt(h, CURLOPT_TIMEOUT_MS, 1000L);
+        curl_easy_setopt(h, CURLOPT_NOSIGNAL, 1L);
+        curl_easy_setopt(h, CURLOPT_WRITEFUNCTION, &discard_callback);
+        long code = 0;
+        if (curl_easy_perform(h) == CURLE_OK) {
+            curl_easy_getinfo(h, CURLINFO_RESPONSE_CODE, &code);
+        }
+        ok = code == 200;
+        if (!ok) std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+    curl_easy_cleanup(h);
+    return ok;
+}
+
+void stop_server(bench_server s) {
+    close(s.stdin_fd);
+    timer t;
+    while (t.time() < 10) {
+        if (waitpid(s.pid, nullptr, WNOHANG) == s.pid) return;
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    }
+    kill(s.pid, SIGKILL);
+    waitpid(s.pid, nullptr, 0);
+}
+
+#endif
+
+int main(int argc, char *argv[]) {
+    config::instance()->gdalcubes_init();
+
+    namespace po = boost::program_options;
+    po::options_description global_args("Options");
+    global_args.add_options()("help,h", "")("debug,d", "")("servers,n", po::value<std::string>()->default_value("1,2,4"), "")("server,s", po::value<std::string>(), "")("port,p", po::value<uint16_t>()->default_value(11111), "")("worker_threads,t", po::value<uint16_t>()->default_value(1), "")("dir,D", po::value<std::string>()->default_value(filesystem::join(filesystem::get_tempdir(), "gdalcubes_swarm_bench")), "")("images", po::value<uint16_t>()->default_value(16), "")("size", po::value<uint32_t>()->default_value(2048), "")("chunk_size", po::value<uint32_t>()->default_value(256), "")("batch_size", po::value<uint16_t>()->default_value(8), "")("encoding", po::value<std::string>()->default_value("nanmask,deflate"), "");
+
+    po::variables_map vm;
+    std::vector<uint16_t> nservers;
+    try {
+        po::store(po::command_line_parser(argc, argv).options(global_args).run(), vm);
+        if (vm.count("help")) {
+            print_usage();
+            return 0;
+        }
+        std::vector<std::string> parts;
+        std::string servers = vm["servers"].as<std::string>();
+        boost::split(parts, servers, boost::is_any_of(","));
+        for (uint16_t i = 0; i < parts.size(); ++i) {
+            nservers.push_back(std::stoi(parts[i]));
+        }
+    } catch (...) {
+        std::cout << "ERROR in gdalcubes_swarm_bench: cannot parse arguments." << std::endl;
+        print_usage();
+        return 1;
+    }
+
+#ifdef _WIN32
+    std::cout << "ERROR in gdalcubes_swarm_bench: starting servers is not supported on Windows." << std::endl;
+    return 1;
+#else
+    bool debug = vm.count("debug") > 0;
+    if (debug) {
+        config::instance()->set_error_handler(error_handler::error_handler_debug);
+    }
+
+    std::string exe;
+    if (vm.count("server")) {
+        exe = filesystem::make_absolute(vm["server"].as<std::string>());
+    } else {
+        exe = filesystem::join(filesystem::directory(filesystem::make_absolute(argv[0])), "gdalcubes_server");
+    }
+    if (!filesystem::exists(exe)) {
+        std::cout << "ERROR in gdalcubes_swarm_bench: gdalcubes_server executable '" << exe << "' does not exist, please use --server." << std::endl;
+        return 1;
+    }
+
+    std::string dir = filesystem::make_absolute(vm["dir"].as<std::string>());
+    uint32_t size = vm["size"].as<uint32_t>();
+    uint16_t nimages = vm["images"].as<uint16_t>();
+    uint32_t chunk_size = vm["chunk_size"].as<uint32_t>();
+    uint16_t port = vm["port"].as<uint16_t>();
+    uint16_t threads = vm["worker_threads"].as<uint16_t>();
+
+    try {
+        filesystem::mkdir_recursive(dir);
+        // the swarm uploads all files of the working directory; the collection in dir is read by the local servers directly, so
+        // the working directory is an empty context directory
+        std::string ctxdir = filesystem::join(dir, "context");
+        filesystem::mkdir_recursive(ctxdir);
+        std::string icfile = generate_collection(dir, nimages, size);
+        if (chdir(ctxdir.c_str()) != 0) {
+            throw std::string("ERROR in gdalcubes_swarm_bench: cannot change working directory to '" + ctxdir + "'");
+        }
+
+        // reference process graph: NDVI, median over time
+        cube_view v;
+        v.srs("EPSG:3857");
+        v.left(0);
+        v.right(size * 10);
+        v.bottom(0);
+        v.top(size * 10);
+        v.nx(size);
+        v.ny(size);
+        v.t0(datetime::from_string("2020-01-01"));
+        v.t1(datetime::from_string("2020-01-01") + duration(nimages - 1, datetime_unit::DAY));
+        v.dt(duration(1, datetime_unit::DAY));
+        v.aggregation_method() = aggregation::aggregation_type::AGG_FIRST;
+        v.resampling_method() = resampling::resampling_type::RSMPL_NEAR;
+        std::shared_ptr<image_collection_cube> ic_cube = image_collection_cube::create(icfile, v);
+        ic_cube->set_chunk_size(nimages, chunk_size, chunk_size);
+        std::shared_ptr<cube> c = reduce_time_cube::create(apply_pixel_cube::create(ic_cube, {"(nir-red)/(nir+red)"}, {"ndvi"}), {{"median", "ndvi"}});
+
+        std::cout << "gdalcubes_swarm_bench: " << c->count_chunks() << " chunks, " << nimages << " images of " << size << "x" << size << " pixels, "
+                  << threads << " worker thread(s) per server" << std::endl;
+        std::cout << std::endl;
+        std::cout << std::setw(8) << "servers" << std::setw(12) << "seconds" << std::setw(12) << "chunks/s" << std::setw(10) << "speedup" << std::setw(12) << "efficiency"
+                  << std::setw(14) << "MiB received" << std::setw(14) << "MiB decoded" << std::setw(16) << "transfer share" << std::endl;
+
+        double seconds_first = 0;
+        uint16_t nservers_first = 0;
+        std::vector<std::string> details;
+        for (uint16_t in = 0; in < nservers.size(); ++in) {
+            uint16_t n = nservers[in];
+            if (n == 0) continue;
+
+            // fresh servers without cached chunks for each run
+            std::vector<bench_server> servers;
+            std::vector<std::string> urls;
+            for (uint16_t i = 0; i < n; ++i) {
+                std::string sdir = filesystem::join(dir, "server_" + std::to_string(i));
+                servers.push_back(start_server(exe, port + i, sdir, threads, debug));
+                urls.push_back(servers.back().url);
+            }
+            bool ready = true;
+            for (uint16_t i = 0; i < n; ++i) {
+                if (!wait_server(servers[i], 30)) {
+                    std::cout << "ERROR in gdalcubes_swarm_bench: server at '" << servers[i].url << "' did not start" << std::endl;
+                    ready = false;
+                }
+            }
+
+            if (ready) {
+                std::shared_ptr<gdalcubes_swarm> swarm = gdalcubes_swarm::from_urls(urls);
+                swarm->set_threads(std::max(uint16_t(1), std::min(n, uint16_t(std::thread::hardware_concurrency()))));
+                swarm->set_batch_size(vm["batch_size"].as<uint16_t>());
+                swarm->set_chunk_encoding(vm["encoding"].as<std::string>());
+                swarm->set_chunks_per_server(std::max(uint16_t(2), threads));
+
+                uint32_t nchunks = 0;
+                swarm->apply(c, [&nchunks](chunkid_t id, std::shared_ptr<chunk_data> dat, std::mutex &m) {
+                    std::lock_guard<std::mutex> lock(m);
+                    ++nchunks;
+                });
+
+                swarm_transfer_stats ts = swarm->transfer_stats();
+                std::vector<swarm_server_stats> ss = swarm->server_stats();
+                if (nservers_first == 0) {
+                    seconds_first = ts.wall_seconds;
+                    nservers_first = n;
+                }
+                double speedup = seconds_first / ts.wall_seconds;
+                double efficiency = speedup * nservers_first / n;
+                double busy = 0;
+                for (uint16_t i = 0; i < ss.size(); ++i) busy += ss[i].busy_seconds;
+                std::cout << std::fixed << std::setprecision(2) << std::setw(8) << n << std::setw(12) << ts.wall_seconds << std::setw(12) << nchunks / ts.wall_seconds
+                          << std::setw(10) << speedup << std::setw(12) << efficiency << std::setw(14) << ts.bytes_received / (1024.0 * 1024.0)
+                          << std::setw(14) << ts.bytes_decoded / (1024.0 * 1024.0) << std::setw(16) << (busy > 0 ? ts.transfer_seconds / busy : 0) << std::endl;
+
+                std::stringstream str;
+                str << std::fixed << std::setprecision(2);
+                str << n << " server(s):" << std::endl;
+                for (uint16_t i = 0; i < ss.size(); ++i) {
+                    str << "  " << urls[i] << ": " << ss[i].chunks << " chunks (" << ss[i].speculative << " speculative, " << ss[i].wasted << " wasted, "
+                        << ss[i].errors << " errors), utilization " << (100 * ss[i].busy_seconds / ts.wall_seconds) << "%" << std::endl;
+                }
+                details.push_back(str.str());
+            }
+
+            for (uint16_t i = 0; i < n; ++i) {
+                stop_server(servers[i]);
+            }
+        }
+
+        std::cout << std::endl;
+        for (uint16_t i = 0; i < details.size(); ++i) {
+            std::cout << details[i];
+        }
+        std::cout << std::endl;
+        std::cout << "Utilization is the sum of request durations of a server relative to the total time, values above 100% indicate concurrent chunks. "
+                     "Transfer share is the fraction of request durations spent downloading chunks."
+                  << std::endl;
+    } catch (std::string s) {
+        std::cout << s << std::endl;
+        config::instance()->gdalcubes_cleanup();
+        return 1;
+    }
+
+    config::instance()->gdalcubes_cleanup();
+    return 0;
+#endif
+}
@@ -0,0 +1,176 @@
+/*
+    MIT License
+
+    Copyright (c) 2019 Marius Appel <marius.appel@uni-muenster.de>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+#include "../arrow_stream.h"
+#include "../external/catch.hpp"
+#include "test_helpers.h"
+
+using namespace gdalcubes;
+
+/**
+ * Read access to flatbuffer tables of a single Arrow message, positions are relative to the start of the metadata
+ */
+struct fb_reader {
+    fb_reader(const unsigned char *buf) : b(buf) {}
+
+    template <typename T>
+    T get(uint32_t pos) const {
+        T v;
+        std::memcpy(&v, b + pos, sizeof(T));
+        return v;
+    }
+
+    // position of an inline field of a table, 0 if the field is absent
+    uint32_t field(uint32_t table, uint16_t slot) const {
+        uint32_t vt = table - get<int32_t>(table);
+        if (4 + 2 * slot >= get<uint16_t>(vt)) return 0;
+        uint16_t off = get<uint16_t>(vt + 4 + 2 * slot);
+        return off == 0 ? 0 : table + off;
+    }
+
+    // position of an object referenced by a field of a table
+    uint32_t ref(uint32_t table, uint16_t slot) const {
+        uint32_t f = field(table, slot);
+        REQUIRE(f != 0);
+        return f + get<uint32_t>(f);
+    }
+
+    std::string str(uint32_t pos) const {
+        return std::string((const char *)b + pos + 4, get<uint32_t>(pos));
+    }
+
+    // position of the i-th table in a vector of tables
+    uint32_t element(uint32_t vec, uint32_t i) const {
+        uint32_t e = vec + 4 + 4 * i;
+        return e + get<uint32_t>(e);
+    }
+
+    const unsigned char *b;
+};
+
+TEST_CASE("Arrow IPC stream", "[arrow_stream]") {
+    // a chunk with two bands, 3 x 4 x 5 pixels, and some NaN values
+    std::shared_ptr<chunk_data> c = make_test_chunk();
+    uint64_t nrows = 3 * 4 * 5;
+
+    std::FILE *f = std::tmpfile();
+    REQUIRE(f != NULL);
+    arrow_stream_writer writer(fileno(f));
+    writer.write_schema({"B04", "B08"}, {{"gdalcubes", "{}"}});
+    writer.write_record_batch(nrows, {(const double *)c->buf(), (const double *)c->buf() + nrows}, {{"gdalcubes", "{\"chunk_id\":0}"}});
+    writer.write_record_batch(0, {nullptr, nullptr});  // empty chunk
+    writer.write_eos();
+    REQUIRE_THROWS(writer.write_record_batch(nrows, {(const double *)c->buf()}));
+
+    std::vector<unsigned char> stream(std::ftell(f));
+    std::rewind(f);
+    REQUIRE(std::fread(stream.data(), 1, stream.size(), f) == stream.size());
+    std::fclose(f);
+
+    // encapsulated messages: continuation marker, metadata length (multiple of 8), metadata, body
+    uint32_t pos = 0;
+    auto next_message = [&stream, &pos](uint32_t &metadata_length) {
+        REQUIRE(pos + 8 <= stream.size());
+        uint32_t prefix[2];
+        std::memcpy(prefix, stream.data() + pos, 8);
+        REQUIRE(prefix[0] == 0xFFFFFFFF);
+        REQUIRE(prefix[1] % 8 == 0);
+        metadata_length = prefix[1];
+        uint32_t start = pos + 8;
+        pos = start + metadata_length;
+        REQUIRE(pos <= stream.size());
+        return start;
+    };
+
+    // schema
+    uint32_t len;
+    fb_reader schema_msg(stream.data() + next_message(len));
+    uint32_t msg = schema_msg.get<uint32_t>(0);
+    REQUIRE(schema_msg.get<int16_t>(schema_msg.field(msg, 0)) == 4);  // MetadataVersion V5
+    REQUIRE(schema_msg.get<uint8_t>(schema_msg.field(msg, 1)) == 1);  // MessageHeader Schema
+    REQUIRE(schema_msg.get<int64_t>(schema_msg.field(msg, 3)) == 0);
+    uint32_t schema = schema_msg.ref(msg, 2);
+    uint32_t fields = schema_msg.ref(schema, 1);
+    REQUIRE(schema_msg.get<uint32_t>(fields) == 2);
+    std::vector<std::string> names = {"B04", "B08"};
+    for (uint32_t i = 0; i < 2; ++i) {
+        uint32_t field = schema_msg.element(fields, i);
+        REQUIRE(schema_msg.str(schema_msg.ref(field, 0)) == names[i]);
+        REQUIRE(schema_msg.get<uint8_t>(schema_msg.field(field, 1)) == 0);  // not nullable
+        REQUIRE(schema_msg.get<uint8_t>(schema_msg.field(field, 2)) == 3);  // Type FloatingPoint
+        uint32_t type = schema_msg.ref(field, 3);
+        REQUIRE(schema_msg.get<int16_t>(schema_msg.field(type, 0)) == 2);  // Precision DOUBLE
+    }
+    uint32_t schema_kv = schema_msg.element(schema_msg.ref(schema, 2), 0);
+    REQUIRE(schema_msg.str(schema_msg.ref(schema_kv, 0)) == "gdalcubes");
+    REQUIRE(schema_msg.str(schema_msg.ref(schema_kv, 1)) == "{}");
+
+    // record batch with data
+    fb_reader batch_msg(stream.data() + next_message(len));
+    msg = batch_msg.get<uint32_t>(0);
+    REQUIRE(batch_msg.get<uint8_t>(batch_msg.field(msg, 1)) == 3);  // MessageHeader RecordBatch
+    int64_t body_length = batch_msg.get<int64_t>(batch_msg.field(msg, 3));
+    REQUIRE(body_length == 2 * nrows * sizeof(double));
+    uint32_t batch_kv = batch_msg.element(batch_msg.ref(msg, 4), 0);
+    REQUIRE(batch_msg.str(batch_msg.ref(batch_kv, 1)) == "{\"chunk_id\":0}");
+    uint32_t batch = batch_msg.ref(msg, 2);
+    REQUIRE(batch_msg.get<int64_t>(batch_msg.field(batch, 0)) == (int64_t)nrows);
+    uint32_t nodes = batch_msg.ref(batch, 1);
+    REQUIRE(batch_msg.get<uint32_t>(nodes) == 2);
+    REQUIRE(batch_msg.get<int64_t>(nodes + 4) == (int64_t)nrows);  // length
+    REQUIRE(batch_msg.get<int64_t>(nodes + 12) == 0);              // null count
+    uint32_t buffers = batch_msg.ref(batch, 2);
+    REQUIRE(batch_msg.get<uint32_t>(buffers) == 4);
+    for (uint32_t i = 0; i < 2; ++i) {
+        REQUIRE(batch_msg.get<int64_t>(buffers + 4 + 32 * i + 8) == 0);  // no validity bitmap
+        REQUIRE(batch_msg.get<int64_t>(buffers + 4 + 32 * i + 16) == (int64_t)(i * nrows * sizeof(double)));
+        REQUIRE(batch_msg.get<int64_t>(buffers + 4 + 32 * i + 24) == (int64_t)(nrows * sizeof(double)));
+    }
+    REQUIRE(pos + body_length <= stream.size());
+    const double *body = (const double *)(stream.data() + pos);
+    for (uint32_t i = 0; i < 2 * nrows; ++i) {
+        double expected = ((double *)c->buf())[i];
+        if (std::isnan(expected)) {
+            REQUIRE(std::isnan(body[i]));
+        } else {
+            REQUIRE(body[i] == expected);
+        }
+    }
+    pos += body_length;
+
+    // empty record batch
+    fb_reader empty_msg(stream.data() + next_message(len));
+    msg = empty_msg.get<uint32_t>(0);
+    REQUIRE(empty_msg.get<int64_t>(empty_msg.field(msg, 3)) == 0);
+    REQUIRE(empty_msg.get<int64_t>(empty_msg.field(empty_msg.ref(msg, 2), 0)) == 0);
+
+    // end-of-stream marker
+    next_message(len);
+    REQUIRE(len == 0);
+    REQUIRE(pos == stream.size());
+}
@@ -0,0 +1,78 @@
+/*
+    MIT License
+
+    Copyright (c) 2019 Marius Appel <marius.appel@uni-muenster.de>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#include <cmath>
+
+#include "../batch_expr.h"
+#include "../external/catch.hpp"
+#include "../external/tinyexpr/tinyexpr.h"
+
+using namespace gdalcubes;
+
+TEST_CASE("Batch expressions", "[batch_expr]") {
+    // values of two variables including NAN, zero, and negative values
+    std::vector<double> b1, b2;
+    for (uint32_t i = 0; i < batch_expr::block_size; ++i) {
+        b1.push_back(i % 7 == 0 ? NAN : (double(i) - 300) / 17);
+        b2.push_back(i % 11 == 0 ? 0 : (double(i % 50) - 10) / 3);
+    }
+    const double *vars[] = {b1.data(), b2.data()};
+
+    std::vector<std::string> expr = {"b1", "3", "(b1 - b2) / (b1 + b2)", "-b1 * 2 ^ b2 % 3", "b1 < b2 || b1 >= 2 && b2 != 0",
+                                     "ifelse(isnan(b1), -1, sqrt(abs(b1)))", "floor(b1) + ceil(b2) + exp(b2 / 10) + atan2(b1, b2)",
+                                     "(b1, b2 == 1) + b1 <= b2 + pi", "ifelse(b1 > 0, 1, 0) * ln(b2)"};
+    for (uint16_t ie = 0; ie < expr.size(); ++ie) {
+        int err;
+        std::shared_ptr<batch_expr> x = batch_expr::compile(expr[ie], {"b1", "b2"}, &err);
+        REQUIRE(x);
+
+        double v1, v2;
+        te_variable te_vars[] = {{"b1", &v1, TE_VARIABLE, nullptr}, {"b2", &v2, TE_VARIABLE, nullptr}};
+        te_expr *te = te_compile(expr[ie].c_str(), te_vars, 2, &err);
+
+        std::vector<double> out(batch_expr::block_size);
+        x->eval(vars, batch_expr::block_size, out.data());
+        bool equal = true;
+        for (uint32_t i = 0; i < batch_expr::block_size; ++i) {
+            v1 = b1[i];
+            v2 = b2[i];
+            double ref = te_eval(te);
+            if (!((std::isnan(ref) && std::isnan(out[i])) || ref == out[i])) equal = false;
+        }
+        te_free(te);
+        INFO(expr[ie]);
+        REQUIRE(equal);
+    }
+
+    int err;
+    std::shared_ptr<batch_expr> x = batch_expr::compile("b2 * 2", {"b1", "b2"}, &err);
+    REQUIRE(!x->uses(0));
+    REQUIRE(x->uses(1));
+    double out[3];
+    const double *partial[] = {nullptr, b2.data()};
+    x->eval(partial, 3, out);  // unused variables may be null, blocks may be smaller
+    REQUIRE(out[1] == b2[1] * 2);
+    REQUIRE(!batch_expr::compile("b1 +* b2", {"b1", "b2"}, &err));
+    REQUIRE(!batch_expr::compile("b3", {"b1", "b2"}, &err));
+}
@@ -0,0 +1,101 @@
+/*
+    MIT License
+
+    Copyright (c) 2019 Marius Appel <marius.appel@uni-muenster.de>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+
+#include "../chunk_codec.h"
+#include "../external/catch.hpp"
+#include "test_helpers.h"
+
+using namespace gdalcubes;
+
+TEST_CASE("Chunk encodings", "[chunk_codec]") {
+    REQUIRE(chunk_codec::parse_encoding("float32, nanmask,deflate") == (chunk_codec::FLOAT32 | chunk_codec::NANMASK | chunk_codec::DEFLATE));
+    REQUIRE(chunk_codec::parse_encoding("xyz") == chunk_codec::RAW);
+    REQUIRE(chunk_codec::encoding_string(chunk_codec::NANMASK | chunk_codec::DEFLATE) == "nanmask,deflate");
+
+    std::shared_ptr<chunk_data> c = make_test_chunk();
+    for (uint8_t enc = 0; enc < 8; ++enc) {
+        std::vector<unsigned char> bytes = chunk_codec::encode(c, enc);
+        std::shared_ptr<chunk_data> d = chunk_codec::decode(bytes.data(), bytes.size());
+        REQUIRE(d->size() == c->size());
+        for (uint32_t i = 0; i < 2 * 3 * 4 * 5; ++i) {
+            double a = ((double *)c->buf())[i];
+            double b = ((double *)d->buf())[i];
+            if (std::isnan(a)) {
+                REQUIRE(std::isnan(b));
+            } else {
+                REQUIRE(b == Approx(a));  // float32 is lossy
+            }
+        }
+        if (enc & chunk_codec::NANMASK) {
+            REQUIRE(bytes.size() < 2 * 3 * 4 * 5 * sizeof(double));
+        }
+    }
+
+    // empty chunks
+    std::shared_ptr<chunk_data> e = std::make_shared<chunk_data>();
+    std::vector<unsigned char> bytes = chunk_codec::encode(e, chunk_codec::NANMASK);
+    REQUIRE(bytes.size() == chunk_codec::HEADER_SIZE);
+    REQUIRE(chunk_codec::decode(bytes.data(), bytes.size())->empty());
+
+    // truncated data
+    bytes = chunk_codec::encode(c, chunk_codec::RAW);
+    REQUIRE_THROWS(chunk_codec::decode(bytes.data(), bytes.size() - 8));
+}
+
+TEST_CASE("Batch download frames", "[chunk_codec]") {
+    std::shared_ptr<chunk_data> c = make_test_chunk();
+    std::vector<unsigned char> stream;
+    for (uint32_t id = 0; id < 3; ++id) {
+        std::vector<unsigned char> frame = chunk_codec::encode_frame(id, chunk_codec::FRAME_OK, chunk_codec::encode(c, chunk_codec::DEFLATE));
+        stream.insert(stream.end(), frame.begin(), frame.end());
+    }
+    std::string msg = "error message";
+    std::vector<unsigned char> frame = chunk_codec::encode_frame(7, chunk_codec::FRAME_ERROR, std::vector<unsigned char>(msg.begin(), msg.end()));
+    stream.insert(stream.end(), frame.begin(), frame.end());
+
+    // feed in small pieces of varying size
+    std::vector<uint32_t> ids;
+    std::vector<uint32_t> status;
+    std::string err;
+    chunk_frame_reader reader([&](uint32_t chunk_id, uint32_t s, const unsigned char *content, std::size_t n) {
+        ids.push_back(chunk_id);
+        status.push_back(s);
+        if (s == chunk_codec::FRAME_OK) {
+            REQUIRE(chunk_codec::decode(content, n)->size() == c->size());
+        } else {
+            err = std::string((const char *)content, n);
+        }
+    });
+    std::size_t pos = 0;
+    for (std::size_t piece = 1; pos < stream.size(); piece = (piece * 7) % 97 + 1) {
+        std::size_t n = std::min(piece, stream.size() - pos);
+        reader.feed(stream.data() + pos, n);
+        pos += n;
+    }
+    REQUIRE(reader.complete());
+    REQUIRE(ids == std::vector<uint32_t>({0, 1, 2, 7}));
+    REQUIRE(status == std::vector<uint32_t>({0, 0, 0, 1}));
+    REQUIRE(err == msg);
+}
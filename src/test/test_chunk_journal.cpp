@@ -0,0 +1,74 @@
+/*
+    MIT License
+
+    Copyright (c) 2019 Marius Appel <marius.appel@uni-muenster.de>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#include "../chunk_journal.h"
+#include "../external/catch.hpp"
+#include "../filesystem.h"
+
+using namespace gdalcubes;
+
+TEST_CASE("Chunk journal write and load", "[chunk_journal]") {
+    std::string path = filesystem::join(filesystem::get_tempdir(), "test_chunk_journal.journal");
+    {
+        chunk_journal j(path, "abc", 10);
+        j.open(false);
+        j.add(1);
+        j.add(5);
+        j.add(9);
+        j.sync();
+        REQUIRE(j.is_done(5));
+        REQUIRE(!j.is_done(4));
+    }
+    {
+        chunk_journal j(path, "abc", 10);
+        REQUIRE(j.load());
+        REQUIRE(j.is_done(1));
+        REQUIRE(j.is_done(9));
+        REQUIRE(j.missing().size() == 7);
+        REQUIRE(j.missing()[1] == 2);
+
+        // appending keeps previously completed chunks
+        j.open(true);
+        j.add(0);
+        j.sync();
+        REQUIRE(j.missing().size() == 6);
+    }
+    {
+        chunk_journal j(path, "abc", 10);
+        REQUIRE(j.load());
+        REQUIRE(j.missing().size() == 6);
+    }
+    {
+        chunk_journal j1(path, "xyz", 10);
+        REQUIRE(!j1.load());
+        chunk_journal j2(path, "abc", 11);
+        REQUIRE(!j2.load());
+    }
+    {
+        chunk_journal j(path, "abc", 10);
+        j.remove();
+        REQUIRE(!filesystem::exists(path));
+        REQUIRE(!j.load());
+    }
+}
@@ -0,0 +1,70 @@
+/*
+    MIT License
+
+    Copyright (c) 2019 Marius Appel <marius.appel@uni-muenster.de>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#ifndef TEST_HELPERS_H
+#define TEST_HELPERS_H
+
+#include <cmath>
+#include <cstdlib>
+
+#include "../cube.h"
+
+namespace gdalcubes {
+
+/**
+ * Small data cube view shared by tests: 10 x 10 pixels in EPSG:4326 and 10 daily time slices
+ */
+inline cube_view test_cube_view() {
+    cube_view v;
+    v.srs("EPSG:4326");
+    v.left(0);
+    v.right(10);
+    v.bottom(0);
+    v.top(10);
+    v.nx(10);
+    v.ny(10);
+    v.t0(datetime::from_string("2018-01-01"));
+    v.t1(datetime::from_string("2018-01-10"));
+    v.nt(10);
+    return v;
+}
+
+/**
+ * Chunk of the given size (bands, t, y, x) with values offset + i + 0.25 at the i-th position and NaN at every third
+ * position, starting with the first
+ */
+inline std::shared_ptr<chunk_data> make_test_chunk(coords_nd<uint32_t, 4> size = {2, 3, 4, 5}, double offset = 0) {
+    uint32_t n = size[0] * size[1] * size[2] * size[3];
+    std::shared_ptr<chunk_data> c = std::make_shared<chunk_data>();
+    c->size(size);
+    c->buf(std::malloc(n * sizeof(double)));
+    for (uint32_t i = 0; i < n; ++i) {
+        ((double *)c->buf())[i] = (i % 3 == 0) ? NAN : offset + i + 0.25;
+    }
+    return c;
+}
+
+}  // namespace gdalcubes
+
+#endif  //TEST_HELPERS_H
@@ -0,0 +1,60 @@
+/*
+    MIT License
+
+    Copyright (c) 2019 Marius Appel <marius.appel@uni-muenster.de>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#include <sstream>
+#include <thread>
+
+#include "../metrics.h"
+#include "../external/catch.hpp"
+
+using namespace gdalcubes;
+
+TEST_CASE("Histogram", "[metrics]") {
+    histogram h({0.1, 1, 10});
+    std::vector<std::thread> workers;
+    for (uint16_t i = 0; i < 4; ++i) {
+        workers.push_back(std::thread([&h]() {
+            for (uint16_t j = 0; j < 1000; ++j) {
+                h.observe(0.05);
+                h.observe(0.5);
+                h.observe(100);
+            }
+        }));
+    }
+    for (uint16_t i = 0; i < workers.size(); ++i) {
+        workers[i].join();
+    }
+    REQUIRE(h.count() == 12000);
+    REQUIRE(h.sum() == Approx(4000 * 100.55));
+
+    std::stringstream ss;
+    h.write_prometheus(ss, "x_seconds", "Test");
+    std::string out = ss.str();
+    REQUIRE(out.find("# TYPE x_seconds histogram\n") != std::string::npos);
+    REQUIRE(out.find("x_seconds_bucket{le=\"0.1\"} 4000\n") != std::string::npos);
+    REQUIRE(out.find("x_seconds_bucket{le=\"1\"} 8000\n") != std::string::npos);
+    REQUIRE(out.find("x_seconds_bucket{le=\"10\"} 8000\n") != std::string::npos);
+    REQUIRE(out.find("x_seconds_bucket{le=\"+Inf\"} 12000\n") != std::string::npos);
+    REQUIRE(out.find("x_seconds_count 12000\n") != std::string::npos);
+}
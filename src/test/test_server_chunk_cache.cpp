@@ -0,0 +1,91 @@
+/*
+    MIT License
+
+    Copyright (c) 2019 Marius Appel <marius.appel@uni-muenster.de>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+#include "../server_chunk_cache.h"
+#include "../external/catch.hpp"
+#include "test_helpers.h"
+
+using namespace gdalcubes;
+
+static uint32_t count_chunk_files(std::string dir) {
+    uint32_t n = 0;
+    filesystem::iterate_directory(dir, [&n](const std::string &p) {
+        if (filesystem::extension(p) == "gcc") ++n;
+    });
+    return n;
+}
+
+TEST_CASE("Server chunk cache disk tier", "[server_chunk_cache]") {
+    uint32_t old_max = config::instance()->get_server_chunkcache_max();
+    bool old_compression = config::instance()->get_server_chunkcache_compression();
+    uint64_t old_disk_max = config::instance()->get_server_chunkcache_disk_max();
+
+    // memory for two chunks only
+    config::instance()->set_server_chunkcache_max(2 * 100 * sizeof(double));
+    config::instance()->set_server_chunkcache_compression(false);
+    config::instance()->set_server_chunkcache_disk_max(1024 * 1024);
+    std::string dir = filesystem::join(filesystem::get_tempdir(), "test_server_chunk_cache");
+    server_chunk_cache *cache = server_chunk_cache::instance();
+    cache->set_disk_dir(dir);
+
+    uint32_t cube_id = 4000000000;
+    server_chunk_cache_stats before = cache->stats();
+    for (uint32_t i = 0; i < 4; ++i) {
+        cache->add(std::make_pair(cube_id, i), make_test_chunk({1, 1, 10, 10}, i * 100));
+    }
+
+    // chunks exceeding the memory limit are spilled to disk
+    server_chunk_cache_stats after = cache->stats();
+    REQUIRE(after.resident_bytes <= config::instance()->get_server_chunkcache_max());
+    REQUIRE(after.spills - before.spills >= 2);
+    REQUIRE(after.disk_count >= 2);
+    REQUIRE(count_chunk_files(dir) == after.disk_count);
+    for (uint32_t i = 0; i < 4; ++i) {
+        REQUIRE(cache->has(std::make_pair(cube_id, i)));
+    }
+
+    // the least recently used chunk is read back from disk and its file is removed
+    std::shared_ptr<chunk_data> c = cache->get(std::make_pair(cube_id, 0));
+    REQUIRE(c);
+    REQUIRE(c->size() == make_test_chunk({1, 1, 10, 10})->size());
+    for (uint32_t i = 0; i < 100; ++i) {
+        if (i % 3 == 0) {
+            REQUIRE(std::isnan(((double *)c->buf())[i]));
+        } else {
+            REQUIRE(((double *)c->buf())[i] == i + 0.25);
+        }
+    }
+    REQUIRE(cache->stats().disk_hits == after.disk_hits + 1);
+    REQUIRE(!filesystem::exists(filesystem::join(dir, std::to_string(cube_id) + "_0.gcc")));
+
+    // removing the cube deletes its files
+    cache->remove_cube(cube_id);
+    REQUIRE(count_chunk_files(dir) == 0);
+    for (uint32_t i = 0; i < 4; ++i) {
+        REQUIRE(!cache->has(std::make_pair(cube_id, i)));
+    }
+
+    config::instance()->set_server_chunkcache_max(old_max);
+    config::instance()->set_server_chunkcache_compression(old_compression);
+    config::instance()->set_server_chunkcache_disk_max(old_disk_max);
+}
@@ -0,0 +1,73 @@
+/*
+    MIT License
+
+    Copyright (c) 2019 Marius Appel <marius.appel@uni-muenster.de>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+#include <thread>
+
+#include "../dummy.h"
+#include "../server_cube_store.h"
+#include "../external/catch.hpp"
+#include "test_helpers.h"
+
+using namespace gdalcubes;
+
+TEST_CASE("Server cube store", "[server_cube_store]") {
+    server_cube_store store;
+
+    // identical process graphs reuse the same id
+    uint32_t a = store.add(dummy_cube::create(test_cube_view(), 1, 1.0));
+    uint32_t b = store.add(dummy_cube::create(test_cube_view(), 1, 1.0));
+    uint32_t c = store.add(dummy_cube::create(test_cube_view(), 1, 2.0));
+    REQUIRE(a == b);
+    REQUIRE(a != c);
+    REQUIRE(store.size() == 2);
+    REQUIRE(store.get(a));
+    REQUIRE(!store.get(c + 1));
+
+    // after replacing input files, identical process graphs get a new id
+    store.forget_hashes();
+    uint32_t d = store.add(dummy_cube::create(test_cube_view(), 1, 1.0));
+    REQUIRE(d != a);
+    REQUIRE(store.size() == 3);
+}
+
+TEST_CASE("Server cube store TTL", "[server_cube_store]") {
+    server_cube_store store;
+    uint32_t a = store.add(dummy_cube::create(test_cube_view(), 1, 1.0));
+    uint32_t b = store.add(dummy_cube::create(test_cube_view(), 1, 2.0));
+    REQUIRE(store.idle(std::chrono::milliseconds(200)).empty());
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+    store.get(b);  // access resets the idle time
+    std::set<uint32_t> idle = store.idle(std::chrono::milliseconds(200));
+    REQUIRE(idle.size() == 1);
+    REQUIRE(idle.count(a) == 1);
+
+    REQUIRE(!store.remove_if_idle(b, std::chrono::milliseconds(200)));
+    REQUIRE(store.remove_if_idle(a, std::chrono::milliseconds(200)));
+    REQUIRE(!store.get(a));
+    REQUIRE(store.get(b));
+
+    // an evicted process graph gets a new id
+    uint32_t c = store.add(dummy_cube::create(test_cube_view(), 1, 1.0));
+    REQUIRE(c != a);
+}
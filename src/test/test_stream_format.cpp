@@ -0,0 +1,110 @@
+/*
+    MIT License
+
+    Copyright (c) 2019 Marius Appel <marius.appel@uni-muenster.de>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#include "../stream_format.h"
+#include "../external/catch.hpp"
+
+using namespace gdalcubes;
+
+TEST_CASE("Streaming input format", "[stream_format]") {
+    band_collection bands;
+    bands.add(band("B02"));
+    bands.add(band("B03"));
+    bands.add(band("B04"));
+
+    std::shared_ptr<chunk_data> c = std::make_shared<chunk_data>();
+    c->size({3, 1, 1, 2});
+    c->buf(std::calloc(6, sizeof(double)));
+    for (uint16_t i = 0; i < 6; ++i) ((double *)c->buf())[i] = i + 0.5;
+
+    // default: all bands as doubles without copying
+    stream_format f;
+    REQUIRE(f.header_prefix().empty());
+    std::shared_ptr<stream_payload> p = f.payload(c, f.band_indexes(bands));
+    REQUIRE(p->segments.size() == 3);
+    REQUIRE(p->segments[0].first == (const char *)c->buf());
+    REQUIRE(p->segments[2].first == (const char *)c->buf() + 4 * sizeof(double));
+    REQUIRE(p->size() == 6 * sizeof(double));
+
+    // band subset as float32
+    stream_format g({"B04", "B02"}, true);
+    std::vector<uint16_t> idx = g.band_indexes(bands);
+    REQUIRE(idx == std::vector<uint16_t>({2, 0}));
+    std::string prefix = g.header_prefix();
+    REQUIRE(prefix.size() == 2 * sizeof(int));
+    REQUIRE(((const int *)prefix.data())[0] == -2);
+    REQUIRE(((const int *)prefix.data())[1] == 4);
+    p = g.payload(c, idx);
+    REQUIRE(p->size() == 4 * sizeof(float));
+    REQUIRE(((const float *)p->segments[0].first)[0] == 4.5f);
+    REQUIRE(((const float *)p->segments[1].first)[1] == 1.5f);
+
+    REQUIRE_THROWS(stream_format({"B08"}, false).band_indexes(bands));
+
+    json11::Json::object j;
+    g.to_json(j);
+    stream_format h = stream_format::from_json(j);
+    REQUIRE(h.bands() == g.bands());
+    REQUIRE(h.float32());
+}
+
+TEST_CASE("Streaming output format", "[stream_format]") {
+    // version 1: sizes followed by doubles
+    std::string v1;
+    int size[] = {1, 1, 1, 3};
+    double dvalues[] = {1, 2, 3};
+    v1.append((char *)size, sizeof(size));
+    v1.append((char *)dvalues, sizeof(dvalues));
+
+    // version 2: -2, bytes per value, sizes, and floats
+    std::string v2;
+    int prefix[] = {-2, 4};
+    float fvalues[] = {4, 5, 6};
+    v2.append((char *)prefix, sizeof(prefix));
+    v2.append((char *)size, sizeof(size));
+    v2.append((char *)fvalues, sizeof(fvalues));
+
+    std::shared_ptr<chunk_data> a = stream_format::decode_output(v1.data(), v1.size());
+    REQUIRE(a->size()[3] == 3);
+    REQUIRE(((double *)a->buf())[2] == 3);
+    std::shared_ptr<chunk_data> b = stream_format::decode_output(v2.data(), v2.size());
+    REQUIRE(b->size()[3] == 3);
+    REQUIRE(((double *)b->buf())[2] == 6);
+
+    // incremental parsing of a sequence of results, one byte at a time
+    std::string seq = v2 + v1 + v2;
+    stream_output_reader reader;
+    std::deque<std::shared_ptr<chunk_data>> results;
+    for (std::size_t i = 0; i < seq.size(); ++i) {
+        reader.read(seq.data() + i, 1, results);
+    }
+    REQUIRE(results.size() == 3);
+    REQUIRE(((double *)results[0]->buf())[0] == 4);
+    REQUIRE(((double *)results[1]->buf())[1] == 2);
+    REQUIRE(((double *)results[2]->buf())[2] == 6);
+
+    std::string v3 = v2;
+    ((int *)&v3[0])[0] = -3;
+    REQUIRE_THROWS(stream_format::decode_output(v3.data(), v3.size()));
+}
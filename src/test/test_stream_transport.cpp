@@ -0,0 +1,159 @@
+/*
+    MIT License
+
+    Copyright (c) 2019 Marius Appel <marius.appel@uni-muenster.de>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+
+#ifndef _WIN32
+
+#include <algorithm>
+#include <set>
+#include <thread>
+
+#include "../dummy.h"
+#include "../stream_transport.h"
+#include "../external/catch.hpp"
+#include "test_helpers.h"
+
+using namespace gdalcubes;
+
+TEST_CASE("Stream transport", "[stream_transport]") {
+    std::string header(4 * sizeof(int), 0);
+    double values[] = {1, 2, 3};
+    bool shared_memory = config::instance()->get_streaming_shared_memory();
+    uint16_t n = filesystem::is_directory("/dev/shm") ? 2 : 1;  // shared memory objects are accessible as files on Linux only
+    for (uint16_t i = 0; i < n; ++i) {
+        config::instance()->set_streaming_shared_memory(i == 1);
+        // the output is a copy of the input
+        std::shared_ptr<stream_output> out = stream_transport::run("cp \"$GDALCUBES_STREAMING_FILE_IN\" \"$GDALCUBES_STREAMING_FILE_OUT\"", 0, header, stream_payload(values, sizeof(values)));
+        REQUIRE(out->size() == header.size() + sizeof(values));
+        REQUIRE(((const double *)(out->data() + header.size()))[2] == 3);
+        REQUIRE_THROWS(stream_transport::run("exit 1", 0, header, stream_payload(values, sizeof(values))));
+
+        // pieces written in arbitrary order, unwritten parts are zero
+        out = stream_transport::run("cp \"$GDALCUBES_STREAMING_FILE_IN\" \"$GDALCUBES_STREAMING_FILE_OUT\"", 0, header, 4 * sizeof(double), [&values](stream_transport::sink write) {
+            write(2 * sizeof(double), (const char *)(values + 2), sizeof(double));
+            write(0, (const char *)values, 2 * sizeof(double));
+        });
+        REQUIRE(out->size() == header.size() + 4 * sizeof(double));
+        const double *res = (const double *)(out->data() + header.size());
+        REQUIRE(res[0] == 1);
+        REQUIRE(res[1] == 2);
+        REQUIRE(res[2] == 3);
+        REQUIRE(res[3] == 0);
+    }
+    config::instance()->set_streaming_shared_memory(shared_memory);
+}
+
+/**
+ * Dummy cube that records the chunks read in batches, batch reads fail if fail_batches is set
+ */
+class batch_recording_cube : public dummy_cube {
+   public:
+    batch_recording_cube(cube_view v) : dummy_cube(v, 1, 1.0), batches(), mtx(), fail_batches(false) {}
+    std::vector<std::shared_ptr<chunk_data>> read_chunks(std::vector<chunkid_t> ids) override {
+        std::lock_guard<std::mutex> lock(mtx);
+        batches.push_back(ids);
+        if (fail_batches) throw std::string("ERROR in batch_recording_cube::read_chunks(): batch read failed");
+        return dummy_cube::read_chunks(ids);
+    }
+    uint32_t read_batch_size() override { return 3; }
+    std::vector<std::vector<chunkid_t>> batches;
+    std::mutex mtx;
+    bool fail_batches;
+};
+
+TEST_CASE("Batched chunk reads", "[stream_transport]") {
+    // chunk processors read batches of the requested chunks only
+    cube_view v = test_cube_view();
+    std::shared_ptr<batch_recording_cube> c = std::make_shared<batch_recording_cube>(v);
+    c->set_chunk_size(1, 5, 5);
+    std::vector<chunkid_t> requested = {1, 4, 5, 8, 13, 21, 22, 30};
+    std::multiset<chunkid_t> received;
+    chunk_processor_multithread p(2);
+    p.apply(c, requested, [&received](chunkid_t id, std::shared_ptr<chunk_data> dat, std::mutex &m) {
+        std::lock_guard<std::mutex> lock(m);
+        received.insert(id);
+    });
+    REQUIRE(received == std::multiset<chunkid_t>(requested.begin(), requested.end()));
+    std::multiset<chunkid_t> batched;
+    for (uint16_t i = 0; i < c->batches.size(); ++i) {
+        REQUIRE(c->batches[i].size() <= 3);
+        batched.insert(c->batches[i].begin(), c->batches[i].end());
+    }
+    REQUIRE(!c->batches.empty());
+    REQUIRE(std::set<chunkid_t>(batched.begin(), batched.end()).size() == batched.size());  // no chunk is read twice
+    for (auto it = batched.begin(); it != batched.end(); ++it) {
+        REQUIRE(std::find(requested.begin(), requested.end(), *it) != requested.end());
+    }
+
+    // chunks of failed batch reads are read individually
+    c->fail_batches = true;
+    received.clear();
+    chunk_processor_singlethread ps;
+    ps.apply(c, requested, [&received](chunkid_t id, std::shared_ptr<chunk_data> dat, std::mutex &m) {
+        std::lock_guard<std::mutex> lock(m);
+        received.insert(id);
+    });
+    REQUIRE(received == std::multiset<chunkid_t>(requested.begin(), requested.end()));
+
+    // the output of the external program contains all chunks of a batch
+    int size[] = {1, 1, 1, 3};
+    std::string header((const char *)size, 4 * sizeof(int));
+    double values1[] = {1, 2, 3};
+    double values2[] = {4, 5, 6};
+    std::vector<std::shared_ptr<stream_payload>> data = {std::make_shared<stream_payload>(values1, sizeof(values1)), std::make_shared<stream_payload>(values2, sizeof(values2))};
+    std::vector<std::shared_ptr<chunk_data>> res = stream_transport::run_batch("test \"$GDALCUBES_STREAMING_BATCH\" = 2 && test \"$GDALCUBES_STREAMING_CHUNK_IDS\" = 3,5 && cp \"$GDALCUBES_STREAMING_FILE_IN\" \"$GDALCUBES_STREAMING_FILE_OUT\"", {3, 5}, {header, header}, data);
+    REQUIRE(res.size() == 2);
+    REQUIRE(((double *)res[0]->buf())[2] == 3);
+    REQUIRE(((double *)res[1]->buf())[0] == 4);
+    REQUIRE_THROWS(stream_transport::run_batch("head -c 40 \"$GDALCUBES_STREAMING_FILE_IN\" > \"$GDALCUBES_STREAMING_FILE_OUT\"", {3, 5}, {header, header}, data));  // first chunk only
+}
+
+TEST_CASE("Streaming child process environment", "[stream_transport]") {
+    TinyProcessLib::Process::environment_type env = stream_transport::child_environment({{"GDALCUBES_STREAMING", "1"}});
+    REQUIRE(env["GDALCUBES_STREAMING"] == "1");
+    REQUIRE(env.count("PATH") == 1);
+    REQUIRE(getenv("GDALCUBES_STREAMING") == nullptr);
+
+    // concurrent child processes see their own chunk id only
+    std::string header(4 * sizeof(int), 0);
+    double values[] = {1, 2, 3};
+    std::vector<std::thread> workers;
+    std::vector<bool> ok(8, false);
+    for (uint16_t i = 0; i < ok.size(); ++i) {
+        workers.push_back(std::thread([i, &ok, &header, &values]() {
+            try {
+                stream_transport::run("test \"$GDALCUBES_STREAMING_CHUNK_ID\" = " + std::to_string(i) + " && cp \"$GDALCUBES_STREAMING_FILE_IN\" \"$GDALCUBES_STREAMING_FILE_OUT\"", i, header, stream_payload(values, sizeof(values)));
+                ok[i] = true;
+            } catch (std::string s) {
+            }
+        }));
+    }
+    for (uint16_t i = 0; i < workers.size(); ++i) {
+        workers[i].join();
+    }
+    REQUIRE(std::count(ok.begin(), ok.end(), true) == 8);
+    REQUIRE(getenv("GDALCUBES_STREAMING_CHUNK_ID") == nullptr);
+}
+
+#endif
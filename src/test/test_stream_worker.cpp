@@ -0,0 +1,101 @@
+/*
+    MIT License
+
+    Copyright (c) 2019 Marius Appel <marius.appel@uni-muenster.de>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#ifndef _WIN32
+
+#include <signal.h>
+
+#include <fstream>
+
+#include "../filesystem.h"
+#include "../stream_worker.h"
+#include "../external/catch.hpp"
+
+using namespace gdalcubes;
+
+/**
+ * Input frame that is echoed by cat as a valid result chunk of size (1, 1, 1, 2)
+ */
+static std::string echo_header() {
+    int size[] = {1, 1, 1, 2};
+    return std::string((char *)size, 4 * sizeof(int));
+}
+
+TEST_CASE("Persistent stream worker", "[stream_worker]") {
+    stream_worker w("cat");
+    for (uint16_t i = 0; i < 3; ++i) {
+        double values[] = {double(i), NAN};
+        std::shared_ptr<chunk_data> out = w.process(echo_header(), stream_payload(values, sizeof(values)));
+        REQUIRE(out->size()[3] == 2);
+        REQUIRE(((double *)out->buf())[0] == i);
+        REQUIRE(std::isnan(((double *)out->buf())[1]));
+    }
+    REQUIRE(w.nprocessed() == 3);
+    REQUIRE(w.alive());
+}
+
+TEST_CASE("Persistent stream worker with invalid output", "[stream_worker]") {
+    // the worker writes an unsupported format version and keeps running
+    std::string pidfile = filesystem::join(filesystem::get_tempdir(), "test_stream_worker_invalid.pid");
+    stream_worker w("echo $$ > " + pidfile + "; printf '\\200\\377\\377\\377'; exec sleep 30");
+    double values[] = {1, 2};
+    REQUIRE_THROWS(w.process(echo_header(), stream_payload(values, sizeof(values))));
+    REQUIRE(!w.alive());
+
+    // the process is killed and reaped nevertheless
+    w.kill();
+    int pid = 0;
+    std::ifstream(pidfile) >> pid;
+    REQUIRE(pid > 0);
+    REQUIRE(::kill(pid, 0) != 0);
+    filesystem::remove(pidfile);
+}
+
+TEST_CASE("Persistent stream worker pool", "[stream_worker]") {
+    stream_worker_pool p("cat", 2);
+    double values[] = {1, 2};
+    std::shared_ptr<chunk_data> out = p.process(echo_header(), stream_payload(values, sizeof(values)));
+    REQUIRE(((double *)out->buf())[1] == 2);
+
+    // crashing workers are restarted once before the chunk fails
+    stream_worker_pool q("exit 3", 2);
+    REQUIRE_THROWS(q.process(echo_header(), stream_payload(values, sizeof(values))));
+}
+
+TEST_CASE("Persistent stream worker pool retries broken pipes", "[stream_worker]") {
+    // the first worker closes its input but keeps running, writing the chunk fails with a broken pipe
+    std::string marker = filesystem::join(filesystem::get_tempdir(), "test_stream_worker_pool.marker");
+    if (filesystem::exists(marker)) filesystem::remove(marker);
+    stream_worker_pool p("if [ -e " + marker + " ]; then exec cat; fi; touch " + marker + "; exec 0<&-; sleep 30", 1);
+
+    // larger than a pipe buffer such that the first write blocks until the input has been closed
+    std::vector<double> values(256 * 1024, 1.0);
+    int size[] = {1, 1, 1, int(values.size())};
+    std::shared_ptr<chunk_data> out = p.process(std::string((char *)size, 4 * sizeof(int)), stream_payload(values.data(), values.size() * sizeof(double)));
+    REQUIRE(out->size()[3] == values.size());
+    REQUIRE(((double *)out->buf())[values.size() - 1] == 1.0);
+    filesystem::remove(marker);
+}
+
+#endif
@@ -0,0 +1,225 @@
+/*
+    MIT License
+
+    Copyright (c) 2019 Marius Appel <marius.appel@uni-muenster.de>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#ifndef _WIN32
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <set>
+#include <sstream>
+
+#include "../dummy.h"
+#include "../swarm.h"
+#include "../external/catch.hpp"
+#include "test_helpers.h"
+
+using namespace gdalcubes;
+
+/**
+ * Encoded chunk of the mock server, filled with the chunk id
+ */
+static std::string mock_chunk(chunkid_t id) {
+    std::shared_ptr<chunk_data> c = std::make_shared<chunk_data>();
+    c->size({1, 1, 2, 2});
+    c->buf(std::malloc(4 * sizeof(double)));
+    for (uint16_t i = 0; i < 4; ++i) ((double *)c->buf())[i] = id;
+    std::vector<unsigned char> bytes = chunk_codec::encode(c, chunk_codec::DEFLATE);
+    return std::string(bytes.begin(), bytes.end());
+}
+
+/**
+ * Minimal single-threaded HTTP server emulating the part of the gdalcubes_server API that is used by gdalcubes_swarm,
+ * optionally without batch requests. Runs in a child process until it is killed.
+ */
+static void mock_server_run(int fd, uint32_t delay_ms, bool batch) {
+    while (1) {
+        int conn = accept(fd, nullptr, nullptr);
+        if (conn < 0) continue;
+
+        // read request header and body
+        std::string req;
+        char buf[4096];
+        std::size_t header_end = std::string::npos;
+        std::size_t content_length = 0;
+        while (1) {
+            ssize_t n = read(conn, buf, sizeof(buf));
+            if (n <= 0) break;
+            req.append(buf, n);
+            if (header_end == std::string::npos) {
+                header_end = req.find("\r\n\r\n");
+                if (header_end != std::string::npos) {
+                    std::size_t pos = req.find("Content-Length: ");
+                    if (pos != std::string::npos && pos < header_end) {
+                        content_length = std::stoul(req.substr(pos + 16));
+                    }
+                }
+            }
+            if (header_end != std::string::npos && req.size() >= header_end + 4 + content_length) break;
+        }
+
+        std::string method = req.substr(0, req.find(' '));
+        std::string path = req.substr(method.size() + 1, req.find(' ', method.size() + 1) - method.size() - 1);
+        std::string query = path.find('?') == std::string::npos ? "" : path.substr(path.find('?') + 1);
+        path = path.substr(0, path.find('?'));
+        std::vector<std::string> parts;
+        std::stringstream ss(path.substr(1));
+        std::string part;
+        while (std::getline(ss, part, '/')) parts.push_back(part);
+
+        std::string status = "200 OK";
+        std::string body;
+        if (parts.size() == 4 && parts[3] == "download") {
+            // /cube/{cube_id}/{chunk_id}/download
+            body = mock_chunk(std::stoi(parts[2]));
+            usleep(delay_ms * 1000);
+        } else if (parts.size() == 3 && !batch) {
+            status = "404 Not Found";
+        } else if (parts.size() == 3 && parts[2] == "download") {
+            // /cube/{cube_id}/download?chunks=1,2,3
+            std::string chunks = query.substr(query.find("chunks=") + 7);
+            std::stringstream ids(chunks.substr(0, chunks.find('&')));
+            std::string id;
+            while (std::getline(ids, id, ',')) {
+                std::string c = mock_chunk(std::stoi(id));
+                std::vector<unsigned char> frame = chunk_codec::encode_frame(std::stoi(id), chunk_codec::FRAME_OK, std::vector<unsigned char>(c.begin(), c.end()));
+                body += std::string(frame.begin(), frame.end());
+                usleep(delay_ms * 1000);
+            }
+        } else if (parts.size() == 3 && parts[2] == "status") {
+            body = "{}";
+        } else if (path == "/files/missing") {
+            body = "[]";
+        } else if (path == "/cube" && method == "POST") {
+            body = "0";
+        } else if (path == "/version") {
+            body = "mock";
+        }
+
+        std::string response = "HTTP/1.1 " + status + "\r\nConnection: close\r\nContent-Length: " + std::to_string(method == "HEAD" ? 0 : body.size()) + "\r\n\r\n";
+        if (method != "HEAD") response += body;
+        std::size_t written = 0;
+        while (written < response.size()) {
+            ssize_t n = write(conn, response.data() + written, response.size() - written);
+            if (n <= 0) break;
+            written += n;
+        }
+        close(conn);
+    }
+}
+
+/**
+ * Start a mock server in a child process on a random port of localhost, returns the process id and sets the URL
+ */
+static pid_t mock_server_start(std::string &url, uint32_t delay_ms, bool batch) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    struct sockaddr_in addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = 0;
+    bind(fd, (struct sockaddr *)&addr, sizeof(addr));
+    listen(fd, 64);
+    socklen_t len = sizeof(addr);
+    getsockname(fd, (struct sockaddr *)&addr, &len);
+    url = "http://127.0.0.1:" + std::to_string(ntohs(addr.sin_port));
+
+    pid_t pid = fork();
+    if (pid == 0) {
+        mock_server_run(fd, delay_ms, batch);
+        _exit(0);
+    }
+    close(fd);
+    return pid;
+}
+
+TEST_CASE("Swarm completes chunks of killed servers", "[swarm]") {
+    std::vector<std::string> urls(3);
+    std::vector<pid_t> pids;
+    for (uint16_t i = 0; i < urls.size(); ++i) {
+        pids.push_back(mock_server_start(urls[i], 20, i < 2));  // the last server does not support batch requests
+    }
+
+    cube_view v = test_cube_view();
+    std::shared_ptr<dummy_cube> c = dummy_cube::create(v, 1, 1.0);
+    c->set_chunk_size(1, 5, 5);
+    uint32_t nchunks = c->count_chunks();
+
+    std::shared_ptr<gdalcubes_swarm> swarm = gdalcubes_swarm::from_urls(urls);
+    swarm->set_retry(5, 0.01);
+    swarm->set_health_check(1, 1);
+
+    std::set<chunkid_t> received;
+    uint32_t ncalls = 0;
+    bool wrong_data = false;
+    swarm->apply(c, [&](chunkid_t id, std::shared_ptr<chunk_data> dat, std::mutex &m) {
+        std::lock_guard<std::mutex> lock(m);
+        ++ncalls;
+        received.insert(id);
+        if (dat->empty() || ((double *)dat->buf())[0] != id) wrong_data = true;
+        if (ncalls == 5) {
+            // kill two of the servers mid-run
+            kill(pids[0], SIGKILL);
+            kill(pids[1], SIGKILL);
+        }
+    });
+
+    for (uint16_t i = 0; i < pids.size(); ++i) {
+        kill(pids[i], SIGKILL);
+        waitpid(pids[i], nullptr, 0);
+    }
+
+    REQUIRE(received.size() == nchunks);
+    REQUIRE(ncalls == nchunks);
+    REQUIRE(!wrong_data);
+    std::vector<swarm_server_stats> stats = swarm->server_stats();
+    REQUIRE(stats[0].chunks + stats[1].chunks + stats[2].chunks == nchunks);
+}
+
+TEST_CASE("Swarm processes duplicate chunk ids once", "[swarm]") {
+    std::string url;
+    pid_t pid = mock_server_start(url, 0, true);
+
+    std::shared_ptr<dummy_cube> c = dummy_cube::create(test_cube_view(), 1, 1.0);
+    c->set_chunk_size(1, 5, 5);
+    std::shared_ptr<gdalcubes_swarm> swarm = gdalcubes_swarm::from_urls({url});
+
+    std::multiset<chunkid_t> received;
+    swarm->apply(c, {3, 1, 3, 1, 7}, [&](chunkid_t id, std::shared_ptr<chunk_data> dat, std::mutex &m) {
+        std::lock_guard<std::mutex> lock(m);
+        received.insert(id);
+    });
+
+    kill(pid, SIGKILL);
+    waitpid(pid, nullptr, 0);
+    REQUIRE(received == std::multiset<chunkid_t>{1, 3, 7});
+}
+
+#endif
@@ -0,0 +1,74 @@
+/*
+    MIT License
+
+    Copyright (c) 2019 Marius Appel <marius.appel@uni-muenster.de>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#include "../dummy.h"
+#include "../udf_apply_pixel.h"
+#include "../udf_apply_time.h"
+#include "../udf_reduce_time.h"
+#include "../cube_factory.h"
+#include "../external/catch.hpp"
+#include "test_helpers.h"
+
+using namespace gdalcubes;
+
+TEST_CASE("UDF plugin", "[udf]") {
+    REQUIRE_THROWS(udf_plugin("does_not_exist.so", "test_udf_double"));
+    REQUIRE_THROWS(udf_plugin(GDALCUBES_TEST_UDF_LIBRARY, "does_not_exist"));
+
+    std::shared_ptr<chunk_data> in = std::make_shared<chunk_data>();
+    in->size({1, 1, 1, 3});
+    in->buf(std::malloc(3 * sizeof(double)));
+    for (uint16_t i = 0; i < 3; ++i) ((double *)in->buf())[i] = i;
+    double out[3];
+    udf_plugin f(GDALCUBES_TEST_UDF_LIBRARY, "test_udf_double");
+    f.call(in, out, {1, 1, 1, 3});
+    REQUIRE(out[2] == 4);
+    REQUIRE_THROWS(udf_plugin(GDALCUBES_TEST_UDF_LIBRARY, "test_udf_fail").call(in, out, {1, 1, 1, 3}));
+}
+
+TEST_CASE("UDF cubes", "[udf]") {
+    std::shared_ptr<dummy_cube> c = dummy_cube::create(test_cube_view(), 1, 1.0);
+    c->set_chunk_size(4, 5, 5);
+
+    std::shared_ptr<udf_apply_pixel_cube> p = udf_apply_pixel_cube::create(c, GDALCUBES_TEST_UDF_LIBRARY, "test_udf_double", 1, {"y"}, true);
+    REQUIRE(p->size_bands() == 2);
+    std::shared_ptr<chunk_data> x = p->read_chunk(0);
+    REQUIRE(((double *)x->buf())[0] == 1);
+    REQUIRE(((double *)x->buf())[x->size()[1] * x->size()[2] * x->size()[3]] == 2);
+
+    std::shared_ptr<udf_apply_time_cube> a = udf_apply_time_cube::create(c, GDALCUBES_TEST_UDF_LIBRARY, "test_udf_double", 1);
+    x = a->read_chunk(0);
+    REQUIRE(x->size()[1] == 10);
+    REQUIRE(((double *)x->buf())[9 * 25] == 2);
+
+    std::shared_ptr<udf_reduce_time_cube> r = udf_reduce_time_cube::create(c, GDALCUBES_TEST_UDF_LIBRARY, "test_udf_sum_time", 1);
+    REQUIRE(r->size_t() == 1);
+    x = r->read_chunk(3);
+    REQUIRE(x->size()[1] == 1);
+    REQUIRE(((double *)x->buf())[0] == 10);
+
+    // cubes can be recreated from their JSON representation
+    std::shared_ptr<cube> r2 = cube_factory::instance()->create_from_json(r->make_constructible_json());
+    REQUIRE(((double *)r2->read_chunk(3)->buf())[24] == 10);
+}
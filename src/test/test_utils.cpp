@@ -0,0 +1,72 @@
+/*
+    MIT License
+
+    Copyright (c) 2019 Marius Appel <marius.appel@uni-muenster.de>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+
+#include "../utils.h"
+#include "../external/catch.hpp"
+
+using namespace gdalcubes;
+
+static std::string sha256_string(std::string s) {
+    sha256 h;
+    h.update(s.data(), s.size());
+    return h.hexdigest();
+}
+
+TEST_CASE("SHA-256", "[utils]") {
+    REQUIRE(sha256_string("") == "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855");
+    REQUIRE(sha256_string("abc") == "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad");
+    REQUIRE(sha256_string("abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq") == "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1");
+
+    // incremental updates with pieces crossing block boundaries
+    sha256 h;
+    std::string a(1000, 'a');
+    for (uint16_t i = 0; i < 1000; ++i) {
+        h.update(a.data(), a.size());
+    }
+    REQUIRE(h.hexdigest() == "cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0");
+}
+
+TEST_CASE("Block compression", "[utils]") {
+    std::vector<unsigned char> data(300000);
+    for (uint32_t i = 0; i < data.size(); ++i) {
+        data[i] = (i / 7) % 251;
+    }
+    std::vector<unsigned char> stream;
+    for (uint32_t i = 0; i < data.size(); i += 65536) {
+        std::vector<unsigned char> block = utils::deflate_block(data.data() + i, std::min((std::size_t)65536, data.size() - i));
+        stream.insert(stream.end(), block.begin(), block.end());
+    }
+    REQUIRE(stream.size() < data.size());
+
+    std::vector<unsigned char> out;
+    block_inflater inflater([&out](const unsigned char *buf, std::size_t n) {
+        out.insert(out.end(), buf, buf + n);
+    });
+    for (std::size_t pos = 0; pos < stream.size(); pos += 1000) {
+        inflater.feed(stream.data() + pos, std::min((std::size_t)1000, stream.size() - pos));
+    }
+    REQUIRE(inflater.complete());
+    REQUIRE(out == data);
+}
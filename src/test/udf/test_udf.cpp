@@ -0,0 +1,69 @@
+/*
+    MIT License
+
+    Copyright (c) 2019 Marius Appel <marius.appel@uni-muenster.de>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+/*
+ * UDF plugin library for the tests, see udf.h
+ */
+
+#include <cmath>
+#include <cstdint>
+
+extern "C" {
+
+/**
+ * Multiplies all values of the first band with 2
+ */
+int test_udf_double(const double *in, const uint32_t *in_size, double *out, const uint32_t *out_size) {
+    if (out_size[0] != 1) return 1;
+    uint64_t n = uint64_t(in_size[1]) * in_size[2] * in_size[3];
+    for (uint64_t i = 0; i < n; ++i) {
+        out[i] = 2 * in[i];
+    }
+    return 0;
+}
+
+/**
+ * Sums time series of the first band, ignoring NAN
+ */
+int test_udf_sum_time(const double *in, const uint32_t *in_size, double *out, const uint32_t *out_size) {
+    if (out_size[0] != 1 || out_size[1] != 1) return 1;
+    uint64_t nxy = uint64_t(in_size[2]) * in_size[3];
+    for (uint64_t ixy = 0; ixy < nxy; ++ixy) {
+        double sum = 0;
+        for (uint32_t it = 0; it < in_size[1]; ++it) {
+            double v = in[it * nxy + ixy];
+            if (!std::isnan(v)) sum += v;
+        }
+        out[ixy] = sum;
+    }
+    return 0;
+}
+
+/**
+ * Always fails
+ */
+int test_udf_fail(const double *in, const uint32_t *in_size, double *out, const uint32_t *out_size) {
+    return 42;
+}
+}
@@ -0,0 +1,109 @@
+/*
+    MIT License
+
+    Copyright (c) 2019 Marius Appel <marius.appel@uni-muenster.de>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#include "udf.h"
+
+#include <map>
+#include <mutex>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <dlfcn.h>
+#endif
+
+namespace gdalcubes {
+
+void *udf_plugin::open_library(std::string library) {
+    static std::mutex mtx;
+    static std::map<std::string, void *> handles;  // never closed, function pointers of cubes must remain valid
+    std::lock_guard<std::mutex> lock(mtx);
+    auto it = handles.find(library);
+    if (it != handles.end()) {
+        return it->second;
+    }
+#ifdef _WIN32
+    void *handle = (void *)LoadLibraryA(library.c_str());
+    std::string err = handle ? "" : "error code " + std::to_string(GetLastError());
+#else
+    void *handle = dlopen(library.c_str(), RTLD_NOW | RTLD_LOCAL);
+    std::string err = handle ? "" : std::string(dlerror());
+#endif
+    if (!handle) {
+        GCBS_ERROR("Cannot load UDF library '" + library + "': " + err);
+        throw std::string("ERROR in udf_plugin::udf_plugin(): cannot load UDF library '" + library + "'");
+    }
+    handles[library] = handle;
+    return handle;
+}
+
+udf_plugin::udf_plugin(std::string library, std::string symbol) : _library(library), _symbol(symbol), _f(nullptr) {
+    void *handle = open_library(library);
+#ifdef _WIN32
+    _f = (gdalcubes_udf_func)GetProcAddress((HMODULE)handle, symbol.c_str());
+#else
+    _f = (gdalcubes_udf_func)dlsym(handle, symbol.c_str());
+#endif
+    if (!_f) {
+        GCBS_ERROR("UDF library '" + library + "' does not export a function '" + symbol + "'");
+        throw std::string("ERROR in udf_plugin::udf_plugin(): UDF library '" + library + "' does not export a function '" + symbol + "'");
+    }
+}
+
+void udf_plugin::call(std::shared_ptr<chunk_data> in, double *out, coords_nd<uint32_t, 4> out_size) {
+    uint32_t in_size[] = {in->size()[0], in->size()[1], in->size()[2], in->size()[3]};
+    uint32_t size[] = {out_size[0], out_size[1], out_size[2], out_size[3]};
+    int ret = _f((const double *)in->buf(), in_size, out, size);
+    if (ret != 0) {
+        GCBS_ERROR("UDF '" + _symbol + "' returned error code " + std::to_string(ret));
+        throw std::string("ERROR in udf_plugin::call(): UDF '" + _symbol + "' returned error code " + std::to_string(ret));
+    }
+}
+
+std::shared_ptr<chunk_data> udf_plugin::read_time_series(std::shared_ptr<cube> in, chunkid_t id) {
+    std::shared_ptr<chunk_data> out = std::make_shared<chunk_data>();
+    coords_nd<uint32_t, 3> size_tyx = in->chunk_size(id);
+    coords_nd<uint32_t, 4> size_btyx = {uint32_t(in->size_bands()), in->size_t(), size_tyx[1], size_tyx[2]};
+    out->size(size_btyx);
+    std::size_t nxy = std::size_t(size_btyx[2]) * size_btyx[3];
+    out->buf(std::calloc(size_btyx[0] * size_btyx[1] * nxy, sizeof(double)));
+    std::fill((double *)out->buf(), ((double *)out->buf()) + size_btyx[0] * size_btyx[1] * nxy, NAN);
+
+    // copy each band of the input chunks as a contiguous block
+    uint32_t t0 = 0;
+    for (chunkid_t i = id; i < in->count_chunks(); i += in->count_chunks_x() * in->count_chunks_y()) {
+        std::shared_ptr<chunk_data> x = in->read_chunk(i);
+        uint32_t nt = in->chunk_size(i)[0];
+        if (!x->empty()) {
+            for (uint16_t ib = 0; ib < size_btyx[0]; ++ib) {
+                std::memcpy(((double *)out->buf()) + (ib * std::size_t(size_btyx[1]) + t0) * nxy,
+                            ((double *)x->buf()) + ib * std::size_t(x->size()[1]) * nxy, sizeof(double) * x->size()[1] * nxy);
+            }
+        }
+        t0 += nt;
+    }
+    return out;
+}
+
+}  // namespace gdalcubes
@@ -0,0 +1,93 @@
+/*
+    MIT License
+
+    Copyright (c) 2019 Marius Appel <marius.appel@uni-muenster.de>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#ifndef UDF_H
+#define UDF_H
+
+#include "cube.h"
+
+extern "C" {
+/**
+ * @brief Signature of user-defined functions in plugin libraries
+ *
+ * Plugins are shared libraries that export functions with this signature and C linkage, e.g.
+ * `extern "C" int my_udf(const double *in, const uint32_t *in_size, double *out, const uint32_t *out_size)`.
+ * Buffers contain the chunk data in band, time, y, x order, sizes are given as four integers (bands, time, y, x).
+ * The output buffer is initialized with NAN. Functions are called from several threads at the same time and must be
+ * reentrant.
+ * @param in input chunk data
+ * @param in_size size of the input chunk
+ * @param out output chunk data
+ * @param out_size size of the output chunk
+ * @return 0 on success, any other value is considered as an error
+ */
+typedef int (*gdalcubes_udf_func)(const double *in, const uint32_t *in_size, double *out, const uint32_t *out_size);
+}
+
+namespace gdalcubes {
+
+/**
+ * @brief A user-defined function from a shared library that is called in-process on chunk buffers
+ *
+ * Libraries are loaded once per process and stay loaded until the process exits.
+ */
+class udf_plugin {
+   public:
+    /**
+     * @brief Load a user-defined function from a shared library
+     * @param library path of the shared library
+     * @param symbol name of the exported function
+     */
+    udf_plugin(std::string library, std::string symbol);
+
+    /**
+     * @brief Call the function on a chunk
+     * @param in input chunk, must not be empty
+     * @param out output buffer, initialized with NAN
+     * @param out_size size of the output buffer
+     */
+    void call(std::shared_ptr<chunk_data> in, double *out, coords_nd<uint32_t, 4> out_size);
+
+    inline std::string library() { return _library; }
+    inline std::string symbol() { return _symbol; }
+
+    /**
+     * @brief Read the complete time series of a spatial chunk column
+     * @param in input data cube
+     * @param id id of the first chunk of the column
+     * @return chunk with all bands and time slices of the input cube, missing values are NAN
+     */
+    static std::shared_ptr<chunk_data> read_time_series(std::shared_ptr<cube> in, chunkid_t id);
+
+   private:
+    static void *open_library(std::string library);
+
+    std::string _library;
+    std::string _symbol;
+    gdalcubes_udf_func _f;
+};
+
+}  // namespace gdalcubes
+
+#endif  //UDF_H
@@ -0,0 +1,117 @@
+/*
+    MIT License
+
+    Copyright (c) 2019 Marius Appel <marius.appel@uni-muenster.de>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#ifndef UDF_APPLY_PIXEL_H
+#define UDF_APPLY_PIXEL_H
+
+#include "cube.h"
+#include "udf.h"
+
+namespace gdalcubes {
+
+/**
+ * @brief A data cube that applies a user-defined function from a shared library on all chunks of a data cube
+ */
+class udf_apply_pixel_cube : public cube {
+   public:
+    /**
+        * @brief Create a data cube that applies a user-defined function from a shared library on all chunks, producing new bands with the same time series
+        * @note This static creation method should preferably be used instead of the constructors as
+        * the constructors will not set connections between cubes properly.
+        * @param in input data cube
+        * @param library path of the shared library
+        * @param symbol name of the function exported by the library, see gdalcubes_udf_func
+        * @param nbands number of new bands in the output cube
+        * @param names string vector of output band names, must have the size nbands or empty (the default). If empty,
+        * output bands will be named "x1", "x2", ...
+        * @param keep_bands if true, bands will be added to the existing bands of the input cube, otherwise (default) they are dropped
+        * @return a shared pointer to the created data cube instance
+        */
+    static std::shared_ptr<udf_apply_pixel_cube>
+    create(std::shared_ptr<cube> in, std::string library, std::string symbol, uint16_t nbands,
+           std::vector<std::string> names = std::vector<std::string>(), bool keep_bands = false) {
+        std::shared_ptr<udf_apply_pixel_cube> out = std::make_shared<udf_apply_pixel_cube>(in, library, symbol, nbands, names, keep_bands);
+        in->add_child_cube(out);
+        out->add_parent_cube(in);
+        return out;
+    }
+
+   public:
+    udf_apply_pixel_cube(std::shared_ptr<cube> in, std::string library, std::string symbol, uint16_t nbands,
+          std::vector<std::string> names = std::vector<std::string>(), bool keep_bands = false) : cube(in->st_reference()->copy()), _in_cube(in), _udf(library, symbol), _nbands(nbands), _names(names), _keep_bands(keep_bands) {  // it is important to duplicate st reference here, otherwise changes will affect input cube as well
+        _chunk_size[0] = _in_cube->chunk_size()[0];
+        _chunk_size[1] = _in_cube->chunk_size()[1];
+        _chunk_size[2] = _in_cube->chunk_size()[2];
+
+        if (!names.empty()) {
+            if (names.size() != nbands) {
+                GCBS_ERROR("size of names is different to nbands");
+                throw std::string("ERROR in udf_apply_pixel_cube::udf_apply_pixel_cube(): size of names is different to nbands");
+            }
+        }
+
+        if (_keep_bands) {
+            for (uint16_t i = 0; i < _in_cube->size_bands(); ++i) {
+                _bands.add(_in_cube->bands().get(i));
+            }
+        }
+
+        for (uint16_t i = 0; i < nbands; ++i) {
+            std::string name;
+            if (!_names.empty())
+                name = _names[i];
+            else
+                name = "x" + std::to_string(i + 1);
+            _bands.add(band(name));
+        }
+    }
+
+   public:
+    ~udf_apply_pixel_cube() {}
+
+    std::shared_ptr<chunk_data> read_chunk(chunkid_t id) override;
+
+    json11::Json make_constructible_json() override {
+        json11::Json::object out;
+        out["cube_type"] = "udf_apply_pixel";
+        out["library"] = _udf.library();
+        out["symbol"] = _udf.symbol();
+        out["nbands"] = _nbands;
+        out["names"] = _names;
+        out["keep_bands"] = _keep_bands;
+        out["in_cube"] = _in_cube->make_constructible_json();
+        return out;
+    }
+
+   private:
+    std::shared_ptr<cube> _in_cube;
+    udf_plugin _udf;
+    uint16_t _nbands;
+    std::vector<std::string> _names;
+    bool _keep_bands;
+};
+
+}  // namespace gdalcubes
+
+#endif  //UDF_APPLY_PIXEL_H
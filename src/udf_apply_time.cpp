@@ -0,0 +1,55 @@
+/*
+    MIT License
+
+    Copyright (c) 2019 Marius Appel <marius.appel@uni-muenster.de>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#include "udf_apply_time.h"
+
+namespace gdalcubes {
+
+std::shared_ptr<chunk_data> udf_apply_time_cube::read_chunk(chunkid_t id) {
+    GCBS_TRACE("udf_apply_time_cube::read_chunk(" + std::to_string(id) + ")");
+    std::shared_ptr<chunk_data> out = std::make_shared<chunk_data>();
+    if (id >= count_chunks())
+        return out;  // chunk is outside of the view, we don't need to read anything.
+
+    // read the complete time series of the spatial chunk column
+    std::shared_ptr<chunk_data> in = udf_plugin::read_time_series(_in_cube, id);
+    coords_nd<uint32_t, 4> size_btyx = {_bands.count(), in->size()[1], in->size()[2], in->size()[3]};
+    out->size(size_btyx);
+
+    // Fill buffers accordingly
+    out->buf(std::calloc(size_btyx[0] * size_btyx[1] * size_btyx[2] * size_btyx[3], sizeof(double)));
+    double *begin = (double *)out->buf();
+    double *end = ((double *)out->buf()) + size_btyx[0] * size_btyx[1] * size_btyx[2] * size_btyx[3];
+    std::fill(begin, end, NAN);
+
+    std::size_t offset = 0;
+    if (_keep_bands) {
+        offset = std::size_t(in->size()[0]) * in->size()[1] * in->size()[2] * in->size()[3];
+        std::memcpy(out->buf(), in->buf(), sizeof(double) * offset);
+    }
+    _udf.call(in, ((double *)out->buf()) + offset, {_nbands, size_btyx[1], size_btyx[2], size_btyx[3]});
+    return out;
+}
+
+}  // namespace gdalcubes
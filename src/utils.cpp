@@ -24,6 +24,8 @@
 
 #include "utils.h"
 
+#include <cstring>
+#include <fstream>
 #include <functional>  // std::hash
 #include <iomanip>
 #include <mutex>
@@ -31,6 +33,8 @@
 #include <sstream>
 #include <string>
 
+#include <cpl_conv.h>
+
 namespace gdalcubes {
 
 std::string utils::generate_unique_filename(uint16_t n, std::string prefix, std::string suffix) {
@@ -124,4 +128,145 @@ std::string utils::hash(std::string in) {
     return std::to_string(str_hash);
 }
 
+std::string utils::sha256_file(std::string path) {
+    std::ifstream is(path, std::ios::in | std::ios::binary);
+    if (!is.is_open()) {
+        throw std::string("ERROR in utils::sha256_file(): cannot open file '" + path + "'");
+    }
+    sha256 h;
+    std::vector<char> buf(1024 * 1024);
+    while (is) {
+        is.read(buf.data(), buf.size());
+        h.update(buf.data(), is.gcount());
+    }
+    return h.hexdigest();
+}
+
+std::vector<unsigned char> utils::deflate_block(const void *data, uint32_t n, int level) {
+    std::size_t nout = 0;
+    void *compressed = CPLZLibDeflate(data, n, level, nullptr, 0, &nout);
+    if (!compressed) {
+        throw std::string("ERROR in utils::deflate_block(): compression failed");
+    }
+    std::vector<unsigned char> out(8 + nout);
+    uint32_t ncompressed = nout;
+    std::memcpy(out.data(), &ncompressed, sizeof(uint32_t));
+    std::memcpy(out.data() + 4, &n, sizeof(uint32_t));
+    std::memcpy(out.data() + 8, compressed, nout);
+    CPLFree(compressed);
+    return out;
+}
+
+void block_inflater::feed(const unsigned char *buf, std::size_t n) {
+    _buf.insert(_buf.end(), buf, buf + n);
+    std::vector<unsigned char> out;
+    while (_buf.size() - _pos >= 8) {
+        uint32_t ncompressed;
+        uint32_t nuncompressed;
+        std::memcpy(&ncompressed, _buf.data() + _pos, sizeof(uint32_t));
+        std::memcpy(&nuncompressed, _buf.data() + _pos + 4, sizeof(uint32_t));
+        if (_buf.size() - _pos - 8 < ncompressed) break;
+        out.resize(nuncompressed);
+        std::size_t nout = 0;
+        if (nuncompressed > 0 && (!CPLZLibInflate(_buf.data() + _pos + 8, ncompressed, out.data(), nuncompressed, &nout) || nout != nuncompressed)) {
+            throw std::string("ERROR in block_inflater::feed(): invalid compressed data");
+        }
+        _f(out.data(), nuncompressed);
+        _pos += 8 + ncompressed;
+    }
+    if (_pos == _buf.size()) {
+        _buf.clear();
+        _pos = 0;
+    } else if (_pos > _buf.size() / 2) {
+        _buf.erase(_buf.begin(), _buf.begin() + _pos);
+        _pos = 0;
+    }
+}
+
+static const uint32_t SHA256_K[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2};
+
+static inline uint32_t rotr(uint32_t x, uint32_t n) {
+    return (x >> n) | (x << (32 - n));
+}
+
+sha256::sha256() : _state{0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19}, _block(), _block_len(0), _total_len(0) {}
+
+void sha256::transform(const unsigned char *block) {
+    uint32_t w[64];
+    for (uint16_t i = 0; i < 16; ++i) {
+        w[i] = (uint32_t(block[4 * i]) << 24) | (uint32_t(block[4 * i + 1]) << 16) | (uint32_t(block[4 * i + 2]) << 8) | uint32_t(block[4 * i + 3]);
+    }
+    for (uint16_t i = 16; i < 64; ++i) {
+        uint32_t s0 = rotr(w[i - 15], 7) ^ rotr(w[i - 15], 18) ^ (w[i - 15] >> 3);
+        uint32_t s1 = rotr(w[i - 2], 17) ^ rotr(w[i - 2], 19) ^ (w[i - 2] >> 10);
+        w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+    uint32_t a = _state[0], b = _state[1], c = _state[2], d = _state[3], e = _state[4], f = _state[5], g = _state[6], h = _state[7];
+    for (uint16_t i = 0; i < 64; ++i) {
+        uint32_t t1 = h + (rotr(e, 6) ^ rotr(e, 11) ^ rotr(e, 25)) + ((e & f) ^ (~e & g)) + SHA256_K[i] + w[i];
+        uint32_t t2 = (rotr(a, 2) ^ rotr(a, 13) ^ rotr(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+        h = g;
+        g = f;
+        f = e;
+        e = d + t1;
+        d = c;
+        c = b;
+        b = a;
+        a = t1 + t2;
+    }
+    _state[0] += a;
+    _state[1] += b;
+    _state[2] += c;
+    _state[3] += d;
+    _state[4] += e;
+    _state[5] += f;
+    _state[6] += g;
+    _state[7] += h;
+}
+
+void sha256::update(const void *data, std::size_t n) {
+    const unsigned char *p = (const unsigned char *)data;
+    _total_len += n;
+    while (n > 0) {
+        std::size_t k = std::min(n, 64 - _block_len);
+        std::memcpy(_block + _block_len, p, k);
+        _block_len += k;
+        p += k;
+        n -= k;
+        if (_block_len == 64) {
+            transform(_block);
+            _block_len = 0;
+        }
+    }
+}
+
+std::string sha256::hexdigest() {
+    uint64_t nbits = _total_len * 8;
+    unsigned char pad = 0x80;
+    update(&pad, 1);
+    pad = 0;
+    while (_block_len != 56) {
+        update(&pad, 1);
+    }
+    unsigned char len[8];
+    for (uint16_t i = 0; i < 8; ++i) {
+        len[i] = (unsigned char)(nbits >> (56 - 8 * i));
+    }
+    update(len, 8);
+
+    std::stringstream ss;
+    for (uint16_t i = 0; i < 8; ++i) {
+        ss << std::hex << std::setw(8) << std::setfill('0') << _state[i];
+    }
+    return ss.str();
+}
+
 }  // namespace gdalcubes
\ No newline at end of file
@@ -26,6 +26,8 @@
 
 #include <gdal_priv.h>
 
+#include <functional>
+
 namespace gdalcubes {
 
 /**
@@ -77,6 +79,74 @@ class utils {
      * @return hashed string
      */
     static std::string hash(std::string in);
+
+    /**
+     * Compute the SHA-256 hash of a file, e.g. to identify files by their content
+     * @param path path of the file
+     * @return lower case hexadecimal digest
+     */
+    static std::string sha256_file(std::string path);
+
+    /**
+     * Compress a block of data for streamed transfers, see block_inflater
+     * @param data pointer to uncompressed data
+     * @param n number of bytes
+     * @param level zlib compression level (1-9)
+     * @return compressed size (uint32), uncompressed size (uint32), and zlib compressed data
+     */
+    static std::vector<unsigned char> deflate_block(const void *data, uint32_t n, int level = 1);
+};
+
+/**
+ * @brief Incremental decompression of a stream of blocks created with utils::deflate_block()
+ */
+class block_inflater {
+   public:
+    typedef std::function<void(const unsigned char *data, std::size_t n)> callback;
+
+    block_inflater(callback f) : _f(f), _buf(), _pos(0) {}
+
+    /**
+     * Append compressed bytes to the stream and call the callback with decompressed data of all blocks completed by these bytes
+     */
+    void feed(const unsigned char *buf, std::size_t n);
+
+    /**
+     * @return true if the stream ends at a block boundary
+     */
+    inline bool complete() const { return _pos == _buf.size(); }
+
+   private:
+    callback _f;
+    std::vector<unsigned char> _buf;
+    std::size_t _pos;
+};
+
+/**
+ * @brief Incremental SHA-256 hash computation
+ */
+class sha256 {
+   public:
+    sha256();
+
+    /**
+     * Append data to the message
+     */
+    void update(const void *data, std::size_t n);
+
+    /**
+     * Finish the computation, further calls of update() are not allowed
+     * @return lower case hexadecimal digest
+     */
+    std::string hexdigest();
+
+   private:
+    void transform(const unsigned char *block);
+
+    uint32_t _state[8];
+    unsigned char _block[64];
+    std::size_t _block_len;
+    uint64_t _total_len;
 };
 
 }  // namespace gdalcubes
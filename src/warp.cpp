@@ -27,6 +27,7 @@
 #include <gdalwarper.h>
 
 #include "config.h"
+#include "metrics.h"
 
 namespace gdalcubes {
 
@@ -57,6 +58,7 @@ gdalwarp_client::gdal_transformation_cache::~gdal_transformation_cache() {
 GDALDataset *gdalwarp_client::warp(GDALDataset *in, std::string s_srs, std::string t_srs, double te_left,
                                    double te_right, double te_top, double te_bottom, uint32_t ts_x, uint32_t ts_y,
                                    std::string resampling, std::vector<double> srcnodata) {
+    ++metrics::instance()->gdal_warp;
     char *wkt_out = NULL;
 
     OGRSpatialReference srs_out;
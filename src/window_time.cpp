@@ -126,13 +126,6 @@ std::shared_ptr<chunk_data> window_time_cube::read_chunk(chunkid_t id) {
     coords_nd<uint32_t, 3> size_tyx = chunk_size(id);
 
     coords_nd<uint32_t, 4> size_btyx = {uint32_t(_bands.count()), size_tyx[0], size_tyx[1], size_tyx[2]};
-    out->size(size_btyx);
-
-    // Fill buffers accordingly
-    out->buf(std::calloc(size_btyx[0] * size_btyx[1] * size_btyx[2] * size_btyx[3], sizeof(double)));
-    double* begin = (double*)out->buf();
-    double* end = ((double*)out->buf()) + size_btyx[0] * size_btyx[1] * size_btyx[2] * size_btyx[3];
-    std::fill(begin, end, NAN);
 
     uint32_t chunk_count_l = (uint32_t)std::ceil((double)_win_size_l / (double)(_in_cube->chunk_size()[0]));
     uint32_t chunk_count_r = (uint32_t)std::ceil((double)_win_size_r / (double)(_in_cube->chunk_size()[0]));
@@ -155,6 +148,23 @@ std::shared_ptr<chunk_data> window_time_cube::read_chunk(chunkid_t id) {
         r_chunks.push_back(_in_cube->read_chunk(tid));
     }
 
+    if (returns_nan_if_empty()) {
+        bool allempty = this_chunk->empty();
+        for (uint16_t i = 0; i < l_chunks.size() && allempty; ++i) allempty = l_chunks[i]->empty();
+        for (uint16_t i = 0; i < r_chunks.size() && allempty; ++i) allempty = r_chunks[i]->empty();
+        if (allempty) {
+            return out;  // propagate empty chunk
+        }
+    }
+
+    out->size(size_btyx);
+
+    // Fill buffers accordingly
+    out->buf(std::calloc(size_btyx[0] * size_btyx[1] * size_btyx[2] * size_btyx[3], sizeof(double)));
+    double* begin = (double*)out->buf();
+    double* end = ((double*)out->buf()) + size_btyx[0] * size_btyx[1] * size_btyx[2] * size_btyx[3];
+    std::fill(begin, end, NAN);
+
     // buffer for a single time series including data from adjacent chunks for all used input bands
     uint32_t cur_ts_length = _win_size_l + size_tyx[0] + _win_size_r;
     double* cur_ts = (double*)std::calloc(cur_ts_length * _bands.count(), sizeof(double));
@@ -164,7 +174,7 @@ std::shared_ptr<chunk_data> window_time_cube::read_chunk(chunkid_t id) {
         // fill values from l chunks
         int32_t tsidx = _win_size_l - 1;
         for (uint16_t i = 0; i < chunk_count_l; ++i) {
-            if (i >= l_chunks.size()) {
+            if (i >= l_chunks.size() || l_chunks[i]->empty()) {
                 // fill NA
                 for (uint32_t ic = 0; ic < _in_cube->chunk_size()[0]; ++ic) {
                     if (tsidx >= 0 && tsidx < (int32_t)cur_ts_length) {
@@ -188,19 +198,27 @@ std::shared_ptr<chunk_data> window_time_cube::read_chunk(chunkid_t id) {
 
         // fill values from current chunk
         tsidx = _win_size_l;
+        if (this_chunk->empty()) {
+            for (uint32_t ic = 0; ic < size_tyx[0]; ++ic) {
+                for (uint16_t ib = 0; ib < _bands.count(); ++ib) {
+                    cur_ts[ib * cur_ts_length + tsidx] = NAN;
+                }
+                tsidx++;
+            }
+        }
         for (uint32_t ic = 0; ic < this_chunk->size()[1]; ++ic) {
             if (tsidx >= 0 && tsidx < (int32_t)cur_ts_length) {  // read only up to window size even if current chunk is larger
                 for (uint16_t ib = 0; ib < _bands.count(); ++ib) {
                     cur_ts[ib * cur_ts_length + tsidx] = ((double*)(this_chunk->buf()))[_band_idx_in[ib] * (this_chunk->size()[1] * this_chunk->size()[2] * this_chunk->size()[3]) +
                                                                                         ic * (this_chunk->size()[2] * this_chunk->size()[3]) + ixy];
-                    tsidx++;
                 }
+                tsidx++;
             }
         }
 
         // fill values from r chunks
         for (uint16_t i = 0; i < chunk_count_r; ++i) {
-            if (i >= r_chunks.size()) {
+            if (i >= r_chunks.size() || r_chunks[i]->empty()) {
                 // fill NA
                 for (uint32_t ic = 0; ic < _in_cube->chunk_size()[0]; ++ic) {
                     if (tsidx >= 0 && tsidx < (int32_t)cur_ts_length) {
@@ -235,4 +253,37 @@ std::shared_ptr<chunk_data> window_time_cube::read_chunk(chunkid_t id) {
     return out;
 }
 
+bool window_time_cube::returns_nan_if_empty() {
+    // convolution kernels return NAN as soon as the window contains a NAN value
+    for (uint16_t i = 0; i < _reducer_bands.size(); ++i) {
+        if (_reducer_bands[i].first == "sum" || _reducer_bands[i].first == "count" || _reducer_bands[i].first == "prod") {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool window_time_cube::chunk_is_empty(chunkid_t id) {
+    if (id >= count_chunks())
+        return true;
+    if (!returns_nan_if_empty())
+        return false;
+    if (!_in_cube->chunk_is_empty(id))
+        return false;
+
+    uint32_t chunk_count_l = (uint32_t)std::ceil((double)_win_size_l / (double)(_in_cube->chunk_size()[0]));
+    uint32_t chunk_count_r = (uint32_t)std::ceil((double)_win_size_r / (double)(_in_cube->chunk_size()[0]));
+    for (uint16_t i = 1; i <= chunk_count_l; ++i) {
+        int32_t tid = id - i * (_in_cube->count_chunks_x() * _in_cube->count_chunks_y());
+        if (tid < 0) break;
+        if (!_in_cube->chunk_is_empty(tid)) return false;
+    }
+    for (uint16_t i = 1; i <= chunk_count_r; ++i) {
+        int32_t tid = id + i * (_in_cube->count_chunks_x() * _in_cube->count_chunks_y());
+        if (tid >= (int32_t)_in_cube->count_chunks()) break;
+        if (!_in_cube->chunk_is_empty(tid)) return false;
+    }
+    return true;
+}
+
 }  // namespace gdalcubes
\ No newline at end of file
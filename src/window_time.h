@@ -123,6 +123,8 @@ class window_time_cube : public cube {
 
     std::shared_ptr<chunk_data> read_chunk(chunkid_t id) override;
 
+    bool chunk_is_empty(chunkid_t id) override;
+
     json11::Json make_constructible_json() override {
         json11::Json::object out;
         out["cube_type"] = "window_time";
@@ -153,6 +155,12 @@ class window_time_cube : public cube {
     std::function<double(double *buf, uint16_t n)> get_default_reducer_by_name(std::string name);
 
     std::function<double(double *buf, uint16_t n)> get_kernel_reducer(std::vector<double> kernel);
+
+    /**
+     * @brief Check whether all window functions return NAN for windows without any valid observation
+     * @return false if at least one band uses the sum, count, or prod reducer
+     */
+    bool returns_nan_if_empty();
 };
 
 }  // namespace gdalcubes